@@ -21,7 +21,7 @@ syn keyword simitFunc         apply map to reduce print println
 
 syn keyword simitBuiltins      mod sin cos tan asin acos atan2 sqrt cbrt log exp pow  
 syn keyword simitBuiltins      clock storeTime
-syn keyword simitBuiltins      norm dot det det2 det4 inv inv2 inv4 cross lu lufree lusolve lumatsolve chol cholfree lltsolve lltmatsolve triangularSolve
+syn keyword simitBuiltins      norm dot det det2 det4 inv inv2 inv4 cross lu lufree lusolve lumatsolve chol cholfree lltsolve lltmatsolve triangularSolve cgsolve pcgsolve bicgstabsolve
 syn keyword simitBuiltins      createComplex createNorm complexGetReal complexGetImag complexConj
 
 syn keyword simitTodo contained TODO NOTE FIXME XXX
@@ -0,0 +1,124 @@
+#include "allocator.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/mman.h>
+
+#include "error.h"
+#include "util/thread_pool.h"
+
+using namespace std;
+
+namespace simit {
+extern int kNumThreads;
+extern bool kHugePages;
+
+/// The size of a transparent huge page on x86-64.
+static const size_t kHugePageSize = 2 << 20;
+
+/// Buffers smaller than this are zeroed by the calling thread.
+static const size_t kMinParallelSize = 1 << 18;
+
+// class AlignedAllocator
+void* AlignedAllocator::allocate(size_t size) {
+  bool huge = hugePages && size >= kHugePageSize;
+  size_t alignment = huge ? kHugePageSize : kBufferAlignment;
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, alignment, max(size, (size_t)1)) != 0) {
+    return nullptr;
+  }
+#ifdef MADV_HUGEPAGE
+  if (huge) {
+    madvise(ptr, size, MADV_HUGEPAGE);
+  }
+#endif
+  return ptr;
+}
+
+void AlignedAllocator::deallocate(void* ptr, size_t) {
+  free(ptr);
+}
+
+
+static AlignedAllocator defaultAllocator(false);
+static AlignedAllocator hugePageAllocator(true);
+static Allocator* installedAllocator = nullptr;
+
+void setAllocator(Allocator* allocator) {
+  installedAllocator = allocator;
+}
+
+Allocator* getAllocator() {
+  if (installedAllocator != nullptr) {
+    return installedAllocator;
+  }
+  // Both default allocators free buffers the same way, so changing the setting
+  // between allocating and freeing a buffer is safe
+  return kHugePages ? (Allocator*)&hugePageAllocator : &defaultAllocator;
+}
+
+
+namespace internal {
+
+/// Call `body(start, end)` on ranges of [0, capacity) the way set loops over
+/// `capacity` elements are split among threads, if the buffer is large enough.
+template <typename Body>
+static void forEachRange(size_t capacity, size_t bufferSize, Body body) {
+  unsigned numThreads = (bufferSize >= kMinParallelSize) ? kNumThreads : 1;
+  util::ThreadPool::getInstance().parallelFor(capacity, numThreads,
+      [&](int start, int end) {
+        body(start, end);
+      });
+}
+
+static void* allocate(size_t size) {
+  void* buffer = getAllocator()->allocate(size);
+  simit_uassert(buffer != nullptr) << "could not allocate " << size << " bytes";
+  return buffer;
+}
+
+void* allocateBuffer(size_t capacity, size_t elementSize, size_t numArrays) {
+  size_t arraySize = capacity * elementSize;
+  char* buffer = (char*)allocate(numArrays * arraySize);
+  forEachRange(capacity, numArrays * arraySize, [&](size_t start, size_t end) {
+    for (size_t a = 0; a < numArrays; ++a) {
+      memset(buffer + a*arraySize + start*elementSize, 0,
+             (end-start) * elementSize);
+    }
+  });
+  return buffer;
+}
+
+void* resizeBuffer(void* buffer, size_t oldCapacity, size_t newCapacity,
+                   size_t numElements, size_t elementSize, size_t numArrays,
+                   bool freeOld) {
+  simit_iassert(numElements <= oldCapacity && numElements <= newCapacity);
+  const char* oldBuffer = (const char*)buffer;
+  char* newBuffer = (char*)allocate(numArrays * newCapacity * elementSize);
+  forEachRange(newCapacity, numArrays * newCapacity * elementSize,
+               [&](size_t start, size_t end) {
+    size_t copyEnd = max(start, min(end, numElements));
+    for (size_t a = 0; a < numArrays; ++a) {
+      char* dst = newBuffer + (a*newCapacity + start) * elementSize;
+      const char* src = oldBuffer + (a*oldCapacity + start) * elementSize;
+      if (copyEnd > start) {
+        memcpy(dst, src, (copyEnd-start) * elementSize);
+      }
+      memset(dst + (copyEnd-start) * elementSize, 0, (end-copyEnd)*elementSize);
+    }
+  });
+  if (freeOld) {
+    freeBuffer(buffer, numArrays * oldCapacity * elementSize);
+  }
+  return newBuffer;
+}
+
+void freeBuffer(void* buffer, size_t size) {
+  if (buffer != nullptr) {
+    getAllocator()->deallocate(buffer, size);
+  }
+}
+
+}}
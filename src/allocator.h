@@ -0,0 +1,72 @@
+#ifndef SIMIT_ALLOCATOR_H
+#define SIMIT_ALLOCATOR_H
+
+#include <cstddef>
+
+namespace simit {
+
+/// The alignment, in bytes, of the field, endpoint and temporary buffers that
+/// Simit allocates. It is a cache line and the widest vector register, and
+/// compiled code assumes it when it reads these buffers.
+const size_t kBufferAlignment = 64;
+
+/// Allocates the field, endpoint and temporary buffers of sets and functions.
+/// Applications can install their own allocator with setAllocator, for example
+/// to bind buffers to specific NUMA nodes.
+class Allocator {
+public:
+  virtual ~Allocator() {}
+
+  /// Return `size` uninitialized bytes aligned to at least kBufferAlignment,
+  /// or nullptr if they cannot be allocated. `size` may be zero.
+  virtual void* allocate(size_t size) = 0;
+
+  /// Free the `size` bytes at `ptr`, returned by allocate(size).
+  virtual void deallocate(void* ptr, size_t size) = 0;
+};
+
+/// The default allocator. Buffers are aligned to kBufferAlignment, and if
+/// `hugePages` is set, buffers of at least a huge page are aligned to huge
+/// pages and backed by transparent huge pages where the kernel supports them.
+class AlignedAllocator : public Allocator {
+public:
+  explicit AlignedAllocator(bool hugePages=false) : hugePages(hugePages) {}
+
+  void* allocate(size_t size);
+  void deallocate(void* ptr, size_t size);
+
+private:
+  bool hugePages;
+};
+
+/// Install the allocator of buffers. Buffers are freed by the allocator that
+/// is installed when they are freed, so the allocator must be installed before
+/// any sets are created or functions initialized, and must outlive them. Pass
+/// nullptr to restore the default allocator.
+void setAllocator(Allocator* allocator);
+
+/// Return the allocator of buffers.
+Allocator* getAllocator();
+
+namespace internal {
+
+/// Allocate a zeroed buffer of `numArrays` arrays of `capacity` elements of
+/// `elementSize` bytes each. Large buffers are zeroed by the threads that
+/// execute set loops, each zeroing the elements it is likely to loop over, so
+/// that on NUMA machines the pages land near the threads that use them
+/// (first-touch placement).
+void* allocateBuffer(size_t capacity, size_t elementSize, size_t numArrays=1);
+
+/// Move the first `numElements` elements of each array of `buffer`, which has
+/// capacity `oldCapacity`, into a new buffer with capacity `newCapacity`, and
+/// zero the rest of the new buffer. The new buffer is placed like one from
+/// allocateBuffer. `buffer` is freed if `freeOld` is true.
+void* resizeBuffer(void* buffer, size_t oldCapacity, size_t newCapacity,
+                   size_t numElements, size_t elementSize, size_t numArrays,
+                   bool freeOld);
+
+/// Free a buffer of `size` bytes. Does nothing if `buffer` is nullptr.
+void freeBuffer(void* buffer, size_t size);
+
+}}
+#endif
@@ -445,7 +445,9 @@ void GPUBackend::compile(const ir::CallStmt& op) {
       std::string fname = callee.getName() + "3" + floatTypeName;
       call = emitCall(fname, args);
     }
-    else if (op.callee == ir::intrinsics::loc()) {
+    else if (op.callee == ir::intrinsics::loc() ||
+             op.callee == ir::intrinsics::sortedLoc()) {
+      // Sorted rows are searched linearly, which suits the GPU's short rows
       call = emitCall("loc", args, LLVM_INT);
     }
     else if (op.callee == ir::intrinsics::complexNorm()) {
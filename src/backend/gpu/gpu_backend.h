@@ -134,6 +134,9 @@ protected:
   virtual void emitMemSet(llvm::Value *dst, llvm::Value *val,
                           llvm::Value *size, unsigned align);
 
+  /// GPU buffers are allocated by the CUDA driver, not the Simit allocator
+  virtual void emitAssumeAligned(llvm::Value *ptr) {}
+
   void emitShardedMemSet(ir::Type targetType, llvm::Value *target,
                          llvm::Value *size);
 
@@ -26,14 +26,18 @@
 #include "llvm_codegen.h"
 #include "llvm_util.h"
 #include "llvm_data_layouts.h"
+#include "llvm_object_cache.h"
 
+#include "allocator.h"
 #include "macros.h"
 #include "types.h"
 #include "func.h"
 #include "ir.h"
+#include "ir_visitor.h"
 #include "intrinsics.h"
 #include "ir_printer.h"
 #include "ir_queries.h"
+#include "ir_codegen.h"
 #include "ir_transforms.h"
 #include "ir_rewriter.h" // TODO: Remove this header
 #include "environment.h"
@@ -41,12 +45,15 @@
 #include "llvm_function.h"
 #include "macros.h"
 #include "path_expressions.h"
+#include "var_replace_rewriter.h"
 #include "util/collections.h"
 
 using namespace std;
 using namespace simit::ir;
 
 namespace simit {
+extern int kNumThreads;
+
 namespace backend {
 
 const std::string VAL_SUFFIX(".val");
@@ -62,7 +69,8 @@ shared_ptr<llvm::EngineBuilder> createEngineBuilder(llvm::Module *module) {
   return engineBuilder;
 }
 
-LLVMBackend::LLVMBackend() : builder(new LLVMIRBuilder(LLVM_CTX)) {
+LLVMBackend::LLVMBackend() : builder(new LLVMIRBuilder(LLVM_CTX)),
+                             parallelLoop(nullptr) {
   if (!llvmInitialized) {
     llvm::InitializeNativeTarget();
     llvm::InitializeNativeTargetAsmPrinter();
@@ -120,6 +128,7 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   this->symtable.clear();
   this->buffers.clear();
   this->globals.clear();
+  this->allocatedGlobals.clear();
   this->storage = storage;
 
   // This backend stores dense tensors and sparse tensors with path expressions
@@ -134,12 +143,26 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   std::reverse(callTree.begin(), callTree.end());
 
   llvm::Function *llvmFunc = nullptr;
+  vector<int> spmmSites;
   for (auto &f : callTree) {
     if (f.getKind() != Func::Internal) {
       continue;
     }
     simit_iassert(f.getBody().defined());
 
+    // The runtime keeps the results of the sparse matrix products of each call
+    // site until the site is freed by the de-initialization function
+    match(f.getBody(),
+      std::function<void(const CallStmt*)>([&](const CallStmt* op) {
+        if (op->callee.getKind() == Func::External &&
+            op->callee.getName() == "spmm") {
+          simit_iassert(op->actuals.size() == 3 &&
+                        isa<Literal>(op->actuals[2]));
+          spmmSites.push_back(to<Literal>(op->actuals[2])->getIntVal(0));
+        }
+      })
+    );
+
     this->storage.add(f.getStorage());
 
     // Emit function
@@ -154,6 +177,14 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
       symtable.insert(global.first, compile(global.second));
     }
 
+    // Find the set loops to run on the thread pool. This must happen before
+    // the var decls are moved, since the decls left in a loop body tell us
+    // which variables are private to each iteration.
+    parallelLoops.clear();
+    if (kNumThreads > 1) {
+      parallelLoops = findParallelLoops(f.getBody(), this->storage);
+    }
+
     // LLVM does not de-allocate any stack memory until a function returns, so
     // we must make sure to not allocate stack memory inside a loop. To do this
     // we move all the var decls to the front of the function body
@@ -166,15 +197,16 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
   }
   simit_iassert(llvmFunc);
 
-  // Declare malloc and free if necessary
+  // Declare the runtime allocation functions if necessary
   llvm::FunctionType *m =
       llvm::FunctionType::get(LLVM_INT8_PTR, {LLVM_INT}, false);
   llvm::Function *malloc =
-      llvm::cast<llvm::Function>(module->getOrInsertFunction("malloc", m));
+      llvm::cast<llvm::Function>(module->getOrInsertFunction("simitAllocate",
+                                                             m));
   llvm::FunctionType *f =
-      llvm::FunctionType::get(LLVM_VOID, {LLVM_INT8_PTR}, false);
+      llvm::FunctionType::get(LLVM_VOID, {LLVM_INT8_PTR, LLVM_INT}, false);
   llvm::Function *free =
-      llvm::cast<llvm::Function>(module->getOrInsertFunction("free", f));
+      llvm::cast<llvm::Function>(module->getOrInsertFunction("simitFree", f));
 
   // Create initialization function
   emitEmptyFunction(func.getName()+"_init", func.getArguments(),
@@ -207,10 +239,24 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
     Var var = buffer.first;
     llvm::Value *bufferVal = buffer.second;
 
+    const TensorType *ttype = var.getType().toTensor();
+    llvm::Value *len = emitComputeLen(ttype, this->storage.getStorage(var));
+    unsigned compSize = ttype->getComponentType().bytes();
+    llvm::Value *size = builder->CreateMul(len, llvmInt(compSize));
+
     llvm::Value *tmpPtr = builder->CreateLoad(bufferVal);
     tmpPtr = builder->CreateCast(llvm::Instruction::CastOps::BitCast,
                                  tmpPtr, LLVM_INT8_PTR);
-    builder->CreateCall(free, tmpPtr);
+    builder->CreateCall(free, {tmpPtr, size});
+  }
+  if (spmmSites.size() > 0) {
+    llvm::FunctionType *freeSiteType =
+        llvm::FunctionType::get(LLVM_VOID, {LLVM_INT}, false);
+    llvm::Function *freeSpmmSite = llvm::cast<llvm::Function>(
+        module->getOrInsertFunction("simitFreeSpmmSite", freeSiteType));
+    for (int site : spmmSites) {
+      builder->CreateCall(freeSpmmSite, llvmInt(site));
+    }
   }
   builder->CreateRetVoid();
   symtable.clear();
@@ -220,32 +266,40 @@ Function* LLVMBackend::compile(ir::Func func, const ir::Storage& storage) {
 
   auto engineBuilder = createEngineBuilder(module);
 
+  // If the module's object code is cached then MCJIT loads it instead of
+  // compiling the module, so there is no need to optimize it
+  bool cached = LLVMObjectCache::getInstance().lookup(module);
+
 #ifndef SIMIT_DEBUG
-  // Run LLVM optimization passes on the function
-  // We use the built-in PassManagerBuilder to build
-  // the set of passes that are similar to clang's -O3
-  llvm::legacy::FunctionPassManager fpm(module);
-  llvm::legacy::PassManager mpm;
-  llvm::PassManagerBuilder pmBuilder;
-  
-  pmBuilder.OptLevel = 3;
+  if (!cached) {
+    // Run LLVM optimization passes on the function
+    // We use the built-in PassManagerBuilder to build
+    // the set of passes that are similar to clang's -O3
+    llvm::legacy::FunctionPassManager fpm(module);
+    llvm::legacy::PassManager mpm;
+    llvm::PassManagerBuilder pmBuilder;
 
-  pmBuilder.BBVectorize = 1;
-  pmBuilder.LoopVectorize = 1;
-//  pmBuilder.LoadCombine = 1;
-  pmBuilder.SLPVectorize = 1;
+    pmBuilder.OptLevel = 3;
 
-  llvm::DataLayout dataLayout(module);
-  module->setDataLayout(dataLayout);
+    pmBuilder.BBVectorize = 1;
+    pmBuilder.LoopVectorize = 1;
+//    pmBuilder.LoadCombine = 1;
+    pmBuilder.SLPVectorize = 1;
 
-  pmBuilder.populateFunctionPassManager(fpm);
-  pmBuilder.populateModulePassManager(mpm);
+    llvm::DataLayout dataLayout(module);
+    module->setDataLayout(dataLayout);
 
-  fpm.doInitialization();
-  fpm.run(*llvmFunc);
-  fpm.doFinalization();
-  
-  mpm.run(*module);
+    pmBuilder.populateFunctionPassManager(fpm);
+    pmBuilder.populateModulePassManager(mpm);
+
+    fpm.doInitialization();
+    fpm.run(*llvmFunc);
+    fpm.doFinalization();
+
+    mpm.run(*module);
+  }
+#else
+  (void)cached;  // Debug builds are never optimized
 #endif
 
   return new LLVMFunction(func, storage, llvmFunc, module, engineBuilder);
@@ -320,6 +374,9 @@ void LLVMBackend::compile(const ir::VarExpr& varExpr) {
       llvm::Type* eltTy = val->getType()->getPointerElementType();
       val = builder->CreateAddrSpaceCast(val, eltTy->getPointerTo(0));
     }
+    if (util::contains(allocatedGlobals, varExpr.var)) {
+      emitAssumeAligned(val);
+    }
   }
 
   // Special case: check if the symbol is a scalar and the llvm value is a ptr,
@@ -685,6 +742,22 @@ void LLVMBackend::compile(const ir::AssignStmt& assignStmt) {
       emitAssign(assignStmt.var, Add::make(assignStmt.var, assignStmt.value));
       return;
     }
+    case ir::CompoundOperator::Mul: {
+      emitAssign(assignStmt.var, Mul::make(assignStmt.var, assignStmt.value));
+      return;
+    }
+    case ir::CompoundOperator::Min: {
+      compile(IfThenElse::make(Lt::make(assignStmt.value, assignStmt.var),
+                               AssignStmt::make(assignStmt.var,
+                                                assignStmt.value)));
+      return;
+    }
+    case ir::CompoundOperator::Max: {
+      compile(IfThenElse::make(Gt::make(assignStmt.value, assignStmt.var),
+                               AssignStmt::make(assignStmt.var,
+                                                assignStmt.value)));
+      return;
+    }
     default: simit_ierror << "Unknown compound operator type";
   }
 }
@@ -957,6 +1030,9 @@ void LLVMBackend::emitIntrinsicCall(const ir::CallStmt& callStmt) {
   else if (callStmt.callee == ir::intrinsics::loc()) {
     call = emitCall("loc", args, LLVM_INT);
   }
+  else if (callStmt.callee == ir::intrinsics::sortedLoc()) {
+    call = emitCall("sortedLoc", args, LLVM_INT);
+  }
   else if (callStmt.callee == ir::intrinsics::free()) {
     auto arg = args[args.size()-1];
     arg = builder->CreateCast(llvm::Instruction::CastOps::BitCast,
@@ -984,6 +1060,12 @@ void LLVMBackend::emitIntrinsicCall(const ir::CallStmt& callStmt) {
   else if (callStmt.callee == ir::intrinsics::storeTime()) {
     call = emitCall("storeTime", args);
   }
+  else if (callStmt.callee == ir::intrinsics::profileBegin()) {
+    call = emitCall("simitProfileBegin", args);
+  }
+  else if (callStmt.callee == ir::intrinsics::profileEnd()) {
+    call = emitCall("simitProfileEnd", args);
+  }
   else if (callee == ir::intrinsics::det()) {
     simit_iassert(args.size() == 1);
     std::string fname = callStmt.callee.getName() + "3" + floatTypeName;
@@ -1082,6 +1164,36 @@ void LLVMBackend::compile(const ir::CallStmt& callStmt) {
 void LLVMBackend::compile(const ir::Store& store) {
   llvm::Value *buffer = compile(store.buffer);
   llvm::Value *index = compile(store.index);
+
+  // Compound stores to locations shared by the iterations of a parallel loop
+  if (parallelLoop != nullptr && needsAtomicUpdate(&store, *parallelLoop)) {
+    simit_iassert(store.cop == CompoundOperator::Add ||
+                  store.cop == CompoundOperator::Sub);
+    llvm::Value *value = compile(store.value);
+    if (store.cop == CompoundOperator::Sub) {
+      value = value->getType()->isFloatingPointTy()
+              ? builder->CreateFNeg(value) : builder->CreateNeg(value);
+    }
+    string locName = string(buffer->getName()) + PTR_SUFFIX;
+    llvm::Value *bufferLoc = llvmCreateInBoundsGEP(builder.get(),
+                                                   buffer, index, locName);
+    llvmCreateAtomicAdd(builder.get(), bufferLoc, value);
+    return;
+  }
+
+  // Compound min and max stores only store values that improve on the stored
+  // value
+  if (store.cop == CompoundOperator::Min ||
+      store.cop == CompoundOperator::Max) {
+    Expr stored = Load::make(store.buffer, store.index);
+    Expr improves = (store.cop == CompoundOperator::Min)
+                    ? Lt::make(store.value, stored)
+                    : Gt::make(store.value, stored);
+    compile(IfThenElse::make(improves, Store::make(store.buffer, store.index,
+                                                   store.value)));
+    return;
+  }
+
   llvm::Value *value;
   switch (store.cop) {
     case CompoundOperator::None: {
@@ -1098,6 +1210,12 @@ void LLVMBackend::compile(const ir::Store& store) {
                                 store.value));
       break;
     }
+    case CompoundOperator::Mul: {
+      value = compile(Mul::make(Load::make(store.buffer, store.index),
+                                store.value));
+      break;
+    }
+    default: simit_ierror << "Unknown compound operator type";
   }
   simit_iassert(value != nullptr);
 
@@ -1163,6 +1281,8 @@ void LLVMBackend::compile(const ir::FieldWrite& fieldWrite) {
                                      fieldWrite.value));
         break;
       }
+      default:
+        not_supported_yet << "compound field write " << fieldWrite.cop << "=";
     }
     simit_iassert(valuePtr != nullptr);
 
@@ -1283,9 +1403,26 @@ void LLVMBackend::compile(const ir::For& forLoop) {
     case ForDomain::Diagonal:
       not_supported_yet;
       break;
+    case ForDomain::Colors: {
+      simit_iassert(isa<VarExpr>(domain.set));
+      if (environment->hasColoringIndex(to<VarExpr>(domain.set)->var)) {
+        emitColorLoop(forLoop);
+        return;
+      }
+      // Only the sets bound to the compiled function are colored, so loops
+      // over the sets of called functions visit their elements in order.
+      iNum = emitComputeLen(domain.indexSet);
+      break;
+    }
   }
   simit_iassert(iNum);
 
+  if (parallelLoop == nullptr && domain.kind != ForDomain::Colors &&
+      util::contains(parallelLoops, forLoop.var)) {
+    emitParallelFor(forLoop, iNum);
+    return;
+  }
+
   llvm::Function *llvmFunc = builder->GetInsertBlock()->getParent();
 
   // Loop Header
@@ -1319,6 +1456,337 @@ void LLVMBackend::compile(const ir::For& forLoop) {
   builder->SetInsertPoint(loopEnd);
 }
 
+/// Returns the variables referenced by `stmt`, including the sets and tensor
+/// indices needed to compute the sizes of the tensors it refers to.
+static vector<Var> getReferencedVars(const Stmt& stmt, const Storage& storage) {
+  class ReferencedVars : public IRVisitor {
+  public:
+    ReferencedVars(const Storage& storage) : storage(storage) {}
+    vector<Var> vars;
+
+  private:
+    const Storage& storage;
+    set<Var> visited;
+
+    void add(const Var& var) {
+      if (util::contains(visited, var)) {
+        return;
+      }
+      visited.insert(var);
+      vars.push_back(var);
+
+      if (var.getType().isTensor()) {
+        for (auto& dim : var.getType().toTensor()->getDimensions()) {
+          for (auto& indexSet : dim.getIndexSets()) {
+            if (indexSet.getKind() == IndexSet::Set) {
+              indexSet.getSet().accept(this);
+            }
+          }
+        }
+        if (storage.hasStorage(var) &&
+            storage.getStorage(var).getKind() == TensorStorage::Indexed) {
+          const TensorIndex& index = storage.getStorage(var).getTensorIndex();
+          add(index.getRowptrArray());
+          add(index.getColidxArray());
+        }
+      }
+    }
+
+    using IRVisitor::visit;
+
+    void visit(const VarExpr* op) {
+      add(op->var);
+    }
+
+    void visit(const AssignStmt* op) {
+      add(op->var);
+      IRVisitor::visit(op);
+    }
+
+    void visit(const CallStmt* op) {
+      for (auto& result : op->results) {
+        add(result);
+      }
+      IRVisitor::visit(op);
+    }
+
+    void visit(const For* op) {
+      if (op->domain.kind == ForDomain::IndexSet &&
+          op->domain.indexSet.getKind() == IndexSet::Set) {
+        op->domain.indexSet.getSet().accept(this);
+      }
+      else if (op->domain.kind == ForDomain::Colors) {
+        op->domain.set.accept(this);
+      }
+      IRVisitor::visit(op);
+    }
+  };
+  ReferencedVars referencedVars(storage);
+  stmt.accept(&referencedVars);
+  return referencedVars.vars;
+}
+
+void LLVMBackend::emitParallelFor(const ir::For& forLoop, llvm::Value* iNum,
+                                  llvm::Value* elements) {
+  std::string iName = forLoop.var.getName();
+  const ParallelLoop& loop = parallelLoops.at(forLoop.var);
+
+  llvm::Function *llvmFunc = builder->GetInsertBlock()->getParent();
+  llvm::BasicBlock *parentBlock = builder->GetInsertBlock();
+
+  // The worker receives the values it uses from this function in a closure.
+  // Constants and globals are visible from the worker and need not be passed.
+  vector<Var> captured;
+  vector<llvm::Value*> capturedValues;
+  vector<llvm::Type*> capturedTypes;
+  for (const Var& var : getReferencedVars(forLoop.body, storage)) {
+    if (var == forLoop.var || util::contains(loop.privates, var) ||
+        !symtable.contains(var)) {
+      continue;
+    }
+    llvm::Value *value = symtable.get(var);
+    if (llvm::isa<llvm::Constant>(value)) {
+      continue;
+    }
+    captured.push_back(var);
+    capturedValues.push_back(value);
+    capturedTypes.push_back(value->getType());
+  }
+  if (elements != nullptr) {
+    capturedValues.push_back(elements);
+    capturedTypes.push_back(elements->getType());
+  }
+  llvm::StructType *closureType = llvm::StructType::get(LLVM_CTX,
+                                                        capturedTypes);
+
+  // Allocate the closure in the entry block, so that loops around this one do
+  // not grow the stack
+  llvm::BasicBlock *funcEntry = &llvmFunc->getEntryBlock();
+  builder->SetInsertPoint(funcEntry, funcEntry->begin());
+  llvm::Value *closure = builder->CreateAlloca(closureType, nullptr,
+                                               iName+"_closure");
+  builder->SetInsertPoint(parentBlock);
+  for (size_t i = 0; i < capturedValues.size(); ++i) {
+    builder->CreateStore(capturedValues[i],
+                         llvmCreateStructGEP(builder.get(), closureType,
+                                             closure, i));
+  }
+
+  // Emit the worker function: void worker(int start, int end, i8* closure)
+  llvm::FunctionType *workerType =
+      llvm::FunctionType::get(LLVM_VOID, {LLVM_INT, LLVM_INT, LLVM_INT8_PTR},
+                              false);
+  llvm::Function *worker =
+      llvm::Function::Create(workerType, llvm::Function::InternalLinkage,
+                             string(llvmFunc->getName())+"_"+iName+"_worker",
+                             module);
+  worker->setDoesNotThrow();
+  auto workerArgs = worker->getArgumentList().begin();
+  llvm::Value *rangeStart = &(*workerArgs++);
+  llvm::Value *rangeEnd = &(*workerArgs++);
+  llvm::Value *workerClosure = &(*workerArgs++);
+  rangeStart->setName(iName+"_start");
+  rangeEnd->setName(iName+"_end");
+
+  llvm::BasicBlock *workerEntry =
+      llvm::BasicBlock::Create(LLVM_CTX, "entry", worker);
+  builder->SetInsertPoint(workerEntry);
+  symtable.scope();
+
+  workerClosure = builder->CreateBitCast(workerClosure,
+                                         closureType->getPointerTo());
+  for (size_t i = 0; i < captured.size(); ++i) {
+    llvm::Value *capturedPtr = llvmCreateStructGEP(builder.get(), closureType,
+                                                   workerClosure, i);
+    symtable.insert(captured[i], builder->CreateLoad(capturedPtr,
+                                                     captured[i].getName()));
+  }
+  llvm::Value *workerElements = nullptr;
+  if (elements != nullptr) {
+    llvm::Value *elementsPtr = llvmCreateStructGEP(builder.get(), closureType,
+                                                   workerClosure,
+                                                   captured.size());
+    workerElements = builder->CreateLoad(elementsPtr, iName+"_elements");
+  }
+
+  // Each worker gets its own copy of the variables declared in the loop body
+  for (const Var& var : loop.privates) {
+    simit_iassert(var.getType().isTensor());
+    const TensorType *type = var.getType().toTensor();
+    llvm::Type *ctype = llvmType(type->getComponentType());
+    llvm::Value *llvmVar;
+    if (isScalar(var.getType())) {
+      llvmVar = builder->CreateAlloca(ctype, nullptr, var.getName());
+      if (isString(var.getType())) {
+        builder->CreateStore(defaultInitializer(ctype), llvmVar);
+      }
+    }
+    else {
+      llvm::Value *len = emitComputeLen(type, storage.getStorage(var));
+      llvmVar = builder->CreateAlloca(ctype, len, var.getName());
+    }
+    symtable.insert(var, llvmVar);
+  }
+
+  // Each worker reduces into partial results of its own, which start from the
+  // identity of the reduction
+  Stmt body = forLoop.body;
+  vector<pair<Var,Var>> partials;
+  for (auto& reduction : loop.reductions) {
+    const Var& var = reduction.first;
+    const TensorType *type = var.getType().toTensor();
+    Var partial(var.getName()+"_partial", var.getType());
+    body = replaceVar(body, var, partial);
+    partials.push_back({var, partial});
+
+    llvm::Type *ctype = llvmType(type->getComponentType());
+    symtable.insert(partial, builder->CreateAlloca(ctype, nullptr,
+                                                   partial.getName()));
+    compile(AssignStmt::make(partial, getIdentityVal(type, reduction.second)));
+  }
+
+  // Loop Header
+  llvm::BasicBlock *loopBodyStart =
+      llvm::BasicBlock::Create(LLVM_CTX, iName+"_loop_body", worker);
+  llvm::BasicBlock *loopEnd = llvm::BasicBlock::Create(LLVM_CTX,
+                                                       iName+"_loop_end",
+                                                       worker);
+  llvm::Value *firstCmp = llvmCreateICmpSLT(builder.get(),
+                                            rangeStart, rangeEnd);
+  builder->CreateCondBr(firstCmp, loopBodyStart, loopEnd);
+  builder->SetInsertPoint(loopBodyStart);
+
+  llvm::PHINode *i = llvmCreatePHI(builder.get(), LLVM_INT32, 2, iName);
+  i->addIncoming(rangeStart, workerEntry);
+
+  // Loop Body
+  parallelLoop = &loop;
+  if (workerElements != nullptr) {
+    llvm::Value *elementPtr = llvmCreateInBoundsGEP(builder.get(),
+                                                    workerElements, i);
+    symtable.insert(forLoop.var, builder->CreateLoad(elementPtr, iName));
+  }
+  else {
+    symtable.insert(forLoop.var, i);
+  }
+  compile(body);
+  parallelLoop = nullptr;
+
+  // Loop Footer
+  llvm::BasicBlock *loopBodyEnd = builder->GetInsertBlock();
+  llvm::Value *i_nxt = builder->CreateAdd(i, builder->getInt32(1),
+                                          iName+"_nxt", false, true);
+  i->addIncoming(i_nxt, loopBodyEnd);
+
+  llvm::Value *exitCond = llvmCreateICmpSLT(builder.get(), i_nxt, rangeEnd,
+                                            iName+"_cmp");
+  builder->CreateCondBr(exitCond, loopBodyStart, loopEnd);
+  builder->SetInsertPoint(loopEnd);
+
+  // Combine the partial results into the reduction variables, one worker at a
+  // time
+  if (partials.size() > 0) {
+    emitCall("simitLockReductions", {});
+    for (auto& partial : partials) {
+      compile(AssignStmt::make(partial.first, partial.second,
+                               loop.reductions.at(partial.first)));
+    }
+    emitCall("simitUnlockReductions", {});
+  }
+  builder->CreateRetVoid();
+  symtable.unscope();
+
+  // Run the worker on the thread pool
+  builder->SetInsertPoint(parentBlock);
+  emitCall("simitParallelFor",
+           {iNum, builder->CreateBitCast(worker, LLVM_INT8_PTR),
+            builder->CreateBitCast(closure, LLVM_INT8_PTR)});
+}
+
+void LLVMBackend::emitColorLoop(const ir::For& forLoop) {
+  std::string iName = forLoop.var.getName();
+  ForDomain domain = forLoop.domain;
+  const ColoringIndex& coloring =
+      environment->getColoringIndex(to<VarExpr>(domain.set)->var);
+
+  llvm::Value *colorsPtr = compile(VarExpr::make(coloring.colorsPtr));
+  llvm::Value *elements = compile(VarExpr::make(coloring.elements));
+  llvm::Value *setSize = emitComputeLen(domain.indexSet);
+
+  llvm::Function *llvmFunc = builder->GetInsertBlock()->getParent();
+  llvm::BasicBlock *entryBlock = builder->GetInsertBlock();
+  llvm::BasicBlock *colorHeader =
+      llvm::BasicBlock::Create(LLVM_CTX, iName+"_color_header", llvmFunc);
+  llvm::BasicBlock *colorBody =
+      llvm::BasicBlock::Create(LLVM_CTX, iName+"_color_body", llvmFunc);
+  llvm::BasicBlock *colorEnd =
+      llvm::BasicBlock::Create(LLVM_CTX, iName+"_color_end", llvmFunc);
+  builder->CreateBr(colorHeader);
+
+  // Every color has at least one element, so the colors end where the start
+  // of the next color reaches the size of the set.
+  builder->SetInsertPoint(colorHeader);
+  llvm::PHINode *c = llvmCreatePHI(builder.get(), LLVM_INT32, 2,
+                                   iName+"_color");
+  c->addIncoming(builder->getInt32(0), entryBlock);
+  llvm::Value *colorStart =
+      builder->CreateLoad(llvmCreateInBoundsGEP(builder.get(), colorsPtr, c),
+                          iName+"_color_start");
+  llvm::Value *moreColors = llvmCreateICmpSLT(builder.get(), colorStart,
+                                              setSize);
+  builder->CreateCondBr(moreColors, colorBody, colorEnd);
+
+  builder->SetInsertPoint(colorBody);
+  llvm::Value *c_nxt = builder->CreateAdd(c, builder->getInt32(1),
+                                          iName+"_color_nxt", false, true);
+  llvm::Value *colorEndIdx =
+      builder->CreateLoad(llvmCreateInBoundsGEP(builder.get(), colorsPtr,
+                                                c_nxt),
+                          iName+"_color_end");
+  llvm::Value *colorSize = builder->CreateSub(colorEndIdx, colorStart,
+                                              iName+"_color_size");
+  llvm::Value *colorElements = llvmCreateInBoundsGEP(builder.get(), elements,
+                                                     colorStart);
+
+  if (parallelLoop == nullptr && util::contains(parallelLoops, forLoop.var)) {
+    emitParallelFor(forLoop, colorSize, colorElements);
+  }
+  else {
+    // Loop Header
+    llvm::BasicBlock *loopEntry = builder->GetInsertBlock();
+    llvm::BasicBlock *loopBodyStart =
+        llvm::BasicBlock::Create(LLVM_CTX, iName+"_loop_body", llvmFunc);
+    llvm::BasicBlock *loopEnd =
+        llvm::BasicBlock::Create(LLVM_CTX, iName+"_loop_end", llvmFunc);
+    builder->CreateBr(loopBodyStart);
+    builder->SetInsertPoint(loopBodyStart);
+
+    llvm::PHINode *k = llvmCreatePHI(builder.get(), LLVM_INT32, 2,
+                                     iName+"_k");
+    k->addIncoming(builder->getInt32(0), loopEntry);
+
+    // Loop Body
+    llvm::Value *elementPtr = llvmCreateInBoundsGEP(builder.get(),
+                                                    colorElements, k);
+    symtable.insert(forLoop.var, builder->CreateLoad(elementPtr, iName));
+    compile(forLoop.body);
+
+    // Loop Footer
+    llvm::BasicBlock *loopBodyEnd = builder->GetInsertBlock();
+    llvm::Value *k_nxt = builder->CreateAdd(k, builder->getInt32(1),
+                                            iName+"_k_nxt", false, true);
+    k->addIncoming(k_nxt, loopBodyEnd);
+    llvm::Value *exitCond = llvmCreateICmpSLT(builder.get(), k_nxt, colorSize,
+                                              iName+"_k_cmp");
+    builder->CreateCondBr(exitCond, loopBodyStart, loopEnd);
+    builder->SetInsertPoint(loopEnd);
+  }
+
+  c->addIncoming(c_nxt, builder->GetInsertBlock());
+  builder->CreateBr(colorHeader);
+  builder->SetInsertPoint(colorEnd);
+}
+
 void LLVMBackend::compile(const ir::While& whileLoop) {
   llvm::Function *llvmFunc = builder->GetInsertBlock()->getParent();
 
@@ -1428,8 +1896,13 @@ llvm::Value *LLVMBackend::emitFieldRead(const Expr &elemOrSet,
   
   assert(elemType->hasField(fieldName));
   unsigned fieldLoc = fieldsOffset + elemType->fieldNames.at(fieldName);
-  return llvmCreateExtractValue(builder.get(), setOrElemValue, {fieldLoc},
-                                setOrElemValue->getName()+"."+fieldName);
+  llvm::Value *fieldPtr =
+      llvmCreateExtractValue(builder.get(), setOrElemValue, {fieldLoc},
+                             setOrElemValue->getName()+"."+fieldName);
+  if (elemOrSet.type().isSet()) {
+    emitAssumeAligned(fieldPtr);
+  }
+  return fieldPtr;
 }
 
 llvm::Value *LLVMBackend::emitComputeLen(const TensorType *tensorType,
@@ -1670,6 +2143,7 @@ void LLVMBackend::emitGlobals(const ir::Environment& env, bool packed) {
                                              globalAddrspace(), packed);
     this->symtable.insert(tmp, ptr);
     this->globals.insert(tmp);
+    this->allocatedGlobals.insert(tmp);
   }
 
   // Emit global tensor indices
@@ -1690,6 +2164,27 @@ void LLVMBackend::emitGlobals(const ir::Environment& env, bool packed) {
       this->globals.insert(colidx);
     }
   }
+
+  // Emit global coloring indices
+  for (const ColoringIndex& coloringIndex : env.getColoringIndices()) {
+    for (const Var& array : {coloringIndex.colorsPtr, coloringIndex.elements}) {
+      llvm::GlobalVariable* arrayPtr =
+          createGlobal(module, array, llvm::GlobalValue::ExternalLinkage,
+                       globalAddrspace(), packed);
+      this->symtable.insert(array, arrayPtr);
+      this->globals.insert(array);
+    }
+  }
+
+  // Emit global location tables
+  for (const LocationTable& locationTable : env.getLocationTables()) {
+    const Var& table = locationTable.table;
+    llvm::GlobalVariable* tablePtr =
+        createGlobal(module, table, llvm::GlobalValue::ExternalLinkage,
+                     globalAddrspace(), packed);
+    this->symtable.insert(table, tablePtr);
+    this->globals.insert(table);
+  }
 }
 
 void LLVMBackend::emitAssign(Var var, const Expr& value) {
@@ -1741,6 +2236,12 @@ void LLVMBackend::emitAssign(Var var, const Expr& value) {
              ((int*)to<Literal>(value)->data)[0] == 0)) {
           emitMemSet(varPtr, llvmInt(0,8), size, componentSize);
         }
+        // Assigning another literal to a tensor, such as the identity of a
+        // min or max reduction
+        else if (sType.kind == ScalarType::Float ||
+                 sType.kind == ScalarType::Int) {
+          emitFill(varPtr, valuePtr, len);
+        }
         else {
           not_supported_yet << "Cannot assign non-zero value to tensor:"
                             << std::endl
@@ -1773,6 +2274,36 @@ void LLVMBackend::emitMemSet(llvm::Value *dst, llvm::Value *val,
   builder->CreateMemSet(dst, val, size, align);
 }
 
+void LLVMBackend::emitFill(llvm::Value *dst, llvm::Value *val,
+                           llvm::Value *len) {
+  llvm::Function *llvmFunc = builder->GetInsertBlock()->getParent();
+  llvm::BasicBlock *entryBlock = builder->GetInsertBlock();
+  llvm::BasicBlock *fillBody = llvm::BasicBlock::Create(LLVM_CTX, "fill_body",
+                                                        llvmFunc);
+  llvm::BasicBlock *fillEnd = llvm::BasicBlock::Create(LLVM_CTX, "fill_end",
+                                                       llvmFunc);
+  llvm::Value *firstCmp = llvmCreateICmpSLT(builder.get(), llvmInt(0), len);
+  builder->CreateCondBr(firstCmp, fillBody, fillEnd);
+  builder->SetInsertPoint(fillBody);
+
+  llvm::PHINode *i = llvmCreatePHI(builder.get(), LLVM_INT32, 2, "fill_i");
+  i->addIncoming(llvmInt(0), entryBlock);
+  llvm::Value *loc = llvmCreateInBoundsGEP(builder.get(), dst, i, "fill_ptr");
+  builder->CreateStore(val, loc);
+
+  llvm::Value *i_nxt = builder->CreateAdd(i, builder->getInt32(1), "fill_nxt",
+                                          false, true);
+  i->addIncoming(i_nxt, fillBody);
+  llvm::Value *exitCond = llvmCreateICmpSLT(builder.get(), i_nxt, len,
+                                            "fill_cmp");
+  builder->CreateCondBr(exitCond, fillBody, fillEnd);
+  builder->SetInsertPoint(fillEnd);
+}
+
+void LLVMBackend::emitAssumeAligned(llvm::Value *ptr) {
+  builder->CreateAlignmentAssumption(*dataLayout, ptr, kBufferAlignment);
+}
+
 llvm::Value *LLVMBackend::makeGlobalTensor(ir::Var var) {
   // Allocate buffer for local variable in global storage.
   // TODO: We should allocate small local dense tensors on the stack
@@ -1792,7 +2323,9 @@ llvm::Value *LLVMBackend::makeGlobalTensor(ir::Var var) {
   buffers.insert(pair<Var, llvm::Value*>(var, buffer));
 
   // Add load to symtable
-  return builder->CreateLoad(buffer, buffer->getName());
+  llvm::Value *bufferPtr = builder->CreateLoad(buffer, buffer->getName());
+  emitAssumeAligned(bufferPtr);
+  return bufferPtr;
 }
 
 }}
@@ -12,6 +12,7 @@
 
 #include "storage.h"
 #include "var.h"
+#include "parallel_loops.h"
 #include "backend/backend_visitor.h"
 #include "util/scopedmap.h"
 
@@ -57,6 +58,9 @@ protected:
   std::map<ir::Var, llvm::Value*> buffers;
 
   std::set<ir::Var> globals;
+
+  // Globals that point to buffers from the Simit allocator (temporaries)
+  std::set<ir::Var> allocatedGlobals;
   ir::Storage storage;
   const ir::Environment* environment;
 
@@ -65,6 +69,11 @@ protected:
 
   std::unique_ptr<LLVMIRBuilder> builder;
 
+  /// Set loops that are outlined and executed on the thread pool, and the
+  /// loop whose worker function is currently being emitted.
+  std::map<ir::Var, ir::ParallelLoop> parallelLoops;
+  const ir::ParallelLoop* parallelLoop;
+
   using BackendImpl::compile;
   virtual Function* compile(ir::Func func, const ir::Storage& storage);
 
@@ -161,6 +170,13 @@ protected:
   virtual void emitMemSet(llvm::Value *dst, llvm::Value *val,
                           llvm::Value *size, unsigned align);
 
+  /// Emit a loop that stores `val` to the `len` components of `dst`
+  void emitFill(llvm::Value *dst, llvm::Value *val, llvm::Value *len);
+
+  /// Tell the optimizer that `ptr` points to a buffer from the Simit
+  /// allocator, which is aligned to kBufferAlignment
+  virtual void emitAssumeAligned(llvm::Value *ptr);
+
   /// Allocate a global pointer for a tensor, and add to the symtable
   /// and list of global buffers
   virtual llvm::Value *makeGlobalTensor(ir::Var var);
@@ -192,6 +208,16 @@ protected:
   /// Emit a call to an intrinsic
   void emitIntrinsicCall(const ir::CallStmt& callStmt);
 
+  /// Outline the body of `forLoop` into a worker function and emit a call that
+  /// runs it over [0, iNum) on the thread pool. If `elements` is given then
+  /// iteration i runs the body for element elements[i].
+  void emitParallelFor(const ir::For& forLoop, llvm::Value* iNum,
+                       llvm::Value* elements=nullptr);
+
+  /// Emit a loop over the colors of an edge set, that runs the body of
+  /// `forLoop` for the elements of each color.
+  void emitColorLoop(const ir::For& forLoop);
+
   // TODO: Remove this function, once the old init system has been removed
   ir::Func makeSystemTensorsGlobal(ir::Func func);
 
@@ -65,6 +65,13 @@ llvm::Value *llvmCreateICmpSLE(LLVMIRBuilder *builder, llvm::Value*,
                                llvm::Value *, const llvm::Twine &name = "");
 llvm::PHINode *llvmCreatePHI(LLVMIRBuilder *builder, llvm::Type *, unsigned,
                              const llvm::Twine &name = "");
+llvm::Value *llvmCreateStructGEP(LLVMIRBuilder *builder, llvm::Type *,
+                                 llvm::Value *, unsigned,
+                                 const llvm::Twine &name = "");
+
+/// Atomically add `val` to the int or floating-point location `ptr`.
+void llvmCreateAtomicAdd(LLVMIRBuilder *builder, llvm::Value *ptr,
+                         llvm::Value *val);
 
 llvm::ConstantInt* llvmInt(long long int val, unsigned bits=32);
 llvm::ConstantInt* llvmUInt(long long unsigned int val, unsigned bits=32);
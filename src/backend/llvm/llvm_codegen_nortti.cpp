@@ -100,4 +100,49 @@ PHINode *llvmCreatePHI(LLVMIRBuilder *builder, Type *ty, unsigned num,
   return builder->CreatePHI(ty, num, name);
 }
 
+Value *llvmCreateStructGEP(LLVMIRBuilder *builder, Type *ty, Value *ptr,
+                           unsigned idx, const Twine &name) {
+  return builder->CreateStructGEP(ty, ptr, idx, name);
+}
+
+void llvmCreateAtomicAdd(LLVMIRBuilder *builder, Value *ptr, Value *val) {
+  Type *type = val->getType();
+  if (type->isIntegerTy()) {
+    builder->CreateAtomicRMW(AtomicRMWInst::Add, ptr, val,
+                             AtomicOrdering::Monotonic);
+    return;
+  }
+
+  // There is no floating-point atomicrmw, so we retry a compare-and-swap on
+  // the integer representation of the value until no other thread has
+  // updated the location between our load and our store.
+  unsigned bits = type->getPrimitiveSizeInBits();
+  Type *intType = builder->getIntNTy(bits);
+  unsigned addrspace = ptr->getType()->getPointerAddressSpace();
+  Value *intPtr = builder->CreateBitCast(ptr, intType->getPointerTo(addrspace));
+  LoadInst *initial = builder->CreateLoad(intPtr);
+  initial->setAlignment(bits/8);
+  initial->setAtomic(AtomicOrdering::Monotonic);
+
+  BasicBlock *entryBlock = builder->GetInsertBlock();
+  Function *func = entryBlock->getParent();
+  BasicBlock *retryBlock = BasicBlock::Create(LLVM_CTX, "atomic_add", func);
+  BasicBlock *exitBlock = BasicBlock::Create(LLVM_CTX, "atomic_add_end", func);
+  builder->CreateBr(retryBlock);
+
+  builder->SetInsertPoint(retryBlock);
+  PHINode *expected = builder->CreatePHI(intType, 2);
+  expected->addIncoming(initial, entryBlock);
+  Value *sum = builder->CreateFAdd(builder->CreateBitCast(expected, type), val);
+  Value *result =
+      builder->CreateAtomicCmpXchg(intPtr, expected,
+                                   builder->CreateBitCast(sum, intType),
+                                   AtomicOrdering::Monotonic,
+                                   AtomicOrdering::Monotonic);
+  expected->addIncoming(builder->CreateExtractValue(result, 0), retryBlock);
+  builder->CreateCondBr(builder->CreateExtractValue(result, 1),
+                        exitBlock, retryBlock);
+  builder->SetInsertPoint(exitBlock);
+}
+
 }}
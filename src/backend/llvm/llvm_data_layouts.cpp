@@ -245,9 +245,21 @@ std::shared_ptr<SetLayout> getSetLayout(
   }
 }
 
+/// Compiled code strides the components of SoA fields by the set size, so sets
+/// with SoA fields give up their spare capacity before their data is bound.
+static void packSoAFields(Set *actual) {
+  for (const Set::FieldData *field : actual->getFields()) {
+    if (field->layout == Set::SoA) {
+      actual->shrinkToFit();
+      return;
+    }
+  }
+}
+
 /// Build llvm set struct from runtime Set object
 llvm::Value* makeSet(Set *actual, ir::Type type) {
   simit_iassert(type.isSet());
+  packSoAFields(actual);
   if (type.isUnstructuredSet()) {
     if (type.toUnstructuredSet()->getCardinality() == 0) {
       return UnstructuredSetLayout::makeSet(actual, type);
@@ -268,6 +280,7 @@ llvm::Value* makeSet(Set *actual, ir::Type type) {
 /// Write set pointers to extern pointer structure
 void writeSet(Set *actual, ir::Type type, void *externPtr) {
   simit_iassert(type.isSet());
+  packSoAFields(actual);
   if (type.isUnstructuredSet()) {
     if (type.toUnstructuredSet()->getCardinality() == 0) {
       return UnstructuredSetLayout::writeSet(actual, type, externPtr);
@@ -3,6 +3,11 @@
 
 /// Define data layouts for set types in one consistent location.
 /// All references to set data layouts should refer to this interface.
+///
+/// Each field <f> points to the field's data. The tensors of AoS fields are
+/// stored one after the other, while SoA fields store component c of element i
+/// at c*<size> + i, where <size> is the total size of the set (see
+/// ir::Field::Layout).
 
 #include "ir.h"
 
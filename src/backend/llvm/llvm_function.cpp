@@ -1,5 +1,7 @@
 #include "llvm_function.h"
 
+#include <algorithm>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -15,9 +17,12 @@
 #include "llvm_types.h"
 #include "llvm_codegen.h"
 #include "llvm_data_layouts.h"
+#include "llvm_object_cache.h"
 
 #include "backend/actual.h"
+#include "allocator.h"
 #include "graph.h"
+#include "coloring.h"
 #include "tensor_index.h"
 #include "path_indices.h"
 #include "util/collections.h"
@@ -28,6 +33,8 @@ using namespace std;
 using namespace simit::ir;
 
 namespace simit {
+extern int kNumThreads;
+
 namespace backend {
 
 typedef void (*FuncPtrType)();
@@ -38,7 +45,7 @@ LLVMFunction::LLVMFunction(ir::Func func, const ir::Storage &storage,
                            bool skipEEInit)
     : Function(func), initialized(false), llvmFunc(llvmFunc), module(module),
       harnessModule(new llvm::Module("simit_harness", LLVM_CTX)),
-      storage(storage),
+      storage(storage), pathIndexBuilder(new pe::PathIndexBuilder()),
       engineBuilder(engineBuilder),
       harnessEngineBuilder(new llvm::EngineBuilder(
           std::unique_ptr<llvm::Module>(harnessModule))),
@@ -56,6 +63,9 @@ LLVMFunction::LLVMFunction(ir::Func func, const ir::Storage &storage,
   engineBuilder->setErrorStr(&errStr);
   this->executionEngine.reset(engineBuilder->create());
   simit_iassert((bool)this->executionEngine) << errStr;
+  if (LLVMObjectCache::getInstance().isEnabled()) {
+    executionEngine->setObjectCache(&LLVMObjectCache::getInstance());
+  }
   harnessEngineBuilder->setErrorStr(&errStr);
   this->harnessExecEngine.reset(harnessEngineBuilder->create());
   simit_iassert((bool)this->harnessExecEngine) << errStr;
@@ -117,6 +127,33 @@ LLVMFunction::LLVMFunction(ir::Func func, const ir::Storage &storage,
       not_supported_yet;
     }
   }
+
+  // Initialize global coloring index ptrs
+  for (const ColoringIndex& coloringIndex : env.getColoringIndices()) {
+    uint64_t addr;
+
+    addr = executionEngine->getGlobalValueAddress(
+        coloringIndex.colorsPtr.getName());
+    const int** colorsPtrPtr = (const int**)addr;
+    *colorsPtrPtr = nullptr;
+
+    addr = executionEngine->getGlobalValueAddress(
+        coloringIndex.elements.getName());
+    const int** elementsPtr = (const int**)addr;
+    *elementsPtr = nullptr;
+
+    coloringIndexPtrs.insert({coloringIndex.set.getName(),
+                              {colorsPtrPtr, elementsPtr}});
+  }
+
+  // Initialize global location table ptrs
+  for (const LocationTable& locationTable : env.getLocationTables()) {
+    const string& name = locationTable.table.getName();
+    uint64_t addr = executionEngine->getGlobalValueAddress(name);
+    const int** tablePtr = (const int**)addr;
+    *tablePtr = nullptr;
+    locationTablePtrs.insert({name, tablePtr});
+  }
 }
 
 LLVMFunction::~LLVMFunction() {
@@ -124,8 +161,10 @@ LLVMFunction::~LLVMFunction() {
     deinit();
   }
   for (auto& tmpPtr : temporaryPtrs) {
-    free(*tmpPtr.second);
-    *tmpPtr.second = nullptr;
+    if (*tmpPtr.second != nullptr) {
+      internal::freeBuffer(*tmpPtr.second, temporarySizes.at(tmpPtr.first));
+      *tmpPtr.second = nullptr;
+    }
   }
 }
 
@@ -225,15 +264,7 @@ size_t LLVMFunction::size(const ir::IndexDomain& dimension) {
             << "Attempting to get the static size of a runtime dynamic set: "
             << quote(setExpr);
         string setName = ir::to<ir::VarExpr>(setExpr)->var.getName();
-
-        simit_iassert(util::contains(arguments, setName) ||
-                util::contains(globals, setName));
-        Actual* setActual = util::contains(arguments, setName)
-                            ? arguments.at(setName).get()
-                            : globals.at(setName).get();
-        simit_iassert(isa<SetActual>(setActual));
-        Set* set = to<SetActual>(setActual)->getSet();
-        result *= set->getSize();
+        result *= getBoundSet(setName)->getSize();
         break;
       }
       case ir::IndexSet::Single:
@@ -245,22 +276,119 @@ size_t LLVMFunction::size(const ir::IndexDomain& dimension) {
   return result;
 }
 
+Set* LLVMFunction::getBoundSet(const std::string& name) {
+  simit_iassert(util::contains(arguments, name) ||
+                util::contains(globals, name));
+  Actual* setActual = util::contains(arguments, name)
+                      ? arguments.at(name).get()
+                      : globals.at(name).get();
+  simit_iassert(isa<SetActual>(setActual));
+  return to<SetActual>(setActual)->getSet();
+}
+
+/// Find the location of `col` in row `row` of a CSR index. Rows are searched
+/// with a binary search, and if they turn out not to be sorted, linearly.
+static int findLocation(unsigned row, unsigned col,
+                        const uint32_t* rowptr, const uint32_t* colidx) {
+  const uint32_t* rowStart = colidx + rowptr[row];
+  const uint32_t* rowEnd = colidx + rowptr[row+1];
+  const uint32_t* it = std::lower_bound(rowStart, rowEnd, col);
+  if (it == rowEnd || *it != col) {
+    it = std::find(rowStart, rowEnd, col);
+  }
+  simit_iassert(it != rowEnd)
+      << "(" << row << "," << col << ") is not in the tensor index";
+  return it - colidx;
+}
+
+/// Compute the location table of `edgeSet` (see ir::LocationTable).
+static vector<int> buildLocationTable(ir::LocationTable::Kind kind,
+                                      const Set* edgeSet,
+                                      const uint32_t* rowptr,
+                                      const uint32_t* colidx) {
+  const int cardinality = edgeSet->getCardinality();
+  vector<int> table;
+  if (kind == ir::LocationTable::VV) {
+    table.resize(edgeSet->getSize() * cardinality * cardinality);
+    for (ElementRef e : *edgeSet) {
+      int* elemLocs = &table[e.getIdent() * cardinality * cardinality];
+      for (int i = 0; i < cardinality; ++i) {
+        unsigned row = edgeSet->getEndpoint(e, i).getIdent();
+        for (int j = 0; j < cardinality; ++j) {
+          unsigned col = edgeSet->getEndpoint(e, j).getIdent();
+          elemLocs[i*cardinality + j] = findLocation(row, col, rowptr, colidx);
+        }
+      }
+    }
+  }
+  else {
+    table.resize(edgeSet->getSize() * cardinality);
+    for (ElementRef e : *edgeSet) {
+      int* elemLocs = &table[e.getIdent() * cardinality];
+      for (int i = 0; i < cardinality; ++i) {
+        unsigned row = edgeSet->getEndpoint(e, i).getIdent();
+        elemLocs[i] = findLocation(row, e.getIdent(), rowptr, colidx);
+      }
+    }
+  }
+  return table;
+}
+
 Function::FuncType LLVMFunction::init() {
-  pe::PathIndexBuilder piBuilder;
+  // The builder persists across calls, so that indices over sets that have not
+  // changed since the last call are reused, and the others are rebuilt from
+  // their unchanged rows.
+  pathIndexBuilder->setNumThreads(kNumThreads);
 
   for (auto& pair : arguments) {
     string name = pair.first;
     Actual* actual = pair.second.get();
     if (isa<SetActual>(actual)) {
       Set* set = to<SetActual>(actual)->getSet();
-      piBuilder.bind(name,set);
+      pathIndexBuilder->bind(name,set);
     }
   }
 
   const Environment& environment = getEnvironment();
 
   // Initialize indices
-  initIndices(piBuilder, environment);
+  initIndices(*pathIndexBuilder, environment);
+
+  // Color the edge sets whose loops iterate over them color by color. The
+  // colorings are cached by the sets, and are kept alive here in case a set is
+  // mutated before this function is initialized again.
+  for (const ColoringIndex& coloringIndex : environment.getColoringIndices()) {
+    string setName = coloringIndex.set.getName();
+    Set* set = getBoundSet(setName);
+    std::shared_ptr<const internal::SetColoring> coloring = set->getColoring();
+    simit_iassert(util::contains(coloringIndexPtrs, setName));
+    *coloringIndexPtrs.at(setName).first = coloring->getColorsPtr();
+    *coloringIndexPtrs.at(setName).second = coloring->getElements();
+    colorings[setName] = coloring;
+  }
+
+  // Build the tables of the locations that edge set elements assemble into,
+  // unless the set and the index are unchanged since the last init
+  for (const LocationTable& locationTable : environment.getLocationTables()) {
+    const pe::PathExpression& pexpr = locationTable.index.getPathExpression();
+    simit_iassert(util::contains(tensorIndexPtrs, pexpr));
+    const uint32_t* rowptr = *tensorIndexPtrs.at(pexpr).first;
+    const uint32_t* colidx = *tensorIndexPtrs.at(pexpr).second;
+    Set* set = getBoundSet(locationTable.set.getName());
+
+    const string& name = locationTable.table.getName();
+    pair<pe::PathIndex,unsigned long> version = {pathIndices.at(pexpr),
+                                                 set->getGeneration()};
+    if (!util::contains(locationTableVersions, name) ||
+        !(locationTableVersions.at(name).first == version.first) ||
+        locationTableVersions.at(name).second != version.second) {
+      locationTables[name] = buildLocationTable(locationTable.kind, set,
+                                                rowptr, colidx);
+      locationTableVersions[name] = version;
+    }
+    simit_iassert(util::contains(locationTablePtrs, name));
+    *locationTablePtrs.at(name) = locationTables.at(name).data();
+  }
 
   // Allocate memory for temporaries
   for (const Var& tmp : environment.getTemporaries()) {
@@ -278,8 +406,8 @@ Function::FuncType LLVMFunction::init() {
         Type blockType = tensorType->getBlockType();
         size_t blockSize = blockType.toTensor()->size();
         size_t componentSize = tensorType->getComponentType().bytes();
-        *temporaryPtrs.at(tmp.getName()) =
-            calloc(size(vecDimension) *blockSize, componentSize);
+        initTemporary(tmp.getName(), size(vecDimension),
+                      blockSize * componentSize);
       }
       else if (order == 2) {
         Type blockType = tensorType->getBlockType();
@@ -292,9 +420,8 @@ Function::FuncType LLVMFunction::init() {
         if (ti.getKind() == TensorIndex::PExpr) {
           const pe::PathExpression& pexpr = ti.getPathExpression();
           simit_iassert(util::contains(pathIndices, pexpr));
-          size_t matSize = pathIndices.at(pexpr).numNeighbors() *
-              blockSize * componentSize;
-          *temporaryPtrs.at(tmp.getName()) = malloc(matSize);
+          initTemporary(tmp.getName(), pathIndices.at(pexpr).numNeighbors(),
+                        blockSize * componentSize);
         }
         else if (ti.getKind() == TensorIndex::Sten) {
           auto iss = tensorType->getOuterDimensions();
@@ -304,8 +431,8 @@ Function::FuncType LLVMFunction::init() {
           size_t gridSize = size(iss[0]);
           const StencilLayout& stencil = ti.getStencilLayout();
           size_t stensize = stencil.getLayout().size();
-          size_t matSize = stensize * gridSize * blockSize * componentSize;
-          *temporaryPtrs.at(tmp.getName()) = malloc(matSize);
+          initTemporary(tmp.getName(), stensize * gridSize,
+                        blockSize * componentSize);
         }
         else {
           not_supported_yet;
@@ -327,6 +454,10 @@ Function::FuncType LLVMFunction::init() {
   if (llvmFunc->getArgumentList().size() == 0) {
     llvm::Function *initFunc = getInitFunc();
     llvm::Function *deinitFunc = getDeinitFunc();
+    // Free the buffers of the previous init
+    if (deinit) {
+      deinit();
+    }
     // Call init()
     getGlobalFunc(initFunc, executionEngine.get())();
     // Store deinit(), func()
@@ -404,6 +535,10 @@ Function::FuncType LLVMFunction::init() {
     // Finalize harness module
     harnessExecEngine->finalizeObject();
 
+    // Free the buffers of the previous init
+    if (deinit) {
+      deinit();
+    }
     // Fetch hard addresses from ExecutionEngine
     // call init()
     getGlobalFunc(initHarness, harnessExecEngine.get())();
@@ -435,6 +570,23 @@ void LLVMFunction::printMachine(std::ostream &os) const {
   target->Options.PrintMachineCode = false;
 }
 
+void LLVMFunction::initTemporary(const std::string& name, size_t numBlocks,
+                                 size_t blockSize) {
+  simit_iassert(util::contains(temporaryPtrs, name));
+  void** tmpPtr = temporaryPtrs.at(name);
+  size_t size = numBlocks * blockSize;
+  if (*tmpPtr != nullptr && util::contains(temporarySizes, name) &&
+      temporarySizes.at(name) == size) {
+    memset(*tmpPtr, 0, size);
+    return;
+  }
+  if (*tmpPtr != nullptr) {
+    internal::freeBuffer(*tmpPtr, temporarySizes.at(name));
+  }
+  *tmpPtr = internal::allocateBuffer(numBlocks, blockSize);
+  temporarySizes[name] = size;
+}
+
 void LLVMFunction::initIndices(pe::PathIndexBuilder& piBuilder,
                                const Environment& environment) {
   // Initialize indices
@@ -442,7 +594,7 @@ void LLVMFunction::initIndices(pe::PathIndexBuilder& piBuilder,
     if (tensorIndex.getKind() == TensorIndex::PExpr) {
       pe::PathExpression pexpr = tensorIndex.getPathExpression();
       pe::PathIndex pidx = piBuilder.buildSegmented(pexpr, 0);
-      pathIndices.insert({pexpr, pidx});
+      pathIndices[pexpr] = pidx;
 
       pair<const uint32_t**,const uint32_t**> ptrPair=tensorIndexPtrs.at(pexpr);
 
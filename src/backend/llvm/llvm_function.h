@@ -20,6 +20,9 @@ class ExecutionEngine;
 
 namespace simit {
 
+namespace internal {
+class SetColoring;
+}
 namespace pe {
 class PathExpression;
 class PathIndex;
@@ -54,9 +57,18 @@ class LLVMFunction : public backend::Function {
   /// Get the number of elements in the index domains.
   size_t size(const ir::IndexDomain &dimension);
 
+  /// Get the set bound to the argument or global `name`.
+  Set* getBoundSet(const std::string& name);
+
   void initIndices(pe::PathIndexBuilder& piBuilder,
                    const ir::Environment& environment);
 
+  /// Point temporary `name` to a zeroed buffer of `numBlocks` blocks of
+  /// `blockSize` bytes. The buffer of the previous init is reused if it has the
+  /// same size.
+  void initTemporary(const std::string& name, size_t numBlocks,
+                     size_t blockSize);
+
   bool initialized;
 
   llvm::Function*                        llvmFunc;
@@ -75,9 +87,22 @@ class LLVMFunction : public backend::Function {
   std::map<pe::PathExpression,
            std::pair<const uint32_t**,const uint32_t**>> tensorIndexPtrs;
   std::map<pe::PathExpression, pe::PathIndex>            pathIndices;
+  std::unique_ptr<pe::PathIndexBuilder>                  pathIndexBuilder;
+
+  /// Coloring indices, by set name
+  std::map<std::string, std::pair<const int**,const int**>> coloringIndexPtrs;
+  std::map<std::string, std::shared_ptr<const internal::SetColoring>> colorings;
+
+  /// Location tables, by table name
+  std::map<std::string, const int**>      locationTablePtrs;
+  std::map<std::string, std::vector<int>> locationTables;
+  /// The index and set generation each location table was built from
+  std::map<std::string, std::pair<pe::PathIndex,unsigned long>>
+      locationTableVersions;
 
-  /// Temporaries
+  /// Temporaries, and the size in bytes of their buffers
   std::map<std::string, void**> temporaryPtrs;
+  std::map<std::string, size_t> temporarySizes;
 
  private:
   std::shared_ptr<llvm::EngineBuilder>   engineBuilder;
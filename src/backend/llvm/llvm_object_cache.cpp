@@ -0,0 +1,122 @@
+#include "llvm_object_cache.h"
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/MD5.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include "types.h"
+#include "error.h"
+
+using namespace std;
+
+namespace simit {
+extern std::string kObjectCacheDir;
+
+namespace backend {
+
+// class LLVMObjectCache
+bool LLVMObjectCache::isEnabled() const {
+  return !kObjectCacheDir.empty();
+}
+
+bool LLVMObjectCache::lookup(const llvm::Module* module) {
+  if (!isEnabled()) {
+    return false;
+  }
+
+  string ir;
+  llvm::raw_string_ostream irStream(ir);
+  module->print(irStream, nullptr);
+  irStream.flush();
+
+  // Tensor literals are emitted as pointers to the compiler's copy of their
+  // data, which do not survive the process.
+  if (ir.find("inttoptr") != string::npos) {
+    return false;
+  }
+
+  // The key covers everything the generated code depends on besides the IR
+  stringstream keyStream;
+  keyStream << ir << "\n"
+            << llvm::sys::getProcessTriple() << "\n"
+            << llvm::sys::getHostCPUName().str() << "\n"
+            << "llvm-" << LLVM_MAJOR_VERSION << "." << LLVM_MINOR_VERSION
+            << "\n" << "float-" << ir::ScalarType::floatBytes << "\n"
+#ifdef SIMIT_DEBUG
+            << "debug" << "\n"
+#endif
+            ;
+  string keyData = keyStream.str();
+
+  llvm::MD5 md5;
+  md5.update(keyData);
+  llvm::MD5::MD5Result md5Result;
+  md5.final(md5Result);
+  llvm::SmallString<32> key;
+  llvm::MD5::stringifyResult(md5Result, key);
+
+  auto object = llvm::MemoryBuffer::getFile(getPath(key.str()));
+
+  lock_guard<std::mutex> lock(mutex);
+  keys[module] = key.str();
+  if (!object) {
+    return false;
+  }
+  objects[module] = std::move(object.get());
+  return true;
+}
+
+void LLVMObjectCache::notifyObjectCompiled(const llvm::Module* module,
+                                           llvm::MemoryBufferRef object) {
+  string key;
+  {
+    lock_guard<std::mutex> lock(mutex);
+    if (keys.find(module) == keys.end()) {
+      return;
+    }
+    key = keys.at(module);
+    keys.erase(module);
+  }
+
+  // Write to a temporary file that is then renamed, so that concurrent runs
+  // never load a partially written object
+  string path = getPath(key);
+  stringstream tmpPath;
+  tmpPath << path << ".tmp" << std::random_device()();
+  ofstream file(tmpPath.str(), ofstream::binary);
+  if (!file) {
+    return;
+  }
+  file.write(object.getBufferStart(), object.getBufferSize());
+  file.close();
+  if (!file || std::rename(tmpPath.str().c_str(), path.c_str()) != 0) {
+    std::remove(tmpPath.str().c_str());
+  }
+}
+
+std::unique_ptr<llvm::MemoryBuffer>
+LLVMObjectCache::getObject(const llvm::Module* module) {
+  lock_guard<std::mutex> lock(mutex);
+  auto it = objects.find(module);
+  if (it == objects.end()) {
+    return nullptr;
+  }
+  std::unique_ptr<llvm::MemoryBuffer> object = std::move(it->second);
+  objects.erase(it);
+  keys.erase(module);
+  return object;
+}
+
+std::string LLVMObjectCache::getPath(const std::string& key) const {
+  return kObjectCacheDir + "/" + key + ".o";
+}
+
+}}
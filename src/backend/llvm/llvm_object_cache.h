@@ -0,0 +1,65 @@
+#ifndef SIMIT_LLVM_OBJECT_CACHE_H
+#define SIMIT_LLVM_OBJECT_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "llvm/ExecutionEngine/ObjectCache.h"
+
+namespace llvm {
+class MemoryBuffer;
+class MemoryBufferRef;
+class Module;
+}
+
+namespace simit {
+namespace backend {
+
+/// An on-disk cache of the object code MCJIT generates for Simit functions,
+/// which lets repeated runs of a program skip LLVM optimization and code
+/// generation. Objects are stored in the directory given by
+/// `Settings::objectCacheDir`, keyed by a hash of the unoptimized module, the
+/// target and the LLVM version. The cache is disabled if no directory is set.
+class LLVMObjectCache : public llvm::ObjectCache {
+public:
+  static LLVMObjectCache& getInstance() {
+    static LLVMObjectCache instance;
+    return instance;
+  }
+
+  /// True if a cache directory is set.
+  bool isEnabled() const;
+
+  /// Registers `module`, which must not have been optimized yet, with the
+  /// cache and returns true if its object code is cached. In that case the
+  /// module does not need to be optimized, since MCJIT loads the cached object
+  /// instead of compiling it. Modules that embed host pointers are not cached.
+  bool lookup(const llvm::Module* module);
+
+  /// Stores the object code of a registered module in the cache directory.
+  void notifyObjectCompiled(const llvm::Module* module,
+                            llvm::MemoryBufferRef object);
+
+  /// Returns the cached object code of a registered module, or nullptr.
+  std::unique_ptr<llvm::MemoryBuffer> getObject(const llvm::Module* module);
+
+private:
+  std::mutex mutex;
+
+  /// The cache keys of registered modules.
+  std::map<const llvm::Module*, std::string> keys;
+
+  /// Cached objects found by `lookup`, waiting to be handed to MCJIT.
+  std::map<const llvm::Module*, std::unique_ptr<llvm::MemoryBuffer>> objects;
+
+  LLVMObjectCache() {}
+  LLVMObjectCache(const LLVMObjectCache&) = delete;
+  LLVMObjectCache& operator=(const LLVMObjectCache&) = delete;
+
+  std::string getPath(const std::string& key) const;
+};
+
+}}
+#endif
@@ -0,0 +1,95 @@
+#include "coloring.h"
+
+#include <map>
+
+#include "graph.h"
+
+using namespace std;
+
+namespace simit {
+namespace internal {
+
+// class SetColoring
+SetColoring::SetColoring(const Set& edgeSet) {
+  simit_iassert(edgeSet.getKind() == Set::Unstructured)
+      << "Only unstructured edge sets can be colored";
+  const int numElements = edgeSet.getSize();
+  const int cardinality = edgeSet.getCardinality();
+  const int* endpoints = edgeSet.endpoints;
+
+  // Endpoints are only shared if they come from the same set, so give each
+  // endpoint set its own range of vertex ids.
+  map<const Set*, int> offsets;
+  vector<int> endpointOffsets(cardinality);
+  int numVertices = 0;
+  for (int i = 0; i < cardinality; ++i) {
+    const Set* endpointSet = edgeSet.getEndpointSet(i);
+    if (offsets.find(endpointSet) == offsets.end()) {
+      offsets[endpointSet] = numVertices;
+      numVertices += endpointSet->getSize();
+    }
+    endpointOffsets[i] = offsets.at(endpointSet);
+  }
+
+  // Build the elements incident to each vertex
+  vector<int> incidentPtr(numVertices+1, 0);
+  for (int e = 0; e < numElements; ++e) {
+    for (int i = 0; i < cardinality; ++i) {
+      incidentPtr[endpoints[e*cardinality+i] + endpointOffsets[i] + 1]++;
+    }
+  }
+  for (int v = 0; v < numVertices; ++v) {
+    incidentPtr[v+1] += incidentPtr[v];
+  }
+  vector<int> incident(incidentPtr[numVertices]);
+  vector<int> incidentPos(incidentPtr.begin(), incidentPtr.end()-1);
+  for (int e = 0; e < numElements; ++e) {
+    for (int i = 0; i < cardinality; ++i) {
+      int v = endpoints[e*cardinality+i] + endpointOffsets[i];
+      incident[incidentPos[v]++] = e;
+    }
+  }
+
+  // Give each element the smallest color not used by an element it shares an
+  // endpoint with. forbidden[c] == e marks color c as taken for element e.
+  colors.assign(numElements, -1);
+  vector<int> forbidden;
+  vector<int> colorSizes;
+  for (int e = 0; e < numElements; ++e) {
+    for (int i = 0; i < cardinality; ++i) {
+      int v = endpoints[e*cardinality+i] + endpointOffsets[i];
+      for (int j = incidentPtr[v]; j < incidentPtr[v+1]; ++j) {
+        int color = colors[incident[j]];
+        if (color != -1) {
+          forbidden[color] = e;
+        }
+      }
+    }
+
+    int color = 0;
+    while (color < (int)forbidden.size() && forbidden[color] == e) {
+      ++color;
+    }
+    if (color == (int)forbidden.size()) {
+      forbidden.push_back(-1);
+      colorSizes.push_back(0);
+    }
+    colors[e] = color;
+    colorSizes[color]++;
+  }
+
+  // Group the elements by color
+  int numColors = colorSizes.size();
+  colorsPtr.resize(numColors+1);
+  colorsPtr[0] = 0;
+  for (int c = 0; c < numColors; ++c) {
+    colorsPtr[c+1] = colorsPtr[c] + colorSizes[c];
+  }
+  elements.resize(numElements);
+  vector<int> elementPos(colorsPtr.begin(), colorsPtr.end()-1);
+  for (int e = 0; e < numElements; ++e) {
+    elements[elementPos[colors[e]]++] = e;
+  }
+}
+
+}}
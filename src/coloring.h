@@ -0,0 +1,44 @@
+#ifndef SIMIT_COLORING_H
+#define SIMIT_COLORING_H
+
+#include <vector>
+
+namespace simit {
+class Set;
+
+namespace internal {
+
+/// A coloring of the elements of an edge set such that no two elements of the
+/// same color share an endpoint. Elements of one color can therefore update
+/// the data of their endpoints concurrently without conflicts.
+///
+/// The coloring is stored in a CSR-like format: the elements of color `c` are
+/// `getElements()[getColorsPtr()[c]]` up to (not including)
+/// `getElements()[getColorsPtr()[c+1]]`. Every color has at least one element,
+/// so `getColorsPtr()[getNumColors()]` is the size of the set.
+class SetColoring {
+public:
+  /// Greedily colors the elements of `edgeSet` in element order.
+  SetColoring(const Set& edgeSet);
+
+  /// The number of colors used.
+  int getNumColors() const {return colorsPtr.size()-1;}
+
+  /// The start of each color's segment in the element list, followed by the
+  /// total number of elements.
+  const int* getColorsPtr() const {return colorsPtr.data();}
+
+  /// The elements of the set ordered by color, and by id within a color.
+  const int* getElements() const {return elements.data();}
+
+  /// The color of `elem`.
+  int getColor(int elem) const {return colors[elem];}
+
+private:
+  std::vector<int> colors;
+  std::vector<int> colorsPtr;
+  std::vector<int> elements;
+};
+
+}}
+#endif
@@ -21,6 +21,22 @@ std::ostream& operator<<(std::ostream& os, const VarMapping& vm) {
   return os;
 }
 
+// struct ColoringIndex
+std::ostream& operator<<(std::ostream& os, const ColoringIndex& ci) {
+  os << "coloring " << ci.set << ":" << endl;
+  os << "  " << ci.colorsPtr << " : " << ci.colorsPtr.getType() << endl;
+  os << "  " << ci.elements << " : " << ci.elements.getType();
+  return os;
+}
+
+// struct LocationTable
+std::ostream& operator<<(std::ostream& os, const LocationTable& lt) {
+  os << (lt.kind == LocationTable::VV ? "vv" : "ve") << " locations of "
+     << lt.set << " in " << lt.index.getName() << ":" << endl;
+  os << "  " << lt.table << " : " << lt.table.getType();
+  return os;
+}
+
 // class Environment
 struct Environment::Content {
   vector<pair<Var, Expr>>        constants;
@@ -36,6 +52,11 @@ struct Environment::Content {
   map<StencilLayout,size_t>      locationOfTensorIndexStencil;
 
   map<Var,TensorIndex>           tensorIndexOfVar;
+
+  vector<ColoringIndex>          coloringIndices;
+  map<Var,size_t>                locationOfColoringIndex;
+
+  vector<LocationTable>          locationTables;
 };
 
 Environment::Environment() : content(new Content) {
@@ -161,6 +182,24 @@ const TensorIndex& Environment::getTensorIndex(
       content->locationOfTensorIndexStencil.at(stencil)];
 }
 
+const std::vector<ColoringIndex>& Environment::getColoringIndices() const {
+  return content->coloringIndices;
+}
+
+bool Environment::hasColoringIndex(const Var& set) const {
+  return util::contains(content->locationOfColoringIndex, set);
+}
+
+const ColoringIndex& Environment::getColoringIndex(const Var& set) const {
+  simit_iassert(hasColoringIndex(set))
+      << set << " has no coloring index in environment";
+  return content->coloringIndices[content->locationOfColoringIndex.at(set)];
+}
+
+const std::vector<LocationTable>& Environment::getLocationTables() const {
+  return content->locationTables;
+}
+
 void Environment::addConstant(const Var& var, const Expr& initializer) {
   content->constants.push_back({var, initializer});
 }
@@ -231,6 +270,46 @@ void Environment::addTensorIndex(const StencilLayout& stencil, const Var& var) {
   content->tensorIndexOfVar.insert({var, getTensorIndex(stencil)});
 }
 
+void Environment::addColoringIndex(const Var& set) {
+  simit_iassert(set.getType().isUnstructuredSet() &&
+                set.getType().toUnstructuredSet()->endpointSets.size() > 0)
+      << "attempting to add a coloring index to " << set
+      << ", which is not an edge set";
+  if (hasColoringIndex(set)) {
+    return;
+  }
+
+  string prefix = set.getName() + "_colors.";
+  ColoringIndex ci;
+  ci.set = set;
+  ci.colorsPtr = Var(prefix + "ptr", ArrayType::make(ScalarType::Int));
+  ci.elements  = Var(prefix + "elements", ArrayType::make(ScalarType::Int));
+  content->coloringIndices.push_back(ci);
+  content->locationOfColoringIndex.insert({set,
+                                           content->coloringIndices.size()-1});
+}
+
+Var Environment::addLocationTable(LocationTable::Kind kind,
+                                  const TensorIndex& index, const Var& set) {
+  simit_iassert(index.getKind() == TensorIndex::PExpr)
+      << "location tables are built from path expression indices";
+  for (const LocationTable& lt : content->locationTables) {
+    if (lt.kind == kind && lt.index == index && lt.set == set) {
+      return lt.table;
+    }
+  }
+
+  string suffix = (kind == LocationTable::VV) ? "vv" : "ve";
+  LocationTable lt;
+  lt.kind = kind;
+  lt.index = index;
+  lt.set = set;
+  lt.table = Var(index.getName() + "." + set.getName() + "_locs_" + suffix,
+                 ArrayType::make(ScalarType::Int));
+  content->locationTables.push_back(lt);
+  return content->locationTables.back().table;
+}
+
 std::ostream& operator<<(std::ostream& os, const Environment& env) {
   bool somethingPrinted = false;
 
@@ -291,6 +370,32 @@ std::ostream& operator<<(std::ostream& os, const Environment& env) {
     }
     somethingPrinted = true;
   }
+
+  // Coloring indices
+  if (env.getColoringIndices().size() > 0) {
+    if (somethingPrinted) {
+      os << std::endl;
+    }
+    auto coloringIndices = env.getColoringIndices();
+    os << *coloringIndices.begin();
+    for (auto& coloringIndex : util::excludeFirst(coloringIndices)) {
+      os << std::endl << coloringIndex;
+    }
+    somethingPrinted = true;
+  }
+
+  // Location tables
+  if (env.getLocationTables().size() > 0) {
+    if (somethingPrinted) {
+      os << std::endl;
+    }
+    auto locationTables = env.getLocationTables();
+    os << *locationTables.begin();
+    for (auto& locationTable : util::excludeFirst(locationTables)) {
+      os << std::endl << locationTable;
+    }
+    somethingPrinted = true;
+  }
   UNUSED(somethingPrinted);
 
   return os;
@@ -6,6 +6,7 @@
 #include <ostream>
 #include "var.h"
 #include "macros.h"
+#include "tensor_index.h"
 #include "util/name_generator.h"
 
 namespace simit {
@@ -36,6 +37,33 @@ private:
 
 std::ostream& operator<<(std::ostream&, const VarMapping&);
 
+/// A ColoringIndex holds the arrays of an edge set whose loops iterate over it
+/// color by color (see Set::getColoring). `colorsPtr` holds the start of each
+/// color in `elements`, which lists the set's elements grouped by color.
+struct ColoringIndex {
+  Var set;
+  Var colorsPtr;
+  Var elements;
+};
+
+std::ostream& operator<<(std::ostream&, const ColoringIndex&);
+
+/// A LocationTable holds the locations in the values of the matrices indexed
+/// by `index` that each element of the edge set `set` assembles into, so that
+/// assembly need not search the index. With c the cardinality of the set, a
+/// VV table holds the location of block (eps[i],eps[j]) of element e at
+/// table[(e*c+i)*c+j], and a VE table the location of block (eps[i],e) at
+/// table[e*c+i]. Tables are built when a simit::Function is initialized.
+struct LocationTable {
+  enum Kind {VV, VE};
+  Kind kind;
+  TensorIndex index;
+  Var set;
+  Var table;
+};
+
+std::ostream& operator<<(std::ostream&, const LocationTable&);
+
 /// An Environment keeps track of global constants, externs and temporaries.
 /// It also keeps track of the data arrays and shared index arrays of tensors
 /// that have path expressions. (The latter are added to the environment as the
@@ -102,6 +130,18 @@ public:
   /// Retrieve the tensor index of the given stencil.
   const TensorIndex& getTensorIndex(const StencilLayout& stencil) const;
 
+  /// Retrieve all the coloring indices in the environment.
+  const std::vector<ColoringIndex>& getColoringIndices() const;
+
+  /// True if the environment has a coloring index for the edge set `set`.
+  bool hasColoringIndex(const Var& set) const;
+
+  /// Retrieve the coloring index of the edge set `set`.
+  const ColoringIndex& getColoringIndex(const Var& set) const;
+
+  /// Retrieve all the location tables in the environment.
+  const std::vector<LocationTable>& getLocationTables() const;
+
   /// Insert a constant into the environment.
   void addConstant(const Var& var, const Expr& initializer);
 
@@ -129,6 +169,16 @@ public:
   /// and associate it with var.
   void addTensorIndex(const StencilLayout& stencil, const Var& var);
 
+  /// Add a coloring index for the edge set `set` to the environment, unless
+  /// it already has one.
+  void addColoringIndex(const Var& set);
+
+  /// Add a location table of the given kind for the elements of the edge set
+  /// `set` in `index` to the environment, unless it already has one, and
+  /// return the array that holds it.
+  Var addLocationTable(LocationTable::Kind kind,
+                       const TensorIndex& index, const Var& set);
+
 private:
   struct Content;
   Content* content;
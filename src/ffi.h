@@ -6,12 +6,21 @@
 #include <vector>
 #include <algorithm>
 
+#include "allocator.h"
+
 namespace simit {
 namespace ffi {
 
+/// Allocates memory for the results of external functions. The memory is
+/// aligned like the buffers Simit allocates itself, and is freed by compiled
+/// code with free.
 extern "C" inline
 void* simit_malloc(std::size_t size) {
-  return malloc(size);
+  void* ptr = nullptr;
+  if (posix_memalign(&ptr, kBufferAlignment, size) != 0) {
+    return nullptr;
+  }
+  return ptr;
 }
 
 extern "C" inline
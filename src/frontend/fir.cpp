@@ -317,6 +317,12 @@ FIRNode::Ptr IdentDecl::cloneNode() {
   return node;
 }
 
+void FieldDecl::copy(FIRNode::Ptr node) {
+  const auto fieldDecl = to<FieldDecl>(node);
+  IdentDecl::copy(fieldDecl);
+  soa = fieldDecl->soa;
+}
+
 FIRNode::Ptr FieldDecl::cloneNode() {
   const auto node = std::make_shared<FieldDecl>();
   node->copy(shared_from_this());
@@ -454,16 +454,26 @@ protected:
 };
 
 struct FieldDecl : public IdentDecl {
+  bool soa = false;  // laid out component-major (structure of arrays)
+
   typedef std::shared_ptr<FieldDecl> Ptr;
   
   virtual void accept(FIRVisitor *visitor) {
     visitor->visit(self<FieldDecl>());
   }
 
+  virtual unsigned getLineBegin() {
+    return soa ? FIRNode::getLineBegin() : IdentDecl::getLineBegin();
+  }
+  virtual unsigned getColBegin() {
+    return soa ? FIRNode::getColBegin() : IdentDecl::getColBegin();
+  }
   virtual unsigned getLineEnd() { return FIRNode::getLineEnd(); }
   virtual unsigned getColEnd() { return FIRNode::getColEnd(); }
 
 protected:
+  virtual void copy(FIRNode::Ptr);
+
   virtual FIRNode::Ptr cloneNode(); 
 };
 
@@ -812,7 +822,7 @@ protected:
 };
 
 struct MapExpr : public Expr {
-  enum class ReductionOp {NONE, SUM};
+  enum class ReductionOp {NONE, SUM, PRODUCT, MAX, MIN};
   
   Identifier::Ptr            func;
   std::vector<IndexSet::Ptr> genericArgs;
@@ -286,6 +286,27 @@ std::vector<FuncDecl::Ptr> createIntrinsics() {
                {nmMatrixType, nVectorType},
                {mVectorType},
                {N, M});
+  addIntrinsic(&intrinsics,
+               ir::intrinsics::cgsolve().getName(),
+               {nnMatrixType, nVectorType, nVectorType,
+                makeTensorType(ScalarType::Type::FLOAT),
+                makeTensorType(ScalarType::Type::INT)},
+               {nVectorType},
+               {N});
+  addIntrinsic(&intrinsics,
+               ir::intrinsics::pcgsolve().getName(),
+               {nnMatrixType, nVectorType, nVectorType,
+                makeTensorType(ScalarType::Type::FLOAT),
+                makeTensorType(ScalarType::Type::INT)},
+               {nVectorType},
+               {N});
+  addIntrinsic(&intrinsics,
+               ir::intrinsics::bicgstabsolve().getName(),
+               {nnMatrixType, nVectorType, nVectorType,
+                makeTensorType(ScalarType::Type::FLOAT),
+                makeTensorType(ScalarType::Type::INT)},
+               {nVectorType},
+               {N});
 
   // Complex numbers
   addScalarIntrinsic(&intrinsics,
@@ -178,6 +178,9 @@ void FIRPrinter::visit(IdentDecl::Ptr decl) {
 }
 
 void FIRPrinter::visit(FieldDecl::Ptr decl) {
+  if (decl->soa) {
+    oss << "soa ";
+  }
   printIdentDecl(decl);
   oss << ";";
 }
@@ -802,6 +805,15 @@ void FIRPrinter::printMapOrApply(MapExpr::Ptr expr, const bool isApply) {
       case MapExpr::ReductionOp::SUM:
         oss << "+";
         break;
+      case MapExpr::ReductionOp::PRODUCT:
+        oss << "*";
+        break;
+      case MapExpr::ReductionOp::MAX:
+        oss << "max";
+        break;
+      case MapExpr::ReductionOp::MIN:
+        oss << "min";
+        break;
       default:
         simit_unreachable;
         break;
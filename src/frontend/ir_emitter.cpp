@@ -5,10 +5,27 @@
 #include "domain.h"
 #include "error.h"
 #include "ir.h"
+#include "intrinsics.h"
 
 namespace simit {
 namespace fir {
 
+/// Returns the type of result `i` of a call to `func` with `actuals`. The
+/// iterative solvers are declared on vectors of floats, but return the
+/// (possibly blocked) type of their initial guess.
+static ir::Type getResultType(const ir::Func& func,
+                              const std::vector<ir::Expr>& actuals,
+                              unsigned i) {
+  // Calls to generic functions are specialized with an @ suffix
+  const std::string name = func.getName().substr(0, func.getName().find("@"));
+  if (name == ir::intrinsics::cgsolve().getName() ||
+      name == ir::intrinsics::pcgsolve().getName() ||
+      name == ir::intrinsics::bicgstabsolve().getName()) {
+    return actuals[2].type();
+  }
+  return func.getResults()[i].getType();
+}
+
 void IREmitter::visit(StmtBlock::Ptr stmtBlock) {
   for (auto stmt : stmtBlock->stmts) {
     stmt->accept(this);
@@ -435,6 +452,15 @@ void IREmitter::visit(MapExpr::Ptr expr) {
     case MapExpr::ReductionOp::SUM:
       reduction = ir::ReductionOperator::Sum;
       break;
+    case MapExpr::ReductionOp::PRODUCT:
+      reduction = ir::ReductionOperator::Product;
+      break;
+    case MapExpr::ReductionOp::MAX:
+      reduction = ir::ReductionOperator::Max;
+      break;
+    case MapExpr::ReductionOp::MIN:
+      reduction = ir::ReductionOperator::Min;
+      break;
     default:
       not_supported_yet;
       break;
@@ -694,7 +720,8 @@ void IREmitter::visit(CallExpr::Ptr expr) {
   // Function calls are translated to call statements whose values are stored 
   // in temporary variables. Within the original expression in which the call 
   // appeared, the call is replaced with a read of the temporary variable.
-  const auto type = (results.size() == 1) ? results[0].getType() : ir::Type();
+  const auto type = (results.size() == 1) ? getResultType(func, arguments, 0)
+                                           : ir::Type();
   const ir::Var tmp = ctx->getBuilder()->temporary(type);
   const ir::Stmt callStmt = ir::CallStmt::make({tmp}, func, arguments);
   
@@ -1087,7 +1114,10 @@ ir::Field IREmitter::emitField(FieldDecl::Ptr ptr) {
   retField = ir::Field("", ir::Type());
 
   ptr->accept(this);
-  const ir::Field ret = retField;
+  ir::Field ret = retField;
+  if (ptr->soa) {
+    ret.layout = ir::Field::SoA;
+  }
 
   retField = tmpField;
   return ret;
@@ -1201,6 +1231,13 @@ void IREmitter::addAssign(const std::vector<ir::Expr> &lhs, ir::Expr expr) {
     const std::vector<ir::Var> retVals = isCallStmt ? 
       ir::to<ir::CallStmt>(topLevelStmt)->callee.getResults() :
       ir::to<ir::Map>(topLevelStmt)->function.getResults();
+    auto getRetValType = [&](unsigned i) {
+      if (!isCallStmt) {
+        return retVals[i].getType();
+      }
+      const auto callStmt = ir::to<ir::CallStmt>(topLevelStmt);
+      return getResultType(callStmt->callee, callStmt->actuals, i);
+    };
     
     simit_iassert(lhs.size() <= retVals.size());
 
@@ -1215,14 +1252,14 @@ void IREmitter::addAssign(const std::vector<ir::Expr> &lhs, ir::Expr expr) {
         const std::string varName = var.getName();
 
         if (!ctx->hasSymbol(varName)) {
-          var = ir::Var(varName, retVals[i].getType());
+          var = ir::Var(varName, getRetValType(i));
           addSymbol(var);
           ctx->addStatement(ir::VarDecl::make(var));
         }
 
         results.push_back(var);
       } else {
-        const ir::Var tmp = ctx->getBuilder()->temporary(retVals[i].getType());
+        const ir::Var tmp = ctx->getBuilder()->temporary(getRetValType(i));
         addSymbol(tmp);
 
         if (!isCallStmt ||
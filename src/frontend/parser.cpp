@@ -93,7 +93,8 @@ fir::ElementTypeDecl::Ptr Parser::parseElementTypeDecl() {
 std::vector<fir::FieldDecl::Ptr> Parser::parseFieldDeclList() {
   std::vector<fir::FieldDecl::Ptr> fields;
 
-  while (peek().type == Token::Type::IDENT) {
+  while (peek().type == Token::Type::IDENT ||
+         peek().type == Token::Type::SOA) {
     const fir::FieldDecl::Ptr field = parseFieldDecl();
     fields.push_back(field);
   }
@@ -101,10 +102,16 @@ std::vector<fir::FieldDecl::Ptr> Parser::parseFieldDeclList() {
   return fields;
 }
 
-// field_decl: tensor_decl ';'
+// field_decl: ['soa'] tensor_decl ';'
 fir::FieldDecl::Ptr Parser::parseFieldDecl() {
   auto fieldDecl = std::make_shared<fir::FieldDecl>();
 
+  if (peek().type == Token::Type::SOA) {
+    const Token soaToken = consume(Token::Type::SOA);
+    fieldDecl->setBeginLoc(soaToken);
+    fieldDecl->soa = true;
+  }
+
   const auto tensorDecl = parseTensorDecl();
   fieldDecl->name = tensorDecl->name;
   fieldDecl->type = tensorDecl->type;
@@ -786,7 +793,8 @@ fir::Expr::Ptr Parser::parseExpr() {
 }
 
 // map_expr: 'map' ident ['<' endpoints '>'] ['(' [expr_params] ')'] 
-//           'to' set_index_set ['through' set_index_set] ['reduce' '+']
+//           'to' set_index_set ['through' set_index_set]
+//           ['reduce' ('+' | '*' | 'max' | 'min')]
 fir::MapExpr::Ptr Parser::parseMapExpr() {
   const Token mapToken = consume(Token::Type::MAP);
   const fir::Identifier::Ptr func = parseIdent();
@@ -822,10 +830,33 @@ fir::MapExpr::Ptr Parser::parseMapExpr() {
     mapExpr->partialActuals = partialActuals;
     mapExpr->target = target;
     mapExpr->through = through;
-    mapExpr->op = fir::MapExpr::ReductionOp::SUM;
 
-    const Token plusToken = consume(Token::Type::PLUS);
-    mapExpr->setEndLoc(plusToken);
+    const Token opToken = peek();
+    switch (opToken.type) {
+      case Token::Type::PLUS:
+        mapExpr->op = fir::MapExpr::ReductionOp::SUM;
+        break;
+      case Token::Type::STAR:
+        mapExpr->op = fir::MapExpr::ReductionOp::PRODUCT;
+        break;
+      case Token::Type::IDENT:
+        if (opToken.str == "max") {
+          mapExpr->op = fir::MapExpr::ReductionOp::MAX;
+        }
+        else if (opToken.str == "min") {
+          mapExpr->op = fir::MapExpr::ReductionOp::MIN;
+        }
+        else {
+          reportError(opToken, "a reduction operator");
+          throw SyntaxError();
+        }
+        break;
+      default:
+        reportError(opToken, "a reduction operator");
+        throw SyntaxError();
+    }
+    consume(opToken.type);
+    mapExpr->setEndLoc(opToken);
 
     return mapExpr;
   }
@@ -28,6 +28,7 @@ Token::Type Scanner::getTokenType(const std::string token) {
   if (token == "export") return Token::Type::EXPORT;
   if (token == "func") return Token::Type::FUNC;
   if (token == "inout") return Token::Type::INOUT;
+  if (token == "soa") return Token::Type::SOA;
   if (token == "apply") return Token::Type::APPLY;
   if (token == "map") return Token::Type::MAP;
   if (token == "to") return Token::Type::TO;
@@ -68,6 +68,8 @@ std::string Token::tokenTypeString(Token::Type type) {
       return "'func'";
     case Token::Type::INOUT:
       return "'inout'";
+    case Token::Type::SOA:
+      return "'soa'";
     case Token::Type::APPLY:
       return "'apply'";
     case Token::Type::MAP:
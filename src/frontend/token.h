@@ -37,6 +37,7 @@ struct Token {
     EXPORT,
     FUNC,
     INOUT,
+    SOA,
     APPLY,
     MAP,
     TO,
@@ -1152,6 +1152,20 @@ void TypeChecker::visit(CallExpr::Ptr expr) {
     typeCheckOrder(expr->args[1], argTypes[1], 2);
     return;
   }
+  else if (funcName == ir::intrinsics::cgsolve().getName() ||
+           funcName == ir::intrinsics::pcgsolve().getName() ||
+           funcName == ir::intrinsics::bicgstabsolve().getName()) {
+    simit_iassert(expr->args.size() == 5);
+    typeCheckOrder(expr->args[0], argTypes[0], 2);
+    typeCheckOrder(expr->args[1], argTypes[1], 1);
+    typeCheckOrder(expr->args[2], argTypes[2], 1);
+
+    // The solution has the (possibly blocked) type of the initial guess
+    if (argTypes[2].defined && argTypes[2].isSingleValue()) {
+      retType = ExprType(argTypes[2].type[0]);
+    }
+    return;
+  }
 
   for (unsigned i = 0; i < expr->args.size(); ++i) {
     const Argument::Ptr funcArg = func->args[i];
@@ -1913,6 +1927,28 @@ void TypeChecker::typeCheckMapOrApply(MapExpr::Ptr expr, const bool isApply) {
     retType = ExprType(resultTypes);
   }
 
+  // Check that results reduced to their maximum or minimum are ordered.
+  if (expr->getReductionOp() == MapExpr::ReductionOp::MAX ||
+      expr->getReductionOp() == MapExpr::ReductionOp::MIN) {
+    for (const auto res : func->results) {
+      if (!isa<TensorType>(res->type)) {
+        continue;
+      }
+
+      const auto resType = to<TensorType>(res->type);
+      const ScalarType::Type componentType = getComponentType(resType);
+      if (componentType != ScalarType::Type::INT &&
+          componentType != ScalarType::Type::FLOAT) {
+        std::stringstream errMsg;
+        errMsg << "cannot reduce results of type " << toString(res->type)
+               << " to their "
+               << (expr->getReductionOp() == MapExpr::ReductionOp::MAX ?
+                   "maximum" : "minimum");
+        reportError(errMsg.str(), expr);
+      }
+    }
+  }
+
   if (!retTypeChecked) {
     return;
   }
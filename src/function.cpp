@@ -3,10 +3,12 @@
 #include "backend/backend_function.h"
 #include "types_convert.h"
 #include "graph.h"  // TODO: should not need this include
+#include "reorder.h"
 
 using namespace std;
 
 namespace simit {
+extern bool kReorder;
 
 // class Function
 Function::Function() : Function(nullptr) {
@@ -17,6 +19,7 @@ Function::Function(backend::Function* func) : impl(func), funcPtr(nullptr) {
 
 void Function::clear() {
   impl = nullptr;
+  sets.clear();
 }
 
 void Function::bind(const std::string& name, simit::Set *set) {
@@ -82,9 +85,16 @@ void Function::bind(const std::string& name, simit::Set *set) {
       simit_uassert(setFieldType->getDimension(i) == argFieldRange)
           << fieldTypeErrorString;
     }
+
+    // Compiled code accesses fields as laid out in the program
+    bool soa = (elemType->field(fieldData->name).layout == ir::Field::SoA);
+    simit_uassert(soa == (fieldData->layout == Set::SoA))
+        << name << "." << fieldData->name << " must be added as an "
+        << (soa ? "SoA" : "AoS") << " field to match the Simit program";
   }
 #endif
 
+  sets[name] = set;
   impl->bind(name, set);
 }
 
@@ -115,6 +125,14 @@ void Function::bind(const string& name, TensorData& data) {
 
 void Function::init() {
   simit_uassert(defined()) << "undefined function";
+  if (kReorder) {
+    // Reorder before the backend builds indices over the sets
+    vector<Set*> boundSets;
+    for (auto& set : sets) {
+      boundSets.push_back(set.second);
+    }
+    reorderForLocality(boundSets);
+  }
   funcPtr = impl->init();
 }
 
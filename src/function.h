@@ -3,6 +3,7 @@
 
 #include <string>
 #include <functional>
+#include <map>
 #include "tensor.h"
 
 namespace simit {
@@ -59,7 +60,9 @@ public:
 
   /// Initialize the function. This must be done between calls to bind arguments
   /// and calls to run. If runSafe is used, there init will be called
-  /// automatically as needed.
+  /// automatically as needed. If Settings::reorder is set, the bound sets are
+  /// reordered for locality the first time a function that binds them is
+  /// initialized (see reorderForLocality and Set::getElementOrdering).
   void init();
 
   /// Run the function. Make sure to bind arguments and map arguments, and to
@@ -92,6 +95,9 @@ private:
 
   // To make the run method faster we store the function pointer here.
   std::function<void()> funcPtr;
+
+  /// The bound sets, which are reordered at init if Settings::reorder is set.
+  std::map<std::string, simit::Set*> sets;
 };
 
 /// Write the function to the stream. The output depends on the backend,
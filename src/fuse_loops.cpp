@@ -0,0 +1,550 @@
+#include "fuse_loops.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ir.h"
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
+#include "var_replace_rewriter.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// A variable, or a field of a set variable.
+typedef pair<Var,string> Location;
+
+struct Access {
+  bool read = false;
+  bool written = false;
+
+  /// Whether the location is accessed at something other than the loop
+  /// variable, so that an iteration may touch the elements of other ones.
+  bool indirect = false;
+};
+
+/// The locations a statement accesses.
+struct Accesses {
+  map<Location,Access> locations;
+
+  /// Whether the statement assigns a variable declared outside it, other than
+  /// by reducing into an int or float scalar.
+  bool assignsOuterVar = false;
+
+  /// The int or float scalars declared outside the statement that it only
+  /// updates with compound assignments, and the operators of the updates.
+  map<Var,CompoundOperator> reductions;
+
+  /// Whether a scalar is reduced into with different operators.
+  bool mixedReductions = false;
+
+  /// The variables the statement reads.
+  set<Var> readVars;
+
+  /// Whether the statement contains a loop.
+  bool hasLoop = false;
+
+  /// Whether the statement calls functions or prints, which may not be
+  /// reordered, or accesses tensors we cannot identify.
+  bool opaque = false;
+
+  void merge(const Accesses& other) {
+    for (auto& location : other.locations) {
+      Access& access = locations[location.first];
+      access.read |= location.second.read;
+      access.written |= location.second.written;
+      access.indirect |= location.second.indirect;
+    }
+    assignsOuterVar |= other.assignsOuterVar;
+    for (auto& reduction : other.reductions) {
+      addReduction(reduction.first, reduction.second);
+    }
+    mixedReductions |= other.mixedReductions;
+    readVars.insert(other.readVars.begin(), other.readVars.end());
+    hasLoop |= other.hasLoop;
+    opaque |= other.opaque;
+  }
+
+  void addReduction(const Var& var, CompoundOperator cop) {
+    auto reduction = reductions.find(var);
+    if (reduction == reductions.end()) {
+      reductions.insert({var, cop});
+    }
+    else if (reduction->second != cop) {
+      mixedReductions = true;
+    }
+  }
+
+  /// Whether a loop with this body runs serially on multiple threads. Loops
+  /// that reduce into scalars they do not otherwise read run in parallel with
+  /// a partial result per thread (see findParallelLoops).
+  bool runsSerially() const {
+    if (assignsOuterVar || mixedReductions) {
+      return true;
+    }
+    for (auto& reduction : reductions) {
+      if (readVars.find(reduction.first) != readVars.end()) {
+        return true;
+      }
+    }
+    return false;
+  }
+};
+
+/// True if reordering the iterations of `a` and `b` could change what they
+/// compute. If `byIteration` is set, `a` and `b` are loop bodies that run
+/// interleaved by iteration, which is safe for locations that both access
+/// only at the loop variable.
+static bool conflicts(const Accesses& a, const Accesses& b, bool byIteration) {
+  for (auto& location : a.locations) {
+    auto other = b.locations.find(location.first);
+    if (other == b.locations.end()) {
+      continue;
+    }
+    const Access& aAccess = location.second;
+    const Access& bAccess = other->second;
+    if (!aAccess.written && !bAccess.written) {
+      continue;
+    }
+    if (!byIteration || aAccess.indirect || bAccess.indirect) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/// True if `op` folds a value into an int or float scalar.
+static bool isScalarReduction(const AssignStmt* op) {
+  Type type = op->var.getType();
+  if (op->cop == CompoundOperator::None || !type.isTensor() ||
+      !isScalar(type)) {
+    return false;
+  }
+  ScalarType componentType = type.toTensor()->getComponentType();
+  return componentType.kind == ScalarType::Float ||
+         componentType.kind == ScalarType::Int;
+}
+
+/// Collects the locations `stmt` accesses. If `loopVar` is defined then
+/// `stmt` is the body of a loop over it, whose local variables are left out.
+static Accesses collectAccesses(Stmt stmt, Var loopVar=Var()) {
+  class CollectAccesses : public IRVisitor {
+  public:
+    CollectAccesses(Var loopVar) : loopVar(loopVar) {
+      if (loopVar.defined()) {
+        locals.insert(loopVar);
+      }
+    }
+
+    Accesses accesses;
+
+  private:
+    Var loopVar;
+    set<Var> locals;
+
+    using IRVisitor::visit;
+
+    void access(const Location& location, bool write, bool indirect) {
+      if (locals.find(location.first) != locals.end()) {
+        return;
+      }
+      Access& access = accesses.locations[location];
+      if (write) {
+        access.written = true;
+      }
+      else {
+        access.read = true;
+      }
+      access.indirect |= indirect;
+    }
+
+    /// Records an access to the tensor or buffer `tensor` at `indices`.
+    void accessElement(Expr tensor, const vector<Expr>& indices, bool write,
+                       bool read) {
+      bool atLoopVar = loopVar.defined() && indices.size() == 1 &&
+                       isa<VarExpr>(indices[0]) &&
+                       to<VarExpr>(indices[0])->var == loopVar;
+      // Blocks of blocked tensors are in the elements of their outer index
+      if (isa<TensorRead>(tensor)) {
+        const TensorRead* block = to<TensorRead>(tensor);
+        for (const Expr& index : block->indices) {
+          index.accept(this);
+        }
+        accessElement(block->tensor, block->indices, write, read);
+        return;
+      }
+
+      Location location;
+      if (isa<VarExpr>(tensor)) {
+        location = Location(to<VarExpr>(tensor)->var, "");
+      }
+      else if (isa<FieldRead>(tensor) &&
+               isa<VarExpr>(to<FieldRead>(tensor)->elementOrSet)) {
+        location = Location(to<VarExpr>(to<FieldRead>(tensor)->elementOrSet)->var,
+                            to<FieldRead>(tensor)->fieldName);
+      }
+      else if (write) {
+        accesses.opaque = true;
+        return;
+      }
+      else {
+        tensor.accept(this);
+        return;
+      }
+      if (write) {
+        access(location, true, !atLoopVar);
+      }
+      if (read) {
+        access(location, false, !atLoopVar);
+      }
+    }
+
+    void visit(const VarExpr* op) {
+      access(Location(op->var, ""), false, true);
+      accesses.readVars.insert(op->var);
+    }
+
+    void visit(const FieldRead* op) {
+      if (isa<VarExpr>(op->elementOrSet)) {
+        access(Location(to<VarExpr>(op->elementOrSet)->var, op->fieldName),
+               false, true);
+      }
+      else {
+        IRVisitor::visit(op);
+      }
+    }
+
+    void visit(const TensorRead* op) {
+      accessElement(op->tensor, op->indices, false, true);
+      for (const Expr& index : op->indices) {
+        index.accept(this);
+      }
+    }
+
+    void visit(const Load* op) {
+      accessElement(op->buffer, {op->index}, false, true);
+      op->index.accept(this);
+    }
+
+    void visit(const VarDecl* op) {
+      if (loopVar.defined()) {
+        locals.insert(op->var);
+      }
+      else {
+        access(Location(op->var, ""), true, true);
+      }
+    }
+
+    void visit(const AssignStmt* op) {
+      bool local = locals.find(op->var) != locals.end();
+      if (!local) {
+        if (isScalarReduction(op)) {
+          accesses.addReduction(op->var, (op->cop == CompoundOperator::Sub)
+                                         ? CompoundOperator::Add : op->cop);
+        }
+        else {
+          accesses.assignsOuterVar = true;
+        }
+      }
+      access(Location(op->var, ""), true, true);
+      if (op->cop != CompoundOperator::None) {
+        access(Location(op->var, ""), false, true);
+      }
+      op->value.accept(this);
+    }
+
+    void visit(const TensorWrite* op) {
+      accessElement(op->tensor, op->indices, true,
+                    op->cop != CompoundOperator::None);
+      for (const Expr& index : op->indices) {
+        index.accept(this);
+      }
+      op->value.accept(this);
+    }
+
+    void visit(const Store* op) {
+      accessElement(op->buffer, {op->index}, true,
+                    op->cop != CompoundOperator::None);
+      op->index.accept(this);
+      op->value.accept(this);
+    }
+
+    void visit(const FieldWrite* op) {
+      if (!isa<VarExpr>(op->elementOrSet)) {
+        accesses.opaque = true;
+        return;
+      }
+      Location location(to<VarExpr>(op->elementOrSet)->var, op->fieldName);
+      access(location, true, true);
+      if (op->cop != CompoundOperator::None) {
+        access(location, false, true);
+      }
+      op->value.accept(this);
+    }
+
+    void visit(const ForRange* op) {
+      locals.insert(op->var);
+      accesses.hasLoop = true;
+      IRVisitor::visit(op);
+    }
+
+    void visit(const For* op) {
+      locals.insert(op->var);
+      accesses.hasLoop = true;
+      IRVisitor::visit(op);
+    }
+
+    void visit(const While* op) {
+      accesses.hasLoop = true;
+      IRVisitor::visit(op);
+    }
+
+    void visit(const CallStmt*) {accesses.opaque = true;}
+    void visit(const Print*)    {accesses.opaque = true;}
+    void visit(const Map*)      {accesses.opaque = true;}
+    void visit(const Kernel*)   {accesses.opaque = true;}
+  };
+  CollectAccesses collector(loopVar);
+  stmt.accept(&collector);
+  return collector.accesses;
+}
+
+class FuseLoops : public IRRewriter {
+public:
+  FuseLoops(bool parallel) : parallel(parallel) {}
+
+private:
+  bool parallel;
+
+  /// A statement of a block, with the comments it was commented with.
+  struct Item {
+    Stmt stmt;
+    vector<Stmt> comments;
+  };
+
+  using IRRewriter::visit;
+
+  void visit(const Block* op) {
+    vector<Item> items;
+    flatten(op, &items);
+
+    bool fused = false;
+    vector<Item> fusedItems = fuse(items, &fused);
+    if (!fused) {
+      stmt = rewriteBlock(op);
+      return;
+    }
+
+    vector<Stmt> stmts;
+    for (Item& item : fusedItems) {
+      Stmt itemStmt = rewrite(item.stmt);
+      if (!itemStmt.defined()) {
+        continue;
+      }
+      // Comments of fused loops are printed as one paragraph
+      for (size_t i = item.comments.size(); i > 0; --i) {
+        const Comment* comment = to<Comment>(item.comments[i-1]);
+        bool outermost = (i == 1);
+        bool footerSpace = outermost &&
+                           to<Comment>(item.comments.back())->footerSpace;
+        bool headerSpace = outermost && comment->headerSpace;
+        itemStmt = Comment::make(comment->comment, itemStmt,
+                                 footerSpace, headerSpace);
+      }
+      stmts.push_back(itemStmt);
+    }
+    stmt = stmts.empty() ? Stmt() : Block::make(stmts);
+  }
+
+  /// Flattens the blocks and commented statements in `stmt`. Comments are
+  /// attached to the first loop they comment, or else to their first statement.
+  static void flatten(Stmt stmt, vector<Item>* items) {
+    if (isa<Block>(stmt)) {
+      flatten(to<Block>(stmt)->first, items);
+      if (to<Block>(stmt)->rest.defined()) {
+        flatten(to<Block>(stmt)->rest, items);
+      }
+    }
+    else if (isa<Comment>(stmt) && to<Comment>(stmt)->commentedStmt.defined()) {
+      size_t first = items->size();
+      flatten(to<Comment>(stmt)->commentedStmt, items);
+      if (first == items->size()) {
+        return;
+      }
+      size_t commented = first;
+      for (size_t i = first; i < items->size(); ++i) {
+        if (getLoop((*items)[i].stmt) != nullptr) {
+          commented = i;
+          break;
+        }
+      }
+      vector<Stmt>& comments = (*items)[commented].comments;
+      comments.insert(comments.begin(), stmt);
+    }
+    else {
+      items->push_back({stmt, {}});
+    }
+  }
+
+  /// Rewrites the statements of a block without flattening it.
+  Stmt rewriteBlock(Stmt stmt) {
+    if (isa<Block>(stmt)) {
+      const Block* block = to<Block>(stmt);
+      Stmt first = rewriteBlock(block->first);
+      Stmt rest = block->rest.defined() ? rewriteBlock(block->rest) : Stmt();
+      if (first.defined() && rest.defined()) {
+        return Block::make(first, rest);
+      }
+      return first.defined() ? first : rest;
+    }
+    if (isa<Comment>(stmt) && to<Comment>(stmt)->commentedStmt.defined()) {
+      const Comment* comment = to<Comment>(stmt);
+      Stmt commentedStmt = rewriteBlock(comment->commentedStmt);
+      if (!commentedStmt.defined()) {
+        return Stmt();
+      }
+      return Comment::make(comment->comment, commentedStmt,
+                           comment->footerSpace, comment->headerSpace);
+    }
+    return rewrite(stmt);
+  }
+
+  /// The loop `stmt` is, if any. For::make scopes loops in a Scope.
+  static const For* getLoop(Stmt stmt) {
+    while (isa<Scope>(stmt)) {
+      stmt = to<Scope>(stmt)->scopedStmt;
+    }
+    return isa<For>(stmt) ? to<For>(stmt) : nullptr;
+  }
+
+  static bool isCandidate(const Item& item) {
+    const For* loop = getLoop(item.stmt);
+    return loop != nullptr && loop->domain.kind == ForDomain::IndexSet;
+  }
+
+  static Accesses collectLoopAccesses(const Item& item) {
+    const For* loop = getLoop(item.stmt);
+    return collectAccesses(loop->body, loop->var);
+  }
+
+  /// True if `a` and `b` are the same range or the same set variable.
+  static bool isSameIndexSet(const IndexSet& a, const IndexSet& b) {
+    if (a.getKind() != b.getKind()) {
+      return false;
+    }
+    switch (a.getKind()) {
+      case IndexSet::Range:
+        return a.getSize() == b.getSize();
+      case IndexSet::Set:
+        return a.getSet() == b.getSet() ||
+               (isa<VarExpr>(a.getSet()) && isa<VarExpr>(b.getSet()) &&
+                to<VarExpr>(a.getSet())->var == to<VarExpr>(b.getSet())->var);
+      case IndexSet::Single:
+      case IndexSet::Dynamic:
+        return false;
+    }
+    return false;
+  }
+
+  bool canFuse(const For* loop, const Accesses& loopAccesses,
+               const For* next, const Accesses& nextAccesses) {
+    return isSameIndexSet(loop->domain.indexSet, next->domain.indexSet) &&
+           !loopAccesses.opaque && !nextAccesses.opaque &&
+           (!parallel || runSameWay(loopAccesses, nextAccesses)) &&
+           !conflicts(loopAccesses, nextAccesses, true);
+  }
+
+  /// True if two loops both run serially or both run in parallel, and still do
+  /// when they are fused.
+  static bool runSameWay(const Accesses& loopAccesses,
+                         const Accesses& nextAccesses) {
+    Accesses fusedAccesses = loopAccesses;
+    fusedAccesses.merge(nextAccesses);
+    return loopAccesses.runsSerially() == nextAccesses.runsSerially() &&
+           fusedAccesses.runsSerially() == loopAccesses.runsSerially();
+  }
+
+  /// Fuses runs of loops in `items`. The statements between two fused loops
+  /// are hoisted before the fused loop if they do not conflict with the loops
+  /// before them, and are otherwise sunk after it.
+  vector<Item> fuse(const vector<Item>& items, bool* fused) {
+    vector<Item> result;
+    size_t i = 0;
+    while (i < items.size()) {
+      if (!isCandidate(items[i])) {
+        result.push_back(items[i]);
+        ++i;
+        continue;
+      }
+
+      Item loop = items[i];
+      Accesses loopAccesses = collectLoopAccesses(loop);
+      vector<Item> hoisted;
+      vector<Item> sunk;
+      Accesses sunkAccesses;
+      size_t end = i + 1;
+      while (true) {
+        // Find the next loop and place the statements before it
+        vector<Item> nextHoisted;
+        vector<Item> nextSunk;
+        Accesses nextSunkAccesses = sunkAccesses;
+        size_t j = end;
+        for (; j < items.size() && !isCandidate(items[j]); ++j) {
+          Accesses accesses = collectAccesses(items[j].stmt);
+          if (accesses.opaque || accesses.hasLoop) {
+            break;
+          }
+          if (!conflicts(accesses, loopAccesses, false) &&
+              !conflicts(accesses, nextSunkAccesses, false)) {
+            nextHoisted.push_back(items[j]);
+          }
+          else {
+            nextSunk.push_back(items[j]);
+            nextSunkAccesses.merge(accesses);
+          }
+        }
+        if (j == items.size() || !isCandidate(items[j])) {
+          break;
+        }
+
+        Accesses nextAccesses = collectLoopAccesses(items[j]);
+        const For* current = getLoop(loop.stmt);
+        const For* next = getLoop(items[j].stmt);
+        if (!canFuse(current, loopAccesses, next, nextAccesses) ||
+            conflicts(nextAccesses, nextSunkAccesses, false)) {
+          break;
+        }
+
+        Stmt nextBody = replaceVar(next->body, next->var, current->var);
+        loop.stmt = For::make(current->var, current->domain,
+                              Block::make(current->body, nextBody));
+        loop.comments.insert(loop.comments.end(), items[j].comments.begin(),
+                             items[j].comments.end());
+        loopAccesses.merge(nextAccesses);
+        hoisted.insert(hoisted.end(), nextHoisted.begin(), nextHoisted.end());
+        sunk.insert(sunk.end(), nextSunk.begin(), nextSunk.end());
+        sunkAccesses = nextSunkAccesses;
+        end = j + 1;
+        *fused = true;
+      }
+
+      result.insert(result.end(), hoisted.begin(), hoisted.end());
+      result.push_back(loop);
+      result.insert(result.end(), sunk.begin(), sunk.end());
+      i = end;
+    }
+    return result;
+  }
+};
+
+Func fuseLoops(Func func, bool parallel) {
+  Stmt body = FuseLoops(parallel).rewrite(func.getBody());
+  return Func(func, body);
+}
+
+}}
@@ -0,0 +1,21 @@
+#ifndef SIMIT_FUSE_LOOPS_H
+#define SIMIT_FUSE_LOOPS_H
+
+#include "func.h"
+
+namespace simit {
+namespace ir {
+
+/// Fuse adjacent loops over the same index set, so that consecutive vector
+/// updates, reductions and matrix-vector products stream their operands once.
+/// Two loops are fused if every tensor or set field that one of them writes
+/// and both access is only accessed at the loop variable. The statements
+/// between them are moved before or after the fused loop if that does not
+/// reorder any of their accesses. If `parallel` is set, loops that assign
+/// variables declared outside them, and therefore run serially, are not fused
+/// with loops that can run in parallel. Loops that only reduce into int or
+/// float scalars that they do not otherwise read run in parallel.
+Func fuseLoops(Func func, bool parallel);
+
+}}
+#endif
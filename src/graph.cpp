@@ -1,39 +1,282 @@
 #include "graph.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <iostream>
 
+#include "coloring.h"
+
 using namespace std;
 
 namespace simit {
 
 Set::~Set() {
+  for (const Set* endpointSet : endpointSets) {
+    if (endpointSet == nullptr) continue;
+    auto& edges = endpointSet->edgeSets;
+    edges.erase(std::remove(edges.begin(), edges.end(), this), edges.end());
+  }
+  // Edge sets that outlive this set no longer reference it
+  for (Set* edgeSet : edgeSets) {
+    std::replace(edgeSet->endpointSets.begin(), edgeSet->endpointSets.end(),
+                 (const Set*)this, (const Set*)nullptr);
+  }
   for (auto f: fields) {
     delete f;
   }
-  free(endpoints);
+  if (!endpointsMapped) {
+    internal::freeBuffer(endpoints, capacity * getCardinality() * sizeof(int));
+  }
   free(gridPoints);
   free(gridEdges);
 }
 
+void Set::registerWithEndpointSets() {
+  for (const Set* endpointSet : endpointSets) {
+    auto& edges = endpointSet->edgeSets;
+    if (std::find(edges.begin(), edges.end(), this) == edges.end()) {
+      edges.push_back(this);
+    }
+  }
+}
+
 void Set::increaseCapacity() {
+  // Geometric growth makes adding n elements one at a time copy O(n) bytes.
+  // Sets loaded from snapshots start out full, possibly with no capacity.
+  setCapacity(std::max(2*capacity, (int)initialCapacity));
+}
+
+void Set::setCapacity(int newCapacity) {
+  simit_iassert(newCapacity >= numElements);
   for (auto f : fields) {
-    int typeSize = f->sizeOfType;
-    f->data = realloc(f->data, (capacity+capacityIncrement) * typeSize);
-    memset((char*)(f->data)+capacity*typeSize, 0, capacityIncrement*typeSize);
+    // Mapped data is copied out, and each component of an SoA field moves to
+    // its place in the new capacity
+    size_t numArrays = f->getNumArrays();
+    f->data = internal::resizeBuffer(f->data, capacity, newCapacity,
+                                     numElements, f->sizeOfType/numArrays,
+                                     numArrays, !f->mapped);
+    f->mapped = false;
+  }
+  if (getCardinality() > 0) {
+    endpoints = (int*)internal::resizeBuffer(endpoints, capacity, newCapacity,
+                                             numElements,
+                                             getCardinality() * sizeof(int), 1,
+                                             !endpointsMapped);
+    endpointsMapped = false;
+  }
+  capacity = newCapacity;
 
+  // Reserve the element indices so that adding elements does not move them
+  // from under the field references
+  if (isReordered()) {
+    elementIndices.reserve(capacity);
+    elementIds.reserve(capacity);
+  }
+  updateFieldReferences();
+}
+
+void Set::updateFieldReferences() {
+  for (auto f : fields) {
     for (FieldRefBase *fieldRef : f->fieldReferences) {
       fieldRef->data = f->data;
+      fieldRef->componentStride = f->getComponentStride();
+      fieldRef->elementIndices = isReordered() ? elementIndices.data()
+                                               : nullptr;
+    }
+  }
+}
+
+void Set::permuteElementIndices(const std::vector<int>& ordering) {
+  simit_iassert(ordering.size() == (size_t)numElements);
+  if (!isReordered()) {
+    elementIndices.reserve(capacity);
+    elementIds.reserve(capacity);
+    for (int i = 0; i < numElements; ++i) {
+      elementIndices.push_back(i);
+      elementIds.push_back(i);
+    }
+  }
+  for (int id = 0; id < numElements; ++id) {
+    int index = ordering[elementIndices[id]];
+    elementIndices[id] = index;
+    elementIds[index] = id;
+  }
+  updateFieldReferences();
+}
+
+void Set::moveElement(int from, int to) {
+  if (from == to) return;
+  for (auto f : fields) {
+    // Each component of an SoA field is moved in its own array
+    size_t numArrays = f->getNumArrays();
+    size_t elementSize = f->sizeOfType / numArrays;
+    char* data = (char*)f->data;
+    for (size_t a = 0; a < numArrays; ++a) {
+      memcpy(data + (a*capacity + to)*elementSize,
+             data + (a*capacity + from)*elementSize, elementSize);
+    }
+  }
+  if (getCardinality() > 0) {
+    memcpy(endpoints + to*getCardinality(), endpoints + from*getCardinality(),
+           getCardinality() * sizeof(int));
+  }
+}
+
+void Set::remove(ElementRef element) {
+  simit_uassert(kind != Grid)
+      << "Element removal disallowed for grid edge sets";
+  simit_uassert(element.ident >= 0 && element.ident < numElements)
+      << "Invalid member of set (" << getName() << ") in remove";
+  int index = element.ident;
+  if (isReordered()) {
+    // The last stored element moves to the removed element's index
+    index = elementIndices[element.ident];
+    elementIds[index] = elementIds[numElements-1];
+    elementIndices[elementIds[index]] = index;
+    // and the element with the last id takes the removed element's id, unless
+    // the removed element has the last id
+    if (element.ident != numElements-1) {
+      int lastIndex = elementIndices[numElements-1];
+      elementIds[lastIndex] = element.ident;
+      elementIndices[element.ident] = lastIndex;
+    }
+    elementIndices.pop_back();
+    elementIds.pop_back();
+  }
+  moveElement(numElements-1, index);
+  numElements--;
+  invalidateIndices();
+}
+
+/// Moves the elements of `array` that are kept (`remap[i] != -1`) to their
+/// new indices, one run of consecutive kept elements at a time.
+static void compact(char* array, size_t elementSize, const vector<int>& remap) {
+  const int size = remap.size();
+  int start = 0;
+  while (start < size) {
+    if (remap[start] == -1) {
+      ++start;
+      continue;
     }
+    int end = start;
+    while (end < size && remap[end] != -1) {
+      ++end;
+    }
+    if (remap[start] != start) {
+      memmove(array + remap[start]*elementSize, array + start*elementSize,
+              (end-start)*elementSize);
+    }
+    start = end;
   }
-  capacity += capacityIncrement;
+}
+
+/// Numbers the elements that are kept (`remap[i] != -1`) consecutively.
+static int renumber(vector<int>& remap) {
+  int numKept = 0;
+  for (int& newIndex : remap) {
+    if (newIndex != -1) {
+      newIndex = numKept++;
+    }
+  }
+  return numKept;
+}
+
+vector<int> Set::removeAll(const vector<ElementRef>& elements) {
+  simit_uassert(kind != Grid)
+      << "Element removal disallowed for grid edge sets";
+  vector<int> remap(numElements, 0);
+  for (ElementRef element : elements) {
+    simit_uassert(element.ident >= 0 && element.ident < numElements)
+        << "Invalid member of set (" << getName() << ") in removeAll";
+    remap[element.ident] = -1;
+  }
+
+  // Elements are stored in id order unless the set is reordered
+  vector<int> indexRemap;
+  if (isReordered()) {
+    indexRemap.resize(numElements);
+    for (int id = 0; id < numElements; ++id) {
+      indexRemap[elementIndices[id]] = remap[id];
+    }
+    renumber(indexRemap);
+  }
+  int newSize = renumber(remap);
+  if (!isReordered()) {
+    indexRemap = remap;
+  }
+
+  for (auto f : fields) {
+    size_t numArrays = f->getNumArrays();
+    size_t elementSize = f->sizeOfType / numArrays;
+    for (size_t a = 0; a < numArrays; ++a) {
+      compact((char*)f->data + a*capacity*elementSize, elementSize, indexRemap);
+    }
+  }
+  if (getCardinality() > 0) {
+    compact((char*)endpoints, getCardinality()*sizeof(int), indexRemap);
+  }
+
+  if (isReordered()) {
+    vector<int> oldIndices;
+    oldIndices.swap(elementIndices);
+    elementIndices.resize(newSize);
+    elementIds.resize(newSize);
+    for (size_t id = 0; id < oldIndices.size(); ++id) {
+      if (remap[id] != -1) {
+        int index = indexRemap[oldIndices[id]];
+        elementIndices[remap[id]] = index;
+        elementIds[index] = remap[id];
+      }
+    }
+    elementIndices.reserve(capacity);
+    updateFieldReferences();
+  }
+
+  numElements = newSize;
+  invalidateIndices();
+  return remap;
+}
+
+void Set::remapEndpoints(const Set& endpointSet, const vector<int>& remap) {
+  simit_uassert(!endpointSet.isReordered())
+      << "Cannot remap endpoints into reordered set ("
+      << endpointSet.getName() << ")";
+  for (int i = 0; i < getCardinality(); ++i) {
+    if (endpointSets[i] != &endpointSet) continue;
+    for (int e = 0; e < numElements; ++e) {
+      int& endpoint = endpoints[e*getCardinality() + i];
+      simit_uassert(endpoint < (int)remap.size() && remap[endpoint] != -1)
+          << "Edge " << e << " of set (" << getName() << ") connects a "
+          << "removed element of set (" << endpointSet.getName() << ")";
+      endpoint = remap[endpoint];
+    }
+  }
+  invalidateIndices();
+}
+
+std::shared_ptr<const internal::SetColoring> Set::getColoring() const {
+  simit_uassert(getCardinality() > 0) << "Only edge sets can be colored";
+  if (coloring == nullptr) {
+    coloring.reset(new internal::SetColoring(*this));
+  }
+  return coloring;
+}
+
+void Set::invalidateIndices() {
+  coloring.reset();
+  generation = newGeneration();
+}
+
+unsigned long Set::newGeneration() {
+  static std::atomic<unsigned long> lastGeneration(0);
+  return ++lastGeneration;
 }
 
 
 // Graph generators
 void createElements(Set *elements, unsigned num) {
-  for (size_t i=0; i < num; ++i) {
-    elements->add();
-  }
+  elements->addN(num);
 }
 
 #define node0(x,y,z)  x*numY*numZ + y*numZ + z      // node at x,y,z
@@ -67,6 +310,9 @@ Box createBox(Set *vertices, Set *edges,
               unsigned numX, unsigned numY, unsigned numZ) {
   simit_uassert(numX >= 1 && numY >= 1 && numZ >= 1);
   vector<ElementRef> points(numX*numY*numZ);
+  vertices->reserve(vertices->getSize() + numX*numY*numZ);
+  edges->reserve(edges->getSize() + (numX-1)*numY*numZ + numX*(numY-1)*numZ +
+                 numX*numY*(numZ-1));
 
   for(unsigned x = 0; x < numX; ++x) {
     for(unsigned y = 0; y < numY; ++y) {
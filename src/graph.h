@@ -1,14 +1,17 @@
 #ifndef SIMIT_GRAPH_H
 #define SIMIT_GRAPH_H
 
+#include <algorithm>
 #include <cstddef>
 #include <cstring>
 #include <vector>
 #include <string>
 #include <map>
 #include <set>
+#include <memory>
 #include <ostream>
 
+#include "allocator.h"
 #include "tensor_type.h"
 #include "error.h"
 #include "types.h"
@@ -18,6 +21,7 @@
 namespace simit {
 
 class Function;
+class Snapshot;
 
 class Set;
 class FieldRefBase;
@@ -28,6 +32,7 @@ namespace internal {
 class VertexToEdgeEndpointIndex;
 class VertexToEdgeIndex;
 class NeighborIndex;
+class SetColoring;
 }
 
 namespace pe {
@@ -92,6 +97,9 @@ class Set {
 public:
   enum Kind {Unstructured, Grid};
 
+  /// The memory layout of a field's tensors (see addField).
+  enum FieldLayout {AoS, SoA};
+
   /// Construct a normal named set with no endpoints.
   Set(const std::string &name) : Set(name, Unstructured) {}
 
@@ -102,7 +110,9 @@ public:
     static_assert(util::areSame<Set, Sets...>{},
         "Set constructor takes an optional name followed by zero or more Sets");
     this->endpointSets = {&endpoints...};
-    this->endpoints    = (int*)calloc(sizeof(int), capacity * getCardinality());
+    this->endpoints    = (int*)internal::allocateBuffer(
+        capacity, getCardinality() * sizeof(int));
+    registerWithEndpointSets();
   }
 
   /// Construct a named edge set with n endpoints.
@@ -127,7 +137,9 @@ public:
         << "Grid Edge Set constructor must be passed an empty underlying "
         << "point set, which it will then proceed to initialize.";
     this->endpointSets = {&points, &points};
-    this->endpoints    = (int*)calloc(sizeof(int), capacity * getCardinality());
+    this->endpoints    = (int*)internal::allocateBuffer(
+        capacity, getCardinality() * sizeof(int));
+    registerWithEndpointSets();
     this->dimensions = dims;
     this->underlyingPointSet = &points;
 
@@ -251,12 +263,19 @@ public:
   /// component type and dimension sizes of the tensors.  For example, define a
   /// field of 2x3 matrices containing doubles as follows:
   /// Field<double,2,3> matrix = addField<double,2,3>("mat");
+  ///
+  /// By default the tensor of each element is stored in one piece (AoS). An
+  /// SoA field instead stores each component of all the elements together, so
+  /// that component c of element i is at c*getCapacity() + i in the field
+  /// data, and element-wise code reads each component with unit stride. Simit
+  /// programs must declare SoA fields with the `soa` qualifier.
   template <typename T, int... dimensions>
-  FieldRef<T, dimensions...> addField(const std::string &name) {
+  FieldRef<T, dimensions...> addField(const std::string &name,
+                                      FieldLayout layout=AoS) {
     FieldData::TensorType *type =
         new FieldData::TensorType(typeOf<T>(), {dimensions...});
-    FieldData *fieldData = new FieldData(name, type, this);
-    fieldData->data = calloc(capacity, fieldData->sizeOfType);
+    FieldData *fieldData = new FieldData(name, type, this, layout);
+    fieldData->data = fieldData->allocate(capacity);
     fields.push_back(fieldData);
     fieldNames[name] = fields.size()-1;
     return FieldRef<T, dimensions...>(fieldData);
@@ -295,58 +314,93 @@ public:
   ElementRef add(Endpoints... endpoints) {
     simit_iassert(sizeof...(endpoints) == getCardinality())
         <<"Wrong number of endpoints.";
-    if (numElements > capacity-1) {
-      increaseEdgeCapacity();
+    if (numElements == capacity) {
+      increaseCapacity();
     }
     addEndpoints(0, endpoints...);
-
-    if (numElements > capacity-1) {
-      increaseCapacity();
+    if (isReordered()) {
+      elementIndices.push_back(numElements);
+      elementIds.push_back(numElements);
     }
+    invalidateIndices();
     return ElementRef(numElements++);
   }
 
-  /// Remove an element from the Set
-  void remove(ElementRef element) {
-    simit_uassert(kind != Grid)
-        << "Element removal disallowed for grid edge sets";
-    for (auto f : fields){
-      switch (f->type->getComponentType()) {
-        case ComponentType::Float: {
-          float* data = (float*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
-        }
-        case ComponentType::Double: {
-          double* data = (double*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
-        }
-        case ComponentType::Int: {
-          int* data = (int*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
-        }
-        case ComponentType::Boolean: {
-          bool* data = (bool*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
-        }
-        case ComponentType::FloatComplex: {
-          float_complex* data = (float_complex*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
-        }
-        case ComponentType::DoubleComplex: {
-          double_complex* data = (double_complex*)f->data;
-          data[element.ident] = data[numElements-1];
-          break;
+  /// Add `n` elements or edges, returning the handle of the first one. The
+  /// elements are numbered consecutively. For edge sets, `endpoints` holds the
+  /// getCardinality() endpoints of each new edge one edge after the other, in
+  /// the layout of getEndpointsData(), and is copied in one go.
+  ElementRef addN(int n, const int* endpoints=nullptr) {
+    simit_uassert(n >= 0) << "Cannot add a negative number of elements";
+    simit_uassert(getCardinality() == 0 || endpoints != nullptr || n == 0)
+        << "Edges must be added with their endpoints";
+    for (int i = 0; i < n*getCardinality(); ++i) {
+      int which = i % getCardinality();
+      simit_uassert(endpoints[i] >= 0 &&
+                    endpoints[i] < endpointSets[which]->getSize())
+          << "Invalid member of set (" << endpointSets[which]->getName()
+          << ") in addN (" << endpoints[i] << " < "
+          << endpointSets[which]->getSize() << ")";
+    }
+    if (numElements + n > capacity) {
+      setCapacity(std::max(numElements + n, 2*capacity));
+    }
+    if (getCardinality() > 0) {
+      int* newEndpoints = this->endpoints + numElements*getCardinality();
+      memcpy(newEndpoints, endpoints, n*getCardinality()*sizeof(int));
+      for (int i = 0; i < n*getCardinality(); ++i) {
+        const Set* endpointSet = endpointSets[i % getCardinality()];
+        if (endpointSet->isReordered()) {
+          newEndpoints[i] = endpointSet->elementIndices[newEndpoints[i]];
         }
       }
     }
-    numElements--;
+    if (isReordered()) {
+      for (int i = numElements; i < numElements + n; ++i) {
+        elementIndices.push_back(i);
+        elementIds.push_back(i);
+      }
+    }
+    invalidateIndices();
+    ElementRef first(numElements);
+    numElements += n;
+    return first;
+  }
+
+  /// Make room for at least `n` elements, so that adding up to `n` elements
+  /// does not reallocate the fields or the endpoints.
+  void reserve(int n) {
+    if (n > capacity) {
+      setCapacity(n);
+    }
+  }
+
+  /// Return the number of elements the set can hold without reallocating.
+  inline int getCapacity() const { return capacity; }
+
+  /// Reduce the capacity to the number of elements, so that the components of
+  /// SoA fields are strided by the set size, as compiled code expects.
+  void shrinkToFit() {
+    if (capacity != numElements) {
+      setCapacity(numElements);
+    }
   }
 
+  /// Remove an element from the Set. The element with the highest id takes
+  /// the id of the removed element.
+  void remove(ElementRef element);
+
+  /// Remove the elements from the Set in one pass, keeping the order of the
+  /// remaining elements, and return the new id of each old id, or -1 for the
+  /// removed elements. Edges that connect removed elements must be removed
+  /// from their edge sets, and the endpoints of the edge sets over this set
+  /// updated with remapEndpoints.
+  std::vector<int> removeAll(const std::vector<ElementRef>& elements);
+
+  /// Translate the endpoints of this edge set that are elements of
+  /// `endpointSet` by a mapping returned by endpointSet.removeAll.
+  void remapEndpoints(const Set& endpointSet, const std::vector<int>& remap);
+
   /// Iterator that iterates over the elements in a Set
   ///
   /// This iterator is an input_iterator, and thus can only be
@@ -410,6 +464,11 @@ public:
     return endpointSets[loc];
   }
 
+  /// Get the edge sets with endpoints in this set.
+  const std::vector<Set*>& getEdgeSets() const {
+    return edgeSets;
+  }
+
   /// A set is homogeneous of all it's endpoints come from the same set,
   /// otherwise it is heterogeneous.
   bool isHomogeneous() const {
@@ -427,7 +486,9 @@ public:
 
   /// Get an endpoint of an edge
   ElementRef getEndpoint(ElementRef edge, int endpointNum) const {
-    return ElementRef(endpoints[edge.ident*getCardinality() + endpointNum]);
+    int endpoint = endpoints[getElementIndex(edge)*getCardinality() +
+                             endpointNum];
+    return endpointSets[endpointNum]->getElementAt(endpoint);
   }
   
   class Endpoints {
@@ -441,7 +502,7 @@ public:
 
       Iterator(const Set *set, ElementRef elem, int endpointN=0)
           : curElem(elem), retElem(-1), endpointNum(endpointN), set(set) {
-        if (set->getCardinality() > 0) {
+        if (endpointNum < set->getCardinality()) {
           retElem = set->getEndpoint(curElem, endpointNum);
         }
       }
@@ -453,12 +514,11 @@ public:
       const ElementRef* operator->() const {return &retElem;}
 
       Iterator& operator++() {
-        const int cardinality = set->getCardinality();
         endpointNum++;
         if (endpointNum > set->getCardinality()-1)
           retElem.ident = -1;   // return invalid element
         else
-          retElem.ident = set->endpoints[curElem.ident*cardinality+endpointNum];
+          retElem = set->getEndpoint(curElem, endpointNum);
         return *this;
       }
 
@@ -468,7 +528,7 @@ public:
         if (endpointNum > cardinality-1)
           retElem.ident = -1;   // return invalid element
         else
-          retElem.ident = set->endpoints[curElem.ident*cardinality+endpointNum];
+          retElem = set->getEndpoint(curElem, endpointNum);
         return *this;
       }
 
@@ -519,6 +579,7 @@ public:
     return Endpoints(this, edge);
   }
 
+  /// Get the data of a field, laid out as described in addField.
   void* getFieldData(const std::string &fieldName) {
     simit_uassert(fieldNames.find(fieldName) != fieldNames.end())
         << "The Set has no field " << fieldName;
@@ -566,13 +627,17 @@ public:
       size_t size;
     };
 
-    FieldData(const std::string &name, const TensorType *type, Set *set)
-        : name(name), type(type), set(set), data(nullptr) {
+    FieldData(const std::string &name, const TensorType *type, Set *set,
+              FieldLayout layout=AoS)
+        : name(name), type(type), set(set), data(nullptr), mapped(false),
+          layout(layout) {
       sizeOfType = componentSize(type->getComponentType()) * type->getSize();
     }
 
     ~FieldData() {
-      free(data);
+      if (!mapped) {
+        internal::freeBuffer(data, set->capacity * sizeOfType);
+      }
       delete type;
     }
 
@@ -587,6 +652,38 @@ public:
     /// Buffer for the field data
     void* data;
 
+    /// True if the data is mapped from a snapshot file (see Snapshot) instead
+    /// of allocated, in which case it is copied out before it is grown.
+    bool mapped;
+
+    /// The layout of the tensors in the data.
+    FieldLayout layout;
+
+    /// The distance, in components, between the tensors of two consecutive
+    /// elements.
+    size_t getElementStride() const {
+      return (layout == SoA) ? 1 : type->getSize();
+    }
+
+    /// The distance, in components, between two consecutive components of a
+    /// tensor.
+    size_t getComponentStride() const {
+      return (layout == SoA) ? set->capacity : 1;
+    }
+
+    /// The number of arrays the data is made of: one per component for SoA
+    /// fields, and one for AoS fields.
+    size_t getNumArrays() const {
+      return (layout == SoA) ? type->getSize() : 1;
+    }
+
+    /// Allocate zeroed data for `capacity` elements.
+    void* allocate(size_t capacity) const {
+      size_t numArrays = getNumArrays();
+      return internal::allocateBuffer(capacity, sizeOfType/numArrays,
+                                      numArrays);
+    }
+
     /// Field references so that we can update their data pointers if we realloc
     /// field data. Avoids two loads on field get/set.
     std::set<FieldRefBase*> fieldReferences;
@@ -597,6 +694,21 @@ public:
     FieldData& operator=(const FieldData& f);
   };
 
+  /// Get a coloring of the elements of this edge set where elements of the
+  /// same color share no endpoints. The coloring is computed on first use and
+  /// cached until the set is mutated.
+  std::shared_ptr<const internal::SetColoring> getColoring() const;
+
+  /// Discard the indices derived from the set's elements and endpoints. Code
+  /// that modifies the endpoints through getEndpointsPtr() must call this.
+  void invalidateIndices();
+
+  /// The generation of the set's elements and endpoints, which changes every
+  /// time indices are invalidated. Generations are unique across sets, so an
+  /// index built from a set is current as long as the same set is bound and
+  /// its generation is unchanged.
+  unsigned long getGeneration() const {return generation;}
+
   // Added getters for reordering
   inline int* getEndpointsPtr() { return endpoints; }
   inline int getFieldIndex(std::string name) { return fieldNames[name]; } inline 
@@ -604,13 +716,42 @@ public:
     getSpatialFieldName() const { return spatialFieldName; }
   inline bool hasSpatialField() const { return !spatialFieldName.empty(); }
 
+  /// True if the elements are stored in a different order than their ids,
+  /// which happens when Function::init reorders the set for locality (see
+  /// Settings::reorder). ElementRefs and FieldRefs keep addressing elements by
+  /// id, while compiled code, getFieldData and getEndpointsData see them in
+  /// storage order.
+  inline bool isReordered() const { return !elementIndices.empty(); }
+
+  /// Get the storage index of each element by id, or an empty vector if the
+  /// set is not reordered.
+  inline const std::vector<int>& getElementOrdering() const {
+    return elementIndices;
+  }
+
+  /// Get the storage index of an element.
+  inline int getElementIndex(ElementRef element) const {
+    return isReordered() ? elementIndices[element.ident] : element.ident;
+  }
+
+  /// Get the element stored at an index.
+  inline ElementRef getElementAt(int index) const {
+    return ElementRef(isReordered() ? elementIds[index] : index);
+  }
+
+  /// Record that the elements stored at index i were moved to ordering[i],
+  /// keeping their ids. The first call starts tracking element ids, so that
+  /// isReordered() becomes true. Does not move any data.
+  void permuteElementIndices(const std::vector<int>& ordering);
+
 private:
 
   // Private constructor for delegation
   Set(const std::string &name, Kind kind)
       : kind(kind), name(name), numElements(0), endpoints(nullptr),
-        gridPoints(nullptr), gridEdges(nullptr),
-        capacity(capacityIncrement), neighbors(nullptr) {}
+        endpointsMapped(false), gridPoints(nullptr), gridEdges(nullptr),
+        capacity(initialCapacity), neighbors(nullptr), coloring(nullptr),
+        generation(newGeneration()) {}
 
   // Set data
   Kind kind;
@@ -618,7 +759,9 @@ private:
   std::string spatialFieldName;
   int numElements;                           // number of elements in the set
   std::vector<const Set*> endpointSets;      // the sets the endpoints belong to
+  mutable std::vector<Set*> edgeSets;        // the edge sets over this set
   int* endpoints;                            // the endpoints of edge elements
+  bool endpointsMapped;                      // endpoints are in a snapshot
 
   // Grid edge set data
   std::vector<int> dimensions;               // the grid dimensions
@@ -627,18 +770,41 @@ private:
   ElementRef* gridEdges;                     // ordered refs to grid edges
 
   int capacity;                              // current capacity of the set
-  static const int capacityIncrement = 1024; // increment for capacity increases
+  static const int initialCapacity = 1024;   // capacity of a new set
 
   mutable internal::NeighborIndex *neighbors;// neighbor index (lazily created)
+  // element coloring (lazily created)
+  mutable std::shared_ptr<internal::SetColoring> coloring;
+  unsigned long generation;                  // see getGeneration()
   std::map<std::string, int> fieldNames;     // name to field lookups
   std::vector<FieldData*> fields;            // fields of elements in the set
+  std::vector<int> elementIndices;           // storage index by element id
+  std::vector<int> elementIds;               // element id by storage index
 
   /// disable copy
   Set& operator=(const Set& s);
 
-  /// increase capacity of all fields
+  friend class internal::SetColoring;
+
+  /// double the capacity of the fields and endpoints
   void increaseCapacity();
 
+  /// reallocate the fields and endpoints to hold `newCapacity` elements
+  void setCapacity(int newCapacity);
+
+  /// point the field references at the current field data and element indices
+  void updateFieldReferences();
+
+  /// add this set to the edge sets of its endpoint sets
+  void registerWithEndpointSets();
+
+  /// move the fields and endpoints of the element stored at index `from` to
+  /// index `to`
+  void moveElement(int from, int to);
+
+  /// returns a generation that no set has had before
+  static unsigned long newGeneration();
+
   /// helpers for constructing endpoint sets
   template <typename F, typename ...T> std::vector<const Set*>
   epsMaker(std::vector<const Set*> sofar, const F& f, const T& ... sets) const {
@@ -653,11 +819,6 @@ private:
   std::vector<const Set*>
   epsMaker(std::vector<const Set*> sofar) {return sofar;}
 
-  void increaseEdgeCapacity() {
-    size_t newSize = (capacity+capacityIncrement)*getCardinality()*sizeof(int);
-    endpoints = (int*)realloc(endpoints, newSize);
-  }
-
   // helper for adding edges
   template <typename F, typename ...T>
   void addEndpoints(int which, F f, T ... eps) {
@@ -665,7 +826,8 @@ private:
         << "Invalid member of set (" << endpointSets[which]->getName()
 		<< ")in addEdge (" << f.ident << " < "
 		<< endpointSets[which]->getSize() << ")";
-    endpoints[numElements*getCardinality()+which] = f.ident;
+    endpoints[numElements*getCardinality()+which] =
+        endpointSets[which]->getElementIndex(f);
     addEndpoints(which+1, eps...);
   }
   template <typename F>
@@ -674,7 +836,8 @@ private:
         << "Invalid member of set (" << endpointSets[which]->getName()
 		<< ") in addEdge (" << f.ident << " < "
 		<< endpointSets[which]->getSize() << ")";
-    endpoints[numElements*getCardinality()+which] = f.ident;
+    endpoints[numElements*getCardinality()+which] =
+        endpointSets[which]->getElementIndex(f);
   }
   void addEndpoints(int) {}
 
@@ -706,8 +869,9 @@ private:
       }
       FieldData::TensorType *type =
           new FieldData::TensorType(ctype, dims);
-      FieldData *fieldData = new FieldData(field.name, type, this);
-      fieldData->data = calloc(capacity, fieldData->sizeOfType);
+      FieldLayout layout = (field.layout == ir::Field::SoA) ? SoA : AoS;
+      FieldData *fieldData = new FieldData(field.name, type, this, layout);
+      fieldData->data = fieldData->allocate(capacity);
       fields.push_back(fieldData);
       fieldNames[field.name] = fields.size()-1;
     }
@@ -717,25 +881,16 @@ private:
     os << "{";
     auto it = begin();
     auto it_end = end();
-    if (it != it_end) {
-      os << it->ident;
-      if (getCardinality() > 0) {
-        os << ":(";
-        os << endpoints[0];
-        for (int i=1; i<getCardinality(); ++i) {
-          os << "," << endpoints[i];
-        }
-        os << ")";
-      }
-      ++it;
-    }
     while (it != it_end) {
-      os << ", " << it->ident;
+      if (it != begin()) {
+        os << ", ";
+      }
+      os << it->ident;
       if (getCardinality() > 0) {
         os << ":(";
-        os << endpoints[it->ident*getCardinality() + 0];
+        os << getEndpoint(*it, 0);
         for (int i=1; i<getCardinality(); ++i) {
-          os << "," << endpoints[it->ident*getCardinality() + i];
+          os << "," << getEndpoint(*it, i);
         }
         os << ")";
       }
@@ -746,6 +901,7 @@ private:
 
   friend FieldRefBase;
   friend simit::Function;
+  friend simit::Snapshot;
 };
 
 
@@ -765,12 +921,18 @@ public:
 
   FieldRefBase(const FieldRefBase& other) {
     data = other.data;
+    elementIndices = other.elementIndices;
+    elementStride = other.elementStride;
+    componentStride = other.componentStride;
     fieldData = other.fieldData;
     this->fieldData->fieldReferences.insert(this);
   }
 
   FieldRefBase(FieldRefBase&& other) {
     std::swap (data, other.data);
+    std::swap (elementIndices, other.elementIndices);
+    std::swap (elementStride, other.elementStride);
+    std::swap (componentStride, other.componentStride);
     std::swap (fieldData, other.fieldData);
     this->fieldData->fieldReferences.erase(&other);
     this->fieldData->fieldReferences.insert(this);
@@ -778,6 +940,9 @@ public:
 
   FieldRefBase& operator=(const FieldRefBase &other) {
     data = other.data;
+    elementIndices = other.elementIndices;
+    elementStride = other.elementStride;
+    componentStride = other.componentStride;
     fieldData = other.fieldData;
     this->fieldData->fieldReferences.insert(this);
     return *this;
@@ -785,6 +950,9 @@ public:
 
   FieldRefBase& operator=(FieldRefBase&& other) {
     std::swap(data, other.data);
+    std::swap(elementIndices, other.elementIndices);
+    std::swap (elementStride, other.elementStride);
+    std::swap (componentStride, other.componentStride);
     std::swap (fieldData, other.fieldData);
     this->fieldData->fieldReferences.erase(&other);
     this->fieldData->fieldReferences.insert(this);
@@ -792,8 +960,9 @@ public:
   }
 
   // Return the field's data.  The data is a contigues sequence containing the
-  // tensor of each element in no particular order.  The tensors are currently
-  // laid out in row-major order, but this may change in the future.
+  // tensor of each element in no particular order.  The tensors are laid out
+  // in row-major order, either one after the other or, for SoA fields, one
+  // component at a time (see Set::addField).
   inline void *getData() {
     return static_cast<void*>(data);
   }
@@ -801,21 +970,35 @@ public:
 protected:
   FieldRefBase(void *fieldData)
       : fieldData(static_cast<Set::FieldData*>(fieldData)),
-        data(this->fieldData->data) {
+        elementStride(this->fieldData->getElementStride()),
+        componentStride(this->fieldData->getComponentStride()),
+        data(this->fieldData->data),
+        elementIndices(this->fieldData->set->isReordered()
+                       ? this->fieldData->set->elementIndices.data()
+                       : nullptr) {
     this->fieldData->fieldReferences.insert(this);
   }
 
   template <typename T>
-  inline T *getElemDataPtr(ElementRef element, size_t elementFieldSize) const {
+  inline T *getElemDataPtr(ElementRef element) const {
     simit_iassert(sizeof(T) == componentSize(fieldData->type->getComponentType()));
-    return &static_cast<T*>(data)[element.ident * elementFieldSize];
+    int index = (elementIndices != nullptr) ? elementIndices[element.ident]
+                                            : element.ident;
+    return &static_cast<T*>(data)[index * elementStride];
   }
 
   Set::FieldData *fieldData;
 
+  /// The field data strides (see Set::FieldData)
+  size_t elementStride;
+  size_t componentStride;
+
 private:
   void *data;
 
+  /// The storage index of each element by id, if the set is reordered.
+  const int *elementIndices;
+
   friend Set;
 };
 
@@ -823,11 +1006,13 @@ template <typename T, int... dimensions>
 class FieldRefBaseParameterized : public FieldRefBase {
  public:
   TensorRef<T, dimensions...> get(ElementRef element) {
-    return TensorRef<T, dimensions...>(getElemDataPtr(element));
+    return TensorRef<T, dimensions...>(getElemDataPtr(element),
+                                       this->componentStride);
   }
 
   const TensorRef<T, dimensions...> get(ElementRef element) const {
-    return TensorRef<T, dimensions...>(getElemDataPtr(element));
+    return TensorRef<T, dimensions...>(getElemDataPtr(element),
+                                       this->componentStride);
   }
 
   TensorRef<T, dimensions...> operator()(ElementRef element) {
@@ -844,7 +1029,7 @@ class FieldRefBaseParameterized : public FieldRefBase {
     T *elemData = this->getElemDataPtr(element);
     size_t i=0;
     for (T val : values) {
-      elemData[i++] = val;
+      elemData[this->componentStride * i++] = val;
     }
   }
 
@@ -856,14 +1041,13 @@ class FieldRefBaseParameterized : public FieldRefBase {
     T *elemData = this->getElemDataPtr(element);
     size_t i=0;
     for (T val : values) {
-      elemData[i++] = val;
+      elemData[this->componentStride * i++] = val;
     }
   }
 
  protected:
   inline T *getElemDataPtr(ElementRef element) const {
-    size_t elementFieldSize = TensorRef<T,dimensions...>::getSize();
-    return FieldRefBase::getElemDataPtr<T>(element, elementFieldSize);
+    return FieldRefBase::getElemDataPtr<T>(element);
   }
 
   FieldRefBaseParameterized(void *fieldData) : FieldRefBase(fieldData) {}
@@ -953,7 +1137,7 @@ public:
     simit_iassert(vals.size() == util::product<Dimensions...>::value);
     size_t i=0;
     for (ComponentType val : vals) {
-      data[i++] = val;
+      data[stride * i++] = val;
     }
     return *this;
   }
@@ -962,14 +1146,16 @@ public:
   inline ComponentType& operator()(Indices... index) {
     static_assert(sizeof...(index) == sizeof...(Dimensions),
                   "Incorrect number of indices used to index tensor");
-    return data[util::computeOffset(util::seq<Dimensions...>(), index...)];
+    return data[util::computeOffset(util::seq<Dimensions...>(), index...) *
+                stride];
   }
 
   template <typename... Indices> inline
   const ComponentType& operator()(Indices... index) const {
     static_assert(sizeof...(index) == sizeof...(Dimensions),
                   "Incorrect number of indices used to index tensor");
-    return data[util::computeOffset(util::seq<Dimensions...>(), index...)];
+    return data[util::computeOffset(util::seq<Dimensions...>(), index...) *
+                stride];
   }
 
   friend bool operator==(const TensorRef& l, const TensorRef& r){
@@ -981,8 +1167,10 @@ public:
   }
 
 private:
-  inline TensorRef(ComponentType *data) : data(data) {}
+  inline TensorRef(ComponentType *data, size_t stride=1)
+      : data(data), stride(stride) {}
   ComponentType *data;
+  size_t stride;   // distance between components (see Set::addField)
 
   friend class FieldRefBaseParameterized<ComponentType, Dimensions...>;
 };
@@ -1019,7 +1207,7 @@ public:
   }
 
 private:
-  inline TensorRef(ComponentType *data) : data(data) {}
+  inline TensorRef(ComponentType *data, size_t=1) : data(data) {}
   ComponentType* data;
 
   friend class FieldRefBaseParameterized<ComponentType>;
@@ -2,4 +2,10 @@
 
 namespace simit {
 bool kIndexlessStencils;
+bool kBlockedSpmv = true;
+bool kMatrixFree = false;
+int kNumThreads = 1;
+bool kHugePages = false;
+bool kReorder = false;
+std::string kObjectCacheDir;
 }
@@ -13,12 +13,44 @@ namespace simit {
 extern const std::vector<std::string> VALID_BACKENDS;
 extern std::string kBackend;
 extern bool kIndexlessStencils;
+extern bool kBlockedSpmv;
+extern bool kMatrixFree;
+extern int kNumThreads;
+extern bool kHugePages;
+extern bool kReorder;
+extern std::string kObjectCacheDir;
 
 // Settings struct with default values
 struct Settings {
   std::string backend="cpu";
   int floatSize = 8;
   bool indexlessStencils = false;
+  /// Lower sparse matrix-vector products to kernels specialized for the block
+  /// shape of the matrix, rather than to generic index expression loops.
+  bool blockedSpmv = true;
+  /// Compute products of matrices that are only assembled to be multiplied by
+  /// vectors, such as the matrices of iterative solvers, from the maps that
+  /// assemble them, without storing the matrices or building their indices
+  /// (see fuseMatrixVectorProducts). Saves the memory of the matrices at the
+  /// cost of recomputing their blocks at every product.
+  bool matrixFree = false;
+  /// Number of threads used to execute set loops and to build the indices of
+  /// the sets bound to a function. With one thread all loops run serially on
+  /// the calling thread.
+  int numThreads = 1;
+  /// Align field, endpoint and temporary buffers of at least a huge page to
+  /// huge pages, and ask the kernel to back them with transparent huge pages.
+  /// Has no effect if an allocator is installed with setAllocator.
+  bool hugePages = false;
+  /// Reorder the sets bound to a function for locality when the function is
+  /// initialized (see reorderForLocality). Host code keeps addressing elements
+  /// by the ids they were added with, while field data and endpoints are
+  /// stored in the new order (see Set::getElementOrdering).
+  bool reorder = false;
+  /// Directory where the CPU backend caches the object code of compiled
+  /// functions across runs. The directory must exist. An empty string disables
+  /// the cache.
+  std::string objectCacheDir = "";
 };
 
 inline void init(const Settings& settings) {
@@ -36,6 +68,26 @@ inline void init(const Settings& settings) {
 
   // indexlessStencils
   kIndexlessStencils = settings.indexlessStencils;
+
+  // blockedSpmv
+  kBlockedSpmv = settings.blockedSpmv;
+
+  // matrixFree
+  kMatrixFree = settings.matrixFree;
+
+  // numThreads
+  simit_uassert(settings.numThreads >= 1)
+      << "Invalid number of threads: " << settings.numThreads;
+  kNumThreads = settings.numThreads;
+
+  // hugePages
+  kHugePages = settings.hugePages;
+
+  // reorder
+  kReorder = settings.reorder;
+
+  // objectCacheDir
+  kObjectCacheDir = settings.objectCacheDir;
 }
 
 inline void init(std::string backend="cpu", int floatSize=8) {
@@ -159,7 +159,8 @@ Func inlineCalls(Func func) {
 }
 
 Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
-                       MapFunctionRewriter &rewriter, Storage* storage);
+                       MapFunctionRewriter &rewriter, Storage* storage,
+                       Environment* env);
 
 Stmt MapFunctionRewriter::inlineMapFunc(const Map *map, Var targetLoopVar,
                                         Storage *storage,
@@ -515,15 +516,18 @@ static bool isHomogeneous(const std::vector<Expr*>& endpointSets) {
 ///   for i in 0:2
 ///     for j in 0:2
 ///       var .locVar : int;
-///       .locVar = __loc(.eps[i], .eps[j], As_index.coords, As_index.sinks);
+///       .locVar = As_index.E_locs_vv[((e * 2) + i) * 2 + j];
 ///       .As_index_locs(i,j) = .locVar;
 ///     end
 ///   end
 /// ~~~~~~~~~~~~~~~
+/// If `table` is undefined the locations are instead found by searching the
+/// index rows: `.locVar = __sorted_loc(.eps[i], .eps[j], As_index.coords,
+/// As_index.sinks)`.
 /// (Locations for matrices with the same index are only computed once.)
 static Stmt gatherVVLocs(TensorIndex index, const std::vector<Expr*> &endpoints,
-                         const std::vector<IndexSet> &dims, Var eps,
-                         std::map<TensorIndex,Var>* indexToLocs) {
+                         const std::vector<IndexSet> &dims, Var eps, Var lv,
+                         Var table, std::map<TensorIndex,Var>* indexToLocs) {
   const int cardinality = endpoints.size();
 
   Type locsType = TensorType::make(ScalarType::Int,
@@ -541,8 +545,11 @@ static Stmt gatherVVLocs(TensorIndex index, const std::vector<Expr*> &endpoints,
   Var j("j", Int);
 
   Var locVar(INTERNAL_PREFIX("locVar"), Int);
-  Stmt locStmt = CallStmt::make({locVar}, intrinsics::loc(),
-                                {Load::make(eps,i),Load::make(eps,j),ptr, idx});
+  Stmt locStmt = table.defined()
+      ? AssignStmt::make(locVar, Load::make(table, (lv*cardinality + i)
+                                                   * cardinality + j))
+      : CallStmt::make({locVar}, intrinsics::sortedLoc(),
+                       {Load::make(eps,i),Load::make(eps,j),ptr, idx});
   Stmt locsInit = Block::make({locStmt, TensorWrite::make(locs,{i,j}, locVar)});
 
   if (isHomogeneous(endpoints)) {
@@ -584,15 +591,18 @@ static Stmt gatherVVLocs(TensorIndex index, const std::vector<Expr*> &endpoints,
 ///     var .As_index_locs : tensor[0:2](int);
 ///     for i in 0:2
 ///       var .locVar : int;
-///       .locVar = __loc(.eps[i], e, As_index.coords, As_index.sinks);
+///       .locVar = As_index.E_locs_ve[(e * 2) + i];
 ///       .As_index_locs(i) = .locVar;
 ///     end
 ///     ...
 ///   end
 /// ~~~~~~~~~~~~~~~
+/// If `table` is undefined the locations are instead found by searching the
+/// index rows: `.locVar = __sorted_loc(.eps[i], e, As_index.coords,
+/// As_index.sinks)`.
 /// (Locations for matrices with the same index are only computed once.)
 static Stmt gatherVELocs(TensorIndex index, const std::vector<Expr*> &endpoints, 
-                         IndexSet vDim, Var eps, Var lv,
+                         IndexSet vDim, Var eps, Var lv, Var table,
                          std::map<TensorIndex,Var>* indexToLocs) {
   const int cardinality = endpoints.size();
 
@@ -608,8 +618,10 @@ static Stmt gatherVELocs(TensorIndex index, const std::vector<Expr*> &endpoints,
   Var i("i", Int);
 
   Var locVar(INTERNAL_PREFIX("locVar"), Int);
-  Stmt locStmt = CallStmt::make({locVar}, intrinsics::loc(),
-                                {Load::make(eps,i), lv, ptr, idx});
+  Stmt locStmt = table.defined()
+      ? AssignStmt::make(locVar, Load::make(table, lv*cardinality + i))
+      : CallStmt::make({locVar}, intrinsics::sortedLoc(),
+                       {Load::make(eps,i), lv, ptr, idx});
   Stmt locsInit = Block::make({locStmt, TensorWrite::make(locs,{i}, locVar)});
 
   if (isHomogeneous(endpoints)) {
@@ -688,7 +700,8 @@ static Stmt gatherEVLocs(TensorIndex index, const std::vector<Expr*> &endpoints,
 /// Inlines the mapped function with respect to the given loop variable over
 /// the target set, using the given rewriter.
 Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
-                       MapFunctionRewriter &rewriter, Storage* storage) {
+                       MapFunctionRewriter &rewriter, Storage* storage,
+                       Environment* env) {
   // Compute locations of the mapped edge
   bool returnsMatrix = false;
 
@@ -739,6 +752,11 @@ Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
 
         auto dims = type->getOuterDimensions();
 
+        // Homogeneous edge sets bound to the function get location tables
+        bool buildTable = env != nullptr && isa<VarExpr>(target) &&
+                          isHomogeneous(endpoints);
+        Var tableSet = buildTable ? to<VarExpr>(target)->var : Var();
+
         // Compute locations to use to index into the result matrix. E.g.:
         // ~~~~~~~~~~~~~~~
         //   As(.As_index_locs(0,0)) += 1;
@@ -749,11 +767,18 @@ Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
         Stmt gatherLocs;
         if (dims[0] != target && dims[1] != target) {
           // vv matrix
-          gatherLocs = gatherVVLocs(index, endpoints, dims, eps, &indexToLocs);
+          Var table = buildTable
+              ? env->addLocationTable(LocationTable::VV, index, tableSet)
+              : Var();
+          gatherLocs = gatherVVLocs(index, endpoints, dims, eps, lv, table,
+                                    &indexToLocs);
         }
         else if (dims[0] != target && dims[1] == target) {
           // ve matrix
-          gatherLocs = gatherVELocs(index, endpoints, dims[0], eps, lv, 
+          Var table = buildTable
+              ? env->addLocationTable(LocationTable::VE, index, tableSet)
+              : Var();
+          gatherLocs = gatherVELocs(index, endpoints, dims[0], eps, lv, table,
                                     &indexToLocs);
         }
         else if (dims[0] == target && dims[1] != target) {
@@ -819,7 +844,7 @@ Stmt inlineMapFunction(const Map *map, Var lv, vector<Var> ivs,
 }
 
 Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
-               Storage* storage) {
+               Storage* storage, Environment* env) {
   Func kernel = map->function;
   kernel = insertTemporaries(kernel);
 
@@ -839,7 +864,7 @@ Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
   }
 
   Stmt inlinedMapFunc = inlineMapFunction(map, loopVar, gridIndexVars,
-                                          rewriter, storage);
+                                          rewriter, storage, env);
 
   Stmt inlinedMap;
   auto initializers = vector<Stmt>();
@@ -878,8 +903,14 @@ Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
   if (map->reduction.getKind() != ReductionOperator::Undefined) {
     for (auto &var : map->vars) {
       simit_iassert(var.getType().isTensor());
+      if (map->reduction.getKind() != ReductionOperator::Sum &&
+          storage->hasStorage(var) &&
+          storage->getStorage(var).getKind() != TensorStorage::Dense) {
+        not_supported_yet << "maps can only assemble sparse matrices with "
+                          << "sum reductions";
+      }
       Stmt init = AssignStmt::make(var, var);
-      init = initializeLhsToZero(init);
+      init = initializeLhsToIdentity(init, map->reduction);
       inlinedMap = Block::make(init, inlinedMap);
     }
   }
@@ -99,9 +99,11 @@ protected:
 
 Func inlineCalls(Func func);
 
-/// Inlines the map returning a loop, using the given rewriter.
+/// Inlines the map returning a loop, using the given rewriter. If `env` is
+/// given, matrix assemblies over edge sets read their locations from location
+/// tables that are added to it, instead of searching the matrix indices.
 Stmt inlineMap(const Map *map, MapFunctionRewriter &rewriter,
-               Storage* storage);
+               Storage* storage, Environment* env=nullptr);
 
 }}
 
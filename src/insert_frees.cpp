@@ -1,12 +1,15 @@
 #include "insert_frees.h"
 
+#include <set>
 #include <stack>
 
 #include "ir.h"
 #include "ir_rewriter.h"
+#include "ir_visitor.h"
 #include "intrinsics.h"
 #include "tensor_index.h"
 #include "path_expressions.h"
+#include "lower/index_expressions/lower_matrix_multiply.h"
 
 using namespace std;
 
@@ -15,10 +18,12 @@ namespace ir {
 
 class InsertFrees : public IRRewriter {
 public:
-  InsertFrees(const Storage& storage) : storage{storage} {}
+  InsertFrees(const Storage& storage, const set<Var>& runtimeOwned)
+      : storage{storage}, runtimeOwned{runtimeOwned} {}
 
 private:
   const Storage& storage;
+  set<Var> runtimeOwned;
   stack<vector<Var>> varsToFreeStack;
 
   using IRRewriter::visit;
@@ -39,7 +44,8 @@ private:
     // If a indexed tensor does not have a path expression, then its storage is
     // managed on the stack and it must be freed.
     Var var = op->var;
-    if (storage.hasStorage(var)) {
+    if (storage.hasStorage(var) &&
+        runtimeOwned.find(var) == runtimeOwned.end()) {
       auto tensorStorage = storage.getStorage(var);
       if (tensorStorage.getKind() == TensorStorage::Indexed) {
         auto index = tensorStorage.getTensorIndex();
@@ -55,7 +61,18 @@ private:
 };
 
 Func insertFrees(Func func) {
-  return InsertFrees(func.getStorage()).rewrite(func);
+  // Sparse matrix products without path expressions are computed by the
+  // runtime, which owns their results and reuses them across calls until the
+  // function is de-initialized
+  set<Var> runtimeOwned;
+  match(func.getBody(),
+    function<void(const AssignStmt*)>([&](const AssignStmt* op) {
+      if (isa<IndexExpr>(op->value) && isGemm(to<IndexExpr>(op->value))) {
+        runtimeOwned.insert(op->var);
+      }
+    })
+  );
+  return InsertFrees(func.getStorage(), runtimeOwned).rewrite(func);
 }
 
 }}
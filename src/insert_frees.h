@@ -7,7 +7,8 @@ namespace simit {
 namespace ir {
 
 /// Insert a free wherever a sparse tensor allocated by an extern function
-/// leaves scope.
+/// leaves scope. The results of sparse matrix products are not freed, since
+/// the runtime reuses them across calls.
 Func insertFrees(Func func);
 
 }}
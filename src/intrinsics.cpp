@@ -497,6 +497,51 @@ const Func& triangularSolve() {
   return triangularSolveVar;
 }
 
+static Func cgsolveVar;
+void cgsolveInit() {
+  cgsolveVar = Func("cgsolve",
+                    {Var("A", Type()), Var("b", Type()), Var("x0", Type()),
+                     Var("tol", Float), Var("maxiters", Int)},
+                    {Var("x", Type())},
+                    Func::External);
+}
+const Func& cgsolve() {
+  if (!cgsolveVar.defined()) {
+    cgsolveInit();
+  }
+  return cgsolveVar;
+}
+
+static Func pcgsolveVar;
+void pcgsolveInit() {
+  pcgsolveVar = Func("pcgsolve",
+                     {Var("A", Type()), Var("b", Type()), Var("x0", Type()),
+                      Var("tol", Float), Var("maxiters", Int)},
+                     {Var("x", Type())},
+                     Func::External);
+}
+const Func& pcgsolve() {
+  if (!pcgsolveVar.defined()) {
+    pcgsolveInit();
+  }
+  return pcgsolveVar;
+}
+
+static Func bicgstabsolveVar;
+void bicgstabsolveInit() {
+  bicgstabsolveVar = Func("bicgstabsolve",
+                          {Var("A", Type()), Var("b", Type()), Var("x0", Type()),
+                           Var("tol", Float), Var("maxiters", Int)},
+                          {Var("x", Type())},
+                          Func::External);
+}
+const Func& bicgstabsolve() {
+  if (!bicgstabsolveVar.defined()) {
+    bicgstabsolveInit();
+  }
+  return bicgstabsolveVar;
+}
+
 static Func lumatsolveVar;
 void lumatsolveInit() {
   lumatsolveVar = Func("lumatsolve",
@@ -651,6 +696,34 @@ const Func& storeTime() {
   return storeTimeVar;
 }
 
+static Func profileBeginVar;
+void profileBeginInit() {
+  profileBeginVar = Func("profileBegin",
+                         {Var("region", Int)},
+                         {},
+                         Func::Intrinsic);
+}
+const Func& profileBegin() {
+  if (!profileBeginVar.defined()) {
+    profileBeginInit();
+  }
+  return profileBeginVar;
+}
+
+static Func profileEndVar;
+void profileEndInit() {
+  profileEndVar = Func("profileEnd",
+                       {Var("region", Int)},
+                       {},
+                       Func::Intrinsic);
+}
+const Func& profileEnd() {
+  if (!profileEndVar.defined()) {
+    profileEndInit();
+  }
+  return profileEndVar;
+}
+
 static Func mallocVar;
 void mallocInit() {
   mallocVar = Func("malloc",
@@ -693,6 +766,20 @@ const Func& loc() {
   return locVar;
 }
 
+static Func sortedLocVar;
+void sortedLocInit() {
+  sortedLocVar = Func("__sorted_loc",
+                      {},
+                      {Var("r", Int)},
+                      Func::Intrinsic);
+}
+const Func& sortedLoc() {
+  if (!sortedLocVar.defined()) {
+    sortedLocInit();
+  }
+  return sortedLocVar;
+}
+
 
 const std::map<std::string,Func> &byNames() {
   static std::map<std::string,Func> byNameMap;
@@ -731,6 +818,9 @@ const std::map<std::string,Func> &byNames() {
     lufreeInit();
     lusolveInit();
     triangularSolveInit();
+    cgsolveInit();
+    pcgsolveInit();
+    bicgstabsolveInit();
     lumatsolveInit();
     cholInit();
     cholfreeInit();
@@ -742,9 +832,12 @@ const std::map<std::string,Func> &byNames() {
     strcatInit();
     clockInit();
     storeTimeInit();
+    profileBeginInit();
+    profileEndInit();
     mallocInit();
     freeInit();
     locInit();
+    sortedLocInit();
     byNameMap.insert({{"mod",modVar},
                       {"sin",sinVar},
                       {"cos",cosVar},
@@ -779,6 +872,9 @@ const std::map<std::string,Func> &byNames() {
                       {"lufree", lufreeVar},
                       {"lusolve", lusolveVar},
                       {"triangularSolve", triangularSolveVar},
+                      {"cgsolve", cgsolveVar},
+                      {"pcgsolve", pcgsolveVar},
+                      {"bicgstabsolve", bicgstabsolveVar},
 					  {"lumatsolve", lumatsolveVar},
                       {"chol", cholVar},
                       {"cholfree", cholfreeVar},
@@ -790,9 +886,12 @@ const std::map<std::string,Func> &byNames() {
                       {"strcat", strcatVar},
                       {"clock",clockVar},
                       {"storeTime",storeTimeVar},
+                      {"profileBegin",profileBeginVar},
+                      {"profileEnd",profileEndVar},
                       {"malloc", mallocVar},
                       {"free", freeVar},
-                      {"__loc", locVar}});
+                      {"__loc", locVar},
+                      {"__sorted_loc", sortedLocVar}});
   }
   return byNameMap;
 }
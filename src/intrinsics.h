@@ -62,6 +62,9 @@ const Func& cholfree();
 const Func& lltsolve();
 const Func& lltmatsolve();
 const Func& triangularSolve();
+const Func& cgsolve();
+const Func& pcgsolve();
+const Func& bicgstabsolve();
 
 // String manipulation
 const Func& strcmp();
@@ -73,10 +76,15 @@ const Func& strcat();
 const Func& clock();
 const Func& storeTime();
 
+// Profiling probes, which start and stop timing a region (see timers.h)
+const Func& profileBegin();
+const Func& profileEnd();
+
 // Internal functions
 const Func& malloc();
 const Func& free();
 const Func& loc();
+const Func& sortedLoc();
 
 const std::map<std::string,Func> &byNames();
 
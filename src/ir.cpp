@@ -105,6 +105,9 @@ std::ostream &operator<<(std::ostream &os, const ForDomain &d) {
     case ForDomain::Diagonal:
       os << d.set << ".diagonal[" << d.var << "]";
       break;
+    case ForDomain::Colors:
+      os << d.set << ".colors";
+      break;
   }
   return os;
 }
@@ -182,6 +185,18 @@ std::ostream &operator<<(std::ostream &os, const CompoundOperator &cop) {
       os << "-";
       break;
     }
+    case CompoundOperator::Mul: {
+      os << "*";
+      break;
+    }
+    case CompoundOperator::Min: {
+      os << "min";
+      break;
+    }
+    case CompoundOperator::Max: {
+      os << "max";
+      break;
+    }
   }
   return os;
 }
@@ -141,7 +141,7 @@ Type getIndexExprType(std::vector<IndexVar> lhsIndexVars, Expr expr,
 
 
 /// CompoundOperator used with AssignStmt, TensorWrite, FieldWrite and Store.
-enum class CompoundOperator { None, Add, Sub };
+enum class CompoundOperator { None, Add, Sub, Mul, Min, Max };
 std::ostream &operator<<(std::ostream &os, const CompoundOperator &);
 
 
@@ -381,8 +381,11 @@ struct ForRange : public StmtNode {
 };
 
 struct ForDomain {
+  /// Colors iterates over the elements of the edge set `set` one color at a
+  /// time (see Set::getColoring). Elements of the same color share no
+  /// endpoints, so their iterations never update the same endpoint data.
   enum Kind { IndexSet, Endpoints, Edges, Neighbors, NeighborsOf,
-              Diagonal, Grid };
+              Diagonal, Grid, Colors };
   Kind kind;
 
   /// An index set
@@ -403,7 +406,7 @@ struct ForDomain {
   }
   ForDomain(Expr set, Var var, Kind kind, class IndexSet indexSet) : kind(kind),
       indexSet(indexSet), set(set), var(var)  {
-    simit_iassert(kind == NeighborsOf);
+    simit_iassert(kind == NeighborsOf || kind == Colors);
   }
   ForDomain(Expr set, Var var, int dims, string varName="")
       : kind(Grid), set(set), var(var) {
@@ -1,5 +1,6 @@
 #include "ir_codegen.h"
 
+#include <limits>
 #include <vector>
 
 #include "ir_rewriter.h"
@@ -28,6 +29,68 @@ Expr getZeroVal(const TensorType *type) {
   }
 }
 
+Expr getIdentityVal(const TensorType *type, ReductionOperator reduction) {
+  ScalarType::Kind kind = type->getComponentType().kind;
+  switch (reduction.getKind()) {
+    case ReductionOperator::Sum:
+      return getZeroVal(type);
+    case ReductionOperator::Product:
+      switch (kind) {
+        case ScalarType::Int:
+          return Literal::make(1);
+        case ScalarType::Float:
+          return Literal::make(1.0);
+        case ScalarType::Complex:
+          return Literal::make(double_complex(1.0, 0.0));
+        default:
+          break;
+      }
+      break;
+    case ReductionOperator::Max:
+      switch (kind) {
+        case ScalarType::Int:
+          return Literal::make(numeric_limits<int>::min());
+        case ScalarType::Float:
+          return Literal::make(-numeric_limits<double>::infinity());
+        default:
+          break;
+      }
+      break;
+    case ReductionOperator::Min:
+      switch (kind) {
+        case ScalarType::Int:
+          return Literal::make(numeric_limits<int>::max());
+        case ScalarType::Float:
+          return Literal::make(numeric_limits<double>::infinity());
+        default:
+          break;
+      }
+      break;
+    case ReductionOperator::Undefined:
+      break;
+  }
+  simit_unreachable;
+  return Expr();
+}
+
+Expr getIdentityVal(const TensorType *type, CompoundOperator cop) {
+  switch (cop) {
+    case CompoundOperator::Add:
+    case CompoundOperator::Sub:
+      return getIdentityVal(type, ReductionOperator::Sum);
+    case CompoundOperator::Mul:
+      return getIdentityVal(type, ReductionOperator::Product);
+    case CompoundOperator::Max:
+      return getIdentityVal(type, ReductionOperator::Max);
+    case CompoundOperator::Min:
+      return getIdentityVal(type, ReductionOperator::Min);
+    case CompoundOperator::None:
+      break;
+  }
+  simit_unreachable;
+  return Expr();
+}
+
 Stmt initializeLhsToZero(Stmt stmt) {
   class ReplaceRhsWithZero : public IRRewriter {
     void visit(const AssignStmt *op) {
@@ -48,6 +111,36 @@ Stmt initializeLhsToZero(Stmt stmt) {
   return ReplaceRhsWithZero().rewrite(stmt);
 }
 
+Stmt initializeLhsToIdentity(Stmt stmt, ReductionOperator reduction) {
+  class ReplaceRhsWithIdentity : public IRRewriter {
+  public:
+    ReplaceRhsWithIdentity(ReductionOperator reduction)
+        : reduction(reduction) {}
+
+  private:
+    ReductionOperator reduction;
+
+    void visit(const AssignStmt *op) {
+      Expr identityVal = getIdentityVal(op->var.getType().toTensor(),
+                                        reduction);
+      stmt = AssignStmt::make(op->var, identityVal);
+    }
+
+    void visit(const FieldWrite *op) {
+      Expr identityVal = getIdentityVal(op->value.type().toTensor(),
+                                        reduction);
+      stmt = FieldWrite::make(op->elementOrSet, op->fieldName, identityVal);
+    }
+
+    void visit(const TensorWrite *op) {
+      Expr identityVal = getIdentityVal(op->tensor.type().toTensor(),
+                                        reduction);
+      stmt = TensorWrite::make(op->tensor, op->indices, identityVal);
+    }
+  };
+  return ReplaceRhsWithIdentity(reduction).rewrite(stmt);
+}
+
 Stmt initializeTensorToZero(Stmt stmt) {
   class BuildInitLoopNest : public IRRewriter {
     Stmt makeLoopNest(Expr tensor) {
@@ -11,6 +11,14 @@ namespace ir {
 /// Create a simple assign to scalar zero (regardless of lhs dimensions)
 Stmt initializeLhsToZero(Stmt stmt);
 
+/// Create a simple assign to the identity of the reduction operator, e.g. zero
+/// for sums and infinity for minimums (regardless of lhs dimensions)
+Stmt initializeLhsToIdentity(Stmt stmt, ReductionOperator reduction);
+
+/// The value that compound assignments with `cop` leave unchanged, e.g. zero
+/// for `+=` and infinity for `min=`.
+Expr getIdentityVal(const TensorType *type, CompoundOperator cop);
+
 /// Build a loop nest to assign all components of lhs to zero
 Stmt initializeTensorToZero(Stmt stmt);
 
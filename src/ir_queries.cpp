@@ -204,6 +204,22 @@ bool isBlocked(Stmt stmt) {
   return IsBlockedVisitor().check(stmt);
 }
 
+Expr getSoAStride(Expr tensor) {
+  if (!isa<FieldRead>(tensor)) {
+    return Expr();
+  }
+  const FieldRead *fieldRead = to<FieldRead>(tensor);
+  Type setType = fieldRead->elementOrSet.type();
+  if (!setType.isSet()) {
+    return Expr();
+  }
+  const ElementType *elemType = setType.toSet()->elementType.toElement();
+  if (elemType->field(fieldRead->fieldName).layout != Field::SoA) {
+    return Expr();
+  }
+  return Length::make(IndexSet(fieldRead->elementOrSet));
+}
+
 std::vector<Func> getCallTree(Func func) {
   class ReverseCallGraphBuilder : public IRVisitor {
   public:
@@ -29,6 +29,11 @@ bool isFlattened(Stmt stmt);
 /// rhs is a blocked tensor
 bool isBlocked(Stmt stmt);
 
+/// Returns the size of the set whose field `tensor` reads, if the field is laid
+/// out component-major (see Field::Layout), and an undefined Expr otherwise.
+/// Component c of the block of element i of such a field is at c*size + i.
+Expr getSoAStride(Expr tensor);
+
 /// Returns the call tree of `func`. The call tree constains all functions
 /// (transitively) called from `func`.
 std::vector<Func> getCallTree(Func func);
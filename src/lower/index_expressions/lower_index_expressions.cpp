@@ -8,6 +8,7 @@
 #include "lower_scatter_workspace.h"
 #include "lower_transpose.h"
 #include "lower_matrix_multiply.h"
+#include "lower_matrix_vector_multiply.h"
 
 #include "path_expressions.h"
 
@@ -120,66 +121,34 @@ inline bool isTranspose(const IndexExpr* iexpr) {
   return true;
 }
 
-inline bool isGemm(const IndexExpr* iexpr) {
-  // Very specific index expression form: (i,j B(i,+k)*C(+k,j))
-  // "First" matrix is defined as the one with its first index var
-  // as a free variable. The "second" matrix is defined as the reverse.
-  // The remaining variable should be summed.
-  if (iexpr->resultVars.size() != 2) {
-    return false;
-  }
-  bool result = true;
-  bool foundFirst = false;
-  bool foundSecond = false;
-  match(iexpr->value,
+/// True if `indexExpression` reads the vector or field `target`.
+inline bool readsTarget(const IndexExpr* indexExpression, const Expr& target) {
+  bool result = false;
+  match(indexExpression->value,
     std::function<void(const IndexedTensor*)>([&](const IndexedTensor* op) {
-      if (result == false) {
-        return;
-      }
-      if (op->indexVars.size() != 2) {
-        result = false;
-        return;
-      }
-      // Check for first matrix
-      // TODO: We only allow non-transposed multiplication
-      if (op->indexVars[0].isFreeVar() &&
-          op->indexVars[0] == iexpr->resultVars[0] &&
-          op->indexVars[1].isReductionVar() &&
-          op->indexVars[1].getOperator() == ReductionOperator::Sum) {
-        // We're doing a transpose multiply, unhandled right now
-        if (foundFirst) {
-          result = false;
-          return;
-        }
-        foundFirst = true;
-      }
-      // Check for second matrix
-      else if (op->indexVars[1].isFreeVar() &&
-               op->indexVars[1] == iexpr->resultVars[1] &&
-               op->indexVars[0].isReductionVar() &&
-               op->indexVars[0].getOperator() == ReductionOperator::Sum) {
-        // Transpose multiply is unhandled right now
-        if (foundSecond) {
-          result = false;
-          return;
-        }
-        foundSecond = true;
+      if (isa<VarExpr>(op->tensor) && isa<VarExpr>(target)) {
+        result |= to<VarExpr>(op->tensor)->var == to<VarExpr>(target)->var;
       }
-      // Tensor term is not of matrix multiply form
-      else {
-        result = false;
-        return;
+      else if (isa<FieldRead>(op->tensor) && isa<FieldRead>(target)) {
+        const FieldRead* read = to<FieldRead>(op->tensor);
+        const FieldRead* write = to<FieldRead>(target);
+        result |= read->fieldName == write->fieldName &&
+                  isa<VarExpr>(read->elementOrSet) &&
+                  isa<VarExpr>(write->elementOrSet) &&
+                  to<VarExpr>(read->elementOrSet)->var ==
+                  to<VarExpr>(write->elementOrSet)->var;
       }
     })
   );
-  result = result && foundFirst && foundSecond;
-
   return result;
 }
 
-Func lowerIndexExpressions(Func func) {
+Func lowerIndexExpressions(Func func, bool blockedSpmv) {
   class LowerIndexExpressionsRewriter : private IRRewriter {
   public:
+    LowerIndexExpressionsRewriter(bool blockedSpmv)
+        : blockedSpmv(blockedSpmv) {}
+
     Func lower(Func func) {
       storage = &func.getStorage();
       environment = func.getEnvironment();
@@ -189,9 +158,17 @@ Func lowerIndexExpressions(Func func) {
   private:
     Storage *storage;
     Environment environment;
-    
+    bool blockedSpmv;
+
     using IRRewriter::visit;
 
+    /// True if `target = iexpr` should be lowered to a specialized sparse
+    /// matrix-vector multiply kernel.
+    bool isBlockedSpmv(const Expr& target, const IndexExpr* iexpr) {
+      return blockedSpmv && isMatrixVectorMultiply(iexpr, *storage) &&
+             !readsTarget(iexpr, target);
+    }
+
     void visit(const Func* f) {
       Stmt body = rewrite(f->getBody());
       if (body != f->getBody()) {
@@ -219,14 +196,19 @@ Func lowerIndexExpressions(Func func) {
       // Dispatch the index expression lowering to the correct lowering pass.
       enum Kind {Unknown, DenseResult, MatrixScale,
                  MatrixElwiseWithSameStructureOrDiagonal, MatrixElwise,
-                 MatrixTranspose, MatrixMultiply};
+                 MatrixTranspose, MatrixMultiply, MatrixVectorMultiply};
       Kind kind = Unknown;
 
       simit_iassert(iexpr->type.isTensor());
       const Var& var = op->var;
       const TensorType* type = iexpr->type.toTensor();
 
-      if (type->order()==0 || type->order()==1 ||
+      if (type->order()==1 && storage->hasStorage(var) &&
+          storage->getStorage(var).getKind() == TensorStorage::Dense &&
+          isBlockedSpmv(VarExpr::make(var), iexpr)) {
+        kind = MatrixVectorMultiply;
+      }
+      else if (type->order()==0 || type->order()==1 ||
           storage->getStorage(var).getKind() == TensorStorage::Dense) {
         kind = DenseResult;
       }
@@ -264,6 +246,10 @@ Func lowerIndexExpressions(Func func) {
         case MatrixMultiply:
           stmt = lowerMatrixMultiply(op->var, iexpr, &environment, storage);
           break;
+        case MatrixVectorMultiply:
+          stmt = lowerMatrixVectorMultiply(VarExpr::make(op->var), op->cop,
+                                           iexpr, &environment, storage);
+          break;
         case Unknown:
           simit_unreachable << "unknown matrix expression";
           break;
@@ -277,7 +263,16 @@ Func lowerIndexExpressions(Func func) {
         IRRewriter::visit(op);
         return;
       }
-      stmt = lowerIndexStatement(op, &environment, *storage);
+      Expr field = FieldRead::make(op->elementOrSet, op->fieldName);
+      if (isa<IndexExpr>(op->value) && op->elementOrSet.type().isSet() &&
+          isBlockedSpmv(field, to<IndexExpr>(op->value))) {
+        stmt = lowerMatrixVectorMultiply(field, op->cop,
+                                         to<IndexExpr>(op->value),
+                                         &environment, storage);
+      }
+      else {
+        stmt = lowerIndexStatement(op, &environment, *storage);
+      }
 
       if (isa<IndexExpr>(op->value)) {
         stmt = Comment::make(util::toString(*op), stmt, false, true);
@@ -300,7 +295,7 @@ Func lowerIndexExpressions(Func func) {
       expr = rewrite(op->value);
     }
   };
-  func = LowerIndexExpressionsRewriter().lower(func);
+  func = LowerIndexExpressionsRewriter(blockedSpmv).lower(func);
   func = insertVarDecls(func);
 
   return func;
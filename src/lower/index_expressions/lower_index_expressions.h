@@ -6,7 +6,10 @@
 namespace simit {
 namespace ir {
 
-Func lowerIndexExpressions(Func func);
+/// Lowers the index expressions in `func`. If `blockedSpmv` is true, sparse
+/// matrix-vector products are lowered to kernels specialized for the block
+/// shape of the matrix (see lowerMatrixVectorMultiply).
+Func lowerIndexExpressions(Func func, bool blockedSpmv=false);
 
 }}
 #endif
@@ -241,6 +241,11 @@ Stmt reduce(Stmt loopNest, Stmt kernel, ReductionOperator reductionOperator) {
       switch (op.getKind()) {
         case ReductionOperator::Sum:
           return AssignStmt::make(var, value, CompoundOperator::Add);
+        case ReductionOperator::Product:
+        case ReductionOperator::Max:
+        case ReductionOperator::Min:
+          not_supported_yet << "index expressions only reduce by sums";
+          return Stmt();
         case ReductionOperator::Undefined:
           simit_ierror;
           return Stmt();
@@ -1,5 +1,6 @@
 #include "lower_matrix_multiply.h"
 
+#include <atomic>
 #include <vector>
 
 #include "loops.h"
@@ -12,6 +13,63 @@ using namespace std;
 namespace simit {
 namespace ir {
 
+bool isGemm(const IndexExpr* iexpr) {
+  // Very specific index expression form: (i,j B(i,+k)*C(+k,j))
+  // "First" matrix is defined as the one with its first index var
+  // as a free variable. The "second" matrix is defined as the reverse.
+  // The remaining variable should be summed.
+  if (iexpr->resultVars.size() != 2) {
+    return false;
+  }
+  bool result = true;
+  bool foundFirst = false;
+  bool foundSecond = false;
+  match(iexpr->value,
+    std::function<void(const IndexedTensor*)>([&](const IndexedTensor* op) {
+      if (result == false) {
+        return;
+      }
+      if (op->indexVars.size() != 2) {
+        result = false;
+        return;
+      }
+      // Check for first matrix
+      // TODO: We only allow non-transposed multiplication
+      if (op->indexVars[0].isFreeVar() &&
+          op->indexVars[0] == iexpr->resultVars[0] &&
+          op->indexVars[1].isReductionVar() &&
+          op->indexVars[1].getOperator() == ReductionOperator::Sum) {
+        // We're doing a transpose multiply, unhandled right now
+        if (foundFirst) {
+          result = false;
+          return;
+        }
+        foundFirst = true;
+      }
+      // Check for second matrix
+      else if (op->indexVars[1].isFreeVar() &&
+               op->indexVars[1] == iexpr->resultVars[1] &&
+               op->indexVars[0].isReductionVar() &&
+               op->indexVars[0].getOperator() == ReductionOperator::Sum) {
+        // Transpose multiply is unhandled right now
+        if (foundSecond) {
+          result = false;
+          return;
+        }
+        foundSecond = true;
+      }
+      // Tensor term is not of matrix multiply form
+      else {
+        result = false;
+        return;
+      }
+    })
+  );
+  result = result && foundFirst && foundSecond;
+
+  return result;
+}
+
 Stmt lowerMatrixMultiply(Var target, const IndexExpr* indexExpression,
                          Environment* env, Storage* storage) {
   auto tensorStorage = storage->getStorage(target);
@@ -19,8 +77,12 @@ Stmt lowerMatrixMultiply(Var target, const IndexExpr* indexExpression,
   simit_iassert(isa<Mul>(indexExpression->value))
       << "expr is not a multiplication";
 
+  // Matrices without path expressions are multiplied by the runtime, which
+  // caches the structure and values buffer of the result of each call site
   if (!tensorStorage.getTensorIndex().getPathExpression().defined()) {
-    Func spmm = Func("spmm", {Var(), Var()}, {Var()}, Stmt(), Func::External);
+    static atomic<int> numSites(0);
+    Func spmm = Func("spmm", {Var(), Var(), Var()}, {Var()}, Stmt(),
+                     Func::External);
 
     auto mulExpr = to<Mul>(indexExpression->value);
     simit_iassert(isa<IndexedTensor>(mulExpr->a))
@@ -33,7 +95,8 @@ Stmt lowerMatrixMultiply(Var target, const IndexExpr* indexExpression,
     simit_iassert(isa<VarExpr>(a)) << a << " is not a var";
     simit_iassert(isa<VarExpr>(b)) << b << " is not a var";
 
-    Stmt matmultCall = CallStmt::make({target}, spmm, {a, b});
+    Stmt matmultCall = CallStmt::make({target}, spmm,
+                                      {a, b, Literal::make(numSites++)});
     return matmultCall;
   }
 
@@ -6,6 +6,9 @@
 namespace simit {
 namespace ir {
 
+/// True if `iexpr` is a matrix-matrix multiply (i,j B(i,+k)*C(+k,j)).
+bool isGemm(const IndexExpr* iexpr);
+
 Stmt lowerMatrixMultiply(Var target, const IndexExpr* indexExpression,
                          Environment* env, Storage* storage);
 
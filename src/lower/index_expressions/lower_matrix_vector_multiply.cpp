@@ -0,0 +1,199 @@
+#include "lower_matrix_vector_multiply.h"
+
+#include <string>
+#include <vector>
+
+#include "ir_queries.h"
+#include "loops.h"
+#include "storage.h"
+#include "tensor_index.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// The operands of a matrix-vector multiply index expression, ordered as
+/// matrix and vector regardless of their order in the expression.
+static bool getOperands(const IndexExpr* indexExpression,
+                        const IndexedTensor** matrix,
+                        const IndexedTensor** vec) {
+  if (!isa<Mul>(indexExpression->value)) {
+    return false;
+  }
+  const Mul* mul = to<Mul>(indexExpression->value);
+  if (!isa<IndexedTensor>(mul->a) || !isa<IndexedTensor>(mul->b)) {
+    return false;
+  }
+  *matrix = to<IndexedTensor>(mul->a);
+  *vec = to<IndexedTensor>(mul->b);
+  if ((*matrix)->indexVars.size() == 1) {
+    std::swap(*matrix, *vec);
+  }
+  return (*matrix)->indexVars.size() == 2 && (*vec)->indexVars.size() == 1;
+}
+
+/// Returns the number of rows and columns of the blocks of a matrix, or 1x1 if
+/// it is not blocked. Returns false if the blocks are not matrices of scalars.
+static bool getBlockShape(const TensorType* type, int* rows, int* cols) {
+  Type block = type->getBlockType();
+  const TensorType* blockType = block.toTensor();
+  if (blockType->order() == 0) {
+    *rows = 1;
+    *cols = 1;
+    return true;
+  }
+  if (blockType->order() != 2 || !isScalar(blockType->getBlockType())) {
+    return false;
+  }
+  vector<IndexDomain> dims = blockType->getDimensions();
+  for (const IndexDomain& dim : dims) {
+    for (const IndexSet& indexSet : dim.getIndexSets()) {
+      if (indexSet.getKind() != IndexSet::Range) {
+        return false;
+      }
+    }
+  }
+  *rows = dims[0].getSize();
+  *cols = dims[1].getSize();
+  return true;
+}
+
+bool isMatrixVectorMultiply(const IndexExpr* indexExpression,
+                            const Storage& storage) {
+  if (indexExpression->resultVars.size() != 1) {
+    return false;
+  }
+  const IndexedTensor* matrix;
+  const IndexedTensor* vec;
+  if (!getOperands(indexExpression, &matrix, &vec)) {
+    return false;
+  }
+
+  // (i A(i,+j)*x(+j))
+  const IndexVar& i = matrix->indexVars[0];
+  const IndexVar& j = matrix->indexVars[1];
+  if (i != indexExpression->resultVars[0] || !j.isReductionVar() ||
+      j.getOperator().getKind() != ReductionOperator::Sum ||
+      vec->indexVars[0] != j) {
+    return false;
+  }
+
+  // The matrix must be stored with a path expression index
+  if (!isa<VarExpr>(matrix->tensor)) {
+    return false;
+  }
+  const Var& matrixVar = to<VarExpr>(matrix->tensor)->var;
+  if (!storage.hasStorage(matrixVar)) {
+    return false;
+  }
+  const TensorStorage& matrixStorage = storage.getStorage(matrixVar);
+  if (matrixStorage.getKind() != TensorStorage::Indexed ||
+      !matrixStorage.hasTensorIndex() ||
+      matrixStorage.getTensorIndex().getKind() != TensorIndex::PExpr) {
+    return false;
+  }
+
+  // The vector must be a dense variable or a set field
+  if (isa<VarExpr>(vec->tensor)) {
+    const Var& vectorVar = to<VarExpr>(vec->tensor)->var;
+    if (!storage.hasStorage(vectorVar) ||
+        storage.getStorage(vectorVar).getKind() != TensorStorage::Dense) {
+      return false;
+    }
+  }
+  else if (!isa<FieldRead>(vec->tensor) ||
+           !to<FieldRead>(vec->tensor)->elementOrSet.type().isSet()) {
+    return false;
+  }
+
+  Type matrixTensorType = matrix->tensor.type();
+  Type vectorTensorType = vec->tensor.type();
+  const TensorType* matrixType = matrixTensorType.toTensor();
+  const TensorType* vectorType = vectorTensorType.toTensor();
+  if (matrixType->order() != 2 || vectorType->order() != 1 ||
+      matrixType->getComponentType().kind != ScalarType::Float ||
+      matrixType->getOuterDimensions()[0].getKind() != IndexSet::Set) {
+    return false;
+  }
+  int rows, cols;
+  if (!getBlockShape(matrixType, &rows, &cols)) {
+    return false;
+  }
+  Type vectorBlock = vectorType->getBlockType();
+  const TensorType* vectorBlockType = vectorBlock.toTensor();
+  return (vectorBlockType->order() == 0) ? cols == 1
+         : vectorBlockType->order() == 1 && (int)vectorBlockType->size() == cols;
+}
+
+Stmt lowerMatrixVectorMultiply(Expr target, CompoundOperator cop,
+                               const IndexExpr* indexExpression,
+                               Environment* env, Storage* storage) {
+  simit_iassert(isMatrixVectorMultiply(indexExpression, *storage));
+  const IndexedTensor* matrix;
+  const IndexedTensor* vec;
+  getOperands(indexExpression, &matrix, &vec);
+
+  const Var& matrixVar = to<VarExpr>(matrix->tensor)->var;
+  const TensorType* matrixType = matrixVar.getType().toTensor();
+  int rows, cols;
+  getBlockShape(matrixType, &rows, &cols);
+  ScalarType componentType = matrixType->getComponentType();
+  Type scalarType = TensorType::make(componentType);
+  Expr zero = Literal::make(0.0);
+
+  const IndexVar& rowIndexVar = indexExpression->resultVars[0];
+  Var i(rowIndexVar.getName(), Int);
+  TensorIndexVar columns(matrix->indexVars[1].getName(), matrixVar.getName(),
+                         i, storage->getStorage(matrixVar).getTensorIndex());
+  const Var& ij = columns.getCoordVar();
+  const Var& j = columns.getSinkVar();
+
+  // The blocks of SoA fields are strided by the set size
+  Expr vecStride = getSoAStride(vec->tensor);
+  Expr targetStride = getSoAStride(target);
+
+  // One accumulator per row of a block
+  vector<Var> sums;
+  vector<Stmt> rowStmts;
+  for (int r = 0; r < rows; ++r) {
+    string name = (rows == 1) ? "sum" : "sum" + std::to_string(r);
+    sums.push_back(Var(name, scalarType));
+    rowStmts.push_back(VarDecl::make(sums.back()));
+    rowStmts.push_back(AssignStmt::make(sums.back(), zero));
+  }
+
+  // Multiply the block at ij by the block of the vector at j
+  vector<Stmt> blockStmts;
+  blockStmts.push_back(VarDecl::make(j));
+  blockStmts.push_back(columns.initSinkVar());
+  for (int r = 0; r < rows; ++r) {
+    Expr rowSum;
+    for (int c = 0; c < cols; ++c) {
+      Expr a = Load::make(matrix->tensor, (rows*cols == 1) ? Expr(ij)
+                                          : ij*(rows*cols) + (r*cols + c));
+      Expr x = Load::make(vec->tensor, (cols == 1) ? Expr(j)
+                                       : vecStride.defined() ? c*vecStride + j
+                                       : j*cols + c);
+      rowSum = rowSum.defined() ? Add::make(rowSum, Mul::make(a, x))
+                                : Mul::make(a, x);
+    }
+    blockStmts.push_back(AssignStmt::make(sums[r], rowSum,
+                                          CompoundOperator::Add));
+  }
+  rowStmts.push_back(ForRange::make(ij, columns.loadCoord(),
+                                    columns.loadCoord(1),
+                                    Block::make(blockStmts)));
+
+  for (int r = 0; r < rows; ++r) {
+    Expr index = (rows == 1) ? Expr(i)
+                 : targetStride.defined() ? r*targetStride + i
+                 : i*rows + r;
+    rowStmts.push_back(Store::make(target, index, sums[r], cop));
+  }
+
+  IndexSet rowSet = matrixType->getOuterDimensions()[0];
+  return For::make(i, ForDomain(rowSet), Block::make(rowStmts));
+}
+
+}}
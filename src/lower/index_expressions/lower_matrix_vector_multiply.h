@@ -0,0 +1,27 @@
+#ifndef SIMIT_LOWER_MATRIX_VECTOR_MULTIPLY_H
+#define SIMIT_LOWER_MATRIX_VECTOR_MULTIPLY_H
+
+#include "ir.h"
+
+namespace simit {
+namespace ir {
+
+/// True if `indexExpression` multiplies a sparse matrix with an index by a
+/// dense vector (`(i A(i,+j)*x(+j))` or `(i x(+j)*A(i,+j))`), where the matrix
+/// is not blocked or has one level of blocking.
+bool isMatrixVectorMultiply(const IndexExpr* indexExpression,
+                            const Storage& storage);
+
+/// Lowers `target cop= indexExpression`, where the index expression is a sparse
+/// matrix-vector multiply (see isMatrixVectorMultiply) and `target` is a dense
+/// vector variable or a set field. The block shape of the matrix is known at
+/// compile time, so each block is multiplied by straight-line code that sums a
+/// block row of the result in scalar temporaries before storing it once. This
+/// lets LLVM vectorize the block products, and the loop over the matrix rows
+/// is a set loop that the CPU backend can parallelize.
+Stmt lowerMatrixVectorMultiply(Expr target, CompoundOperator cop,
+                               const IndexExpr* indexExpression,
+                               Environment* env, Storage* storage);
+
+}}
+#endif
@@ -17,6 +17,9 @@
 #include "timers.h"
 #include "temps.h"
 #include "flatten.h"
+#include "fuse_loops.h"
+#include "matrix_free.h"
+#include "reuse_buffers.h"
 #include "insert_frees.h"
 #include "ir_rewriter.h"
 #include "ir_transforms.h"
@@ -31,6 +34,9 @@ using namespace std;
 
 namespace simit {
 extern std::string kBackend;
+extern bool kBlockedSpmv;
+extern bool kMatrixFree;
+extern int kNumThreads;
 
 namespace ir {
 
@@ -73,16 +79,6 @@ void visitCallGraph(Func func, const function<void(Func)>& visitRule) {
   func.accept(&visitor);
 }
 
-static inline
-void printTimedCallGraph(string headerText, Func func, ostream* os) {
-  stringstream ss;
-  simit::ir::IRPrinterCallGraph(ss).print(func);
-  TimerStorage::getInstance().addSourceLines(ss);
-  if (os) {
-    *os << ss.rdbuf();
-  }
-}
-
 static inline
 void printCallGraph(string headerText, Func func, ostream* os) {
   if (os) {
@@ -110,6 +106,13 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, insertTemporaries);
   printCallGraph("Insert Temporaries and Flatten Index Expressions", func, os);
 
+  // Compute the products of matrices that are only multiplied by vectors
+  // without assembling them
+  if (kMatrixFree) {
+    func = rewriteCallGraph(func, fuseMatrixVectorProducts);
+    printCallGraph("Fuse Matrix-Vector Products", func, os);
+  }
+
   // Determine Storage
   func = rewriteCallGraph(func, [](Func func) -> Func {
     updateStorage(func, &func.getStorage(), &func.getEnvironment());
@@ -142,8 +145,14 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, lowerStencilAssemblies);
   printCallGraph("Normalize Row Indices", func, os);
 
-  // Lower maps
-  func = rewriteCallGraph(func, lowerMaps);
+  // Lower maps. Multithreaded CPU code colors edge sets so that reductions
+  // over them can run in parallel without atomics, and CPU code assembles
+  // matrices using location tables built at function initialization.
+  bool colorEdgeSets = (kBackend == "cpu" && kNumThreads > 1);
+  bool locationTables = (kBackend == "cpu");
+  func = rewriteCallGraph(func, [=](Func func) -> Func {
+    return lowerMaps(func, colorEdgeSets, locationTables);
+  });
   printCallGraph("Lower Maps", func, os);
 
 #ifdef GPU
@@ -154,17 +163,31 @@ Func lower(Func func, std::ostream* os, bool time) {
   }
 #endif
 
-  // Lower Index Expressions
-  func = rewriteCallGraph(func, lowerIndexExpressions);
+  // Lower Index Expressions. CPU code multiplies sparse matrices by vectors
+  // with kernels specialized for the matrix block shape.
+  bool blockedSpmv = (kBackend == "cpu" && kBlockedSpmv);
+  func = rewriteCallGraph(func, [=](Func func) -> Func {
+    return lowerIndexExpressions(func, blockedSpmv);
+  });
   printCallGraph("Lower Index Expressions", func, os);
 
+  // Fuse Loops. Multithreaded CPU code keeps loops that assign variables
+  // declared outside them, which run serially, apart from loops that run in
+  // parallel.
+  if (kBackend == "cpu") {
+    bool parallel = (kNumThreads > 1);
+    func = rewriteCallGraph(func, [=](Func func) -> Func {
+      return fuseLoops(func, parallel);
+    });
+    printCallGraph("Fuse Loops", func, os);
+  }
+
   // Lower Tensor Reads and Writes
   func = rewriteCallGraph(func, lowerTensorAccesses);
   printCallGraph("Lower Tensor Reads and Writes", func, os);
 
   // Insert timers
   if (time) {
-    printTimedCallGraph("Insert Timers", func, os);
     func = rewriteCallGraph(func, insertTimers);
     printCallGraph("Insert Timers", func, os);
   }
@@ -177,6 +200,12 @@ Func lower(Func func, std::ostream* os, bool time) {
   func = rewriteCallGraph(func, lowerUnroll);
   printCallGraph("Loops Unrolling", func, os);
 
+  // Reuse Buffers
+  if (kBackend == "cpu") {
+    func = rewriteCallGraph(func, reuseBuffers);
+    printCallGraph("Reuse Buffers", func, os);
+  }
+
   // Lower to GPU Kernels
 #if GPU
   if (kBackend == "gpu") {
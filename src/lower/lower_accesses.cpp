@@ -5,6 +5,7 @@
 
 #include "ir_rewriter.h"
 #include "intrinsics.h"
+#include "ir_queries.h"
 #include "path_expressions.h"
 #include "tensor_index.h"
 #include "util/util.h"
@@ -46,6 +47,16 @@ static Expr createLengthComputation(const vector<IndexDomain> &dimensions) {
   return len;
 }
 
+/// Combines the index of an outer tensor read with the index into the block
+/// it read. The blocks of SoA fields are strided by the size of their set.
+static Expr createNestedIndex(const Load *load, Expr index) {
+  Expr stride = getSoAStride(load->buffer);
+  if (stride.defined()) {
+    index = Mul::make(index, stride);
+  }
+  return Add::make(load->index, index);
+}
+
 static Expr createLoadExpr(Expr tensor, Expr index) {
   simit_iassert(tensor.type().isTensor())
       << "attempting to load from a non-tensor:" << tensor;
@@ -56,7 +67,7 @@ static Expr createLoadExpr(Expr tensor, Expr index) {
     const Load *load = to<Load>(tensor);
     simit_iassert(load->buffer.type().isTensor());
 
-    index = Add::make(load->index, index);
+    index = createNestedIndex(load, index);
     return Load::make(load->buffer, index);
   }
   else {
@@ -75,7 +86,7 @@ static Stmt createStoreStmt(Expr tensor, Expr index, Expr value,
     const Load *load = to<Load>(tensor);
     simit_iassert(load->buffer.type().isTensor());
 
-    index = Add::make(load->index, index);
+    index = createNestedIndex(load, index);
     return Store::make(load->buffer, index, value, cop);
   }
   else {
@@ -231,7 +242,11 @@ private:
     }
     simit_iassert(index.defined());
 
-    // Multiply in inner block size
+    // Multiply in inner block size. The blocks of SoA fields are not stored
+    // together, but strided by the set size (see createNestedIndex).
+    if (getSoAStride(tensor).defined()) {
+      return index;
+    }
     Type blockType = tensor.type().toTensor()->getBlockType();
     Expr blockSize = Literal::make(1);
     if (blockType.toTensor()->getDimensions().size() > 0) {
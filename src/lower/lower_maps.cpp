@@ -34,23 +34,45 @@ inline bool hasSameStorage(std::vector<Var> vars, const Storage &storage) {
 
 class LowerMapFunctionRewriter : public MapFunctionRewriter {
 
-  /// Change assignments to result to compound  assignments, using the map
-  /// reduction operator.
-  Stmt makeCompoundTensorWrite(Expr tensor, vector<Expr> indices, Expr value) {
+  /// The compound operator that folds values into the map results, using the
+  /// map reduction operator.
+  CompoundOperator getCompoundOperator() {
     switch (reduction.getKind()) {
-      case ReductionOperator::Sum: {
-        return TensorWrite::make(tensor, indices, value, CompoundOperator::Add);
-      }
-      case ReductionOperator::Undefined: {
-        return TensorWrite::make(tensor, indices, value);
-      }
+      case ReductionOperator::Sum:
+        return CompoundOperator::Add;
+      case ReductionOperator::Product:
+        return CompoundOperator::Mul;
+      case ReductionOperator::Max:
+        return CompoundOperator::Max;
+      case ReductionOperator::Min:
+        return CompoundOperator::Min;
+      case ReductionOperator::Undefined:
+        return CompoundOperator::None;
     }
     simit_unreachable;
-    return Stmt();
+    return CompoundOperator::None;
+  }
+
+  /// Change assignments to result to compound  assignments, using the map
+  /// reduction operator.
+  Stmt makeCompoundTensorWrite(Expr tensor, vector<Expr> indices, Expr value) {
+    return TensorWrite::make(tensor, indices, value, getCompoundOperator());
   }
 
   using MapFunctionRewriter::visit;
 
+  void visit(const AssignStmt *op) {
+    // Assignments to scalar results are reduced into the map variable, so
+    // that maps can compute global sums, products, maxima and minima
+    if (isResult(op->var)) {
+      stmt = AssignStmt::make(getMapVar(op->var), rewrite(op->value),
+                              getCompoundOperator());
+    }
+    else {
+      MapFunctionRewriter::visit(op);
+    }
+  }
+
   void visit(const TensorWrite *op) {
     // Rewrites the tensor write and assigns the result to stmt
     IRRewriter::visit(op);
@@ -128,14 +150,45 @@ class LowerMapFunctionRewriter : public MapFunctionRewriter {
   }
 };
 
+/// Make the loop over the edges of `edgeSet` iterate over them color by color.
+static Stmt colorEdgeSetLoop(Stmt stmt, const Expr& edgeSet) {
+  class ColorEdgeSetLoop : public IRRewriter {
+  public:
+    ColorEdgeSetLoop(const Expr& edgeSet) : edgeSet(edgeSet) {}
+
+  private:
+    Expr edgeSet;
+
+    using IRRewriter::visit;
+
+    void visit(const For *op) {
+      if (op->domain.kind == ForDomain::IndexSet &&
+          op->domain.indexSet.getKind() == IndexSet::Set &&
+          op->domain.indexSet.getSet() == edgeSet) {
+        ForDomain domain(edgeSet, Var(), ForDomain::Colors,
+                         op->domain.indexSet);
+        stmt = For::make(op->var, domain, op->body);
+      }
+      else {
+        stmt = op;
+      }
+    }
+  };
+  return ColorEdgeSetLoop(edgeSet).rewrite(stmt);
+}
+
 class LowerMaps : public IRRewriter {
 public:
-  LowerMaps(Storage *storage, Environment *env)
-      : storage(storage), env(env) {}
+  LowerMaps(Storage *storage, Environment *env, bool colorEdgeSets,
+            bool locationTables)
+      : storage(storage), env(env), colorEdgeSets(colorEdgeSets),
+        locationTables(locationTables) {}
 
 private:
   Storage *storage;
   Environment *env;
+  bool colorEdgeSets;
+  bool locationTables;
   
   using IRRewriter::visit;
 
@@ -145,7 +198,19 @@ private:
         << util::join(op->vars) << ")";
 
     LowerMapFunctionRewriter mapFunctionRewriter;
-    stmt = inlineMap(op, mapFunctionRewriter, storage);
+    stmt = inlineMap(op, mapFunctionRewriter, storage,
+                     locationTables ? env : nullptr);
+
+    // Edges that share an endpoint reduce into the same locations, so reduction
+    // loops over edge sets visit the edges color by color.
+    if (colorEdgeSets &&
+        op->reduction.getKind() != ReductionOperator::Undefined &&
+        !op->through.defined() && isa<VarExpr>(op->target) &&
+        op->target.type().isUnstructuredSet() &&
+        op->target.type().toUnstructuredSet()->endpointSets.size() > 0) {
+      stmt = colorEdgeSetLoop(stmt, op->target);
+      env->addColoringIndex(to<VarExpr>(op->target)->var);
+    }
 
     // Add comment
     stmt = Comment::make(util::toString(*op), stmt, true);
@@ -173,8 +238,9 @@ private:
   }
 };
 
-Func lowerMaps(Func func) {
-  LowerMaps rewriter(&func.getStorage(),&func.getEnvironment());
+Func lowerMaps(Func func, bool colorEdgeSets, bool locationTables) {
+  LowerMaps rewriter(&func.getStorage(), &func.getEnvironment(), colorEdgeSets,
+                     locationTables);
   Stmt body = rewriter.rewrite(func.getBody());
   func = Func(func, body);
   func = insertVarDecls(func);
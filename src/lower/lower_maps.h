@@ -7,8 +7,13 @@ namespace simit {
 namespace ir {
 
 /// Lower map statements to loops. Map assemblies are lowered to loops that
-/// store the resulting tensors as specified by Func's Storage descriptor.
-Func lowerMaps(Func func);
+/// store the resulting tensors as specified by Func's Storage descriptor. If
+/// `colorEdgeSets` is true, reduction maps over edge sets are lowered to loops
+/// that visit the edges color by color, so that the edges of a color can
+/// scatter into their endpoints concurrently. If `locationTables` is true,
+/// matrix assemblies over edge sets read the locations they store to from
+/// tables that are built when the function is initialized.
+Func lowerMaps(Func func, bool colorEdgeSets=false, bool locationTables=false);
 
 }}
 #endif
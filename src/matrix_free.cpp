@@ -0,0 +1,658 @@
+#include "matrix_free.h"
+
+#include <functional>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "ir.h"
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// The variable of `tensor`, or of the tensor it reads a block of.
+static Var getTensorVar(Expr tensor) {
+  while (isa<TensorRead>(tensor)) {
+    tensor = to<TensorRead>(tensor)->tensor;
+  }
+  return isa<VarExpr>(tensor) ? to<VarExpr>(tensor)->var : Var();
+}
+
+/// True if the blocks of a matrix of type `matrix` can be multiplied by the
+/// blocks of a vector of type `vec` into the blocks of type `result`. The
+/// blocks must be scalars, or matrices and vectors of scalars.
+static bool hasMatchingBlocks(const TensorType* matrix, const TensorType* vec,
+                              const TensorType* result) {
+  if (matrix->getOuterDimensions().size() != 2 ||
+      vec->getOuterDimensions().size() != 1) {
+    return false;
+  }
+  Type aBlock = matrix->getBlockType();
+  Type xBlock = vec->getBlockType();
+  Type yBlock = result->getBlockType();
+  const TensorType* a = aBlock.toTensor();
+  const TensorType* x = xBlock.toTensor();
+  const TensorType* y = yBlock.toTensor();
+  if (!(a->getComponentType() == x->getComponentType())) {
+    return false;
+  }
+  if (a->order() == 0) {
+    return x->order() == 0 && y->order() == 0;
+  }
+  if (a->order() != 2 || x->order() != 1 || y->order() != 1 ||
+      !isScalar(a->getBlockType()) || !isScalar(x->getBlockType())) {
+    return false;
+  }
+  vector<IndexDomain> dims = a->getDimensions();
+  return x->getDimensions()[0] == dims[1] && y->getDimensions()[0] == dims[0];
+}
+
+/// If `value` is a product `(i A(i,+j)*x(+j))` or `(i x(+j)*A(i,+j))` of
+/// `matrix` and a vector whose blocks it can be computed from, returns the
+/// vector.
+static Expr getProductVector(Expr value, Var matrix) {
+  if (!isa<IndexExpr>(value)) {
+    return Expr();
+  }
+  const IndexExpr* indexExpr = to<IndexExpr>(value);
+  if (indexExpr->resultVars.size() != 1 || !isa<Mul>(indexExpr->value)) {
+    return Expr();
+  }
+  const Mul* mul = to<Mul>(indexExpr->value);
+  if (!isa<IndexedTensor>(mul->a) || !isa<IndexedTensor>(mul->b)) {
+    return Expr();
+  }
+  const IndexedTensor* a = to<IndexedTensor>(mul->a);
+  const IndexedTensor* x = to<IndexedTensor>(mul->b);
+  if (a->indexVars.size() == 1) {
+    swap(a, x);
+  }
+  if (a->indexVars.size() != 2 || x->indexVars.size() != 1 ||
+      !isa<VarExpr>(a->tensor) || to<VarExpr>(a->tensor)->var != matrix ||
+      getTensorVar(x->tensor) == matrix) {
+    return Expr();
+  }
+
+  const IndexVar& i = a->indexVars[0];
+  const IndexVar& j = a->indexVars[1];
+  if (i != indexExpr->resultVars[0] || !j.isReductionVar() ||
+      j.getOperator().getKind() != ReductionOperator::Sum ||
+      x->indexVars[0] != j) {
+    return Expr();
+  }
+  if (!hasMatchingBlocks(matrix.getType().toTensor(),
+                         x->tensor.type().toTensor(),
+                         value.type().toTensor())) {
+    return Expr();
+  }
+  return x->tensor;
+}
+
+/// Counts the products of `matrix` by vectors in a statement, and whether the
+/// statement uses `matrix` in any other way than being assigned by `map`.
+class MatrixUses : public IRVisitor {
+public:
+  MatrixUses(Var matrix, const Map* map) : matrix(matrix), map(map) {}
+
+  int products = 0;
+  bool otherUses = false;
+
+private:
+  Var matrix;
+  const Map* map;
+
+  using IRVisitor::visit;
+
+  void visit(const AssignStmt* op) {
+    Expr vec = getProductVector(op->value, matrix);
+    if (vec.defined() && op->cop == CompoundOperator::None) {
+      ++products;
+      vec.accept(this);
+      return;
+    }
+    otherUses |= (op->var == matrix);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const FieldWrite* op) {
+    Expr vec = getProductVector(op->value, matrix);
+    if (vec.defined() && op->cop == CompoundOperator::None) {
+      ++products;
+      op->elementOrSet.accept(this);
+      vec.accept(this);
+      return;
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const VarExpr* op) {
+    otherUses |= (op->var == matrix);
+  }
+
+  void visit(const CallStmt* op) {
+    for (const Var& result : op->results) {
+      otherUses |= (result == matrix);
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Map* op) {
+    if (op != map) {
+      for (const Var& var : op->vars) {
+        otherUses |= (var == matrix);
+      }
+    }
+    IRVisitor::visit(op);
+  }
+};
+
+/// How an assembly function computes its results.
+class AssemblyAnalysis : public IRVisitor {
+public:
+  AssemblyAnalysis(Func func)
+      : results(func.getResults().begin(), func.getResults().end()) {
+    func.getBody().accept(this);
+  }
+
+  /// Whether `matrix` is only assigned by writing whole blocks at two indices,
+  /// `matrix(i,j) = block`, and can therefore be multiplied block by block.
+  bool writesBlocks(const Var& matrix) const {
+    return blockWrites.find(matrix) != blockWrites.end() &&
+           otherWrites.find(matrix) == otherWrites.end();
+  }
+
+  /// Whether the function only assigns its results, so that assignments to
+  /// some of them can be removed without changing the others.
+  bool onlyAssignsResults() const {
+    return !readsResults && !writesFields;
+  }
+
+  /// The set fields the function reads.
+  const set<string>& getFieldsRead() const {
+    return fieldsRead;
+  }
+
+private:
+  set<Var> results;
+  set<Var> blockWrites;
+  set<Var> otherWrites;
+  bool readsResults = false;
+  bool writesFields = false;
+  set<string> fieldsRead;
+
+  using IRVisitor::visit;
+
+  void visit(const TensorWrite* op) {
+    Var var = getTensorVar(op->tensor);
+    if (results.find(var) == results.end()) {
+      IRVisitor::visit(op);
+      return;
+    }
+    if (isa<VarExpr>(op->tensor) && op->indices.size() == 2 &&
+        op->cop == CompoundOperator::None) {
+      blockWrites.insert(var);
+    }
+    else {
+      otherWrites.insert(var);
+    }
+
+    // Visit the indices of the write without counting the result as read
+    Expr tensor = op->tensor;
+    while (isa<TensorRead>(tensor)) {
+      for (const Expr& index : to<TensorRead>(tensor)->indices) {
+        index.accept(this);
+      }
+      tensor = to<TensorRead>(tensor)->tensor;
+    }
+    for (const Expr& index : op->indices) {
+      index.accept(this);
+    }
+    op->value.accept(this);
+  }
+
+  void visit(const AssignStmt* op) {
+    if (results.find(op->var) != results.end()) {
+      otherWrites.insert(op->var);
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const CallStmt* op) {
+    for (const Var& result : op->results) {
+      if (results.find(result) != results.end()) {
+        otherWrites.insert(result);
+      }
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const VarExpr* op) {
+    readsResults |= (results.find(op->var) != results.end());
+  }
+
+  void visit(const FieldRead* op) {
+    fieldsRead.insert(op->fieldName);
+    IRVisitor::visit(op);
+  }
+
+  void visit(const FieldWrite* op) {
+    writesFields = true;
+    IRVisitor::visit(op);
+  }
+};
+
+/// True if `stmt` may assign a variable in `vars` or a set field named in
+/// `fields`, including through the functions it maps.
+static bool assigns(Stmt stmt, const set<Var>& vars, const set<string>& fields){
+  class Assigns : public IRVisitor {
+  public:
+    Assigns(const set<Var>& vars, const set<string>& fields)
+        : vars(vars), fields(fields) {}
+
+    bool result = false;
+
+  private:
+    const set<Var>& vars;
+    const set<string>& fields;
+
+    using IRVisitor::visit;
+
+    void assign(const Var& var) {
+      result |= (vars.find(var) != vars.end());
+    }
+
+    void visit(const AssignStmt* op) {
+      assign(op->var);
+      IRVisitor::visit(op);
+    }
+
+    void visit(const FieldWrite* op) {
+      result |= (fields.find(op->fieldName) != fields.end());
+      IRVisitor::visit(op);
+    }
+
+    void visit(const TensorWrite* op) {
+      Expr tensor = op->tensor;
+      while (isa<TensorRead>(tensor)) {
+        tensor = to<TensorRead>(tensor)->tensor;
+      }
+      if (isa<FieldRead>(tensor)) {
+        result |= (fields.find(to<FieldRead>(tensor)->fieldName) !=
+                   fields.end());
+      }
+      else if (isa<VarExpr>(tensor)) {
+        assign(to<VarExpr>(tensor)->var);
+      }
+      IRVisitor::visit(op);
+    }
+
+    void visit(const CallStmt* op) {
+      for (const Var& result : op->results) {
+        assign(result);
+      }
+      IRVisitor::visit(op);
+    }
+
+    void visit(const Map* op) {
+      for (const Var& var : op->vars) {
+        assign(var);
+      }
+      // Applied functions may write the fields of the sets they are mapped to
+      op->function.getBody().accept(this);
+      IRVisitor::visit(op);
+    }
+  };
+  Assigns visitor(vars, fields);
+  stmt.accept(&visitor);
+  return visitor.result;
+}
+
+/// Rewrites an assembly function to not compute the results in `removed`, and,
+/// if `y` is defined, to multiply the blocks it assigns to `matrix` by the
+/// blocks of `x` and sum them into `y` instead.
+class RewriteAssembly : public IRRewriter {
+public:
+  RewriteAssembly(const set<Var>& removed, Var matrix=Var(), Var x=Var(),
+                  Var y=Var())
+      : removed(removed), matrix(matrix), x(x), y(y) {}
+
+private:
+  set<Var> removed;
+  Var matrix, x, y;
+
+  using IRRewriter::visit;
+
+  void visit(const TensorWrite* op) {
+    Var var = getTensorVar(op->tensor);
+    if (y.defined() && var == matrix) {
+      stmt = multiplyBlock(op->indices[0], op->indices[1], op->value);
+    }
+    else if (removed.find(var) != removed.end()) {
+      stmt = Pass::make();
+    }
+    else {
+      IRRewriter::visit(op);
+    }
+  }
+
+  void visit(const AssignStmt* op) {
+    if (removed.find(op->var) != removed.end()) {
+      stmt = Pass::make();
+    }
+    else {
+      IRRewriter::visit(op);
+    }
+  }
+
+  /// Multiply the block of `matrix` at (`row`,`col`) by the block of `x` at
+  /// `col`, and add it to the block of `y` at `row`. E.g.:
+  /// ~~~~~~~~~~~~~~~
+  ///   var K_block : tensor[3,3](float);
+  ///   K_block = (i,j ...);
+  ///   y(p(0)) = (k K_block(k,+l) * x(p(1))(+l));
+  /// ~~~~~~~~~~~~~~~
+  /// where the write to `y` sums into it since the map reduces with +.
+  Stmt multiplyBlock(Expr row, Expr col, Expr block) {
+    Expr xBlock = TensorRead::make(VarExpr::make(x), {col});
+    Type blockType = matrix.getType().toTensor()->getBlockType();
+    if (blockType.toTensor()->order() == 0) {
+      return TensorWrite::make(VarExpr::make(y), {row},
+                               Mul::make(block, xBlock));
+    }
+
+    vector<Stmt> stmts;
+    if (!isa<VarExpr>(block)) {
+      Var blockVar(matrix.getName() + "_block", blockType);
+      stmts.push_back(VarDecl::make(blockVar));
+      stmts.push_back(AssignStmt::make(blockVar, block));
+      block = VarExpr::make(blockVar);
+    }
+
+    vector<IndexDomain> dims = blockType.toTensor()->getDimensions();
+    IndexVar i("i", dims[0]);
+    IndexVar j("j", dims[1], ReductionOperator::Sum);
+    Expr product = Mul::make(IndexedTensor::make(block, {i, j}),
+                             IndexedTensor::make(xBlock, {j}));
+    Type yBlockType = y.getType().toTensor()->getBlockType();
+    bool isColumnVector = yBlockType.toTensor()->isColumnVector;
+    stmts.push_back(TensorWrite::make(VarExpr::make(y), {row},
+                                      IndexExpr::make({i}, product,
+                                                      isColumnVector)));
+    return Block::make(stmts);
+  }
+};
+
+/// A matrix that is computed in products instead of being assembled.
+struct MatrixFreeMatrix {
+  /// The map that assembles the matrix, and the function it maps.
+  const Map* map;
+  Func kernel;
+
+  /// The matrix, and the result of the kernel it is assembled from.
+  Var matrix;
+  Var kernelMatrix;
+};
+
+static void flattenBlocks(Stmt stmt, vector<Stmt>* stmts) {
+  if (isa<Scope>(stmt)) {
+    flattenBlocks(to<Scope>(stmt)->scopedStmt, stmts);
+  }
+  else if (isa<Block>(stmt)) {
+    flattenBlocks(to<Block>(stmt)->first, stmts);
+    if (to<Block>(stmt)->rest.defined()) {
+      flattenBlocks(to<Block>(stmt)->rest, stmts);
+    }
+  }
+  else {
+    stmts->push_back(stmt);
+  }
+}
+
+/// Finds the matrices of `func` that can be computed in their products.
+static vector<MatrixFreeMatrix> findMatrixFreeMatrices(Func func) {
+  set<Var> interface(func.getArguments().begin(), func.getArguments().end());
+  interface.insert(func.getResults().begin(), func.getResults().end());
+
+  // Maps in nested statements may run more than once, or not at all
+  vector<Stmt> stmts;
+  flattenBlocks(func.getBody(), &stmts);
+
+  vector<MatrixFreeMatrix> matrices;
+  for (size_t k = 0; k < stmts.size(); ++k) {
+    if (!isa<Map>(stmts[k])) {
+      continue;
+    }
+    const Map* map = to<Map>(stmts[k]);
+    const Func& kernel = map->function;
+    if (map->reduction.getKind() != ReductionOperator::Sum ||
+        map->through.defined() || kernel.getKind() != Func::Internal ||
+        map->vars.size() != kernel.getResults().size()) {
+      continue;
+    }
+    AssemblyAnalysis assembly(kernel);
+    if (!assembly.onlyAssignsResults()) {
+      continue;
+    }
+
+    // The blocks depend on the fields the kernel reads and on the partial
+    // actuals, which must not change until the last product
+    set<Var> inputVars;
+    set<string> inputFields = assembly.getFieldsRead();
+    for (const Expr& actual : map->partial_actuals) {
+      match(actual,
+        function<void(const VarExpr*)>([&](const VarExpr* op) {
+          inputVars.insert(op->var);
+        }),
+        function<void(const FieldRead*)>([&](const FieldRead* op) {
+          inputFields.insert(op->fieldName);
+        })
+      );
+    }
+
+    for (size_t r = 0; r < map->vars.size(); ++r) {
+      const Var& matrix = map->vars[r];
+      const Var& kernelMatrix = kernel.getResults()[r];
+      if (!matrix.getType().isTensor() ||
+          matrix.getType().toTensor()->getOuterDimensions().size() != 2 ||
+          interface.find(matrix) != interface.end() ||
+          !assembly.writesBlocks(kernelMatrix)) {
+        continue;
+      }
+
+      bool onlyProducts = true;
+      size_t last = k;
+      for (size_t t = 0; t < stmts.size() && onlyProducts; ++t) {
+        if (t == k) {
+          continue;
+        }
+        MatrixUses uses(matrix, map);
+        stmts[t].accept(&uses);
+        onlyProducts = !uses.otherUses && (uses.products == 0 || t > k);
+        if (uses.products > 0) {
+          last = t;
+        }
+      }
+      if (!onlyProducts || last == k) {
+        continue;
+      }
+
+      // The last product may assign inputs after it has read the matrix,
+      // unless it is in a loop
+      bool inputsChange = false;
+      for (size_t t = k+1; t <= last && !inputsChange; ++t) {
+        if (t == last && (isa<AssignStmt>(stmts[t]) ||
+                          isa<FieldWrite>(stmts[t]))) {
+          continue;
+        }
+        inputsChange = assigns(stmts[t], inputVars, inputFields);
+      }
+      if (inputsChange) {
+        continue;
+      }
+
+      matrices.push_back({map, kernel, matrix, kernelMatrix});
+    }
+  }
+  return matrices;
+}
+
+Func fuseMatrixVectorProducts(Func func) {
+  class FuseMatrixVectorProducts : public IRRewriter {
+  public:
+    FuseMatrixVectorProducts(const vector<MatrixFreeMatrix>& matrices)
+        : matrices(matrices) {}
+
+  private:
+    vector<MatrixFreeMatrix> matrices;
+
+    /// The product kernels built so far, shared by products of the same matrix
+    /// with vectors of the same type.
+    vector<pair<const MatrixFreeMatrix*, Func>> products;
+
+    using IRRewriter::visit;
+
+    void visit(const VarDecl* op) {
+      for (const MatrixFreeMatrix& matrix : matrices) {
+        if (op->var == matrix.matrix) {
+          stmt = Stmt();
+          return;
+        }
+      }
+      IRRewriter::visit(op);
+    }
+
+    /// Remove the matrices from the maps that assemble them.
+    void visit(const Map* op) {
+      set<Var> removed;
+      for (const MatrixFreeMatrix& matrix : matrices) {
+        if (matrix.map == op) {
+          removed.insert(matrix.kernelMatrix);
+        }
+      }
+      if (removed.size() == 0) {
+        IRRewriter::visit(op);
+        return;
+      }
+
+      const Func& kernel = op->function;
+      vector<Var> vars;
+      vector<Var> results;
+      for (size_t i = 0; i < op->vars.size(); ++i) {
+        if (removed.find(kernel.getResults()[i]) == removed.end()) {
+          vars.push_back(op->vars[i]);
+          results.push_back(kernel.getResults()[i]);
+        }
+      }
+      if (vars.size() == 0) {
+        stmt = Stmt();
+        return;
+      }
+      Stmt body = RewriteAssembly(removed).rewrite(kernel.getBody());
+      Func assembly(kernel.getName(), kernel.getArguments(), results, body,
+                    kernel.getEnvironment());
+      stmt = Map::make(vars, assembly, op->partial_actuals, op->target,
+                       op->neighbors, op->through, op->reduction);
+    }
+
+    void visit(const AssignStmt* op) {
+      if (op->cop == CompoundOperator::None) {
+        for (const MatrixFreeMatrix& matrix : matrices) {
+          Expr vec = getProductVector(op->value, matrix.matrix);
+          if (vec.defined()) {
+            bool readsResult = false;
+            match(vec, function<void(const VarExpr*)>([&](const VarExpr* v) {
+              readsResult |= (v->var == op->var);
+            }));
+            stmt = multiply(matrix, vec, op->value.type(),
+                            readsResult ? Var() : op->var,
+                            [&](Expr product) {
+                              return AssignStmt::make(op->var, product);
+                            });
+            return;
+          }
+        }
+      }
+      IRRewriter::visit(op);
+    }
+
+    void visit(const FieldWrite* op) {
+      if (op->cop == CompoundOperator::None) {
+        for (const MatrixFreeMatrix& matrix : matrices) {
+          Expr vec = getProductVector(op->value, matrix.matrix);
+          if (vec.defined()) {
+            stmt = multiply(matrix, vec, op->value.type(), Var(),
+                            [&](Expr product) {
+                              return FieldWrite::make(op->elementOrSet,
+                                                      op->fieldName, product);
+                            });
+            return;
+          }
+        }
+      }
+      IRRewriter::visit(op);
+    }
+
+    /// Maps a copy of the kernel of `matrix` that multiplies its blocks by
+    /// `vec` into `result`, or, if `result` is undefined, into a temporary
+    /// that `assign` stores.
+    Stmt multiply(const MatrixFreeMatrix& matrix, Expr vec, Type type,
+                  Var result, function<Stmt(Expr)> assign) {
+      Func product = getProductKernel(matrix, vec.type(), type);
+
+      const Map* map = matrix.map;
+      vector<Expr> actuals = {vec};
+      actuals.insert(actuals.end(), map->partial_actuals.begin(),
+                     map->partial_actuals.end());
+      if (result.defined()) {
+        return Map::make({result}, product, actuals, map->target,
+                         map->neighbors, map->through, map->reduction);
+      }
+      Var tmp("." + matrix.matrix.getName() + "x", type);
+      return Block::make({VarDecl::make(tmp),
+                          Map::make({tmp}, product, actuals, map->target,
+                                    map->neighbors, map->through,
+                                    map->reduction),
+                          assign(VarExpr::make(tmp))});
+    }
+
+    Func getProductKernel(const MatrixFreeMatrix& matrix, Type vecType,
+                          Type type) {
+      for (auto& product : products) {
+        if (product.first == &matrix &&
+            product.second.getArguments()[0].getType() == vecType &&
+            product.second.getResults()[0].getType() == type) {
+          return product.second;
+        }
+      }
+
+      const Func& kernel = matrix.kernel;
+      string name = matrix.kernelMatrix.getName();
+      Var x(name + "_x", vecType);
+      Var y(name + "_y", type);
+
+      set<Var> removed(kernel.getResults().begin(), kernel.getResults().end());
+      Stmt body = RewriteAssembly(removed, matrix.kernelMatrix, x, y)
+          .rewrite(kernel.getBody());
+      vector<Var> arguments = {x};
+      arguments.insert(arguments.end(), kernel.getArguments().begin(),
+                       kernel.getArguments().end());
+      Func product(kernel.getName() + "_mul", arguments, {y}, body,
+                   kernel.getEnvironment());
+      products.push_back({&matrix, product});
+      return product;
+    }
+  };
+
+  vector<MatrixFreeMatrix> matrices = findMatrixFreeMatrices(func);
+  if (matrices.size() == 0) {
+    return func;
+  }
+  Stmt body = FuseMatrixVectorProducts(matrices).rewrite(func.getBody());
+  return Func(func, body);
+}
+
+}}
@@ -0,0 +1,21 @@
+#ifndef SIMIT_MATRIX_FREE_H
+#define SIMIT_MATRIX_FREE_H
+
+#include "func.h"
+
+namespace simit {
+namespace ir {
+
+/// Compute the products of matrices that are only assembled to be multiplied
+/// by vectors without assembling them. A matrix `A = map f to E reduce +` whose
+/// every use is a product `y = A*x` is removed together with its map, and each
+/// product becomes a map over E of a copy of `f` that multiplies the blocks
+/// `f` computes by the blocks of `x` and sums them into `y`. This trades
+/// recomputing the blocks at every product for never storing the matrix or
+/// building its index. Matrices are only made matrix-free if their map runs
+/// once per call of `func` and nothing their blocks depend on is assigned
+/// between the map and their last product.
+Func fuseMatrixVectorProducts(Func func);
+
+}}
+#endif
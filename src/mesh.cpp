@@ -1,11 +1,20 @@
 #include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <map>
 #include "mesh.h"
+#include "mesh_parser.h"
+#include "graph.h"
+
+namespace simit {
+extern int kNumThreads;
+}
 
 using namespace simit;
+using namespace simit::internal;
 using namespace std;
 
 typedef array<double,3> Vector3d;
@@ -13,6 +22,12 @@ typedef array<int,3> Vector3i;
 typedef map<int,int> IntMap;
 int openIfstream(ifstream & in, const char * filename);
 int openOfstream(ofstream & out, const char * filename);
+int openMappedFile(MappedTextFile & file, const char * filename);
+
+//helper functions used by the parallel TetGen loaders
+const char * parseTetHeader(const MappedTextFile & file, int & num, int & size);
+int parseTetRecords(const char * begin, const char * end, int num,
+    const function<bool(size_t,const char*,const char*)> & parseRecord);
 
 //helper function used by saveHexObj
 int findFace(const IntMap & m, int ei, const MeshVol & vol);
@@ -47,16 +62,166 @@ int openOfstream(ofstream & out, const char * filename)
   return 0;
 }
 
+int openMappedFile(MappedTextFile & file, const char * filename)
+{
+  if(!file.open(filename)){
+    std::cerr << "Cannot read " << filename << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
+///parses the header of a TetGen file, the number of records followed by
+///their size. Returns the position after the header or nullptr.
+const char * parseTetHeader(const MappedTextFile & file, int & num, int & size)
+{
+  const char *line, *lineEnd;
+  const char * body = readDataLine(file.begin(), file.end(), &line, &lineEnd);
+  if(body == nullptr || !parseInt(line, lineEnd, &num) || num < 0){
+    return nullptr;
+  }
+  if(!parseInt(line, lineEnd, &size)){
+    size = 0;
+  }
+  return body;
+}
+
+///parses the records of a TetGen file in parallel. parseRecord gets the
+///record number and the line after the record's index.
+int parseTetRecords(const char * begin, const char * end, int num,
+    const function<bool(size_t,const char*,const char*)> & parseRecord)
+{
+  long numLines = parseDataLines(begin, end, kNumThreads,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        //lines past the declared number of records are ignored
+        if(ii >= (size_t)num){
+          return true;
+        }
+        int index;
+        return parseInt(line, lineEnd, &index) &&
+               parseRecord(ii, line, lineEnd);
+      });
+  if(numLines < num){
+    std::cerr << "Malformed or truncated mesh file" << std::endl;
+    return -1;
+  }
+  return 0;
+}
+
 int Mesh::load(const char * filename)
 {
-  ifstream in;
-  int status = openIfstream(in,filename);
+  MappedTextFile file;
+  int status = openMappedFile(file,filename);
   if(status<0){
     return status;
   }
-  status = load(in);
-  in.close();
-  return status;
+
+  //the #end line written by save ends the mesh
+  const char * end = file.end();
+  for(const char * pos = file.begin(); pos < end;){
+    const char * lineEnd = (const char*)memchr(pos, '\n', end-pos);
+    lineEnd = (lineEnd == nullptr) ? end : lineEnd;
+    size_t size = lineEnd - pos;
+    if(size >= 4 && memcmp(pos, "#end", 4) == 0 &&
+       (size == 4 || (size == 5 && pos[4] == '\r'))){
+      end = pos;
+      break;
+    }
+    pos = lineEnd + 1;
+  }
+
+  //count the vertices and triangles of each chunk, then parse them into place
+  auto lineKind = [](const char *& line, const char * lineEnd) {
+    if(!isDataLine(line, lineEnd) || lineEnd-line < 2 ||
+       (line[1] != ' ' && line[1] != '\t')){
+      return ' ';
+    }
+    return line[0];
+  };
+  TextChunks chunks(file.begin(), end, kNumThreads);
+  vector<size_t> firstVertex(chunks.size()+1, 0);
+  vector<size_t> firstTrig(chunks.size()+1, 0);
+  chunks.parallelFor([&](size_t chunk, const char * begin, const char * end) {
+    forEachLine(begin, end, [&](const char * line, const char * lineEnd) {
+      char kind = lineKind(line, lineEnd);
+      if(kind == 'v'){
+        firstVertex[chunk+1]++;
+      } else if(kind == 'f'){
+        //a polygon with n vertices is split into n-2 triangles
+        int numCorners = 0;
+        for(const char * pos = line+1; pos < lineEnd; pos++){
+          if(pos[-1] == ' ' || pos[-1] == '\t'){
+            numCorners += (*pos != ' ' && *pos != '\t' && *pos != '\r');
+          }
+        }
+        firstTrig[chunk+1] += max(numCorners-2, 0);
+      }
+    });
+  });
+  firstVertex[0] = v.size();
+  firstTrig[0] = t.size();
+  for(size_t ii = 0; ii < chunks.size(); ii++){
+    firstVertex[ii+1] += firstVertex[ii];
+    firstTrig[ii+1] += firstTrig[ii];
+  }
+  v.resize(firstVertex.back());
+  t.resize(firstTrig.back());
+
+  atomic<bool> failed(false);
+  atomic<bool> badFaces(false);
+  chunks.parallelFor([&](size_t chunk, const char * begin, const char * end) {
+    size_t vi = firstVertex[chunk];
+    size_t ti = firstTrig[chunk];
+    vector<int> vidx;
+    forEachLine(begin, end, [&](const char * line, const char * lineEnd) {
+      char kind = lineKind(line, lineEnd);
+      line++;
+      if(kind == 'v'){
+        for(int ii = 0; ii < 3; ii++){
+          if(!parseDouble(line, lineEnd, &v[vi][ii])){
+            failed = true;
+          }
+        }
+        vi++;
+      } else if(kind == 'f'){
+        vidx.clear();
+        int x;
+        while(parseInt(line, lineEnd, &x)){
+          vidx.push_back(x);
+          //skip texture and normal indices
+          while(line < lineEnd && *line != ' ' && *line != '\t'){
+            line++;
+          }
+        }
+        //faces whose corners are not all vertex indices parse into fewer
+        //triangles than were counted
+        if(ti + max((int)vidx.size()-2, 0) > firstTrig[chunk+1]){
+          badFaces = true;
+          return;
+        }
+        for(unsigned ii = 0; ii+2 < vidx.size(); ii++){
+          t[ti][0] = vidx[0]-1;
+          for (int jj = 1; jj < 3; jj++) {
+            t[ti][jj] = vidx[ii+jj]-1;
+          }
+          ti++;
+        }
+      }
+    });
+    if(ti != firstTrig[chunk+1]){
+      badFaces = true;
+    }
+  });
+  if(failed){
+    std::cerr << "Malformed obj file " << filename << std::endl;
+    return -1;
+  }
+  if(badFaces){
+    std::cerr << "Malformed or unsupported face in obj file " << filename
+              << std::endl;
+    return -1;
+  }
+  return 0;
 }
 
 int Mesh::load(std::string filename) {
@@ -230,19 +395,52 @@ int MeshVol::save(ostream & out)
 
 int MeshVol::loadTet(const char * nodeFile, const char * eleFile)
 {
-  ifstream nodeIn, eleIn;
-  int status = openIfstream(nodeIn, nodeFile);
+  MappedTextFile nodeIn, eleIn;
+  int status = openMappedFile(nodeIn, nodeFile);
   if(status<0){
     return status;
   }
-  status = openIfstream(eleIn, eleFile);
+  status = openMappedFile(eleIn, eleFile);
   if(status<0){
     return status;
   }
-  status = loadTet(nodeIn, eleIn);
-  nodeIn.close();
-  eleIn.close();
-  return status;
+
+  //load vertices
+  int num, dim;
+  const char * body = parseTetHeader(nodeIn, num, dim);
+  if(body == nullptr){
+    std::cerr << "Malformed node file " << nodeFile << std::endl;
+    return -1;
+  }
+  v.resize(num);
+  status = parseTetRecords(body, nodeIn.end(), num,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        return parseDouble(line, lineEnd, &v[ii][0]) &&
+               parseDouble(line, lineEnd, &v[ii][1]) &&
+               parseDouble(line, lineEnd, &v[ii][2]);
+      });
+  if(status<0){
+    return status;
+  }
+
+  //load elements
+  int nV;
+  body = parseTetHeader(eleIn, num, nV);
+  if(body == nullptr){
+    std::cerr << "Malformed ele file " << eleFile << std::endl;
+    return -1;
+  }
+  e.resize(num);
+  return parseTetRecords(body, eleIn.end(), num,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        e[ii].resize(nV);
+        for(int jj = 0; jj<nV; jj++){
+          if(!parseInt(line, lineEnd, &e[ii][jj])){
+            return false;
+          }
+        }
+        return true;
+      });
 }
 
 int MeshVol::loadTet(std::string nodeFile, std::string eleFile) {
@@ -322,14 +520,23 @@ int MeshVol::loadTet(istream & nodeIn, istream & eleIn)
 
 int MeshVol::loadTetEdge(const char * edgeFile)
 {
-  ifstream edgeIn;
-  int status = openIfstream(edgeIn, edgeFile);
+  MappedTextFile edgeIn;
+  int status = openMappedFile(edgeIn, edgeFile);
   if(status<0){
     return status;
   }
-  status = loadTetEdge(edgeIn);
-  edgeIn.close();
-  return status;
+  int num, markers;
+  const char * body = parseTetHeader(edgeIn, num, markers);
+  if(body == nullptr){
+    std::cerr << "Malformed edge file " << edgeFile << std::endl;
+    return -1;
+  }
+  edges.resize(num);
+  return parseTetRecords(body, edgeIn.end(), num,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        return parseInt(line, lineEnd, &edges[ii][0]) &&
+               parseInt(line, lineEnd, &edges[ii][1]);
+      });
 }
 
 int MeshVol::loadTetEdge(std::string edgeFile) {
@@ -373,6 +580,116 @@ int MeshVol::loadTetEdge(istream & edgeIn)
   return 0;
 }
 
+int simit::loadTetSets(const std::string & nodeFile,
+                       const std::string & eleFile,
+                       Set * vertices, Set * elements,
+                       const std::string & positionField)
+{
+  MappedTextFile nodeIn, eleIn;
+  int status = openMappedFile(nodeIn, nodeFile.c_str());
+  if(status<0){
+    return status;
+  }
+  status = openMappedFile(eleIn, eleFile.c_str());
+  if(status<0){
+    return status;
+  }
+
+  //load vertices straight into the position field
+  int numNodes, dim;
+  const char * body = parseTetHeader(nodeIn, numNodes, dim);
+  if(body == nullptr){
+    std::cerr << "Malformed node file " << nodeFile << std::endl;
+    return -1;
+  }
+  ComponentType positionType = ComponentType::Double;
+  const Set::FieldData * field = nullptr;
+  if(!positionField.empty()){
+    for(const Set::FieldData * f : vertices->getFields()){
+      if(f->name == positionField){
+        field = f;
+      }
+    }
+    simit_uassert(field != nullptr)
+        << "The vertex set has no field " << util::quote(positionField);
+    positionType = field->type->getComponentType();
+    simit_uassert(field->type->getSize() == 3 &&
+                  (positionType == ComponentType::Double ||
+                   positionType == ComponentType::Float))
+        << util::quote(positionField) << " must be a vector of 3 floats";
+  }
+  //the sets only grow once both files are parsed
+  int firstNode = vertices->getSize();
+  vertices->reserve(firstNode + numNodes);
+  void * positions = positionField.empty() ? nullptr
+                                           : vertices->getFieldData(positionField);
+  //strides are read after reserving, which moves the components of SoA fields
+  size_t elementStride = (field == nullptr) ? 3 : field->getElementStride();
+  size_t componentStride = (field == nullptr) ? 1 : field->getComponentStride();
+  status = parseTetRecords(body, nodeIn.end(), numNodes,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        double x[3];
+        if(!parseDouble(line, lineEnd, &x[0]) ||
+           !parseDouble(line, lineEnd, &x[1]) ||
+           !parseDouble(line, lineEnd, &x[2])){
+          return false;
+        }
+        size_t offset = (firstNode + ii)*elementStride;
+        for(int jj = 0; jj < 3 && positions != nullptr; jj++){
+          if(positionType == ComponentType::Double){
+            ((double*)positions)[offset+jj*componentStride] = x[jj];
+          } else{
+            ((float*)positions)[offset+jj*componentStride] = x[jj];
+          }
+        }
+        return true;
+      });
+  if(status<0){
+    return status;
+  }
+
+  //load elements into one endpoint array
+  int numElements, nV;
+  body = parseTetHeader(eleIn, numElements, nV);
+  if(body == nullptr){
+    std::cerr << "Malformed ele file " << eleFile << std::endl;
+    return -1;
+  }
+  simit_uassert(elements->getCardinality() == nV)
+      << "The element set must have " << nV << " endpoints";
+  for(int ii = 0; ii < nV; ii++){
+    simit_uassert(elements->getEndpointSet(ii) == vertices)
+        << "The endpoints of the element set must be the vertex set";
+  }
+  vector<int> endpoints((size_t)numElements * nV);
+  atomic<bool> outOfRange(false);
+  status = parseTetRecords(body, eleIn.end(), numElements,
+      [&](size_t ii, const char * line, const char * lineEnd) {
+        for(int jj = 0; jj < nV; jj++){
+          int vi;
+          if(!parseInt(line, lineEnd, &vi)){
+            return false;
+          }
+          if(vi < 0 || vi >= numNodes){
+            outOfRange = true;
+            return false;
+          }
+          endpoints[ii*nV + jj] = firstNode + vi;
+        }
+        return true;
+      });
+  if(outOfRange){
+    std::cerr << "Node index out of range in " << eleFile
+              << ", node indices must start at 0" << std::endl;
+  }
+  if(status<0){
+    return status;
+  }
+  vertices->addN(numNodes);
+  elements->addN(numElements, endpoints.data());
+  return 0;
+}
+
 void MeshVol::elementNeighbors(vector<vector<int> > & eleNeighbor)
 {
   eleNeighbor.resize(v.size());
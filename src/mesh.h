@@ -6,6 +6,7 @@
 #include <array>
 #include <string>
 namespace simit{
+class Set;
 
 ///a triagular mesh data structure for loading
 ///plain text obj files. Does not work with quad mesh.
@@ -54,6 +55,8 @@ struct MeshVol{
   ///return -1 if failed to load or format is unrecognized
   int load(std::istream & in);
 
+  ///Loads a TetGen mesh. Loading from files parses them in parallel with
+  ///the number of threads in the Simit settings.
   ///return -1 if failed to load
   int loadTet(const char * nodeFile, const char * eleFile);
   ///return -1 if failed to load
@@ -93,6 +96,19 @@ struct MeshVol{
   void makeTetSurf();
 };
 
+///Loads a TetGen mesh (.node and .ele files) straight into sets, without the
+///per-element vectors of MeshVol. Adds a vertex to `vertices` per node and an
+///element to `elements` per tet, whose endpoints must be the vertex set. If
+///`positionField` is not empty, the node coordinates are stored in that
+///field of the vertices, which must hold 3-vectors of floats or doubles. The
+///element file must index the nodes from 0 (as written by tetgen -z), so
+///files that index them from 1 fail to load. The files are parsed in
+///parallel with the number of threads in the settings.
+///return -1 if failed to load
+int loadTetSets(const std::string & nodeFile, const std::string & eleFile,
+                Set * vertices, Set * elements,
+                const std::string & positionField="");
+
 }
 
 #endif
@@ -0,0 +1,191 @@
+#include "mesh_parser.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "util/thread_pool.h"
+
+using namespace std;
+
+namespace simit {
+namespace internal {
+
+/// Chunks smaller than this are not worth a parallel task.
+static const size_t kMinChunkSize = 1 << 16;
+
+// class MappedTextFile
+MappedTextFile::~MappedTextFile() {
+  if (data != nullptr) {
+    munmap(data, size);
+  }
+}
+
+bool MappedTextFile::open(const char* fileName) {
+  int fd = ::open(fileName, O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0) {
+    close(fd);
+    return false;
+  }
+  size = fileStat.st_size;
+  if (size == 0) {
+    close(fd);
+    return true;
+  }
+  void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    size = 0;
+    return false;
+  }
+  // The file is read front to back
+  madvise(mapping, size, MADV_SEQUENTIAL);
+  data = (char*)mapping;
+  return true;
+}
+
+
+// class TextChunks
+TextChunks::TextChunks(const char* begin, const char* end, unsigned numThreads)
+    : numThreads(numThreads) {
+  size_t size = end - begin;
+  size_t numChunks = max((size_t)1, min((size_t)numThreads*8,
+                                        size/kMinChunkSize));
+  const char* chunkBegin = begin;
+  for (size_t i = 1; i <= numChunks && chunkBegin < end; ++i) {
+    // Each chunk ends after the first newline past its share of the text
+    const char* chunkEnd = (i == numChunks) ? end : begin + size/numChunks*i;
+    if (chunkEnd < chunkBegin) {
+      chunkEnd = chunkBegin;
+    }
+    const char* newline = (const char*)memchr(chunkEnd, '\n', end - chunkEnd);
+    chunkEnd = (newline == nullptr) ? end : newline + 1;
+    chunks.push_back({chunkBegin, chunkEnd});
+    chunkBegin = chunkEnd;
+  }
+}
+
+void TextChunks::parallelFor(
+    const function<void(size_t,const char*,const char*)>& body) const {
+  util::ThreadPool::getInstance().parallelFor(chunks.size(), numThreads,
+      [&](int start, int end) {
+        for (int i = start; i < end; ++i) {
+          body(i, chunks[i].first, chunks[i].second);
+        }
+      });
+}
+
+
+// Number parsing
+static void skipSpaces(const char*& pos, const char* end) {
+  while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+    ++pos;
+  }
+}
+
+bool parseInt(const char*& pos, const char* end, int* value) {
+  skipSpaces(pos, end);
+  bool negative = false;
+  if (pos < end && (*pos == '-' || *pos == '+')) {
+    negative = (*pos == '-');
+    ++pos;
+  }
+  if (pos == end || *pos < '0' || *pos > '9') {
+    return false;
+  }
+  long result = 0;
+  while (pos < end && *pos >= '0' && *pos <= '9') {
+    result = result*10 + (*pos - '0');
+    ++pos;
+  }
+  *value = negative ? -result : result;
+  return true;
+}
+
+bool parseDouble(const char*& pos, const char* end, double* value) {
+  skipSpaces(pos, end);
+  // strtod needs a terminated string and the mapped file may end mid-number,
+  // so the number is copied first
+  char buffer[64];
+  size_t length = 0;
+  while (pos + length < end && length < sizeof(buffer)-1) {
+    char c = pos[length];
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      break;
+    }
+    buffer[length++] = c;
+  }
+  buffer[length] = '\0';
+  char* numberEnd;
+  *value = strtod(buffer, &numberEnd);
+  if (numberEnd == buffer) {
+    return false;
+  }
+  pos += numberEnd - buffer;
+  return true;
+}
+
+const char* readDataLine(const char* begin, const char* end,
+                         const char** lineBegin, const char** lineEnd) {
+  const char* pos = begin;
+  while (pos < end) {
+    const char* newline = (const char*)memchr(pos, '\n', end - pos);
+    const char* next = (newline == nullptr) ? end : newline + 1;
+    const char* line = pos;
+    const char* eol = (newline == nullptr) ? end : newline;
+    if (isDataLine(line, eol)) {
+      *lineBegin = line;
+      *lineEnd = eol;
+      return next;
+    }
+    pos = next;
+  }
+  return nullptr;
+}
+
+long parseDataLines(const char* begin, const char* end, unsigned numThreads,
+                    const function<bool(size_t,const char*,const char*)>&
+                    parseLine) {
+  TextChunks chunks(begin, end, numThreads);
+
+  // Number the data lines of each chunk...
+  vector<size_t> firstLine(chunks.size() + 1, 0);
+  chunks.parallelFor([&](size_t chunk, const char* begin, const char* end) {
+    size_t numLines = 0;
+    forEachLine(begin, end, [&](const char* line, const char* lineEnd) {
+      if (isDataLine(line, lineEnd)) {
+        ++numLines;
+      }
+    });
+    firstLine[chunk+1] = numLines;
+  });
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    firstLine[i+1] += firstLine[i];
+  }
+
+  // ...then parse them
+  atomic<bool> failed(false);
+  chunks.parallelFor([&](size_t chunk, const char* begin, const char* end) {
+    size_t index = firstLine[chunk];
+    forEachLine(begin, end, [&](const char* line, const char* lineEnd) {
+      if (!failed && isDataLine(line, lineEnd)) {
+        if (!parseLine(index, line, lineEnd)) {
+          failed = true;
+        }
+        ++index;
+      }
+    });
+  });
+  return failed ? -1 : (long)firstLine.back();
+}
+
+}}
@@ -0,0 +1,95 @@
+#ifndef SIMIT_MESH_PARSER_H
+#define SIMIT_MESH_PARSER_H
+
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+namespace simit {
+namespace internal {
+
+/// A text file that is mapped into memory, so that it can be parsed in place.
+class MappedTextFile {
+public:
+  MappedTextFile() : data(nullptr), size(0) {}
+  ~MappedTextFile();
+
+  ///return false if the file cannot be read
+  bool open(const char* fileName);
+
+  const char* begin() const {return data;}
+  const char* end() const {return data + size;}
+
+private:
+  char* data;
+  size_t size;
+
+  /// disable copy
+  MappedTextFile(const MappedTextFile&);
+  MappedTextFile& operator=(const MappedTextFile&);
+};
+
+/// Splits text into chunks of whole lines, to parse them in parallel.
+class TextChunks {
+public:
+  TextChunks(const char* begin, const char* end, unsigned numThreads);
+
+  size_t size() const {return chunks.size();}
+
+  /// Calls `body(chunk, begin, end)` for every chunk, on `numThreads` threads.
+  void parallelFor(const std::function<void(size_t,const char*,const char*)>&
+                   body) const;
+
+private:
+  std::vector<std::pair<const char*,const char*>> chunks;
+  unsigned numThreads;
+};
+
+/// True if the line at `pos` holds data, that is, if it is neither blank nor
+/// a comment. Moves `pos` past leading whitespace.
+inline bool isDataLine(const char*& pos, const char* lineEnd) {
+  while (pos < lineEnd && (*pos == ' ' || *pos == '\t' || *pos == '\r')) {
+    ++pos;
+  }
+  return pos < lineEnd && *pos != '#';
+}
+
+/// Calls `body(lineBegin, lineEnd)` for every line in [begin, end), where the
+/// line end excludes the newline.
+template <typename Body>
+void forEachLine(const char* begin, const char* end, Body body) {
+  const char* pos = begin;
+  while (pos < end) {
+    const char* lineEnd = pos;
+    while (lineEnd < end && *lineEnd != '\n') {
+      ++lineEnd;
+    }
+    body(pos, lineEnd);
+    pos = lineEnd + 1;
+  }
+}
+
+/// Parses the integer at `pos`, after skipping spaces and tabs, and moves
+/// `pos` past it. Returns false if there is no integer before `end`.
+bool parseInt(const char*& pos, const char* end, int* value);
+
+/// Parses the floating point number at `pos`, after skipping spaces and tabs,
+/// and moves `pos` past it. Returns false if there is no number before `end`.
+bool parseDouble(const char*& pos, const char* end, double* value);
+
+/// Returns the position after the first data line in [begin, end), and points
+/// `lineBegin` and `lineEnd` at the line, or returns nullptr if there is none.
+/// Used to read the header of a file before parsing the rest in parallel.
+const char* readDataLine(const char* begin, const char* end,
+                         const char** lineBegin, const char** lineEnd);
+
+/// Calls `parseLine(index, lineBegin, lineEnd)` on `numThreads` threads for
+/// every data line in [begin, end), where `index` numbers the data lines from
+/// zero. Returns the number of data lines, or -1 if any call returned false.
+long parseDataLines(const char* begin, const char* end, unsigned numThreads,
+                    const std::function<bool(size_t,const char*,const char*)>&
+                    parseLine);
+
+}}
+#endif
@@ -0,0 +1,317 @@
+#include "parallel_loops.h"
+
+#include "ir_visitor.h"
+#include "intrinsics.h"
+#include "util/collections.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// Intrinsics that allocate, time or otherwise have effects that iterations
+/// can observe, and therefore serialize the loops that call them.
+static bool hasSideEffects(const Func& callee) {
+  static const vector<Func> sideEffectIntrinsics = {
+    intrinsics::solve(), intrinsics::lu(), intrinsics::lufree(),
+    intrinsics::lusolve(), intrinsics::lumatsolve(), intrinsics::chol(),
+    intrinsics::cholfree(), intrinsics::lltsolve(), intrinsics::lltmatsolve(),
+    intrinsics::strcpy(), intrinsics::strcat(), intrinsics::clock(),
+    intrinsics::storeTime(), intrinsics::profileBegin(),
+    intrinsics::profileEnd(), intrinsics::malloc(), intrinsics::free()
+  };
+  return callee.getKind() != Func::Intrinsic ||
+         util::contains(sideEffectIntrinsics, callee);
+}
+
+class ParallelLoopChecker : public IRVisitor {
+public:
+  ParallelLoopChecker(ParallelLoop* loop, const Storage& storage)
+      : loop(loop), storage(storage), parallel(true) {}
+
+  bool check(Stmt body) {
+    class CollectLocals : public IRVisitor {
+    public:
+      CollectLocals(ParallelLoop* loop) : loop(loop) {}
+    private:
+      ParallelLoop* loop;
+      using IRVisitor::visit;
+      void visit(const VarDecl* op) {
+        loop->privates.insert(op->var);
+      }
+      void visit(const ForRange* op) {
+        loop->innerLoopVars.insert(op->var);
+        IRVisitor::visit(op);
+      }
+      void visit(const For* op) {
+        loop->innerLoopVars.insert(op->var);
+        IRVisitor::visit(op);
+      }
+    };
+    CollectLocals collectLocals(loop);
+    body.accept(&collectLocals);
+
+    body.accept(this);
+
+    // Iterations only see their own partial result of a reduction
+    for (auto& reduction : loop->reductions) {
+      if (util::contains(readVars, reduction.first)) {
+        parallel = false;
+      }
+    }
+    return parallel;
+  }
+
+private:
+  ParallelLoop* loop;
+  const Storage& storage;
+  bool parallel;
+  std::set<Var> readVars;
+
+  /// True if `op` folds a value into a scalar that can be reduced in parallel
+  /// with the same operator as the other updates of the scalar in the loop.
+  bool addReduction(const AssignStmt* op) {
+    CompoundOperator cop = op->cop;
+    switch (cop) {
+      case CompoundOperator::None:
+        return false;
+      case CompoundOperator::Sub:
+        cop = CompoundOperator::Add;
+        break;
+      case CompoundOperator::Add:
+      case CompoundOperator::Mul:
+      case CompoundOperator::Min:
+      case CompoundOperator::Max:
+        break;
+    }
+
+    Type type = op->var.getType();
+    if (!type.isTensor() || !isScalar(type)) {
+      return false;
+    }
+    ScalarType componentType = type.toTensor()->getComponentType();
+    if (componentType.kind != ScalarType::Float &&
+        componentType.kind != ScalarType::Int) {
+      return false;
+    }
+
+    auto reduction = loop->reductions.find(op->var);
+    if (reduction != loop->reductions.end()) {
+      return reduction->second == cop;
+    }
+    loop->reductions.insert({op->var, cop});
+    return true;
+  }
+
+  /// True if `expr` refers to the loop variable or to a variable computed in
+  /// the loop body.
+  bool dependsOnIteration(const Expr& expr) {
+    bool depends = false;
+    match(expr,
+      function<void(const VarExpr*)>([&](const VarExpr* op) {
+        if (op->var == loop->var || util::contains(loop->privates, op->var)) {
+          depends = true;
+        }
+      })
+    );
+    return depends;
+  }
+
+  using IRVisitor::visit;
+
+  void visit(const VarDecl* op) {
+    // Private variables are allocated on the stack of each worker, so they
+    // must either be scalars or dense tensors with static dimensions.
+    Type type = op->var.getType();
+    if (!type.isTensor()) {
+      parallel = false;
+      return;
+    }
+    if (isScalar(type)) {
+      return;
+    }
+    for (const IndexDomain& dim : type.toTensor()->getDimensions()) {
+      for (const IndexSet& indexSet : dim.getIndexSets()) {
+        if (indexSet.getKind() != IndexSet::Range) {
+          parallel = false;
+        }
+      }
+    }
+    if (!storage.hasStorage(op->var) ||
+        storage.getStorage(op->var).getKind() != TensorStorage::Dense) {
+      parallel = false;
+    }
+  }
+
+  void visit(const VarExpr* op) {
+    readVars.insert(op->var);
+  }
+
+  void visit(const AssignStmt* op) {
+    if (!util::contains(loop->privates, op->var) && !addReduction(op)) {
+      parallel = false;
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const CallStmt* op) {
+    if (hasSideEffects(op->callee)) {
+      parallel = false;
+    }
+    for (const Var& result : op->results) {
+      if (!util::contains(loop->privates, result)) {
+        parallel = false;
+      }
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const Store* op) {
+    // Set fields are shared, so iterations may only store to locations they own
+    if (isa<FieldRead>(op->buffer) &&
+        isa<VarExpr>(to<FieldRead>(op->buffer)->elementOrSet)) {
+      if (!isOwnedLocation(op->index, *loop)) {
+        parallel = false;
+      }
+      IRVisitor::visit(op);
+      return;
+    }
+    if (!isa<VarExpr>(op->buffer)) {
+      parallel = false;
+      return;
+    }
+    const Var& buffer = to<VarExpr>(op->buffer)->var;
+    if (!util::contains(loop->privates, buffer) &&
+        !isOwnedLocation(op->index, *loop)) {
+      if (op->cop == CompoundOperator::None) {
+        parallel = false;
+      }
+      else if (loop->colored) {
+        // Elements of a color only conflict on locations that do not depend
+        // on the element, such as the single location of a scalar.
+        if (!dependsOnIteration(op->index)) {
+          parallel = false;
+        }
+      }
+      else {
+        ScalarType componentType = buffer.getType().toTensor()->
+            getComponentType();
+        if ((op->cop != CompoundOperator::Add &&
+             op->cop != CompoundOperator::Sub) ||
+            (componentType.kind != ScalarType::Float &&
+             componentType.kind != ScalarType::Int)) {
+          parallel = false;
+        }
+      }
+    }
+    IRVisitor::visit(op);
+  }
+
+  void visit(const FieldWrite* op) {
+    parallel = false;
+  }
+
+  void visit(const Print* op) {
+    parallel = false;
+  }
+
+  void visit(const Kernel* op) {
+    parallel = false;
+  }
+
+  void visit(const TensorWrite* op) {
+    parallel = false;
+  }
+
+  void visit(const Map* op) {
+    parallel = false;
+  }
+};
+
+std::map<Var,ParallelLoop> findParallelLoops(Stmt stmt,
+                                             const Storage& storage) {
+  class FindParallelLoops : public IRVisitor {
+  public:
+    FindParallelLoops(const Storage& storage) : storage(storage) {}
+    std::map<Var,ParallelLoop> loops;
+
+  private:
+    const Storage& storage;
+
+    using IRVisitor::visit;
+
+    void visit(const For* op) {
+      bool setLoop = op->domain.kind == ForDomain::IndexSet &&
+                     op->domain.indexSet.getKind() == IndexSet::Set;
+      bool colorLoop = op->domain.kind == ForDomain::Colors;
+      if (setLoop || colorLoop) {
+        ParallelLoop loop;
+        loop.var = op->var;
+        loop.colored = colorLoop;
+        if (ParallelLoopChecker(&loop, storage).check(op->body)) {
+          loops.insert({op->var, loop});
+          return;
+        }
+      }
+      IRVisitor::visit(op);
+    }
+  };
+  FindParallelLoops finder(storage);
+  stmt.accept(&finder);
+  return finder.loops;
+}
+
+bool isOwnedLocation(const Expr& index, const ParallelLoop& loop) {
+  class OwnedLocationChecker : public IRVisitor {
+  public:
+    OwnedLocationChecker(const ParallelLoop& loop)
+        : loop(loop), owned(true), usesLoopVar(false) {}
+
+    bool check(const Expr& index) {
+      index.accept(this);
+      return owned && usesLoopVar;
+    }
+
+  private:
+    const ParallelLoop& loop;
+    bool owned;
+    bool usesLoopVar;
+
+    using IRVisitor::visit;
+
+    void visit(const VarExpr* op) {
+      if (op->var == loop.var) {
+        usesLoopVar = true;
+      }
+      else if (!util::contains(loop.innerLoopVars, op->var)) {
+        owned = false;
+      }
+    }
+
+    void visit(const Load* op) {
+      owned = false;
+    }
+
+    void visit(const FieldRead* op) {
+      owned = false;
+    }
+
+    void visit(const IndexRead* op) {
+      owned = false;
+    }
+
+    // Set sizes are loop invariant, and stride the components of SoA fields
+    void visit(const Length* op) {
+    }
+  };
+  return OwnedLocationChecker(loop).check(index);
+}
+
+bool needsAtomicUpdate(const Store* store, const ParallelLoop& loop) {
+  return !loop.colored && store->cop != CompoundOperator::None &&
+         isa<VarExpr>(store->buffer) &&
+         !util::contains(loop.privates, to<VarExpr>(store->buffer)->var) &&
+         !isOwnedLocation(store->index, loop);
+}
+
+}}
@@ -0,0 +1,57 @@
+#ifndef SIMIT_PARALLEL_LOOPS_H
+#define SIMIT_PARALLEL_LOOPS_H
+
+#include <map>
+#include <set>
+
+#include "ir.h"
+#include "storage.h"
+
+namespace simit {
+namespace ir {
+
+/// A set loop whose iterations can execute concurrently.
+struct ParallelLoop {
+  /// The loop variable.
+  Var var;
+
+  /// Variables declared in the loop body. Every iteration needs its own copy.
+  std::set<Var> privates;
+
+  /// Loop variables of the loops nested in the body.
+  std::set<Var> innerLoopVars;
+
+  /// Scalar variables declared outside the loop that iterations only update
+  /// with compound assignments, and the operator that combines their updates.
+  /// Each worker reduces into a partial result of its own, which it combines
+  /// into the variable when it is done.
+  std::map<Var,CompoundOperator> reductions;
+
+  /// True if the loop visits the edges of a set one color at a time. The
+  /// iterations of a color update disjoint locations, so they run in parallel
+  /// without atomic updates.
+  bool colored = false;
+};
+
+/// Finds the outermost set loops in `stmt` whose iterations can execute
+/// concurrently. A loop qualifies if its iterations only assign to variables
+/// declared in the loop body or reduce into int or float scalars that they do
+/// not otherwise read, only call side-effect free intrinsics, only store to set
+/// fields at locations they own, and only store to shared tensors at locations
+/// they own or through compound `+=` and `-=` stores on int or float
+/// components (which the backend makes atomic). Loops over edge set colors
+/// qualify with any compound stores, since the iterations of a color do not
+/// conflict. Loops are keyed by their loop variable.
+std::map<Var,ParallelLoop> findParallelLoops(Stmt stmt, const Storage& storage);
+
+/// True if `index` only depends on the iteration of `loop` and on loops nested
+/// in it, which means no other iteration stores to the same location. Indices
+/// are assumed to be linearized tensor coordinates.
+bool isOwnedLocation(const Expr& index, const ParallelLoop& loop);
+
+/// True if `store`, which is executed by an iteration of `loop`, is a compound
+/// store to a shared buffer location that other iterations may also update.
+bool needsAtomicUpdate(const Store* store, const ParallelLoop& loop);
+
+}}
+#endif
@@ -1,6 +1,10 @@
 #include "path_indices.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
 #include <iostream>
+#include <limits>
 #include <stack>
 #include <map>
 #include <vector>
@@ -8,6 +12,7 @@
 #include "path_expressions.h"
 #include "graph.h"
 #include "util/collections.h"
+#include "util/thread_pool.h"
 
 using namespace std;
 
@@ -144,9 +149,222 @@ void SegmentedPathIndex::print(std::ostream &os) const {
 }
 
 
+// class SegmentedIndexWriter
+/// Writes the rows of a segmented path index, in element order, directly into
+/// the malloc'ed arrays that the SegmentedPathIndex takes ownership of. The
+/// sinks array grows geometrically and is shrunk to fit when released.
+class SegmentedIndexWriter {
+public:
+  SegmentedIndexWriter(size_t numElements, size_t capacity)
+      : numElements(numElements), currElem(0), numSinks(0),
+        capacity(std::max(capacity, (size_t)1)) {
+    coordsData = (uint32_t*)malloc((numElements+1)*sizeof(uint32_t));
+    sinksData = (uint32_t*)malloc(this->capacity*sizeof(uint32_t));
+    coordsData[0] = 0;
+  }
+
+  ~SegmentedIndexWriter() {
+    free(coordsData);
+    free(sinksData);
+  }
+
+  size_t getNumElements() const {return numElements;}
+
+  /// Makes room for `n` sinks in the current row, and returns the row. The
+  /// returned pointer is invalidated by the next call to `reserve`.
+  uint32_t* reserve(size_t n) {
+    if (numSinks + n > capacity) {
+      capacity = std::max(numSinks + n, 2*capacity);
+      sinksData = (uint32_t*)realloc(sinksData, capacity*sizeof(uint32_t));
+    }
+    return &sinksData[numSinks];
+  }
+
+  /// Ends the current row, which holds the first `n` sinks written to it. The
+  /// row is sorted and stripped of duplicates if `sortRow` is set.
+  void endRow(size_t n, bool sortRow=false) {
+    simit_iassert(currElem < numElements);
+    uint32_t* row = &sinksData[numSinks];
+    if (sortRow) {
+      std::sort(row, row+n);
+      n = std::unique(row, row+n) - row;
+    }
+    numSinks += n;
+    coordsData[++currElem] = numSinks;
+  }
+
+  /// Writes the row of `elem` in `index` as the current row.
+  void copyRow(const SegmentedPathIndex* index, unsigned elem) {
+    const uint32_t* coords = index->getCoordData();
+    const uint32_t* sinks = index->getSinkData();
+    size_t n = coords[elem+1] - coords[elem];
+    copy(sinks + coords[elem], sinks + coords[elem+1], reserve(n));
+    endRow(n);
+  }
+
+  /// Returns scratch space with at least `n` entries, that persists across the
+  /// rows written by this writer. Entries added to it are set to `value`.
+  vector<size_t>& getScratch(size_t n, size_t value) {
+    if (scratch.size() < n) {
+      scratch.resize(n, value);
+    }
+    return scratch;
+  }
+
+  /// Releases the coords and sinks arrays to the caller, once every row has
+  /// been written.
+  void release(uint32_t** coords, uint32_t** sinks) {
+    simit_iassert(currElem == numElements) << "not every row was written";
+    *coords = coordsData;
+    *sinks = (uint32_t*)realloc(sinksData,
+                                std::max(numSinks,(size_t)1)*sizeof(uint32_t));
+    coordsData = nullptr;
+    sinksData = nullptr;
+  }
+
+private:
+  size_t numElements;
+  size_t currElem;
+  size_t numSinks;
+  size_t capacity;
+  uint32_t* coordsData;
+  uint32_t* sinksData;
+  vector<size_t> scratch;
+};
+
+/// Returns the neighbors of `elem` in `index` as a sorted range without
+/// duplicates, as required by set intersection and union. Rows that are not
+/// already sorted are sorted into `scratch`.
+static pair<const uint32_t*, const uint32_t*>
+getSortedRow(const SegmentedPathIndex* index, unsigned elem,
+             vector<uint32_t>* scratch) {
+  const uint32_t* coords = index->getCoordData();
+  const uint32_t* begin = index->getSinkData() + coords[elem];
+  const uint32_t* end = index->getSinkData() + coords[elem+1];
+  if (adjacent_find(begin, end, greater_equal<uint32_t>()) == end) {
+    return {begin, end};
+  }
+  scratch->assign(begin, end);
+  sort(scratch->begin(), scratch->end());
+  scratch->erase(unique(scratch->begin(), scratch->end()), scratch->end());
+  return {scratch->data(), scratch->data() + scratch->size()};
+}
+
+/// The number of blocks `n` elements are split into to be processed by
+/// `numThreads` threads. Blocks have at least 1024 elements, so that small
+/// indices are built serially.
+static unsigned getNumBlocks(size_t n, unsigned numThreads) {
+  const size_t minBlockSize = 1024;
+  return max((size_t)1, min((size_t)numThreads, n / minBlockSize));
+}
+
+/// The first element of block `b` when `n` elements are split into
+/// `numBlocks` blocks.
+static size_t getBlockStart(size_t n, unsigned numBlocks, unsigned b) {
+  return n * b / numBlocks;
+}
+
+/// Calls `body(b)` for every block `b` in [0, numBlocks), concurrently.
+static void forEachBlock(unsigned numBlocks, unsigned numThreads,
+                         const function<void(unsigned)>& body) {
+  util::ThreadPool::getInstance().parallelFor(numBlocks, numThreads,
+                                              [&](int start, int end) {
+    for (int b = start; b < end; ++b) {
+      body(b);
+    }
+  });
+}
+
+/// Builds the coords and sinks arrays of a segmented path index with `n`
+/// elements, where `writeRows(start, end, writer)` writes the rows of elements
+/// [start, end) to `writer`. The elements are split into blocks that are
+/// written concurrently, each to its own writer, and then concatenated.
+static void
+writeRowsInParallel(size_t n, size_t capacity, unsigned numThreads,
+                    const function<void(size_t,size_t,SegmentedIndexWriter*)>&
+                        writeRows,
+                    uint32_t** coords, uint32_t** sinks) {
+  unsigned numBlocks = getNumBlocks(n, numThreads);
+  if (numBlocks == 1) {
+    SegmentedIndexWriter writer(n, capacity);
+    writeRows(0, n, &writer);
+    writer.release(coords, sinks);
+    return;
+  }
+
+  vector<uint32_t*> blockCoords(numBlocks);
+  vector<uint32_t*> blockSinks(numBlocks);
+  forEachBlock(numBlocks, numThreads, [&](unsigned b) {
+    size_t start = getBlockStart(n, numBlocks, b);
+    size_t end = getBlockStart(n, numBlocks, b+1);
+    SegmentedIndexWriter writer(end-start, capacity/numBlocks);
+    writeRows(start, end, &writer);
+    writer.release(&blockCoords[b], &blockSinks[b]);
+  });
+
+  vector<size_t> blockOffsets(numBlocks+1, 0);
+  for (unsigned b = 0; b < numBlocks; ++b) {
+    size_t blockSize = getBlockStart(n, numBlocks, b+1) -
+                       getBlockStart(n, numBlocks, b);
+    blockOffsets[b+1] = blockOffsets[b] + blockCoords[b][blockSize];
+  }
+  size_t numSinks = blockOffsets[numBlocks];
+
+  *coords = (uint32_t*)malloc((n+1)*sizeof(uint32_t));
+  *sinks = (uint32_t*)malloc(max(numSinks,(size_t)1)*sizeof(uint32_t));
+  forEachBlock(numBlocks, numThreads, [&](unsigned b) {
+    size_t start = getBlockStart(n, numBlocks, b);
+    size_t end = getBlockStart(n, numBlocks, b+1);
+    for (size_t i = start; i < end; ++i) {
+      (*coords)[i] = blockOffsets[b] + blockCoords[b][i-start];
+    }
+    copy(blockSinks[b], blockSinks[b] + (blockOffsets[b+1]-blockOffsets[b]),
+         *sinks + blockOffsets[b]);
+    free(blockCoords[b]);
+    free(blockSinks[b]);
+  });
+  (*coords)[n] = numSinks;
+}
+
+/// Returns, for each row of `index`, whether it differs from the same row of
+/// `previous`. Rows past the end of `previous` differ. Compares every row.
+static vector<char> getChangedRows(const SegmentedPathIndex* index,
+                                   const SegmentedPathIndex* previous,
+                                   unsigned numThreads) {
+  size_t n = index->numElements();
+  if (index == previous) {
+    return vector<char>(n, false);
+  }
+
+  vector<char> changed(n);
+  const uint32_t* coords = index->getCoordData();
+  const uint32_t* sinks = index->getSinkData();
+  const uint32_t* prevCoords = previous->getCoordData();
+  const uint32_t* prevSinks = previous->getSinkData();
+  size_t prevN = previous->numElements();
+  unsigned numBlocks = getNumBlocks(n, numThreads);
+  forEachBlock(numBlocks, numThreads, [&](unsigned b) {
+    for (size_t i = getBlockStart(n, numBlocks, b);
+         i < getBlockStart(n, numBlocks, b+1); ++i) {
+      changed[i] = i >= prevN ||
+                   coords[i+1]-coords[i] != prevCoords[i+1]-prevCoords[i] ||
+                   !equal(sinks + coords[i], sinks + coords[i+1],
+                          prevSinks + prevCoords[i]);
+    }
+  });
+  return changed;
+}
+
+
 // class PathIndexBuilder
 PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
-                                           unsigned sourceEndpoint){
+                                           unsigned sourceEndpoint) {
+  return buildSegmented(pe, sourceEndpoint, nullptr);
+}
+
+PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
+                                           unsigned sourceEndpoint,
+                                           vector<SetVersion>* sets) {
   /// Interpret the path expression, starting at sourceEndpoint, over the graph.
   /// That is given an element, the find its neighbors through the paths
   /// described by the path expression.
@@ -158,61 +376,135 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
     };
     typedef map<Var, vector<Location>> VarToLocationsMap;
 
-    PathNeighborVisitor(PathIndexBuilder *builder) : builder(builder) {}
+    /// Builds path indices, updating `previous` (if given), which was built
+    /// from the same path expression.
+    PathNeighborVisitor(PathIndexBuilder *builder,
+                        const MemoizedPathIndex* previous)
+        : builder(builder), previous(previous) {}
 
-    PathIndex build(const PathExpression &pe) {
+    MemoizedPathIndex build(const PathExpression &pe) {
       pe.accept(this);
-      PathIndex pit = pi;
+      memo.pathIndex = pi;
       pi = nullptr;
-      return pit;
+      return memo;
     }
 
-  private:
-    /// Pack neighbor vectors into a segmented vector (contiguous array).
-    PathIndex pack(const map<unsigned, vector<unsigned>> &pathNeighbors,
-                   bool sorted=true) {
-      unsigned numNeighbors = 0;
-      for (auto &p : pathNeighbors) {
-        numNeighbors += p.second.size();
+    /// Add `versions` to `sets`, skipping the sets already in it.
+    static void addSetVersions(vector<SetVersion>* sets,
+                               const vector<SetVersion>& versions) {
+      for (const SetVersion& version : versions) {
+        if (find_if(sets->begin(), sets->end(), [&](const SetVersion& s) {
+              return s.name == version.name;
+            }) == sets->end()) {
+          sets->push_back(version);
+        }
       }
+    }
 
-      size_t numElements = pathNeighbors.size();
-      uint32_t* coordsData= (uint32_t*)malloc((numElements+1)*sizeof(uint32_t));
-      uint32_t* sinksData = (uint32_t*)malloc(numNeighbors*sizeof(uint32_t));
-
-      int currNbrsStart = 0;
-      for (auto& p : pathNeighbors) {
-        unsigned elem = p.first;
-        coordsData[elem] = currNbrsStart;
+  private:
+    typedef function<void(size_t,size_t,SegmentedIndexWriter*)> RowWriter;
+
+    /// Create a segmented path index with `n` elements, whose rows are written
+    /// by `writeRows` (see writeRowsInParallel).
+    PathIndex pack(size_t n, size_t capacity, const RowWriter& writeRows) {
+      uint32_t* coordsData;
+      uint32_t* sinksData;
+      writeRowsInParallel(n, capacity, builder->getNumThreads(), writeRows,
+                          &coordsData, &sinksData);
+      return new SegmentedPathIndex(n, coordsData, sinksData);
+    }
 
-        unsigned pNeighborSize = p.second.size();
-        if (pNeighborSize > 0) {
-          vector<unsigned> pNeighbors(p.second.begin(), p.second.end());
-          if (sorted) {
-            sort(pNeighbors.begin(), pNeighbors.end());
+    /// Create a segmented path index with `n` elements from the previous
+    /// index. The rows that are not `dirty` are copied from the previous index,
+    /// and runs of dirty rows are written by `writeRows`. The indices are
+    /// packed, so every row is written even if few of them are dirty.
+    PathIndex update(size_t n, const vector<char>& dirty,
+                     const RowWriter& writeRows) {
+      const SegmentedPathIndex* prev =
+          to<SegmentedPathIndex>(previous->pathIndex);
+      simit_iassert(dirty.size() == n);
+      return pack(n, prev->numNeighbors(),
+                  [&](size_t start, size_t end, SegmentedIndexWriter* writer) {
+        size_t elem = start;
+        while (elem < end) {
+          size_t runEnd = elem;
+          while (runEnd < end && dirty[runEnd]) {
+            ++runEnd;
           }
+          if (runEnd > elem) {
+            writeRows(elem, runEnd, writer);
+            elem = runEnd;
+          }
+          for (; elem < end && !dirty[elem]; ++elem) {
+            simit_iassert(elem < prev->numElements());
+            writer->copyRow(prev, elem);
+          }
+        }
+      });
+    }
 
-          memcpy(&sinksData[currNbrsStart], pNeighbors.data(),
-                 pNeighbors.size() * sizeof(uint32_t));
+    /// True if the previous index can be updated from the rows of the operand
+    /// indices that changed since it was built.
+    bool isUpdatable() const {
+      return previous != nullptr && isa<SegmentedPathIndex>(previous->pathIndex)
+          && previous->operands.size() == memo.operands.size();
+    }
 
-          currNbrsStart += pNeighborSize;
-        }
+    /// Returns the rows of operand `i` that changed since the previous index
+    /// was built.
+    vector<char> getChangedOperandRows(size_t i) const {
+      simit_iassert(isUpdatable());
+      return getChangedRows(to<SegmentedPathIndex>(memo.operands[i]),
+                            to<SegmentedPathIndex>(previous->operands[i]),
+                            builder->getNumThreads());
+    }
+
+    /// Returns the rows of either operand that changed since the previous index
+    /// was built.
+    vector<char> getChangedOperandRows() const {
+      vector<char> changed = getChangedOperandRows(0);
+      vector<char> rhsChanged = getChangedOperandRows(1);
+      simit_iassert(changed.size() == rhsChanged.size());
+      for (size_t i = 0; i < changed.size(); ++i) {
+        changed[i] = changed[i] || rhsChanged[i];
       }
-      coordsData[numElements] = currNbrsStart;
-      return new SegmentedPathIndex(numElements, coordsData, sinksData);;
+      return changed;
+    }
+
+    /// Get the set bound to `set`, and record that the index depends on it.
+    const simit::Set* getBinding(const pe::Set& set) {
+      return addBinding(set.getName(), builder->getBinding(set));
+    }
+
+    const simit::Set* getBinding(const ir::Var& var) {
+      return addBinding(var.getName(), builder->getBinding(var));
+    }
+
+    /// Record that the index depends on `set`, which is bound to `name`.
+    const simit::Set* addBinding(const string& name, const simit::Set* set) {
+      addSetVersions(&memo.sets, {{name, set, set->getGeneration()}});
+      return set;
+    }
+
+    /// Build the index of an operand, and record that the index depends on it.
+    PathIndex buildOperand(const PathExpression &pe, unsigned sourceEndpoint) {
+      PathIndex operand = builder->buildSegmented(pe, sourceEndpoint,
+                                                  &memo.sets);
+      memo.operands.push_back(operand);
+      return operand;
     }
 
     void visit(const Link *link) {
+      const unsigned numThreads = builder->getNumThreads();
       switch (link->getType()) {
         case Link::ev: {
-          const simit::Set& edgeSet = *builder->getBinding(link->getEdgeSet());
+          const simit::Set& edgeSet = *getBinding(link->getEdgeSet());
 
           const int cardinality = edgeSet.getCardinality();
           simit_iassert(cardinality > 0)
               << "not an edge set" << edgeSet.getName();
 
-          const simit::Set& vertexSet =
-              *builder->getBinding(link->getVertexSet());
+          const simit::Set& vertexSet = *getBinding(link->getVertexSet());
 
           int nnzPerRow = 0;
           for (size_t i=0; i<(size_t)edgeSet.getCardinality(); ++i) {
@@ -233,74 +525,157 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
             ptr[i] = i*nnzPerRow;
           }
 
-          for (auto e : edgeSet) {
-            for (int i=0, j=0; i<cardinality; ++i) {
-              if (&vertexSet == edgeSet.getEndpointSet(i)) {
-                int ep = edgeSet.getEndpoint(e,i).getIdent();
-                idx[e.getIdent()*nnzPerRow + (j++)] = ep;
+          unsigned numBlocks = getNumBlocks(n, numThreads);
+          forEachBlock(numBlocks, numThreads, [&](unsigned b) {
+            simit::Set::ElementIterator
+                e(&edgeSet, getBlockStart(n, numBlocks, b)),
+                end(&edgeSet, getBlockStart(n, numBlocks, b+1));
+            for (; e != end; ++e) {
+              for (int i=0, j=0; i<cardinality; ++i) {
+                if (&vertexSet == edgeSet.getEndpointSet(i)) {
+                  int ep = edgeSet.getEndpoint(*e,i).getIdent();
+                  idx[e->getIdent()*nnzPerRow + (j++)] = ep;
+                }
               }
             }
-          }
+          });
 
           pi = new SegmentedPathIndex(n, ptr, idx);;
           break;
         }
         case Link::ve: {
-          const simit::Set& edgeSet = *builder->getBinding(link->getEdgeSet());
-          simit_iassert(edgeSet.getCardinality() > 0)
+          const simit::Set& edgeSet = *getBinding(link->getEdgeSet());
+          const int cardinality = edgeSet.getCardinality();
+          simit_iassert(cardinality > 0)
               << "not an edge set" << edgeSet.getName();
-          
-          // add each edge to the neighbor vectors of its endpoints
-          map<unsigned, vector<unsigned>> pathNeighbors;
-
-          // create neighbor lists
-          const simit::Set& vertexSet =
-              *builder->getBinding(link->getVertexSet());
-          for (auto &v : vertexSet) {
-            pathNeighbors.insert({v.getIdent(), vector<unsigned>()});
+
+          const simit::Set& vertexSet = *getBinding(link->getVertexSet());
+          vector<int> vertexEndpoints;
+          for (int i=0; i<cardinality; ++i) {
+            if (&vertexSet == edgeSet.getEndpointSet(i)) {
+              vertexEndpoints.push_back(i);
+            }
           }
 
-          // populate neighbor lists
-          for (auto &e : edgeSet) {
-            simit_iassert(e.getIdent() >= 0);
-            int i = 0;
-            for (auto &ep : edgeSet.getEndpoints(e)) {
-              simit_iassert(ep.getIdent() >= 0);
-              if (&vertexSet == edgeSet.getEndpointSet(i++)) {
-                pathNeighbors.at(ep.getIdent()).push_back(e.getIdent());
+          // Counting sort the edges by endpoint. Each block of edges counts
+          // its edges per vertex, and the counts are then turned into the
+          // position where the block starts writing in each vertex's row. The
+          // blocks are in edge order, so the edges of a vertex come out sorted.
+          size_t n = vertexSet.getSize();
+          size_t numEdges = edgeSet.getSize();
+          unsigned numEdgeBlocks = getNumBlocks(numEdges, numThreads);
+          vector<vector<uint32_t>> blockCounts(numEdgeBlocks);
+          forEachBlock(numEdgeBlocks, numThreads, [&](unsigned b) {
+            vector<uint32_t>& counts = blockCounts[b];
+            counts.assign(n, 0);
+            simit::Set::ElementIterator
+                e(&edgeSet, getBlockStart(numEdges, numEdgeBlocks, b)),
+                end(&edgeSet, getBlockStart(numEdges, numEdgeBlocks, b+1));
+            for (; e != end; ++e) {
+              for (int i : vertexEndpoints) {
+                int ep = edgeSet.getEndpoint(*e,i).getIdent();
+                simit_iassert(ep >= 0 && (size_t)ep < n);
+                counts[ep]++;
               }
             }
+          });
+
+          // Parallel prefix sum of the row sizes, in two passes over blocks
+          // of vertices: one that sums the rows of each block, and one that
+          // offsets them by the sizes of the preceding blocks.
+          uint32_t* ptr = (uint32_t*)malloc((n+1)*sizeof(uint32_t));
+          ptr[0] = 0;
+          unsigned numVertexBlocks = getNumBlocks(n, numThreads);
+          vector<uint32_t> vertexBlockOffsets(numVertexBlocks+1, 0);
+          forEachBlock(numVertexBlocks, numThreads, [&](unsigned b) {
+            uint32_t blockSize = 0;
+            for (size_t v = getBlockStart(n, numVertexBlocks, b);
+                 v < getBlockStart(n, numVertexBlocks, b+1); ++v) {
+              uint32_t rowSize = 0;
+              for (auto& counts : blockCounts) {
+                uint32_t count = counts[v];
+                counts[v] = rowSize;
+                rowSize += count;
+              }
+              ptr[v+1] = rowSize;
+              blockSize += rowSize;
+            }
+            vertexBlockOffsets[b+1] = blockSize;
+          });
+          for (unsigned b = 0; b < numVertexBlocks; ++b) {
+            vertexBlockOffsets[b+1] += vertexBlockOffsets[b];
           }
-          pi = pack(pathNeighbors);
+          forEachBlock(numVertexBlocks, numThreads, [&](unsigned b) {
+            uint32_t offset = vertexBlockOffsets[b];
+            for (size_t v = getBlockStart(n, numVertexBlocks, b);
+                 v < getBlockStart(n, numVertexBlocks, b+1); ++v) {
+              offset += ptr[v+1];
+              ptr[v+1] = offset;
+            }
+          });
+
+          uint32_t* idx = (uint32_t*)malloc(max(ptr[n],1u)*sizeof(uint32_t));
+          forEachBlock(numEdgeBlocks, numThreads, [&](unsigned b) {
+            vector<uint32_t>& pos = blockCounts[b];
+            simit::Set::ElementIterator
+                e(&edgeSet, getBlockStart(numEdges, numEdgeBlocks, b)),
+                end(&edgeSet, getBlockStart(numEdges, numEdgeBlocks, b+1));
+            for (; e != end; ++e) {
+              for (int i : vertexEndpoints) {
+                int ep = edgeSet.getEndpoint(*e,i).getIdent();
+                idx[ptr[ep] + (pos[ep]++)] = e->getIdent();
+              }
+            }
+          });
+
+          pi = new SegmentedPathIndex(n, ptr, idx);
           break;
         }
         case Link::vv: {
           const ir::StencilLayout& stencil = link->getStencil();
           const simit::Set& throughSet =
-              *builder->getBinding(stencil.getGridSet());
-          
-          map<unsigned, vector<unsigned>> pathNeighbors;
+              *getBinding(stencil.getGridSet());
+          const vector<int>& dimensions = throughSet.getDimensions();
 
-          // create neighbor lists
           const simit::Set& sourceSet =
-              *builder->getBinding(link->getVertexSet(0));
+              *getBinding(link->getVertexSet(0));
           simit_iassert(sourceSet.getName() ==
-                  builder->getBinding(link->getVertexSet(1))->getName());
-          for (auto &v : sourceSet) {
-            pathNeighbors.insert({v.getIdent(), vector<unsigned>()});
-            for (auto &kv : stencil.getLayoutReversed()) {
-              const vector<int> &offsets = kv.second;
-              vector<int> base = throughSet.getGridPointCoords(v);
-              simit_iassert(offsets.size() == base.size());
-              for (unsigned i = 0; i < base.size(); ++i) {
-                base[i] += offsets[i] + throughSet.getDimensions()[i];
-                base[i] = base[i] % throughSet.getDimensions()[i];
+                  getBinding(link->getVertexSet(1))->getName());
+
+          // Every vertex has one neighbor per stencil offset, in stencil order
+          map<int, vector<int>> offsets = stencil.getLayoutReversed();
+          size_t n = sourceSet.getSize();
+          size_t nnzPerRow = offsets.size();
+
+          uint32_t* ptr = (uint32_t*)malloc((n+1)*sizeof(uint32_t));
+          uint32_t* idx = (uint32_t*)malloc(max(n*nnzPerRow,(size_t)1) *
+                                            sizeof(uint32_t));
+          for (size_t i=0; i<=n; ++i) {
+            ptr[i] = i*nnzPerRow;
+          }
+
+          unsigned numBlocks = getNumBlocks(n, numThreads);
+          forEachBlock(numBlocks, numThreads, [&](unsigned b) {
+            simit::Set::ElementIterator
+                v(&sourceSet, getBlockStart(n, numBlocks, b)),
+                end(&sourceSet, getBlockStart(n, numBlocks, b+1));
+            for (; v != end; ++v) {
+              const vector<int> coords = throughSet.getGridPointCoords(*v);
+              uint32_t* row = &idx[v->getIdent()*nnzPerRow];
+              for (auto &kv : offsets) {
+                const vector<int> &offset = kv.second;
+                simit_iassert(offset.size() == coords.size());
+                vector<int> base = coords;
+                for (unsigned i = 0; i < base.size(); ++i) {
+                  base[i] += offset[i] + dimensions[i];
+                  base[i] = base[i] % dimensions[i];
+                }
+                *(row++) = throughSet.getGridPoint(base).getIdent();
               }
-              pathNeighbors.at(v.getIdent()).push_back(
-                  throughSet.getGridPoint(base).getIdent());
             }
-          }
-          pi = pack(pathNeighbors, false);
+          });
+
+          pi = new SegmentedPathIndex(n, ptr, idx);
           break;
         }
         default: simit_unreachable;
@@ -328,8 +703,8 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
           << "source variable is not in the path expression";
       simit_iassert(util::contains(locs, sink))
           << "sink variable is not in the path expression";
-      return builder->buildSegmented(locs.at(source)[0].pathExpr,
-                                     locs.at(source)[0].endpoint);
+      return buildOperand(locs.at(source)[0].pathExpr,
+                          locs.at(source)[0].endpoint);
     }
 
     tuple<PathIndex,PathIndex> buildIndices(const PathExpression &lhs,
@@ -345,13 +720,13 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
 
       Location sourceLoc = varToLocations[source][0];
       PathIndex sourceToQuantified =
-          builder->buildSegmented(sourceLoc.pathExpr, sourceLoc.endpoint);
+          buildOperand(sourceLoc.pathExpr, sourceLoc.endpoint);
       PathIndex sourceToQuantified2, quantifiedToSink2;
 
       Location sinkLoc = varToLocations[sink][0];
       unsigned quantifiedLoc = ((sinkLoc.endpoint) == 0) ? 1 : 0;
       PathIndex quantifiedToSink =
-          builder->buildSegmented(sinkLoc.pathExpr, quantifiedLoc);
+          buildOperand(sinkLoc.pathExpr, quantifiedLoc);
 
       return make_pair(sourceToQuantified, quantifiedToSink);
     }
@@ -364,30 +739,40 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
       PathExpression lhs = f->getLhs();
       PathExpression rhs = f->getRhs();
 
-      map<unsigned, set<unsigned>> pathNeighbors;
       if (!f->isQuantified()) {
         // Build indices from first to second free variable through lhs and rhs
         PathIndex lhsIndex = buildIndex(lhs, freeVars[0], freeVars[1]);
         PathIndex rhsIndex = buildIndex(rhs, freeVars[0], freeVars[1]);
-
-        // Build a path index that is the intersection of lhsIndex and rhsIndex.
-        // OPT: If path indices supported efficient lookups we could instead:
-        //      for each (elem,nbr) pair in lhs, if it exist in rhs then emit.
-        map<unsigned, set<unsigned>> lhsPathNeighbors;
-        for (unsigned elem : lhsIndex) {
-          lhsPathNeighbors.insert({elem, set<unsigned>()});
-          for (unsigned nbr : lhsIndex.neighbors(elem)) {
-            lhsPathNeighbors.at(elem).insert(nbr);
+        simit_iassert(lhsIndex.numElements() == rhsIndex.numElements());
+        const SegmentedPathIndex* lhsSegmented =
+            to<SegmentedPathIndex>(lhsIndex);
+        const SegmentedPathIndex* rhsSegmented =
+            to<SegmentedPathIndex>(rhsIndex);
+
+        // Build a path index that is the intersection of lhsIndex and rhsIndex,
+        // by intersecting the sorted neighbors of each element.
+        RowWriter writeRows = [&](size_t start, size_t end,
+                                  SegmentedIndexWriter* writer) {
+          vector<uint32_t> lhsScratch, rhsScratch;
+          for (size_t elem = start; elem < end; ++elem) {
+            auto lhsNbrs = getSortedRow(lhsSegmented, elem, &lhsScratch);
+            auto rhsNbrs = getSortedRow(rhsSegmented, elem, &rhsScratch);
+            uint32_t* row = writer->reserve(min(lhsNbrs.second-lhsNbrs.first,
+                                                rhsNbrs.second-rhsNbrs.first));
+            uint32_t* rowEnd = set_intersection(lhsNbrs.first, lhsNbrs.second,
+                                                rhsNbrs.first, rhsNbrs.second,
+                                                row);
+            writer->endRow(rowEnd - row);
           }
+        };
+        if (isUpdatable()) {
+          pi = update(lhsIndex.numElements(), getChangedOperandRows(),
+                      writeRows);
         }
-        for (unsigned elem : rhsIndex) {
-          pathNeighbors.insert({elem, set<unsigned>()});
-          for (unsigned nbr : rhsIndex.neighbors(elem)) {
-            auto &elemNbrs = lhsPathNeighbors.at(elem);
-            if (elemNbrs.find(nbr) != elemNbrs.end()) {
-              pathNeighbors.at(elem).insert(nbr);
-            }
-          }
+        else {
+          pi = pack(rhsIndex.numElements(),
+                    min(lhsIndex.numNeighbors(), rhsIndex.numNeighbors()),
+                    writeRows);
         }
       }
       else {
@@ -407,25 +792,62 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
 
         tie(sourceToQuantified, quantifiedToSink) =
             buildIndices(lhs, rhs, freeVars[0], qvar.getVar(), freeVars[1]);
+        const SegmentedPathIndex* sourceToQuantifiedSegmented =
+            to<SegmentedPathIndex>(sourceToQuantified);
+        const SegmentedPathIndex* quantifiedToSinkSegmented =
+            to<SegmentedPathIndex>(quantifiedToSink);
+        const uint32_t* sqCoords = sourceToQuantifiedSegmented->getCoordData();
+        const uint32_t* sqSinks = sourceToQuantifiedSegmented->getSinkData();
+        const uint32_t* qsCoords = quantifiedToSinkSegmented->getCoordData();
+        const uint32_t* qsSinks = quantifiedToSinkSegmented->getSinkData();
+
+        const uint32_t* qsSinksEnd = qsSinks + quantifiedToSink.numNeighbors();
+        size_t numSinks = (qsSinks == qsSinksEnd)
+                          ? 0 : *max_element(qsSinks, qsSinksEnd) + 1;
 
         // Build a path index from the first free variable to the second free
-        // variable, through the quantified variable.
-        for (unsigned source : sourceToQuantified) {
-          pathNeighbors.insert({source, set<unsigned>()});
-          for (unsigned q : sourceToQuantified.neighbors(source)) {
-            for (unsigned sink : quantifiedToSink.neighbors(q)) {
-              pathNeighbors.at(source).insert(sink);
+        // variable, through the quantified variable. The sinks already added
+        // to the row of a source are marked with that source.
+        RowWriter writeRows = [&](size_t start, size_t end,
+                                  SegmentedIndexWriter* writer) {
+          vector<size_t>& marks =
+              writer->getScratch(numSinks, numeric_limits<size_t>::max());
+          for (size_t source = start; source < end; ++source) {
+            size_t rowSize = 0;
+            for (uint32_t i = sqCoords[source]; i < sqCoords[source+1]; ++i) {
+              uint32_t q = sqSinks[i];
+              uint32_t* row = writer->reserve(rowSize +
+                                              qsCoords[q+1] - qsCoords[q]);
+              for (uint32_t j = qsCoords[q]; j < qsCoords[q+1]; ++j) {
+                uint32_t sink = qsSinks[j];
+                if (marks[sink] != source) {
+                  marks[sink] = source;
+                  row[rowSize++] = sink;
+                }
+              }
             }
+            writer->endRow(rowSize, true);
           }
+        };
+
+        if (isUpdatable()) {
+          // The row of a source changes if its quantified neighbors change, or
+          // if the sinks of one of them change
+          vector<char> dirty = getChangedOperandRows(0);
+          vector<char> qsChanged = getChangedOperandRows(1);
+          for (size_t source = 0; source < dirty.size(); ++source) {
+            for (uint32_t i = sqCoords[source];
+                 !dirty[source] && i < sqCoords[source+1]; ++i) {
+              dirty[source] = qsChanged[sqSinks[i]];
+            }
+          }
+          pi = update(sourceToQuantified.numElements(), dirty, writeRows);
+        }
+        else {
+          pi = pack(sourceToQuantified.numElements(),
+                    sourceToQuantified.numNeighbors(), writeRows);
         }
       }
-      // Convert path neighbors to vector values
-      map<unsigned, vector<unsigned>> pathNeighborsVec;
-      for (auto &kv : pathNeighbors) {
-        pathNeighborsVec[kv.first] =
-            vector<unsigned>(kv.second.begin(), kv.second.end());
-      }
-      pi = pack(pathNeighborsVec);
     }
 
     void visit(const Or *f) {
@@ -436,24 +858,39 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
       PathExpression lhs = f->getLhs();
       PathExpression rhs = f->getRhs();
 
-      map<unsigned, set<unsigned>> pathNeighbors;
       if (!f->isQuantified()) {
         // Build indices from first to second free variable through lhs and rhs
         PathIndex lhsIndex = buildIndex(lhs, freeVars[0], freeVars[1]);
         PathIndex rhsIndex = buildIndex(rhs, freeVars[0], freeVars[1]);
-
-        // Build a path index that is the union of lhsIndex and rhsIndex
-        for (unsigned elem : lhsIndex) {
-          pathNeighbors.insert({elem, set<unsigned>()});
-          for (unsigned nbr : lhsIndex.neighbors(elem)) {
-            pathNeighbors.at(elem).insert(nbr);
+        simit_iassert(lhsIndex.numElements() == rhsIndex.numElements());
+        const SegmentedPathIndex* lhsSegmented =
+            to<SegmentedPathIndex>(lhsIndex);
+        const SegmentedPathIndex* rhsSegmented =
+            to<SegmentedPathIndex>(rhsIndex);
+
+        // Build a path index that is the union of lhsIndex and rhsIndex, by
+        // merging the sorted neighbors of each element.
+        RowWriter writeRows = [&](size_t start, size_t end,
+                                  SegmentedIndexWriter* writer) {
+          vector<uint32_t> lhsScratch, rhsScratch;
+          for (size_t elem = start; elem < end; ++elem) {
+            auto lhsNbrs = getSortedRow(lhsSegmented, elem, &lhsScratch);
+            auto rhsNbrs = getSortedRow(rhsSegmented, elem, &rhsScratch);
+            uint32_t* row = writer->reserve((lhsNbrs.second-lhsNbrs.first) +
+                                            (rhsNbrs.second-rhsNbrs.first));
+            uint32_t* rowEnd = set_union(lhsNbrs.first, lhsNbrs.second,
+                                         rhsNbrs.first, rhsNbrs.second, row);
+            writer->endRow(rowEnd - row);
           }
+        };
+        if (isUpdatable()) {
+          pi = update(lhsIndex.numElements(), getChangedOperandRows(),
+                      writeRows);
         }
-        for (unsigned elem : rhsIndex) {
-          simit_iassert(pathNeighbors.find(elem) != pathNeighbors.end());
-          for (unsigned nbr : rhsIndex.neighbors(elem)) {
-            pathNeighbors.at(elem).insert(nbr);
-          }
+        else {
+          pi = pack(lhsIndex.numElements(),
+                    max(lhsIndex.numNeighbors(), rhsIndex.numNeighbors()),
+                    writeRows);
         }
       }
       else {
@@ -482,56 +919,98 @@ PathIndex PathIndexBuilder::buildSegmented(const PathExpression &pe,
         // quantified variable. Every free variable that can reach any
         // quantified variable gets links to every element of the second
         // variable. Vice versa for the second variable, but jump from the
-        // quantified var.
-        auto sinkSet = builder->getBinding(f->getSet(freeVars[1]));
-
-        for (unsigned source : sourceToQuantified) {
-          pathNeighbors.insert({source, set<unsigned>()});
-          if (sourceToQuantified.numNeighbors(source) > 0) {
-            for (auto &sinkElem : *sinkSet) {
-              unsigned sink = sinkElem.getIdent();
-              pathNeighbors.at(source).insert(sink);
-            }
+        // quantified var. Hence every source links to the sinks reachable from
+        // any quantified element, and sources with quantified neighbors link
+        // to every sink.
+        auto sinkSet = getBinding(f->getSet(freeVars[1]));
+        size_t numSinks = sinkSet->getSize();
+
+        const SegmentedPathIndex* quantifiedToSinkSegmented =
+            to<SegmentedPathIndex>(quantifiedToSink);
+        const uint32_t* qsSinks = quantifiedToSinkSegmented->getSinkData();
+        vector<bool> reachable(numSinks, false);
+        for (size_t i = 0; i < quantifiedToSink.numNeighbors(); ++i) {
+          simit_iassert(qsSinks[i] < numSinks);
+          reachable[qsSinks[i]] = true;
+        }
+        vector<uint32_t> reachableSinks;
+        for (size_t sink = 0; sink < numSinks; ++sink) {
+          if (reachable[sink]) {
+            reachableSinks.push_back(sink);
           }
         }
 
-        for (unsigned quantified : quantifiedToSink) {
-          for (unsigned sink: quantifiedToSink.neighbors(quantified)) {
-            for (unsigned source : sourceToQuantified) {
-              pathNeighbors.at(source).insert(sink);
+        pi = pack(sourceToQuantified.numElements(),
+                  sourceToQuantified.numElements() * reachableSinks.size(),
+                  [&](size_t start, size_t end, SegmentedIndexWriter* writer) {
+          for (size_t source = start; source < end; ++source) {
+            if (sourceToQuantified.numNeighbors(source) > 0) {
+              uint32_t* row = writer->reserve(numSinks);
+              for (size_t sink = 0; sink < numSinks; ++sink) {
+                row[sink] = sink;
+              }
+              writer->endRow(numSinks);
+            }
+            else {
+              uint32_t* row = writer->reserve(reachableSinks.size());
+              copy(reachableSinks.begin(), reachableSinks.end(), row);
+              writer->endRow(reachableSinks.size());
             }
           }
-        }
+        });
       }
-      // Convert path neighbors to vector values
-      map<unsigned, vector<unsigned>> pathNeighborsVec;
-      for (auto &kv : pathNeighbors) {
-        pathNeighborsVec[kv.first] =
-            vector<unsigned>(kv.second.begin(), kv.second.end());
-      }
-      pi = pack(pathNeighborsVec);
     }
 
     PathIndex pi;  // Path index returned from cases
     PathIndexBuilder *builder;
+    const MemoizedPathIndex* previous;
+    MemoizedPathIndex memo;
   };
 
   // TODO: Possible optimization is to detect symmetric path expressions, and
   //       return the same path index when they are evaluated in both directions
 
   // Check if we have memoized the path index for this path expression, starting
-  // at this sourceEndpoint, bound to these sets.
+  // at this sourceEndpoint, bound to these sets. If the sets have changed since
+  // then the memoized index is updated instead.
+  const MemoizedPathIndex* previous = nullptr;
   if (util::contains(pathIndices, {pe,sourceEndpoint})) {
-    return pathIndices.at({pe,sourceEndpoint});
+    const MemoizedPathIndex& memo = pathIndices.at({pe,sourceEndpoint});
+    if (isCurrent(memo)) {
+      if (sets != nullptr) {
+        PathNeighborVisitor::addSetVersions(sets, memo.sets);
+      }
+      return memo.pathIndex;
+    }
+    previous = &memo;
   }
 
-  PathIndex pi = PathNeighborVisitor(this).build(pe);
-  pathIndices.insert({{pe,sourceEndpoint}, pi});
-  return pi;
+  MemoizedPathIndex memo = PathNeighborVisitor(this, previous).build(pe);
+  pathIndices[{pe,sourceEndpoint}] = memo;
+  if (sets != nullptr) {
+    PathNeighborVisitor::addSetVersions(sets, memo.sets);
+  }
+  return memo.pathIndex;
+}
+
+bool PathIndexBuilder::isCurrent(const MemoizedPathIndex& memo) const {
+  for (const SetVersion& version : memo.sets) {
+    if (!util::contains(bindings, version.name) ||
+        bindings.at(version.name) != version.set ||
+        version.set->getGeneration() != version.generation) {
+      return false;
+    }
+  }
+  return true;
 }
 
 void PathIndexBuilder::bind(std::string name, const simit::Set* set) {
-  bindings.insert({name,set});
+  bindings[name] = set;
+}
+
+void PathIndexBuilder::setNumThreads(unsigned numThreads) {
+  simit_iassert(numThreads >= 1);
+  this->numThreads = numThreads;
 }
 
 const simit::Set* PathIndexBuilder::getBinding(pe::Set pset) const {
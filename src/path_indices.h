@@ -5,6 +5,7 @@
 #include <map>
 #include <memory>
 #include <typeinfo>
+#include <vector>
 
 #include "graph.h"
 #include "path_expressions.h"
@@ -227,12 +228,16 @@ inline const PI* to(PathIndex pi) {
 /// A builder that builds path indices by evaluating path expressions on graphs.
 /// The builder memoizes previously computed path indices, and uses these to
 /// accelerate subsequent path index construction (since path expressions can be
-/// recursively constructed from path expressions).
+/// recursively constructed from path expressions). Memoized indices are reused
+/// until the sets they were built from change or are rebound, and are then
+/// rebuilt faster by recomputing only the rows whose operand rows changed.
+/// Finding those rows and copying the other rows into the new index still
+/// takes time linear in the size of the index, not in the size of the change.
 class PathIndexBuilder {
 public:
-  PathIndexBuilder() {}
+  PathIndexBuilder() : numThreads(1) {}
   PathIndexBuilder(std::map<std::string, const simit::Set*> bindings)
-      : bindings(bindings) {}
+      : bindings(bindings), numThreads(1) {}
 
   // Build a Segmented path index by evaluating the `pe` over the given graph.
   PathIndex buildSegmented(const PathExpression &pe, unsigned sourceEndpoint);
@@ -242,9 +247,38 @@ public:
   const simit::Set* getBinding(pe::Set pset) const;
   const simit::Set* getBinding(ir::Var var) const;
 
+  /// Set the number of threads used to build each path index. Indices over
+  /// small sets are built serially regardless.
+  void setNumThreads(unsigned numThreads);
+  unsigned getNumThreads() const {return numThreads;}
+
 private:
-  std::map<std::pair<PathExpression,unsigned>, PathIndex> pathIndices;
+  /// A set that a path index was built from, and its generation at the time.
+  struct SetVersion {
+    std::string name;
+    const simit::Set* set;
+    unsigned long generation;
+  };
+
+  /// A memoized path index, with the sets and the operand indices it was built
+  /// from.
+  struct MemoizedPathIndex {
+    PathIndex pathIndex;
+    std::vector<SetVersion> sets;
+    std::vector<PathIndex> operands;
+  };
+
+  std::map<std::pair<PathExpression,unsigned>, MemoizedPathIndex> pathIndices;
   std::map<std::string, const simit::Set*> bindings;
+  unsigned numThreads;
+
+  /// Build a segmented path index, and add the sets it was built from to
+  /// `sets` (if given).
+  PathIndex buildSegmented(const PathExpression &pe, unsigned sourceEndpoint,
+                           std::vector<SetVersion>* sets);
+
+  /// True if the sets `memo` was built from are still bound and unchanged.
+  bool isCurrent(const MemoizedPathIndex& memo) const;
 };
 
 }}
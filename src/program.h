@@ -46,6 +46,9 @@ public:
   /// Compile and return a runnable function, or an undefined function if an
   /// error occured.
   Function compile(const std::string &function);
+
+  /// Compile a function with probes that time its statements, loops and
+  /// inlined calls. The times are written by simit::ir::writeProfile.
   Function compileWithTimers(const std::string &function);
 
   /// Verify the program by executing in-code comment tests.
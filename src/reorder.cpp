@@ -1,273 +1,653 @@
 #include "reorder.h"
 #include "graph.h"
 #include "hilbert.h"
+#include "util/thread_pool.h"
 
-#include <vector>
-#include <cstdio>
-#include <cstdlib>
-#include <cmath>
-#include <climits>
+#include <algorithm>
 #include <cfloat>
-#include <string>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
 
 using namespace std;
 namespace simit {
+extern int kNumThreads;
 
-  // ---------- Hilbert Reordering Heuristic ----------
-  namespace hilbert {
-    // This function populates the hilbertId field of each vertex_t in nodes, by
-    // remapping every vertex onto an n^3 lattice using appropriate scaling 
-    // factors,
-    // and then traversing the lattice using a 3-D Hilbert curve.
-    //
-    // hilbertBits = number of bits in Hilbert grid (grid with side 
-    // 2^hilbertBits)
-    void assignHilbertIds(vertex_t * const nodes, const int cntNodes,
-                          const unsigned hilbertBits) {
-      // We first traverse all vertices to find the maximal and minimal 
-      // coordinates
-      // along each axis: xMin, xMax, yMin, yMax, zMin, zMax.
-
-      double xMin, xMax, yMin, yMax, zMin, zMax;
-      uint64_t hilbertGridN = 1 << hilbertBits; xMin = yMin = zMin = DBL_MAX;
-      xMax = yMax = zMax = DBL_MIN;
-      for (int i = 0; i < cntNodes; ++i) {
-        xMin = fmin(xMin, nodes[i].x);
-        yMin = fmin(yMin, nodes[i].y);
-        zMin = fmin(zMin, nodes[i].z);
-        xMax = fmax(xMax, nodes[i].x);
-        yMax = fmax(yMax, nodes[i].y);
-        zMax = fmax(zMax, nodes[i].z);
-      }
+/// Calls `body(start, end)` on sub-ranges of [0, n) on the threads that
+/// execute set loops.
+template <typename Body>
+static void parallelFor(int n, Body body) {
+  util::ThreadPool::getInstance().parallelFor(n, kNumThreads,
+      [&](int start, int end) {
+        body(start, end);
+      });
+}
+
+/// Returns the mapping from old to new indices of elements listed in their
+/// new order, that is, the inverse of `newToOld`.
+static vector<int> invertOrdering(const vector<int>& newToOld) {
+  vector<int> oldToNew(newToOld.size());
+  parallelFor(newToOld.size(), [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      oldToNew[newToOld[i]] = i;
+    }
+  });
+  return oldToNew;
+}
 
-      // We now create a mapping that maps:
-      //   (xMin, yMin, zMin) to lattice point (0, 0, 0)
-      //   (xMax, yMax, zMax) to lattice point (n-1, n-1, n-1)
-      // where n = hilbertGridN
-      //
-      // This mapping is the following: for the T axis,
-      // tLattice = round((t - tMin) * (hilbertGridN - 1) / tMax);
+// ---------- Parallel Radix Sort ----------
+/// Each thread sorts a few blocks, so that uneven blocks balance out.
+static const int kBlocksPerThread = 4;
 
-      for (int i = 0; i < cntNodes; ++i) {
-        bitmask_t latticeCoords[3];
-        bitmask_t hilbertIndex;
+/// Blocks smaller than this are not worth a parallel task.
+static const int kMinBlockSize = 1 << 14;
 
-        nodes[i].id = (vid_t)i;
+/// Stably sorts `ids` by `keys`, and `keys` with them, with a parallel least
+/// significant digit radix sort on the bytes of the keys that are not zero in
+/// every key.
+static void radixSort(vector<uint64_t>& keys, vector<int>& ids) {
+  const int kDigitBits = 8;
+  const int kRadix = 1 << kDigitBits;
+  int n = keys.size();
+  simit_iassert((int)ids.size() == n);
 
-        latticeCoords[0] = (uint64_t) round((nodes[i].x - xMin) * (hilbertGridN 
-              - 1) / xMax);
-        latticeCoords[1] = (uint64_t) round((nodes[i].y - yMin) * (hilbertGridN 
-              - 1) / yMax);
-        latticeCoords[2] = (uint64_t) round((nodes[i].z - zMin) * (hilbertGridN 
-              - 1) / zMax);
+  uint64_t keyBits = 0;
+  for (uint64_t key : keys) {
+    keyBits |= key;
+  }
+  int numBlocks = max(1, min(kNumThreads * kBlocksPerThread,
+                             n / kMinBlockSize));
+  auto blockStart = [&](int block) {
+    return (int)((int64_t)n * block / numBlocks);
+  };
 
-        hilbertIndex = hilbert_c2i(3, hilbertBits, latticeCoords);
-        nodes[i].hilbertId = (vid_t) hilbertIndex;
+  vector<uint64_t> sortedKeys(n);
+  vector<int> sortedIds(n);
+  vector<int> offsets(numBlocks * kRadix);
+  for (int shift = 0; shift < 64 && (keyBits >> shift) != 0;
+       shift += kDigitBits) {
+    // Count the digits of each block...
+    fill(offsets.begin(), offsets.end(), 0);
+    parallelFor(numBlocks, [&](int startBlock, int endBlock) {
+      for (int b = startBlock; b < endBlock; ++b) {
+        int* counts = &offsets[b * kRadix];
+        for (int i = blockStart(b); i < blockStart(b+1); ++i) {
+          ++counts[(keys[i] >> shift) & (kRadix-1)];
+        }
+      }
+    });
 
+    // ...turn the counts into where each block writes each digit...
+    int offset = 0;
+    for (int digit = 0; digit < kRadix; ++digit) {
+      for (int b = 0; b < numBlocks; ++b) {
+        int count = offsets[b * kRadix + digit];
+        offsets[b * kRadix + digit] = offset;
+        offset += count;
       }
     }
 
-    bool vertexComparator(const vertex_t& a, const vertex_t& b) {
-      if (a.hilbertId != b.hilbertId) {
-        return a.hilbertId < b.hilbertId;
-      } else {
-        return a.id < b.id;
+    // ...and scatter the blocks
+    parallelFor(numBlocks, [&](int startBlock, int endBlock) {
+      for (int b = startBlock; b < endBlock; ++b) {
+        int* next = &offsets[b * kRadix];
+        for (int i = blockStart(b); i < blockStart(b+1); ++i) {
+          int position = next[(keys[i] >> shift) & (kRadix-1)]++;
+          sortedKeys[position] = keys[i];
+          sortedIds[position] = ids[i];
+        }
       }
+    });
+    swap(keys, sortedKeys);
+    swap(ids, sortedIds);
+  }
+}
+
+/// Returns the mapping from old to new indices that sorts elements by `keys`,
+/// keeping the current order of elements with the same key.
+static vector<int> sortByKeys(vector<uint64_t>& keys) {
+  vector<int> ids(keys.size());
+  parallelFor(ids.size(), [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      ids[i] = i;
     }
+  });
+  radixSort(keys, ids);
+  return invertOrdering(ids);
+}
+
+// ---------- Space-Filling Curve Reordering Heuristics ----------
+/// Number of bits per axis of the lattice that vertices are mapped onto, such
+/// that the curve index of a lattice point fits in 64 bits.
+static const unsigned kCurveBits = 21;
+
+/// Spreads the low kCurveBits bits of `x` out to every third bit.
+static uint64_t spreadBits(uint64_t x) {
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffff;
+  x = (x | x << 16) & 0x1f0000ff0000ff;
+  x = (x | x << 8)  & 0x100f00f00f00f00f;
+  x = (x | x << 4)  & 0x10c30c30c30c30c3;
+  x = (x | x << 2)  & 0x1249249249249249;
+  return x;
+}
 
-    static void createIdTranslationMapping(vertex_t * reorderedNodes, 
-        vector<int>& vertexOrdering, int cntNodes) {
-      simit_iassert(vertexOrdering.size() == 0);
-      vertexOrdering.resize(cntNodes);
+/// Maps every vertex onto a lattice with 2^kCurveBits points along each axis,
+/// by scaling the bounding box of the vertices onto it, and computes the index
+/// of the vertex's lattice point along a Hilbert or Morton curve.
+template <typename T>
+static vector<uint64_t> computeCurveKeys(const Set::FieldData* spatialField,
+                                         int numVertices, bool hilbert) {
+  const T* coords = static_cast<const T*>(spatialField->data);
+  size_t elementStride = spatialField->getElementStride();
+  size_t componentStride = spatialField->getComponentStride();
 
-      for (int i = 0; i < cntNodes; ++i) {
-        vertexOrdering[reorderedNodes[i].id] = i;
+  double lower[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+  double upper[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+  mutex boundsMutex;
+  parallelFor(numVertices, [&](int start, int end) {
+    double blockLower[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+    double blockUpper[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+    for (int i = start; i < end; ++i) {
+      for (int d = 0; d < 3; ++d) {
+        double coord = coords[i*elementStride + d*componentStride];
+        blockLower[d] = min(blockLower[d], coord);
+        blockUpper[d] = max(blockUpper[d], coord);
       }
     }
+    lock_guard<mutex> lock(boundsMutex);
+    for (int d = 0; d < 3; ++d) {
+      lower[d] = min(lower[d], blockLower[d]);
+      upper[d] = max(upper[d], blockUpper[d]);
+    }
+  });
+
+  double scale[3];
+  for (int d = 0; d < 3; ++d) {
+    double extent = upper[d] - lower[d];
+    scale[d] = (extent > 0.0) ? ((1 << kCurveBits) - 1) / extent : 0.0;
+  }
 
-    void loadNodes(Set& vertexSet, vertex_t ** outNodes, int numNodes) {
-      vertex_t * nodes = new (nothrow) vertex_t[numNodes];
-      
-      auto& fields = vertexSet.getFields();
-      int fieldIndex = vertexSet.getFieldIndex(vertexSet.getSpatialFieldName());
-      double * spatialData = static_cast<double*>(fields[fieldIndex]->data);  
-     
-      for (int i = 0; i < numNodes; ++i) {
-        nodes[i].id = i; nodes[i].x = spatialData[i*3+0];
-        nodes[i].y = spatialData[i*3+1];
-        nodes[i].z = spatialData[i*3+2];
+  vector<uint64_t> keys(numVertices);
+  parallelFor(numVertices, [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      bitmask_t lattice[3];
+      for (int d = 0; d < 3; ++d) {
+        double coord = coords[i*elementStride + d*componentStride];
+        lattice[d] = (bitmask_t)llround((coord - lower[d]) * scale[d]);
       }
-      
-      *outNodes = nodes;
+      keys[i] = hilbert ? hilbert_c2i(3, kCurveBits, lattice)
+                        : spreadBits(lattice[0]) | spreadBits(lattice[1]) << 1 |
+                          spreadBits(lattice[2]) << 2;
     }
+  });
+  return keys;
+}
+
+static vector<int> curveOrdering(Set& vertexSet, bool hilbert) {
+  simit_uassert(vertexSet.hasSpatialField())
+      << "Vertex Set must have a spatial field set prior to reordering";
+  const Set::FieldData* spatialField =
+      vertexSet.getFields()[vertexSet.getFieldIndex(
+          vertexSet.getSpatialFieldName())];
+  vector<uint64_t> keys;
+  switch (spatialField->type->getComponentType()) {
+    case ComponentType::Double:
+      keys = computeCurveKeys<double>(spatialField, vertexSet.getSize(),
+                                      hilbert);
+      break;
+    case ComponentType::Float:
+      keys = computeCurveKeys<float>(spatialField, vertexSet.getSize(),
+                                     hilbert);
+      break;
+    default:
+      simit_uassert(false) << "The spatial field must be a float or double "
+                           << "field";
+  }
+  return sortByKeys(keys);
+}
 
-    void hilbertReorder(Set& vertexSet, vector<int>& vertexOrdering) {
-      vertex_t * nodes;
-      const int hilbertBits = 8;  int cntNodes = vertexSet.getSize();
-      loadNodes(vertexSet, &nodes, cntNodes);
+// ---------- Reverse Cuthill-McKee Reordering Heuristic ----------
+/// Builds the adjacency lists of the graph where two vertices are adjacent if
+/// an edge of `edgeSet` connects them, with the neighbors of vertex v at
+/// neighbors[offsets[v]:offsets[v+1]].
+static void buildVertexGraph(Set& edgeSet, int numVertices,
+                             vector<int>& offsets, vector<int>& neighbors) {
+  const int* endpoints = edgeSet.getEndpointsPtr();
+  const int numEdges = edgeSet.getSize();
+  const int cardinality = edgeSet.getCardinality();
 
-      assignHilbertIds(nodes, cntNodes, hilbertBits);
-      stable_sort(nodes, nodes + cntNodes, vertexComparator);
-      createIdTranslationMapping(nodes, vertexOrdering, cntNodes);
+  vector<int> degrees(numVertices + 1, 0);
+  for (int e = 0; e < numEdges; ++e) {
+    for (int i = 0; i < cardinality; ++i) {
+      degrees[endpoints[e*cardinality + i] + 1] += cardinality - 1;
     }
-  } // namespace simit::hilbert
- 
-  // ---------- Simit Level Reordering Heuristics ----------
-  int qsortCompare( const void* a, const void* b) {
-       int int_a = * ( (int*) a );
-       int int_b = * ( (int*) b );
-
-       if ( int_a == int_b ) return 0;
-       else if ( int_a < int_b ) return -1;
-       else return 1;
-  } 
-  
-  struct edgeCompare{
-    edgeCompare(int* endpoints, const int cardinality) : endpoints(endpoints),
-      cardinality(cardinality)
-      {}
-    
-    bool operator()(int const&left, int const&right) const {
-      
-      for (int i=0; i < cardinality; ++i) {
-        int leftID = endpoints[left*cardinality + i];
-        int rightID = endpoints[right*cardinality + i];
-        if (leftID != rightID) {
-          return leftID < rightID; }
+  }
+  for (int v = 0; v < numVertices; ++v) {
+    degrees[v+1] += degrees[v];
+  }
+  vector<int> next(degrees.begin(), degrees.end() - 1);
+  vector<int> allNeighbors(degrees.back());
+  for (int e = 0; e < numEdges; ++e) {
+    const int* edge = &endpoints[e*cardinality];
+    for (int i = 0; i < cardinality; ++i) {
+      for (int j = 0; j < cardinality; ++j) {
+        if (i != j) {
+          allNeighbors[next[edge[i]]++] = edge[j];
+        }
       }
-      return true;
     }
-    private:
-      int* endpoints;
-      const int cardinality;
-  };
+  }
 
-  void edgeVertexSortReordering(Set& edgeSet, vector<int>& edgeOrdering) {
-    int* endpoints = edgeSet.getEndpointsPtr();
-    const int size = edgeSet.getSize();
-    const int cardinality = edgeSet.getCardinality();
-    
-    assert(edgeOrdering.size() == 0);
-    edgeOrdering.resize(size);
-    int* sortableEndpoints = static_cast<int *>(malloc(size * cardinality * 
-          sizeof(int)));
-    memcpy(sortableEndpoints, endpoints, size * cardinality * sizeof(int));
-
-    for (int index=0; index < size; ++index) {
-      edgeOrdering[index] = index;
-      qsort(sortableEndpoints+ index*cardinality, cardinality, sizeof(int), 
-          qsortCompare);
-    } 
-    
-    sort(edgeOrdering.begin(), edgeOrdering.end(), 
-        edgeCompare(sortableEndpoints, cardinality));
-    free(sortableEndpoints);
+  // Drop self loops and vertices that several edges connect
+  vector<int> numNeighbors(numVertices);
+  parallelFor(numVertices, [&](int start, int end) {
+    for (int v = start; v < end; ++v) {
+      auto begin = allNeighbors.begin() + degrees[v];
+      auto last = allNeighbors.begin() + degrees[v+1];
+      sort(begin, last);
+      last = unique(begin, last);
+      last = remove(begin, last, v);
+      numNeighbors[v] = last - begin;
+    }
+  });
+  offsets.assign(numVertices + 1, 0);
+  for (int v = 0; v < numVertices; ++v) {
+    offsets[v+1] = offsets[v] + numNeighbors[v];
   }
+  neighbors.resize(offsets.back());
+  parallelFor(numVertices, [&](int start, int end) {
+    for (int v = start; v < end; ++v) {
+      copy(allNeighbors.begin() + degrees[v],
+           allNeighbors.begin() + degrees[v] + numNeighbors[v],
+           neighbors.begin() + offsets[v]);
+    }
+  });
+}
 
-  // ---------- Reordering Helper Functions ----------
-  void reorderFields(vector<Set::FieldData*>& fields, const vector<int>& 
-      ordering) {
-    for (auto f : fields) {
-      switch (f->type->getComponentType()) {
-        case ComponentType::Float: {
-          float* data = static_cast<float *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Double: {
-          double* data = static_cast<double *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Int: {
-          int* data = static_cast<int *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::Boolean: {
-          bool* data = static_cast<bool *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::DoubleComplex: {
-          double_complex* data = static_cast<double_complex *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
-        }
-        case ComponentType::FloatComplex: {
-          float_complex* data = static_cast<float_complex *>(f->data);
-          reorderFieldData(data, ordering, f->sizeOfType);
-          break;
+/// Appends the vertices reachable from `start` that are not yet visited to
+/// `order` in breadth-first order, visiting the neighbors of each vertex by
+/// increasing degree, and returns the position in `order` of the first vertex
+/// of the last level.
+static size_t breadthFirstOrder(int start, const vector<int>& offsets,
+                                const vector<int>& neighbors,
+                                vector<int>& visited, int visitMark,
+                                vector<int>& order) {
+  auto degree = [&](int v) {return offsets[v+1] - offsets[v];};
+  size_t levelStart = order.size();
+  size_t lastLevelStart = levelStart;
+  size_t levelEnd = levelStart + 1;
+  visited[start] = visitMark;
+  order.push_back(start);
+  for (size_t i = levelStart; i < order.size(); ++i) {
+    if (i == levelEnd) {
+      lastLevelStart = levelEnd;
+      levelEnd = order.size();
+    }
+    size_t first = order.size();
+    int v = order[i];
+    for (int j = offsets[v]; j < offsets[v+1]; ++j) {
+      if (visited[neighbors[j]] != visitMark) {
+        visited[neighbors[j]] = visitMark;
+        order.push_back(neighbors[j]);
+      }
+    }
+    stable_sort(order.begin() + first, order.end(), [&](int a, int b) {
+      return degree(a) < degree(b);
+    });
+  }
+  return lastLevelStart;
+}
+
+static vector<int> reverseCuthillMcKeeOrdering(Set& edgeSet, Set& vertexSet) {
+  simit_uassert(edgeSet.getCardinality() > 0)
+      << "Reverse Cuthill-McKee ordering needs an edge set";
+  for (int i = 0; i < edgeSet.getCardinality(); ++i) {
+    simit_uassert(edgeSet.getEndpointSet(i) == &vertexSet)
+        << "Every endpoint of the edge set must be in the vertex set";
+  }
+  const int numVertices = vertexSet.getSize();
+  vector<int> offsets;
+  vector<int> neighbors;
+  buildVertexGraph(edgeSet, numVertices, offsets, neighbors);
+
+  // Each component starts from its vertex of least degree, moved to a vertex
+  // of least degree in the last level of a breadth-first search from it (a
+  // pseudo-peripheral vertex, far from the rest of the component)
+  vector<int> byDegree(numVertices);
+  for (int v = 0; v < numVertices; ++v) {
+    byDegree[v] = v;
+  }
+  stable_sort(byDegree.begin(), byDegree.end(), [&](int a, int b) {
+    return offsets[a+1] - offsets[a] < offsets[b+1] - offsets[b];
+  });
+
+  const int kUnvisited = 0, kProbed = 1, kOrdered = 2;
+  vector<int> visited(numVertices, kUnvisited);
+  vector<int> order;
+  order.reserve(numVertices);
+  vector<int> probe;
+  for (int start : byDegree) {
+    if (visited[start] == kOrdered) {
+      continue;
+    }
+    probe.clear();
+    size_t lastLevel = breadthFirstOrder(start, offsets, neighbors, visited,
+                                         kProbed, probe);
+    int peripheral = probe[lastLevel];
+    for (size_t i = lastLevel; i < probe.size(); ++i) {
+      if (offsets[probe[i]+1] - offsets[probe[i]] <
+          offsets[peripheral+1] - offsets[peripheral]) {
+        peripheral = probe[i];
+      }
+    }
+    breadthFirstOrder(peripheral, offsets, neighbors, visited, kOrdered,
+                      order);
+  }
+  simit_iassert((int)order.size() == numVertices);
+  reverse(order.begin(), order.end());
+  return invertOrdering(order);
+}
+
+// ---------- Edge Reordering Heuristics ----------
+static vector<int> sortedEndpointsOrdering(Set& edgeSet) {
+  const int* endpoints = edgeSet.getEndpointsPtr();
+  const int size = edgeSet.getSize();
+  const int cardinality = edgeSet.getCardinality();
+
+  vector<int> sortedEndpoints(endpoints, endpoints + size*cardinality);
+  parallelFor(size, [&](int start, int end) {
+    for (int e = start; e < end; ++e) {
+      sort(sortedEndpoints.begin() + e*cardinality,
+           sortedEndpoints.begin() + (e+1)*cardinality);
+    }
+  });
+
+  // Edges of up to two endpoints are radix sorted on both at once
+  if (cardinality <= 2) {
+    vector<uint64_t> keys(size);
+    parallelFor(size, [&](int start, int end) {
+      for (int e = start; e < end; ++e) {
+        keys[e] = 0;
+        for (int i = 0; i < cardinality; ++i) {
+          keys[e] = keys[e] << 32 | (uint32_t)sortedEndpoints[e*cardinality+i];
         }
       }
+    });
+    return sortByKeys(keys);
+  }
+
+  vector<int> edges(size);
+  for (int e = 0; e < size; ++e) {
+    edges[e] = e;
+  }
+  sort(edges.begin(), edges.end(), [&](int left, int right) {
+    for (int i = 0; i < cardinality; ++i) {
+      int leftID = sortedEndpoints[left*cardinality + i];
+      int rightID = sortedEndpoints[right*cardinality + i];
+      if (leftID != rightID) {
+        return leftID < rightID;
+      }
+    }
+    return left < right;
+  });
+  return invertOrdering(edges);
+}
+
+static vector<int> minEndpointOrdering(Set& edgeSet) {
+  const int* endpoints = edgeSet.getEndpointsPtr();
+  const int cardinality = edgeSet.getCardinality();
+  vector<uint64_t> keys(edgeSet.getSize());
+  parallelFor(keys.size(), [&](int start, int end) {
+    for (int e = start; e < end; ++e) {
+      keys[e] = *min_element(endpoints + e*cardinality,
+                             endpoints + (e+1)*cardinality);
     }
+  });
+  return sortByKeys(keys);
+}
+
+void computeVertexOrdering(Set& edgeSet, Set& vertexSet,
+    VertexOrderingHeuristic heuristic, vector<int>& vertexOrdering) {
+  switch (heuristic) {
+    case HilbertOrder:
+      vertexOrdering = curveOrdering(vertexSet, true);
+      break;
+    case MortonOrder:
+      vertexOrdering = curveOrdering(vertexSet, false);
+      break;
+    case ReverseCuthillMcKeeOrder:
+      vertexOrdering = reverseCuthillMcKeeOrdering(edgeSet, vertexSet);
+      break;
+  }
+}
+
+void computeEdgeOrdering(Set& edgeSet, EdgeOrderingHeuristic heuristic,
+    vector<int>& edgeOrdering) {
+  simit_uassert(edgeSet.getCardinality() > 0)
+      << "Only edge sets have an edge ordering";
+  switch (heuristic) {
+    case SortedEndpointsOrder:
+      edgeOrdering = sortedEndpointsOrdering(edgeSet);
+      break;
+    case MinEndpointOrder:
+      edgeOrdering = minEndpointOrdering(edgeSet);
+      break;
   }
-  
-  void reorderEdgeSet(Set& edgeSet, const vector<int>& edgeOrdering) {
-    simit_iassert(edgeOrdering.size() == (unsigned int) edgeSet.getSize()) << "Edge \
-      Mapping must be the same size as the edge set" << edgeOrdering.size() <<
-      " != " << edgeSet.getSize(); int* endpoints = edgeSet.getEndpointsPtr();
-    const unsigned int size = edgeSet.getSize();
-    const int cardinality = edgeSet.getCardinality();
-
-    int* newEndpoints = static_cast<int *>(malloc(size * cardinality * 
-          sizeof(int)));
-    memcpy(newEndpoints, endpoints, size * cardinality * sizeof(int));
-
-    for (unsigned int edgeIndex=0; edgeIndex < size; ++edgeIndex) {
-      simit_iassert(edgeIndex < edgeOrdering.size());
-      simit_iassert(edgeOrdering[edgeIndex] < (int) ((size - 1) * cardinality * 
-            sizeof(int)));
-      memcpy(newEndpoints + edgeIndex * cardinality, endpoints + 
-          edgeOrdering[edgeIndex] * cardinality, cardinality * sizeof(int));
+}
+
+// ---------- Reordering Helper Functions ----------
+/// Moves each element i of `data`, made of `numArrays` arrays of elements of
+/// `elementSize` bytes spaced `arrayStride` elements apart, to `ordering[i]`.
+/// `scratch` holds at least numElements*numArrays*elementSize bytes.
+static void permute(char* data, int numElements, size_t elementSize,
+                    size_t numArrays, size_t arrayStride,
+                    const vector<int>& inverseOrdering, char* scratch) {
+  parallelFor(numElements, [&](int start, int end) {
+    for (size_t a = 0; a < numArrays; ++a) {
+      char* array = data + a*arrayStride*elementSize;
+      char* scratchArray = scratch + a*numElements*elementSize;
+      for (int i = start; i < end; ++i) {
+        memcpy(scratchArray + i*elementSize,
+               array + inverseOrdering[i]*elementSize, elementSize);
+      }
     }
-    memcpy(endpoints, newEndpoints, size * cardinality * sizeof(int));
-    free(newEndpoints);
-    
-    reorderFields(edgeSet.getFields(), edgeOrdering);
+  });
+  parallelFor(numElements, [&](int start, int end) {
+    for (size_t a = 0; a < numArrays; ++a) {
+      memcpy(data + (a*arrayStride + start)*elementSize,
+             scratch + (a*numElements + start)*elementSize,
+             (end-start)*elementSize);
+    }
+  });
+}
+
+/// Permutes the fields of `set`, and its endpoints if `withEndpoints`, from
+/// old to new indices, sharing one scratch buffer across them. Reordered sets
+/// keep their element ids, and so do other sets if `keepIds`.
+static void reorderElements(Set& set, const vector<int>& ordering,
+                            bool withEndpoints, bool keepIds=false) {
+  const int size = set.getSize();
+  const vector<int> inverseOrdering = invertOrdering(ordering);
+  size_t endpointsSize = set.getCardinality() * sizeof(int);
+
+  size_t scratchSize = withEndpoints ? endpointsSize : 0;
+  for (auto f : set.getFields()) {
+    scratchSize = max(scratchSize, f->sizeOfType);
   }
+  unique_ptr<char[]> scratch(new char[size * scratchSize]);
+
+  if (withEndpoints) {
+    permute((char*)set.getEndpointsPtr(), size, endpointsSize, 1, 0,
+            inverseOrdering, scratch.get());
+  }
+  for (auto f : set.getFields()) {
+    size_t numArrays = f->getNumArrays();
+    permute((char*)f->data, size, f->sizeOfType/numArrays, numArrays,
+            set.getCapacity(), inverseOrdering, scratch.get());
+  }
+  if (keepIds || set.isReordered()) {
+    set.permuteElementIndices(ordering);
+  }
+  set.invalidateIndices();
+}
+
+/// Translates the endpoints of `edgeSet` that are elements of `endpointSet`
+/// from old to new indices.
+static void remapEndpoints(Set& edgeSet, const Set& endpointSet,
+                           const vector<int>& ordering) {
+  const int cardinality = edgeSet.getCardinality();
+  vector<bool> remapped(cardinality);
+  for (int i = 0; i < cardinality; ++i) {
+    remapped[i] = (edgeSet.getEndpointSet(i) == &endpointSet);
+  }
+  int* endpoints = edgeSet.getEndpointsPtr();
+  parallelFor(edgeSet.getSize(), [&](int start, int end) {
+    for (int e = start; e < end; ++e) {
+      for (int i = 0; i < cardinality; ++i) {
+        if (remapped[i]) {
+          endpoints[e*cardinality + i] = ordering[endpoints[e*cardinality + i]];
+        }
+      }
+    }
+  });
+  edgeSet.invalidateIndices();
+}
+
+void reorderEdgeSet(Set& edgeSet, const vector<int>& edgeOrdering) {
+  simit_iassert(edgeOrdering.size() == (unsigned int) edgeSet.getSize())
+      << "Edge Mapping must be the same size as the edge set"
+      << edgeOrdering.size() << " != " << edgeSet.getSize();
+  reorderElements(edgeSet, edgeOrdering, true);
+  edgeSet.invalidateIndices();
+}
+
+void reorderEdgeSetByVertexOrdering(Set& edgeSet, const vector<int>&
+    vertexOrdering) {
+  int* endpoints = edgeSet.getEndpointsPtr();
+  parallelFor(edgeSet.getSize() * edgeSet.getCardinality(),
+              [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      endpoints[i] = vertexOrdering[endpoints[i]];
+    }
+  });
+  edgeSet.invalidateIndices();
+}
+
+void reorderVertexSet(Set& edgeSet, Set& vertexSet, vector<int>&
+    vertexOrdering) {
+  simit_iassert(vertexOrdering.size() == (unsigned int) vertexSet.getSize())
+      << "Vertex Mapping must be the same size as the vertex set"
+      << vertexOrdering.size() << " != " << vertexSet.getSize();
+  // Vertex ordering maps old to new identity, so the endpoints are translated
+  // from old to new
+  reorderEdgeSetByVertexOrdering(edgeSet, vertexOrdering);
+  reorderElements(vertexSet, vertexOrdering, false);
+}
+
+void reorder(Set& edgeSet, Set& vertexSet,
+    VertexOrderingHeuristic vertexHeuristic,
+    EdgeOrderingHeuristic edgeHeuristic, vector<int>& edgeOrdering,
+    vector<int>& vertexOrdering) {
+  computeVertexOrdering(edgeSet, vertexSet, vertexHeuristic, vertexOrdering);
+  reorderVertexSet(edgeSet, vertexSet, vertexOrdering);
 
-  void reorderEdgeSetByVertexOrdering(Set& edgeSet, const vector<int>& 
-      vertexOrdering) {
-    for (int i=0; i < edgeSet.getSize() * edgeSet.getCardinality(); ++i) {
-      edgeSet.getEndpointsPtr()[i] = 
-        vertexOrdering[edgeSet.getEndpointsPtr()[i]]; }
+  computeEdgeOrdering(edgeSet, edgeHeuristic, edgeOrdering);
+  reorderEdgeSet(edgeSet, edgeOrdering);
+}
+
+void reorderForLocality(const vector<Set*>& boundSets) {
+  // A set may be bound to several arguments and externs
+  vector<Set*> sets;
+  for (Set* set : boundSets) {
+    if (find(sets.begin(), sets.end(), set) == sets.end()) {
+      sets.push_back(set);
+    }
   }
-    
-  void reorderVertexSet(Set& edgeSet, Set& vertexSet, vector<int>& 
-      vertexOrdering) {
-    simit_iassert(vertexOrdering.size() == (unsigned int) vertexSet.getSize()) << 
-      "Vertex Mapping must be the same size as the vertex set" << 
-      vertexOrdering.size() << " != " << vertexSet.getSize(); 
-    // Reset Endpoints to reflect reordering
-    // Vertex ordering maps old to new identity This itertates over all enpoints 
-    // translating from old to new
-    reorderEdgeSetByVertexOrdering(edgeSet, vertexOrdering); 
-
-    simit_iassert(vertexOrdering.size() == (unsigned int) vertexSet.getSize()) << 
-      vertexOrdering.size() << ", " << vertexSet.getSize();
-    reorderFields(vertexSet.getFields(), vertexOrdering);
+
+  // Grid edge sets, and their points, are addressed by grid coordinates, also
+  // when the grid edge set is not bound
+  std::set<const Set*> excluded;
+  for (Set* set : sets) {
+    if (set->getKind() == Set::Grid) {
+      excluded.insert(set);
+      excluded.insert(set->getEndpointSet(0));
+    }
+    for (Set* edgeSet : set->getEdgeSets()) {
+      if (edgeSet->getKind() == Set::Grid) {
+        excluded.insert(set);
+      }
+    }
   }
-  
-  void reorder(Set& edgeSet, Set& vertexSet, vector<int>& edgeOrdering, 
-      vector<int>& vertexOrdering) {
-    simit_iassert(vertexSet.hasSpatialField()) << "Vertex Set must have a spatial \
-      field set prior to reordering";
-    vertexOrdering.clear();
-    edgeOrdering.clear();
-    
-    // Get new vertex ordering based on given heuristic 
-    hilbert::hilbertReorder(vertexSet, vertexOrdering);
-    reorderVertexSet(edgeSet, vertexSet, vertexOrdering);
-
-    // Get new edge ordering based on given heuristic 
-    edgeVertexSortReordering(edgeSet, edgeOrdering); reorderEdgeSet(edgeSet, 
-        edgeOrdering);
+
+  // Order the sets so that each set comes after its endpoint sets, as edge
+  // orderings are computed from the new indices of the endpoints
+  vector<Set*> ordered;
+  std::set<const Set*> remaining(sets.begin(), sets.end());
+  while (!remaining.empty()) {
+    for (Set* set : sets) {
+      if (remaining.count(set) == 0) continue;
+      bool ready = true;
+      for (int i = 0; i < set->getCardinality(); ++i) {
+        ready = ready && (remaining.count(set->getEndpointSet(i)) == 0);
+      }
+      if (ready) {
+        ordered.push_back(set);
+        remaining.erase(set);
+      }
+    }
   }
-  
-  void reorder(Set& edgeSet, Set& vertexSet) {
-    vector<int> vertexOrdering;
-    vector<int> edgeOrdering;
-    reorder(edgeSet, vertexSet, edgeOrdering, vertexOrdering);
+
+  for (Set* set : ordered) {
+    if (excluded.count(set) > 0 || set->isReordered() || set->getSize() < 2) {
+      continue;
+    }
+
+    vector<int> ordering;
+    if (set->getCardinality() > 0) {
+      computeEdgeOrdering(*set, SortedEndpointsOrder, ordering);
+    }
+    else if (set->hasSpatialField()) {
+      ordering = curveOrdering(*set, true);
+    }
+    else {
+      // Order the vertices by the largest edge set that connects only them
+      Set* edgeSet = nullptr;
+      for (Set* candidate : sets) {
+        bool connects = candidate->getCardinality() > 0;
+        for (int i = 0; i < candidate->getCardinality(); ++i) {
+          connects = connects && (candidate->getEndpointSet(i) == set);
+        }
+        if (connects &&
+            (edgeSet == nullptr || candidate->getSize() > edgeSet->getSize())) {
+          edgeSet = candidate;
+        }
+      }
+      if (edgeSet == nullptr) continue;
+      ordering = reverseCuthillMcKeeOrdering(*edgeSet, *set);
+    }
+
+    // Edge sets over the set are remapped whether they are bound or not, as
+    // other functions may bind them
+    reorderElements(*set, ordering, set->getCardinality() > 0, true);
+    for (Set* edgeSet : set->getEdgeSets()) {
+      remapEndpoints(*edgeSet, *set, ordering);
+    }
   }
 }
+
+void reorder(Set& edgeSet, Set& vertexSet, vector<int>& edgeOrdering,
+    vector<int>& vertexOrdering) {
+  reorder(edgeSet, vertexSet, HilbertOrder, SortedEndpointsOrder,
+          edgeOrdering, vertexOrdering);
+}
+
+void reorder(Set& edgeSet, Set& vertexSet) {
+  vector<int> vertexOrdering;
+  vector<int> edgeOrdering;
+  reorder(edgeSet, vertexSet, edgeOrdering, vertexOrdering);
+}
+}
@@ -8,73 +8,80 @@
 #include <iostream>
 #include <fstream>
 
-namespace simit { 
+namespace simit {
+  /// Heuristics that order the vertices of a set for locality.
+  enum VertexOrderingHeuristic {
+    /// Along a 3D Hilbert curve through the spatial field of the vertex set.
+    HilbertOrder,
+    /// Along a 3D Morton (Z-order) curve through the spatial field of the
+    /// vertex set. Cheaper to compute than a Hilbert curve, with somewhat
+    /// worse locality.
+    MortonOrder,
+    /// Reverse Cuthill-McKee on the graph whose vertices are adjacent if an
+    /// edge connects them. Needs no spatial field, and minimizes the bandwidth
+    /// of the matrices assembled on the edges.
+    ReverseCuthillMcKeeOrder
+  };
+
+  /// Heuristics that order the edges of an edge set.
+  enum EdgeOrderingHeuristic {
+    /// Lexicographically by the sorted endpoints of each edge.
+    SortedEndpointsOrder,
+    /// By the smallest endpoint of each edge, keeping the current order of
+    /// edges with the same smallest endpoint. Cheaper than SortedEndpointsOrder.
+    MinEndpointOrder
+  };
+
   /// Reorders edge set and vertex set by hilbert reordering of the vertex set.
   /// Vertex set must have a set spatial field in 3 dimensions.
   void reorder(Set& edgeSet, Set& vertexSet);
 
   /// Reorders edge set and vertex set by hilbert reordering of the vertex set.
   /// Vertex set must have a set spatial field in 3 dimensions.
-  /// The supplied edge and vertex ordering vectors are populated with the new 
-  /// mapping from old to new indices. 
-  void reorder(Set& edgeSet, Set& vertexSet, std::vector<int>& edgeOrdering, 
+  /// The supplied edge and vertex ordering vectors are populated with the new
+  /// mapping from old to new indices.
+  void reorder(Set& edgeSet, Set& vertexSet, std::vector<int>& edgeOrdering,
       std::vector<int>& vertexOrdering);
-  
-  /// Reorders edge set and vertex set by the supplied vertex ordering map.
-  void reorderVertexSet(Set& edgeSet, Set& vertexSet, std::vector<int>& 
-      vertexOrdering);
-  
-  /// Reorders edge set by the supplied edge ordering map.
-  void reorderEdgeSet(Set& edgeSet, const std::vector<int>& edgeOrdering);
-
-  /// Reorders edge set by the supplied vertex ordering map.
-  void reorderEdgeSetByVertexOrdering(Set& edgeSet, const std::vector<int>& 
-      vertexOrdering);
 
- 
-  template<typename T>
-  void reorderFieldData(T* data, const std::vector<int>& vertexOrdering, const 
-      int typeSize) {
-    const int capacity = vertexOrdering.size(); T* newData = 
-      static_cast<T*>(malloc(capacity * typeSize));
-    int dim = typeSize/sizeof(T);
-    assert(dim > 0);
-    for (int i=0; i < capacity; ++i) {
-      for (int x=0; x < dim; ++x) {
-        assert(vertexOrdering[i]*dim + x < capacity * dim);
-        newData[vertexOrdering[i]*dim+x] = data[i*dim+x];
-      }
-    }
-
-    memcpy(data, newData, capacity * typeSize); free(newData);
-  }
+  /// Reorders the vertex set with `vertexHeuristic`, and then the edge set
+  /// with `edgeHeuristic`. The supplied edge and vertex ordering vectors are
+  /// populated with the mapping from old to new indices.
+  void reorder(Set& edgeSet, Set& vertexSet,
+      VertexOrderingHeuristic vertexHeuristic,
+      EdgeOrderingHeuristic edgeHeuristic, std::vector<int>& edgeOrdering,
+      std::vector<int>& vertexOrdering);
 
-  namespace hilbert {
-    
-    typedef uint64_t vid_t;  // vertex id type
+  /// Computes an ordering of the vertex set from old to new indices, without
+  /// reordering it. The edge set is only used by ReverseCuthillMcKeeOrder.
+  void computeVertexOrdering(Set& edgeSet, Set& vertexSet,
+      VertexOrderingHeuristic heuristic, std::vector<int>& vertexOrdering);
 
-    struct edges_t {
-      vid_t cntEdges;
-      vid_t * edges;
-    };
-    typedef struct edges_t edges_t;
+  /// Computes an ordering of the edge set from old to new indices, without
+  /// reordering it.
+  void computeEdgeOrdering(Set& edgeSet,
+      EdgeOrderingHeuristic heuristic, std::vector<int>& edgeOrdering);
 
-    struct vertex_t {
-      vid_t id;
-      vid_t hilbertId;
-      double x;
-      double y;
-      double z;
-      void * data;
-      edges_t edgeData;
-    };
-    typedef struct vertex_t vertex_t;
+  /// Reorders the sets for locality while keeping their element ids, so that
+  /// ElementRefs and FieldRefs address the same elements as before (see
+  /// Set::isReordered). Vertex sets with a spatial field are ordered along a
+  /// Hilbert curve and other vertex sets by reverse Cuthill-McKee on the
+  /// largest of the sets that connects only them; edge sets are ordered by
+  /// their sorted endpoints. The endpoints of every edge set over a reordered
+  /// set are remapped, including edge sets that are not among `sets`. Sets
+  /// that are already reordered are left as they are, and grid edge sets and
+  /// their points are never reordered. Function::init calls this on the bound
+  /// sets if Settings::reorder is set.
+  void reorderForLocality(const std::vector<Set*>& sets);
 
-    typedef std::pair<vid_t, vid_t> edge_t;
+  /// Reorders edge set and vertex set by the supplied vertex ordering map.
+  void reorderVertexSet(Set& edgeSet, Set& vertexSet, std::vector<int>&
+      vertexOrdering);
 
-    void hilbertReorder(Set& vertexSet, std::vector<int>& vertexOrdering, int 
-        vertexCount);
-  } // namespace simit::hilbert
+  /// Reorders edge set by the supplied edge ordering map.
+  void reorderEdgeSet(Set& edgeSet, const std::vector<int>& edgeOrdering);
 
-} // namespace simit 
+  /// Reorders edge set by the supplied vertex ordering map.
+  void reorderEdgeSetByVertexOrdering(Set& edgeSet, const std::vector<int>&
+      vertexOrdering);
+} // namespace simit
 #endif
@@ -0,0 +1,331 @@
+#include "reuse_buffers.h"
+
+#include <algorithm>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ir.h"
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
+
+using namespace std;
+
+namespace simit {
+namespace ir {
+
+/// The statements from the first to the last access of a variable.
+struct Lifetime {
+  int start = -1;
+  int end = -1;
+
+  /// The position of the variable's declaration, and the scope it is declared
+  /// in (nullptr for the function body).
+  int declaration = -1;
+  const Scope* scope = nullptr;
+  int numDeclarations = 0;
+
+  /// Whether the variable is declared in a set loop.
+  bool inSetLoop = false;
+};
+
+/// Numbers the statements of a function body in program order and computes the
+/// lifetime of every variable. All accesses in a statement that is not a block
+/// or a loop happen at the same position, so the variables it accesses are
+/// alive at the same time.
+class ComputeLifetimes : public IRVisitor {
+public:
+  map<Var,Lifetime> lifetimes;
+
+  using IRVisitor::visit;
+
+  void visit(const Block* op) {
+    ++position;
+    op->first.accept(this);
+    if (op->rest.defined()) {
+      op->rest.accept(this);
+    }
+  }
+
+  void visit(const Scope* op) {
+    scopes.push_back(op);
+    IRVisitor::visit(op);
+    scopes.pop_back();
+  }
+
+  void visit(const VarDecl* op) {
+    Lifetime& lifetime = lifetimes[op->var];
+    lifetime.declaration = position;
+    lifetime.scope = scopes.empty() ? nullptr : scopes.back();
+    lifetime.numDeclarations++;
+    lifetime.inSetLoop = (numSetLoops > 0);
+    if (!loops.empty()) {
+      loops.back().declared.insert(op->var);
+    }
+    access(op->var);
+  }
+
+  void visit(const VarExpr* op) {
+    access(op->var);
+  }
+
+  void visit(const AssignStmt* op) {
+    IRVisitor::visit(op);
+    access(op->var);
+  }
+
+  void visit(const CallStmt* op) {
+    IRVisitor::visit(op);
+    for (const Var& result : op->results) {
+      access(result);
+    }
+  }
+
+  void visit(const Map* op) {
+    IRVisitor::visit(op);
+    for (const Var& var : op->vars) {
+      access(var);
+    }
+  }
+
+  void visit(const ForRange* op) {
+    enterLoop();
+    IRVisitor::visit(op);
+    exitLoop();
+  }
+
+  void visit(const For* op) {
+    enterLoop();
+    numSetLoops++;
+    IRVisitor::visit(op);
+    numSetLoops--;
+    exitLoop();
+  }
+
+  void visit(const While* op) {
+    enterLoop();
+    IRVisitor::visit(op);
+    exitLoop();
+  }
+
+private:
+  /// The variables accessed and declared in a loop that is being visited.
+  struct Loop {
+    int start;
+    set<Var> accessed;
+    set<Var> declared;
+  };
+
+  int position = 0;
+  vector<const Scope*> scopes;
+  vector<Loop> loops;
+  int numSetLoops = 0;
+
+  void access(const Var& var) {
+    Lifetime& lifetime = lifetimes[var];
+    if (lifetime.start == -1) {
+      lifetime.start = position;
+    }
+    lifetime.end = position;
+    if (!loops.empty()) {
+      loops.back().accessed.insert(var);
+    }
+  }
+
+  void enterLoop() {
+    ++position;
+    loops.push_back(Loop());
+    loops.back().start = position;
+  }
+
+  /// Variables that live across iterations of the loop, because they are
+  /// declared outside it, live for the whole loop.
+  void exitLoop() {
+    ++position;
+    Loop loop = loops.back();
+    loops.pop_back();
+    for (const Var& var : loop.accessed) {
+      if (loop.declared.find(var) == loop.declared.end()) {
+        Lifetime& lifetime = lifetimes[var];
+        lifetime.start = min(lifetime.start, loop.start);
+        lifetime.end = max(lifetime.end, position);
+      }
+    }
+    if (!loops.empty()) {
+      loops.back().accessed.insert(loop.accessed.begin(), loop.accessed.end());
+      loops.back().declared.insert(loop.declared.begin(), loop.declared.end());
+    }
+  }
+};
+
+/// Replaces variables by the variables whose buffers they reuse, and removes
+/// their declarations.
+class ReplaceBuffers : public IRRewriter {
+public:
+  ReplaceBuffers(const map<Var,Var>& replacements)
+      : replacements(replacements) {}
+
+  using IRRewriter::visit;
+
+private:
+  const map<Var,Var>& replacements;
+
+  Var replace(const Var& var) {
+    auto replacement = replacements.find(var);
+    return (replacement != replacements.end()) ? replacement->second : var;
+  }
+
+  void visit(const VarDecl* op) {
+    if (replacements.find(op->var) != replacements.end()) {
+      stmt = Stmt();
+    }
+    else {
+      stmt = op;
+    }
+  }
+
+  void visit(const VarExpr* op) {
+    Var var = replace(op->var);
+    expr = (var == op->var) ? Expr(op) : VarExpr::make(var);
+  }
+
+  void visit(const AssignStmt* op) {
+    Expr value = rewrite(op->value);
+    stmt = AssignStmt::make(replace(op->var), value, op->cop);
+  }
+
+  void visit(const CallStmt* op) {
+    vector<Var> results;
+    for (const Var& result : op->results) {
+      results.push_back(replace(result));
+    }
+    vector<Expr> actuals;
+    for (const Expr& actual : op->actuals) {
+      actuals.push_back(rewrite(actual));
+    }
+    stmt = CallStmt::make(results, op->callee, actuals);
+  }
+};
+
+/// The size of a tensor as a sum of the products of the sizes of the sets its
+/// dimensions range over, scaled by a number of bytes.
+typedef map<string,long> Bytes;
+
+static void addBytes(Bytes* bytes, const TensorType* type) {
+  long factor = type->getComponentType().bytes();
+  vector<string> sets;
+  for (const IndexDomain& dimension : type->getDimensions()) {
+    for (const IndexSet& indexSet : dimension.getIndexSets()) {
+      switch (indexSet.getKind()) {
+        case IndexSet::Range:
+          factor *= indexSet.getSize();
+          break;
+        case IndexSet::Set: {
+          stringstream ss;
+          ss << indexSet;
+          sets.push_back(ss.str());
+          break;
+        }
+        case IndexSet::Dynamic:
+          sets.push_back("n");
+          break;
+        case IndexSet::Single:
+          break;
+      }
+    }
+  }
+  sort(sets.begin(), sets.end());
+  string term;
+  for (const string& set : sets) {
+    term += (term.empty() ? "" : "*") + set;
+  }
+  (*bytes)[term] += factor;
+}
+
+static string toString(const Bytes& bytes) {
+  string result;
+  for (auto& term : bytes) {
+    result += result.empty() ? "" : " + ";
+    result += to_string(term.second) + (term.first.empty() ? "" : "*") +
+              term.first;
+  }
+  return result;
+}
+
+Func reuseBuffers(Func func) {
+  ComputeLifetimes computeLifetimes;
+  func.getBody().accept(&computeLifetimes);
+
+  // Dense tensors declared once, outside set loops, before their first access
+  vector<pair<Lifetime,Var>> tensors;
+  for (auto& var : computeLifetimes.lifetimes) {
+    const Lifetime& lifetime = var.second;
+    Type type = var.first.getType();
+    if (!type.isTensor() || isScalar(type) ||
+        !func.getStorage().hasStorage(var.first) ||
+        func.getStorage().getStorage(var.first).getKind() !=
+            TensorStorage::Dense ||
+        lifetime.numDeclarations != 1 || lifetime.inSetLoop ||
+        lifetime.declaration != lifetime.start) {
+      continue;
+    }
+    tensors.push_back({lifetime, var.first});
+  }
+  sort(tensors.begin(), tensors.end(),
+       [](const pair<Lifetime,Var>& a, const pair<Lifetime,Var>& b) {
+         return a.first.start < b.first.start;
+       });
+
+  // Assign tensors to buffers in the order their lifetimes start. A tensor
+  // reuses the compatible buffer that was freed most recently.
+  struct Buffer {
+    Var var;
+    const Scope* scope;
+    int end;
+  };
+  vector<Buffer> buffers;
+  map<Var,Var> replacements;
+  Bytes before, after;
+  for (auto& tensor : tensors) {
+    const Lifetime& lifetime = tensor.first;
+    const Var& var = tensor.second;
+    const TensorType* type = var.getType().toTensor();
+    addBytes(&before, type);
+
+    Buffer* reused = nullptr;
+    for (Buffer& buffer : buffers) {
+      const TensorType* bufferType = buffer.var.getType().toTensor();
+      if (buffer.end < lifetime.start && buffer.scope == lifetime.scope &&
+          buffer.var.getType() == var.getType() &&
+          bufferType->isColumnVector == type->isColumnVector &&
+          (reused == nullptr || buffer.end > reused->end)) {
+        reused = &buffer;
+      }
+    }
+
+    if (reused != nullptr) {
+      replacements[var] = reused->var;
+      reused->end = lifetime.end;
+    }
+    else {
+      buffers.push_back({var, lifetime.scope, lifetime.end});
+      addBytes(&after, type);
+    }
+  }
+
+  if (replacements.size() == 0) {
+    return func;
+  }
+
+  Stmt body = ReplaceBuffers(replacements).rewrite(func.getBody());
+  stringstream comment;
+  comment << "Temporary buffers: " << tensors.size() << " tensors in "
+          << buffers.size() << " buffers, " << toString(after)
+          << " bytes (was " << toString(before) << " bytes)";
+  body = Comment::make(comment.str(), body);
+  return Func(func, body);
+}
+
+}}
@@ -0,0 +1,24 @@
+#ifndef SIMIT_REUSE_BUFFERS_H
+#define SIMIT_REUSE_BUFFERS_H
+
+#include "func.h"
+
+namespace simit {
+namespace ir {
+
+/// Store dense tensors whose lifetimes do not overlap in the same buffer. The
+/// backend gives every tensor declared in a function its own buffer for the
+/// lifetime of the function, so a long function with many vector temporaries
+/// holds many set-sized buffers. A tensor lives from its first to its last
+/// access, extended to the whole of every loop that accesses it but does not
+/// declare it. Tensors of the same type declared in the same scope are packed
+/// into shared buffers like registers, by replacing the tensors that reuse a
+/// buffer with the tensor that first used it. A buffer is preferably reused by
+/// the tensor after the one that used it last, while it is still in cache.
+/// Tensors declared in set loops, which get one copy per thread if the loop
+/// runs in parallel, are left alone. If any buffer is shared the body is
+/// annotated with the buffer memory before and after.
+Func reuseBuffers(Func func);
+
+}}
+#endif
@@ -2,10 +2,17 @@
 
 #include <cmath>
 #include <time.h>
+#include <algorithm>
 #include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
 #include <vector>
 
+#include "allocator.h"
 #include "timers.h"
+#include "init.h"
+#include "util/thread_pool.h"
 #include "stdio.h"
 
 #ifdef EIGEN
@@ -22,6 +29,21 @@ int loc(int v0, int v1, int *neighbors_start, int *neighbors) {
   return l;
 }
 
+int sortedLoc(int v0, int v1, int *neighbors_start, int *neighbors) {
+  int lo = neighbors_start[v0];
+  int hi = neighbors_start[v0+1];
+  while (lo < hi) {
+    int mid = lo + (hi-lo)/2;
+    if (neighbors[mid] < v1) {
+      lo = mid+1;
+    }
+    else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
 double atan2_f64(double y, double x) {
   return atan2(y, x);
 }
@@ -295,59 +317,308 @@ float complexNorm_f32(float r, float i) {
 }
 
 void storeTime(int i, double value) {
-  simit::ir::TimerStorage::getInstance().storeTime(i, value);
+  simit::ir::Profiler::getInstance().storeTime(i, value);
 }
 
+/// Returns the time in microseconds, with nanosecond resolution.
 double simitClock() {
   using namespace std::chrono;
-  auto t = high_resolution_clock::now();
-  time_point<high_resolution_clock,microseconds> usec = time_point_cast<microseconds>(t);
-  return (double)(usec.time_since_epoch().count());
+  auto t = steady_clock::now().time_since_epoch();
+  return duration_cast<nanoseconds>(t).count() / 1000.0;
+}
+
+void simitProfileBegin(int region) {
+  simit::ir::Profiler::getInstance().begin(region);
+}
+
+void simitProfileEnd(int region) {
+  simit::ir::Profiler::getInstance().end(region);
+}
+
+/// Runs `body` over [0, n) on the thread pool. Generated code outlines the
+/// bodies of parallel loops into functions with this signature, and passes
+/// the values they capture from the enclosing function in `closure`.
+void simitParallelFor(int n, void (*body)(int,int,void*), void *closure) {
+  simit::util::ThreadPool::getInstance().parallelFor(n, simit::kNumThreads,
+      [body, closure](int start, int end) {
+    body(start, end, closure);
+  });
+}
+
+/// Serializes the workers of parallel loops that combine their partial results
+/// of reductions into the reduction variables.
+static std::mutex reductionsMutex;
+
+void simitLockReductions() {
+  reductionsMutex.lock();
+}
+
+void simitUnlockReductions() {
+  reductionsMutex.unlock();
+}
+
+/// Allocates and frees the buffers of the dense tensors that generated code
+/// keeps in global storage, through the installed simit::Allocator.
+void* simitAllocate(int size) {
+  return simit::internal::allocateBuffer(size, 1);
+}
+
+void simitFree(void* buffer, int size) {
+  simit::internal::freeBuffer(buffer, size);
 }
 } // extern "C"
 
 
-/// Temporary external spmm implementation until Simit supports assembling
-/// matrix indices during computation.
+// Sparse matrix-matrix products that work directly on Simit's blocked CSR
+// matrices. A product is computed in two phases: a symbolic phase that
+// computes the structure of the result, and a numeric phase that computes its
+// values. Each call site of spmm keeps the structure and the values buffer of
+// its last result, so the symbolic phase only reruns when the structure of an
+// operand changes, and the result is not reallocated every call. The result
+// matrices are owned by their call sites, and generated code does not free
+// them. Instead the de-initialization function of the compiled function frees
+// its call sites with simitFreeSpmmSite.
+namespace {
+
+/// The state of a call site of spmm.
+struct SpmmSite {
+  /// Copies of the structures of the operands of the last product.
+  std::vector<int> Browptr, Bcolidx, Crowptr, Ccolidx;
+
+  /// The structure and values of the last result.
+  int* rowptr = nullptr;
+  int* colidx = nullptr;
+  void* vals = nullptr;
+  size_t valsSize = 0;
+};
+
+std::mutex spmmSitesMutex;
+std::map<int, SpmmSite> spmmSites;
+
+/// Returns true if the structure of a matrix with `numBlockRows` block rows
+/// equals the structure copied into `rowptrCopy` and `colidxCopy`.
+bool sameStructure(int numBlockRows, const int* rowptr, const int* colidx,
+                   const std::vector<int>& rowptrCopy,
+                   const std::vector<int>& colidxCopy) {
+  int nnz = rowptr[numBlockRows];
+  return (int)rowptrCopy.size() == numBlockRows+1 &&
+         (int)colidxCopy.size() == nnz &&
+         std::equal(rowptr, rowptr+numBlockRows+1, rowptrCopy.begin()) &&
+         std::equal(colidx, colidx+nnz, colidxCopy.begin());
+}
+
+/// Computes the structure of B*C, where B has `numBlockRows` block rows and C
+/// has `numBlockCols` block columns. The columns of each row are sorted.
+void spmmSymbolic(int numBlockRows, int numBlockCols,
+                  const int* Browptr, const int* Bcolidx,
+                  const int* Crowptr, const int* Ccolidx,
+                  int** rowptr, int** colidx) {
+  *rowptr = static_cast<int*>(
+      simit::ffi::simit_malloc((numBlockRows+1) * sizeof(int)));
+
+  // The last row in which each column was seen
+  std::vector<int> seen(numBlockCols, -1);
+  (*rowptr)[0] = 0;
+  for (int i = 0; i < numBlockRows; ++i) {
+    int rowSize = 0;
+    for (int ik = Browptr[i]; ik < Browptr[i+1]; ++ik) {
+      int k = Bcolidx[ik];
+      for (int kj = Crowptr[k]; kj < Crowptr[k+1]; ++kj) {
+        int j = Ccolidx[kj];
+        if (seen[j] != i) {
+          seen[j] = i;
+          ++rowSize;
+        }
+      }
+    }
+    (*rowptr)[i+1] = (*rowptr)[i] + rowSize;
+  }
+
+  int nnz = (*rowptr)[numBlockRows];
+  *colidx = static_cast<int*>(
+      simit::ffi::simit_malloc(std::max(nnz,1) * sizeof(int)));
+  std::fill(seen.begin(), seen.end(), -1);
+  for (int i = 0; i < numBlockRows; ++i) {
+    int ij = (*rowptr)[i];
+    for (int ik = Browptr[i]; ik < Browptr[i+1]; ++ik) {
+      int k = Bcolidx[ik];
+      for (int kj = Crowptr[k]; kj < Crowptr[k+1]; ++kj) {
+        int j = Ccolidx[kj];
+        if (seen[j] != i) {
+          seen[j] = i;
+          (*colidx)[ij++] = j;
+        }
+      }
+    }
+    std::sort(*colidx + (*rowptr)[i], *colidx + (*rowptr)[i+1]);
+  }
+}
+
+/// Computes the values of A=B*C, where A has the structure computed by
+/// spmmSymbolic. Block rows are computed in parallel. Blocks are stored
+/// row-major, and scalar blocks scale the blocks of the other operand.
+template <typename Float>
+void spmmNumeric(int numBlockRows, int numBlockCols,
+                 const int* Browptr, const int* Bcolidx,
+                 int Bnn, int Bmm, const Float* Bvals,
+                 const int* Crowptr, const int* Ccolidx,
+                 int Cnn, int Cmm, const Float* Cvals,
+                 const int* Arowptr, const int* Acolidx,
+                 int Ann, int Amm, Float* Avals) {
+  const int Bbs = Bnn*Bmm;
+  const int Cbs = Cnn*Cmm;
+  const int Abs = Ann*Amm;
+  simit::util::ThreadPool::getInstance().parallelFor(numBlockRows,
+                                                     simit::kNumThreads,
+      [&](int start, int end) {
+    // The location in A of each column of the current row
+    std::vector<int> locs(numBlockCols);
+    for (int i = start; i < end; ++i) {
+      for (int ij = Arowptr[i]; ij < Arowptr[i+1]; ++ij) {
+        locs[Acolidx[ij]] = ij;
+      }
+      std::fill(Avals + (size_t)Arowptr[i]*Abs,
+                Avals + (size_t)Arowptr[i+1]*Abs, Float(0));
+
+      for (int ik = Browptr[i]; ik < Browptr[i+1]; ++ik) {
+        const Float* b = Bvals + (size_t)ik*Bbs;
+        int k = Bcolidx[ik];
+        for (int kj = Crowptr[k]; kj < Crowptr[k+1]; ++kj) {
+          const Float* c = Cvals + (size_t)kj*Cbs;
+          Float* a = Avals + (size_t)locs[Ccolidx[kj]]*Abs;
+          if (Bbs == 1) {
+            for (int x = 0; x < Abs; ++x) {
+              a[x] += b[0] * c[x];
+            }
+          }
+          else if (Cbs == 1) {
+            for (int x = 0; x < Abs; ++x) {
+              a[x] += b[x] * c[0];
+            }
+          }
+          else {
+            for (int bi = 0; bi < Bnn; ++bi) {
+              for (int bk = 0; bk < Bmm; ++bk) {
+                Float bik = b[bi*Bmm+bk];
+                for (int bj = 0; bj < Cmm; ++bj) {
+                  a[bi*Amm+bj] += bik * c[bk*Cmm+bj];
+                }
+              }
+            }
+          }
+        }
+      }
+    }
+  });
+}
+
+}
+
+/// Computes A=B*C at call site `site`. The dimensions are in scalars, and
+/// nn and mm are the block dimensions.
 template <typename Float>
 int spmm(int Bn,  int Bm,  int* Browptr, int* Bcolidx,
          int Bnn, int Bmm, Float* Bvals,
          int Cn,  int Cm,  int* Crowptr, int* Ccolidx,
          int Cnn, int Cmm, Float* Cvals,
+         int site,
          int An,  int Am,  int** Arowptr, int** Acolidx,
          int Ann, int Amm, Float** Avals) {
-#ifdef EIGEN
-  auto B = csr2eigen<Float,RowMajor>(Bn, Bm, Browptr, Bcolidx, Bnn, Bmm, Bvals);
-  auto C = csr2eigen<Float,RowMajor>(Cn, Cm, Crowptr, Ccolidx, Cnn, Cmm, Cvals);
+  simit_iassert(Bm/Bmm == Cn/Cnn) << "spmm operands do not match";
+  simit_iassert((Bnn*Bmm == 1 || Cnn*Cmm == 1 || Bmm == Cnn) &&
+                Ann == (Bnn*Bmm == 1 ? Cnn : Bnn) &&
+                Amm == (Cnn*Cmm == 1 ? Bmm : Cmm))
+      << "spmm blocks do not match";
+  const int numBlockRows = Bn/Bnn;
+  const int numBlockCols = Cm/Cmm;
+
+  SpmmSite* state;
+  {
+    std::lock_guard<std::mutex> lock(spmmSitesMutex);
+    state = &spmmSites[site];
+  }
 
-  SparseMatrix<Float,RowMajor> A(An, Am);
-  A = B*C;
-  eigen2csr(A, An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
-#else
-  simit_ierror << "extern spmm requires Eigen";
-#endif
+  // The buffers of the previous result are freed once the new result has been
+  // computed, since they may be operands of this product
+  int* oldRowptr = nullptr;
+  int* oldColidx = nullptr;
+  void* oldVals = nullptr;
+
+  const int Bnnz = Browptr[numBlockRows];
+  const int Cnnz = Crowptr[Cn/Cnn];
+  if (state->rowptr == nullptr ||
+      !sameStructure(numBlockRows, Browptr, Bcolidx,
+                     state->Browptr, state->Bcolidx) ||
+      !sameStructure(Cn/Cnn, Crowptr, Ccolidx,
+                     state->Crowptr, state->Ccolidx)) {
+    oldRowptr = state->rowptr;
+    oldColidx = state->colidx;
+    spmmSymbolic(numBlockRows, numBlockCols, Browptr, Bcolidx,
+                 Crowptr, Ccolidx, &state->rowptr, &state->colidx);
+    state->Browptr.assign(Browptr, Browptr+numBlockRows+1);
+    state->Bcolidx.assign(Bcolidx, Bcolidx+Bnnz);
+    state->Crowptr.assign(Crowptr, Crowptr+Cn/Cnn+1);
+    state->Ccolidx.assign(Ccolidx, Ccolidx+Cnnz);
+  }
+
+  size_t valsSize = std::max((size_t)state->rowptr[numBlockRows]*Ann*Amm,
+                             (size_t)1) * sizeof(Float);
+  if (state->vals == nullptr || state->valsSize != valsSize ||
+      state->vals == Bvals || state->vals == Cvals) {
+    oldVals = state->vals;
+    state->vals = simit::ffi::simit_malloc(valsSize);
+    state->valsSize = valsSize;
+  }
+
+  spmmNumeric(numBlockRows, numBlockCols,
+              Browptr, Bcolidx, Bnn, Bmm, Bvals,
+              Crowptr, Ccolidx, Cnn, Cmm, Cvals,
+              state->rowptr, state->colidx, Ann, Amm,
+              static_cast<Float*>(state->vals));
+
+  free(oldRowptr);
+  free(oldColidx);
+  free(oldVals);
+
+  *Arowptr = state->rowptr;
+  *Acolidx = state->colidx;
+  *Avals = static_cast<Float*>(state->vals);
   return 0;
 }
 extern "C" int sspmm(int Bn,  int Bm,  int* Browptr, int* Bcolidx,
                      int Bnn, int Bmm, float* Bvals,
                      int Cn,  int Cm,  int* Crowptr, int* Ccolidx,
                      int Cnn, int Cmm, float* Cvals,
+                     int site,
                      int An,  int Am,  int** Arowptr, int** Acolidx,
                      int Ann, int Amm, float** Avals) {
   return spmm(Bn, Bm, Browptr, Bcolidx, Bnn, Bmm, Bvals,
               Cn, Cm, Crowptr, Ccolidx, Cnn, Cmm, Cvals,
+              site,
               An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
 }
 extern "C" int dspmm(int Bn,  int Bm,  int* Browptr, int* Bcolidx,
                      int Bnn, int Bmm, double* Bvals,
                      int Cn,  int Cm,  int* Crowptr, int* Ccolidx,
                      int Cnn, int Cmm, double* Cvals,
+                     int site,
                      int An,  int Am,  int** Arowptr, int** Acolidx,
                      int Ann, int Amm, double** Avals) {
   return spmm(Bn, Bm, Browptr, Bcolidx, Bnn, Bmm, Bvals,
               Cn, Cm, Crowptr, Ccolidx, Cnn, Cmm, Cvals,
+              site,
               An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
 }
+extern "C" void simitFreeSpmmSite(int site) {
+  std::lock_guard<std::mutex> lock(spmmSitesMutex);
+  auto state = spmmSites.find(site);
+  if (state != spmmSites.end()) {
+    free(state->second.rowptr);
+    free(state->second.colidx);
+    free(state->second.vals);
+    spmmSites.erase(state);
+  }
+}
 
 
 // Solvers
@@ -653,3 +924,417 @@ extern "C" int dtriangularSolve(int An,  int Am,  int* Arowptr, int* Acolidx,
 }
 
 
+
+// Iterative solvers that work directly on Simit's blocked CSR matrices, rather
+// than converting them to Eigen. Blocks must be square and are stored
+// row-major. The vector operations and the matrix-vector products run on the
+// thread pool.
+namespace {
+
+/// Vector loops are split into chunks of this many entries, and vectors that
+/// fit in one chunk are processed serially.
+const int kSolverChunkSize = 2048;
+
+template <typename Float>
+struct BlockedCSR {
+  int numBlockRows;
+  int blockSize;
+  const int* rowptr;
+  const int* colidx;
+  const Float* vals;
+};
+
+/// Executes `body(start, end)` on chunks of the range [0, n).
+void solverParallelFor(int n, const std::function<void(int,int)>& body) {
+  int numChunks = (n + kSolverChunkSize - 1) / kSolverChunkSize;
+  simit::util::ThreadPool::getInstance().parallelFor(numChunks,
+                                                     simit::kNumThreads,
+      [n, &body](int start, int end) {
+    body(start*kSolverChunkSize, std::min(end*kSolverChunkSize, n));
+  });
+}
+
+/// y = A*x
+template <typename Float>
+void solverSpmv(const BlockedCSR<Float>& A, const Float* x, Float* y) {
+  const int bs = A.blockSize;
+  const int rowsPerChunk = std::max(1, kSolverChunkSize / (bs*bs));
+  const int numChunks = (A.numBlockRows + rowsPerChunk - 1) / rowsPerChunk;
+  simit::util::ThreadPool::getInstance().parallelFor(numChunks,
+                                                     simit::kNumThreads,
+      [&](int start, int end) {
+    int rowEnd = std::min(end*rowsPerChunk, A.numBlockRows);
+    for (int i = start*rowsPerChunk; i < rowEnd; ++i) {
+      Float* yi = y + i*bs;
+      for (int bi = 0; bi < bs; ++bi) {
+        yi[bi] = 0;
+      }
+      for (int ij = A.rowptr[i]; ij < A.rowptr[i+1]; ++ij) {
+        const Float* block = A.vals + (size_t)ij*bs*bs;
+        const Float* xj = x + A.colidx[ij]*bs;
+        for (int bi = 0; bi < bs; ++bi) {
+          Float sum = 0;
+          for (int bj = 0; bj < bs; ++bj) {
+            sum += block[bi*bs+bj] * xj[bj];
+          }
+          yi[bi] += sum;
+        }
+      }
+    }
+  });
+}
+
+/// Returns the dot product of `a` and `b`. Partial sums are computed per chunk
+/// and added in order, so the result does not depend on the number of threads.
+template <typename Float>
+Float solverDot(int n, const Float* a, const Float* b) {
+  int numChunks = (n + kSolverChunkSize - 1) / kSolverChunkSize;
+  std::vector<double> partials(numChunks, 0.0);
+  simit::util::ThreadPool::getInstance().parallelFor(numChunks,
+                                                     simit::kNumThreads,
+      [&](int start, int end) {
+    for (int c = start; c < end; ++c) {
+      double sum = 0.0;
+      int iEnd = std::min((c+1)*kSolverChunkSize, n);
+      for (int i = c*kSolverChunkSize; i < iEnd; ++i) {
+        sum += a[i] * b[i];
+      }
+      partials[c] = sum;
+    }
+  });
+  double result = 0.0;
+  for (double partial : partials) {
+    result += partial;
+  }
+  return result;
+}
+
+/// Inverts the diagonal blocks of `A` for block-Jacobi preconditioning, using
+/// Gauss-Jordan elimination with partial pivoting. Missing and singular
+/// diagonal blocks are replaced by the identity.
+template <typename Float>
+std::vector<Float> invertDiagonalBlocks(const BlockedCSR<Float>& A) {
+  const int bs = A.blockSize;
+  std::vector<Float> inverses((size_t)A.numBlockRows*bs*bs);
+  solverParallelFor(A.numBlockRows, [&](int start, int end) {
+    std::vector<double> lhs(bs*bs);
+    for (int i = start; i < end; ++i) {
+      Float* inverse = &inverses[(size_t)i*bs*bs];
+      for (int k = 0; k < bs*bs; ++k) {
+        inverse[k] = (k % (bs+1) == 0) ? 1 : 0;
+      }
+
+      const Float* block = nullptr;
+      for (int ij = A.rowptr[i]; ij < A.rowptr[i+1]; ++ij) {
+        if (A.colidx[ij] == i) {
+          block = A.vals + (size_t)ij*bs*bs;
+          break;
+        }
+      }
+      if (block == nullptr) {
+        continue;
+      }
+
+      std::vector<double> rhs(inverse, inverse + bs*bs);
+      std::copy(block, block + bs*bs, lhs.begin());
+      bool singular = false;
+      for (int c = 0; c < bs && !singular; ++c) {
+        int pivot = c;
+        for (int r = c+1; r < bs; ++r) {
+          if (std::abs(lhs[r*bs+c]) > std::abs(lhs[pivot*bs+c])) {
+            pivot = r;
+          }
+        }
+        if (lhs[pivot*bs+c] == 0.0) {
+          singular = true;
+          break;
+        }
+        for (int k = 0; k < bs; ++k) {
+          std::swap(lhs[c*bs+k], lhs[pivot*bs+k]);
+          std::swap(rhs[c*bs+k], rhs[pivot*bs+k]);
+        }
+        double scale = 1.0 / lhs[c*bs+c];
+        for (int k = 0; k < bs; ++k) {
+          lhs[c*bs+k] *= scale;
+          rhs[c*bs+k] *= scale;
+        }
+        for (int r = 0; r < bs; ++r) {
+          if (r == c || lhs[r*bs+c] == 0.0) {
+            continue;
+          }
+          double factor = lhs[r*bs+c];
+          for (int k = 0; k < bs; ++k) {
+            lhs[r*bs+k] -= factor * lhs[c*bs+k];
+            rhs[r*bs+k] -= factor * rhs[c*bs+k];
+          }
+        }
+      }
+      if (!singular) {
+        std::copy(rhs.begin(), rhs.end(), inverse);
+      }
+    }
+  });
+  return inverses;
+}
+
+/// z = M^-1 r, where M^-1 holds the inverted diagonal blocks of A. If
+/// `inverses` is empty the preconditioner is the identity.
+template <typename Float>
+void applyBlockJacobi(const BlockedCSR<Float>& A,
+                      const std::vector<Float>& inverses,
+                      const Float* r, Float* z) {
+  const int bs = A.blockSize;
+  const int n = A.numBlockRows * bs;
+  if (inverses.empty()) {
+    solverParallelFor(n, [&](int start, int end) {
+      std::copy(r + start, r + end, z + start);
+    });
+    return;
+  }
+  solverParallelFor(A.numBlockRows, [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      const Float* inverse = &inverses[(size_t)i*bs*bs];
+      for (int bi = 0; bi < bs; ++bi) {
+        Float sum = 0;
+        for (int bj = 0; bj < bs; ++bj) {
+          sum += inverse[bi*bs+bj] * r[i*bs+bj];
+        }
+        z[i*bs+bi] = sum;
+      }
+    }
+  });
+}
+
+/// Computes r = b - A*x and returns ||b||, or returns 0 and zeroes x if b is
+/// zero.
+template <typename Float>
+Float initSolve(const BlockedCSR<Float>& A, const Float* b, const Float* x0,
+                Float* x, Float* r) {
+  const int n = A.numBlockRows * A.blockSize;
+  Float normb = std::sqrt(solverDot(n, b, b));
+  if (normb == 0) {
+    std::fill(x, x + n, Float(0));
+    return 0;
+  }
+  if (x != x0) {
+    std::copy(x0, x0 + n, x);
+  }
+  solverSpmv(A, x, r);
+  solverParallelFor(n, [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      r[i] = b[i] - r[i];
+    }
+  });
+  return normb;
+}
+
+/// Solves A*x = b for a symmetric positive definite A with the preconditioned
+/// conjugate gradient method, starting from x0. Returns 0 if the relative
+/// residual ||b-A*x||/||b|| dropped below `tol` within `maxiters` iterations.
+template <typename Float>
+int pcg(const BlockedCSR<Float>& A, bool precondition, const Float* b,
+        const Float* x0, Float tol, int maxiters, Float* x) {
+  const int n = A.numBlockRows * A.blockSize;
+  std::vector<Float> r(n), z(n), p(n), Ap(n);
+  Float normb = initSolve(A, b, x0, x, r.data());
+  if (normb == 0) {
+    return 0;
+  }
+
+  std::vector<Float> inverses;
+  if (precondition) {
+    inverses = invertDiagonalBlocks(A);
+  }
+  applyBlockJacobi(A, inverses, r.data(), z.data());
+  p = z;
+  Float rz = solverDot(n, r.data(), z.data());
+  Float threshold = tol * normb;
+  for (int iter = 0; iter < maxiters; ++iter) {
+    if (std::sqrt(solverDot(n, r.data(), r.data())) <= threshold) {
+      return 0;
+    }
+    solverSpmv(A, p.data(), Ap.data());
+    Float pAp = solverDot(n, p.data(), Ap.data());
+    if (pAp == 0) {
+      break;
+    }
+    Float alpha = rz / pAp;
+    solverParallelFor(n, [&](int start, int end) {
+      for (int i = start; i < end; ++i) {
+        x[i] += alpha * p[i];
+        r[i] -= alpha * Ap[i];
+      }
+    });
+    applyBlockJacobi(A, inverses, r.data(), z.data());
+    Float rzNew = solverDot(n, r.data(), z.data());
+    Float beta = rzNew / rz;
+    rz = rzNew;
+    solverParallelFor(n, [&](int start, int end) {
+      for (int i = start; i < end; ++i) {
+        p[i] = z[i] + beta * p[i];
+      }
+    });
+  }
+  return (std::sqrt(solverDot(n, r.data(), r.data())) <= threshold) ? 0 : 1;
+}
+
+/// Solves A*x = b for a general A with the block-Jacobi preconditioned
+/// BiCGSTAB method, starting from x0. Returns 0 if the relative residual
+/// dropped below `tol` within `maxiters` iterations.
+template <typename Float>
+int bicgstab(const BlockedCSR<Float>& A, const Float* b, const Float* x0,
+             Float tol, int maxiters, Float* x) {
+  const int n = A.numBlockRows * A.blockSize;
+  std::vector<Float> r(n), rhat(n), p(n), v(n), s(n), t(n), y(n), z(n);
+  Float normb = initSolve(A, b, x0, x, r.data());
+  if (normb == 0) {
+    return 0;
+  }
+
+  std::vector<Float> inverses = invertDiagonalBlocks(A);
+  rhat = r;
+  Float rho = 1, alpha = 1, omega = 1;
+  Float threshold = tol * normb;
+  for (int iter = 0; iter < maxiters; ++iter) {
+    if (std::sqrt(solverDot(n, r.data(), r.data())) <= threshold) {
+      return 0;
+    }
+    Float rhoNew = solverDot(n, rhat.data(), r.data());
+    if (rhoNew == 0 || omega == 0) {
+      break;
+    }
+    Float beta = (rhoNew / rho) * (alpha / omega);
+    rho = rhoNew;
+    solverParallelFor(n, [&](int start, int end) {
+      for (int i = start; i < end; ++i) {
+        p[i] = r[i] + beta * (p[i] - omega * v[i]);
+      }
+    });
+    applyBlockJacobi(A, inverses, p.data(), y.data());
+    solverSpmv(A, y.data(), v.data());
+    Float rhatv = solverDot(n, rhat.data(), v.data());
+    if (rhatv == 0) {
+      break;
+    }
+    alpha = rho / rhatv;
+    solverParallelFor(n, [&](int start, int end) {
+      for (int i = start; i < end; ++i) {
+        s[i] = r[i] - alpha * v[i];
+      }
+    });
+    if (std::sqrt(solverDot(n, s.data(), s.data())) <= threshold) {
+      solverParallelFor(n, [&](int start, int end) {
+        for (int i = start; i < end; ++i) {
+          x[i] += alpha * y[i];
+        }
+      });
+      return 0;
+    }
+    applyBlockJacobi(A, inverses, s.data(), z.data());
+    solverSpmv(A, z.data(), t.data());
+    Float tt = solverDot(n, t.data(), t.data());
+    omega = (tt == 0) ? 0 : solverDot(n, t.data(), s.data()) / tt;
+    solverParallelFor(n, [&](int start, int end) {
+      for (int i = start; i < end; ++i) {
+        x[i] += alpha * y[i] + omega * z[i];
+        r[i] = s[i] - omega * t[i];
+      }
+    });
+  }
+  return (std::sqrt(solverDot(n, r.data(), r.data())) <= threshold) ? 0 : 1;
+}
+
+template <typename Float>
+BlockedCSR<Float> solverMatrix(int An, int Am, int* Arowptr, int* Acolidx,
+                               int Ann, int Amm, Float* Avals) {
+  simit_uassert(An == Am && Ann == Amm)
+      << "iterative solvers require a square matrix with square blocks";
+  return {An/Ann, Ann, Arowptr, Acolidx, Avals};
+}
+
+/// Warns that `solver` stopped before the relative residual dropped below
+/// `tol`, as generated code drops the status of externs. Returns `status`.
+template <typename Float>
+int warnIfNotConverged(const char* solver, int status, Float tol,
+                       int maxiters) {
+  if (status != 0) {
+    simit_uwarning << solver << " did not reach a relative residual of " << tol
+                   << " within " << maxiters << " iterations, and returns the "
+                   << "last iterate";
+  }
+  return status;
+}
+
+} // anonymous namespace
+
+template <typename Float>
+int cgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+            int Ann, int Amm, Float* Avals,
+            int bn, Float* bvals, int x0n, Float* x0vals,
+            Float tol, int maxiters, int xn, Float* xvals) {
+  auto A = solverMatrix(An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
+  return warnIfNotConverged("cgsolve",
+      pcg(A, false, bvals, x0vals, tol, maxiters, xvals), tol, maxiters);
+}
+extern "C" int scgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                        int Ann, int Amm, float* Avals,
+                        int bn, float* bvals, int x0n, float* x0vals,
+                        float tol, int maxiters, int xn, float* xvals) {
+  return cgsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                 bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
+extern "C" int dcgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                        int Ann, int Amm, double* Avals,
+                        int bn, double* bvals, int x0n, double* x0vals,
+                        double tol, int maxiters, int xn, double* xvals) {
+  return cgsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                 bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
+
+template <typename Float>
+int pcgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+             int Ann, int Amm, Float* Avals,
+             int bn, Float* bvals, int x0n, Float* x0vals,
+             Float tol, int maxiters, int xn, Float* xvals) {
+  auto A = solverMatrix(An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
+  return warnIfNotConverged("pcgsolve",
+      pcg(A, true, bvals, x0vals, tol, maxiters, xvals), tol, maxiters);
+}
+extern "C" int spcgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                         int Ann, int Amm, float* Avals,
+                         int bn, float* bvals, int x0n, float* x0vals,
+                         float tol, int maxiters, int xn, float* xvals) {
+  return pcgsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                  bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
+extern "C" int dpcgsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                         int Ann, int Amm, double* Avals,
+                         int bn, double* bvals, int x0n, double* x0vals,
+                         double tol, int maxiters, int xn, double* xvals) {
+  return pcgsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                  bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
+
+template <typename Float>
+int bicgstabsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                  int Ann, int Amm, Float* Avals,
+                  int bn, Float* bvals, int x0n, Float* x0vals,
+                  Float tol, int maxiters, int xn, Float* xvals) {
+  auto A = solverMatrix(An, Am, Arowptr, Acolidx, Ann, Amm, Avals);
+  return warnIfNotConverged("bicgstabsolve",
+      bicgstab(A, bvals, x0vals, tol, maxiters, xvals), tol, maxiters);
+}
+extern "C" int sbicgstabsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                              int Ann, int Amm, float* Avals,
+                              int bn, float* bvals, int x0n, float* x0vals,
+                              float tol, int maxiters, int xn, float* xvals) {
+  return bicgstabsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                       bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
+extern "C" int dbicgstabsolve(int An,  int Am,  int* Arowptr, int* Acolidx,
+                              int Ann, int Amm, double* Avals,
+                              int bn, double* bvals, int x0n, double* x0vals,
+                              double tol, int maxiters, int xn, double* xvals) {
+  return bicgstabsolve(An, Am, Arowptr, Acolidx, Ann, Amm, Avals,
+                       bn, bvals, x0n, x0vals, tol, maxiters, xn, xvals);
+}
@@ -0,0 +1,419 @@
+#include "snapshot.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "graph.h"
+
+using namespace std;
+
+namespace simit {
+
+// Snapshot file format, version 2:
+//   Header
+//   Metadata, one record per set (see Snapshot::writeMetadata)
+//   Arrays (endpoints, grid points and edges, and fields), each aligned to
+//   kAlignment bytes from the start of the file
+// Integers are stored in the byte order of the machine that wrote the file,
+// which a reader detects with the byteOrder word.
+static const char kMagic[8] = {'S','I','M','I','T','S','N','P'};
+static const uint32_t kVersion = 2;
+static const uint32_t kByteOrder = 0x01020304;
+static const uint64_t kAlignment = 64;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t metadataSize;
+  uint32_t numSets;
+  uint32_t reserved;
+};
+
+/// The location of an array in the file.
+struct ArrayRecord {
+  uint64_t offset;
+  uint64_t size;
+};
+
+static uint64_t align(uint64_t offset) {
+  return (offset + kAlignment - 1) / kAlignment * kAlignment;
+}
+
+
+// class Snapshot
+/// Serializes the metadata of the sets, laying out the arrays they refer to
+/// from `arraysOffset` on.
+class Snapshot::MetadataWriter {
+public:
+  MetadataWriter(uint64_t arraysOffset) : arraysEnd(arraysOffset) {}
+
+  template <typename T>
+  void write(T value) {
+    metadata.append((const char*)&value, sizeof(T));
+  }
+
+  void writeString(const string& str) {
+    write<uint32_t>(str.size());
+    metadata.append(str);
+  }
+
+  /// Lays out an array of `size` bytes, gathered from `numChunks` equal chunks
+  /// that are `chunkStride` bytes apart in memory.
+  void writeArray(const void* data, size_t size, size_t numChunks=1,
+                  size_t chunkStride=0) {
+    ArrayRecord record;
+    record.offset = align(arraysEnd);
+    record.size = size;
+    arraysEnd = record.offset + size;
+    write(record);
+    arrays.push_back({data, record, numChunks, chunkStride});
+  }
+
+  const string& getMetadata() const {return metadata;}
+
+  struct Array {
+    const void* data;
+    ArrayRecord record;
+    size_t numChunks;
+    size_t chunkStride;
+  };
+  const vector<Array>& getArrays() const {return arrays;}
+
+private:
+  string metadata;
+  vector<Array> arrays;
+  uint64_t arraysEnd;
+};
+
+/// Reads the metadata of a mapped snapshot, checking that it and the arrays it
+/// refers to are inside the file.
+class MetadataReader {
+public:
+  MetadataReader(const char* file, uint64_t fileSize, uint64_t offset,
+                 uint64_t size)
+      : file(file), fileSize(fileSize), pos(offset), end(offset+size),
+        valid(offset <= fileSize && size <= fileSize - offset) {}
+
+  bool isValid() const {return valid;}
+
+  template <typename T>
+  T read() {
+    T value;
+    memset(&value, 0, sizeof(T));
+    if (valid && end - pos >= sizeof(T)) {
+      memcpy(&value, file + pos, sizeof(T));
+      pos += sizeof(T);
+    }
+    else {
+      valid = false;
+    }
+    return value;
+  }
+
+  string readString() {
+    uint32_t size = read<uint32_t>();
+    if (!valid || end - pos < size) {
+      valid = false;
+      return "";
+    }
+    string str(file + pos, size);
+    pos += size;
+    return str;
+  }
+
+  /// Returns the array of `size` bytes at the next array record.
+  char* readArray(uint64_t size) {
+    ArrayRecord record = read<ArrayRecord>();
+    if (!valid || record.size != size || record.offset % kAlignment != 0 ||
+        record.offset > fileSize || size > fileSize - record.offset) {
+      valid = false;
+      return nullptr;
+    }
+    return const_cast<char*>(file) + record.offset;
+  }
+
+private:
+  const char* file;
+  uint64_t fileSize;
+  uint64_t pos;
+  uint64_t end;
+  bool valid;
+};
+
+void Snapshot::writeMetadata(MetadataWriter* writer,
+                             const vector<const Set*>& sets,
+                             const map<const Set*,int>& setIndices) {
+  for (const Set* set : sets) {
+    const int cardinality = set->getCardinality();
+    writer->writeString(set->getName());
+    writer->write<uint32_t>(set->getKind());
+    writer->write<int32_t>(set->getSize());
+    writer->write<uint32_t>(cardinality);
+    for (int i = 0; i < cardinality; ++i) {
+      writer->write<int32_t>(setIndices.at(set->getEndpointSet(i)));
+    }
+    Set* mutableSet = const_cast<Set*>(set);
+    writer->writeArray(mutableSet->getEndpointsData(),
+                       (size_t)set->getSize() * cardinality * sizeof(int));
+
+    if (set->getKind() == Set::Grid) {
+      const vector<int>& dimensions = set->getDimensions();
+      int numGridPoints = 1;
+      writer->write<uint32_t>(dimensions.size());
+      for (int dimension : dimensions) {
+        writer->write<int32_t>(dimension);
+        numGridPoints *= dimension;
+      }
+      writer->writeArray(set->gridPoints, numGridPoints*sizeof(ElementRef));
+      writer->writeArray(set->gridEdges,
+                         numGridPoints*dimensions.size()*sizeof(ElementRef));
+    }
+
+    writer->writeString(set->getSpatialFieldName());
+    writer->write<uint32_t>(set->fields.size());
+    for (const Set::FieldData* field : set->fields) {
+      writer->writeString(field->name);
+      writer->write<uint32_t>((uint32_t)field->type->getComponentType());
+      writer->write<uint32_t>(field->type->getOrder());
+      for (size_t i = 0; i < field->type->getOrder(); ++i) {
+        writer->write<int32_t>(field->type->getDimension(i));
+      }
+      // The components of SoA fields are packed together, which makes the
+      // loaded set's capacity their stride
+      writer->write<uint32_t>(field->layout);
+      size_t numComponents = field->type->getSize();
+      size_t componentSize = field->sizeOfType / numComponents;
+      if (field->layout == Set::SoA) {
+        writer->writeArray(field->data, set->getSize() * field->sizeOfType,
+                           numComponents, set->capacity * componentSize);
+      }
+      else {
+        writer->writeArray(field->data, set->getSize() * field->sizeOfType);
+      }
+    }
+  }
+}
+
+int Snapshot::save(const std::string& fileName,
+                   const std::vector<const Set*>& sets) {
+  map<const Set*,int> setIndices;
+  for (size_t i = 0; i < sets.size(); ++i) {
+    setIndices[sets[i]] = i;
+  }
+  for (const Set* set : sets) {
+    for (int i = 0; i < set->getCardinality(); ++i) {
+      simit_uassert(setIndices.find(set->getEndpointSet(i)) != setIndices.end())
+          << "The endpoints of " << util::quote(set->getName())
+          << " are not in the snapshot";
+    }
+  }
+
+  // The arrays follow the metadata, whose size does not depend on where they
+  // are, so lay them out after measuring the metadata.
+  MetadataWriter sizer(0);
+  writeMetadata(&sizer, sets, setIndices);
+  uint64_t metadataSize = sizer.getMetadata().size();
+  MetadataWriter writer(sizeof(Header) + metadataSize);
+  writeMetadata(&writer, sets, setIndices);
+
+  Header header;
+  memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.byteOrder = kByteOrder;
+  header.metadataSize = metadataSize;
+  header.numSets = sets.size();
+  header.reserved = 0;
+
+  ofstream out(fileName, ofstream::binary | ofstream::trunc);
+  if (!out.good()) {
+    return -1;
+  }
+  out.write((const char*)&header, sizeof(Header));
+  out.write(writer.getMetadata().data(), metadataSize);
+  uint64_t pos = sizeof(Header) + metadataSize;
+  const char padding[kAlignment] = {};
+  for (const MetadataWriter::Array& array : writer.getArrays()) {
+    out.write(padding, array.record.offset - pos);
+    size_t chunkSize = array.record.size / array.numChunks;
+    for (size_t i = 0; i < array.numChunks; ++i) {
+      out.write((const char*)array.data + i*array.chunkStride, chunkSize);
+    }
+    pos = array.record.offset + array.record.size;
+  }
+  out.close();
+  return out.good() ? 0 : -1;
+}
+
+Snapshot::Snapshot() : mapping(nullptr), mappingSize(0) {
+}
+
+Snapshot::~Snapshot() {
+  clear();
+}
+
+void Snapshot::clear() {
+  // The sets must go before the mapping they point into
+  sets.clear();
+  if (mapping != nullptr) {
+    munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+  }
+}
+
+int Snapshot::load(const std::string& fileName) {
+  clear();
+
+  int fd = open(fileName.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat fileStat;
+  if (fstat(fd, &fileStat) != 0 || (size_t)fileStat.st_size < sizeof(Header)) {
+    ::close(fd);
+    return -1;
+  }
+  mappingSize = fileStat.st_size;
+  // Private, so the sets can be written without changing the file
+  mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                 fd, 0);
+  ::close(fd);
+  if (mapping == MAP_FAILED) {
+    mapping = nullptr;
+    mappingSize = 0;
+    return -1;
+  }
+
+  const char* file = (const char*)mapping;
+  Header header;
+  memcpy(&header, file, sizeof(Header));
+  if (memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 ||
+      header.version != kVersion || header.byteOrder != kByteOrder) {
+    clear();
+    return -1;
+  }
+
+  MetadataReader reader(file, mappingSize, sizeof(Header),
+                        header.metadataSize);
+  vector<vector<int32_t>> endpointSetIndices(header.numSets);
+  vector<int32_t> underlyingPointSets(header.numSets, -1);
+  for (uint32_t s = 0; s < header.numSets && reader.isValid(); ++s) {
+    string name = reader.readString();
+    uint32_t kind = reader.read<uint32_t>();
+    int32_t numElements = reader.read<int32_t>();
+    uint32_t cardinality = reader.read<uint32_t>();
+    if (!reader.isValid() || numElements < 0 ||
+        (kind != Set::Unstructured && kind != Set::Grid)) {
+      break;
+    }
+
+    Set* set = new Set(name, (Set::Kind)kind);
+    sets.push_back(unique_ptr<Set>(set));
+    set->numElements = numElements;
+    set->capacity = numElements;
+    for (uint32_t i = 0; i < cardinality && reader.isValid(); ++i) {
+      endpointSetIndices[s].push_back(reader.read<int32_t>());
+    }
+    set->endpoints = (int*)reader.readArray((uint64_t)numElements *
+                                            cardinality * sizeof(int));
+    set->endpointsMapped = true;
+
+    if (kind == Set::Grid) {
+      uint32_t numDimensions = reader.read<uint32_t>();
+      uint64_t numGridPoints = 1;
+      for (uint32_t i = 0; i < numDimensions && reader.isValid(); ++i) {
+        int32_t dimension = reader.read<int32_t>();
+        set->dimensions.push_back(dimension);
+        numGridPoints *= dimension;
+      }
+      uint64_t gridPointsSize = numGridPoints * sizeof(ElementRef);
+      uint64_t gridEdgesSize = gridPointsSize * numDimensions;
+      const char* gridPoints = reader.readArray(gridPointsSize);
+      const char* gridEdges = reader.readArray(gridEdgesSize);
+      if (!reader.isValid() || endpointSetIndices[s].empty()) {
+        break;
+      }
+      // The grid point and edge tables are not used by compiled code, so they
+      // are copied to where the set frees them
+      set->gridPoints = (ElementRef*)malloc(gridPointsSize);
+      set->gridEdges = (ElementRef*)malloc(gridEdgesSize);
+      memcpy(set->gridPoints, gridPoints, gridPointsSize);
+      memcpy(set->gridEdges, gridEdges, gridEdgesSize);
+      underlyingPointSets[s] = endpointSetIndices[s][0];
+    }
+
+    string spatialFieldName = reader.readString();
+    uint32_t numFields = reader.read<uint32_t>();
+    for (uint32_t f = 0; f < numFields && reader.isValid(); ++f) {
+      string fieldName = reader.readString();
+      uint32_t componentType = reader.read<uint32_t>();
+      uint32_t order = reader.read<uint32_t>();
+      vector<int> dimensions;
+      for (uint32_t i = 0; i < order && reader.isValid(); ++i) {
+        dimensions.push_back(reader.read<int32_t>());
+      }
+      uint32_t layout = reader.read<uint32_t>();
+      if (!reader.isValid() ||
+          componentType > (uint32_t)ComponentType::DoubleComplex ||
+          (layout != Set::AoS && layout != Set::SoA)) {
+        break;
+      }
+
+      auto type = new Set::FieldData::TensorType((ComponentType)componentType,
+                                                 dimensions);
+      auto fieldData = new Set::FieldData(fieldName, type, set,
+                                          (Set::FieldLayout)layout);
+      set->fields.push_back(fieldData);
+      set->fieldNames[fieldName] = set->fields.size()-1;
+      fieldData->data = reader.readArray(numElements * fieldData->sizeOfType);
+      fieldData->mapped = true;
+    }
+    set->spatialFieldName = spatialFieldName;
+  }
+  if (!reader.isValid() || sets.size() != header.numSets) {
+    clear();
+    return -1;
+  }
+
+  // Link the edge sets to their endpoint sets
+  for (size_t s = 0; s < sets.size(); ++s) {
+    for (int32_t index : endpointSetIndices[s]) {
+      if (index < 0 || (size_t)index >= sets.size()) {
+        clear();
+        return -1;
+      }
+      sets[s]->endpointSets.push_back(sets[index].get());
+    }
+    if (underlyingPointSets[s] >= 0) {
+      sets[s]->underlyingPointSet = sets[underlyingPointSets[s]].get();
+    }
+  }
+  return 0;
+}
+
+std::vector<Set*> Snapshot::getSets() const {
+  vector<Set*> result;
+  for (auto& set : sets) {
+    result.push_back(set.get());
+  }
+  return result;
+}
+
+Set* Snapshot::getSet(const std::string& name) const {
+  for (auto& set : sets) {
+    if (set->getName() == name) {
+      return set.get();
+    }
+  }
+  return nullptr;
+}
+
+}
@@ -0,0 +1,60 @@
+#ifndef SIMIT_SNAPSHOT_H
+#define SIMIT_SNAPSHOT_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace simit {
+class Set;
+
+/// A graph of sets loaded from a binary snapshot file written by save(). The
+/// file is mapped into memory copy-on-write, and the endpoints and field data
+/// of the sets point into the mapping instead of being read and copied, so
+/// loading a snapshot costs about as much as touching the pages that are used.
+/// Writes to the sets are private to the process and never reach the file.
+/// A set copies its data out of the mapping the first time it grows.
+///
+/// The sets belong to the snapshot and are valid until it is destroyed.
+class Snapshot {
+public:
+  Snapshot();
+  ~Snapshot();
+
+  /// Writes `sets` to a snapshot file. A snapshot holds each set's name, kind,
+  /// grid dimensions, endpoints and fields, with every array aligned so that
+  /// it can be used in place. The endpoint sets of the edge sets must be among
+  /// `sets`.
+  ///return -1 if failed to save
+  static int save(const std::string& fileName,
+                  const std::vector<const Set*>& sets);
+
+  ///return -1 if failed to load or format is unrecognized
+  int load(const std::string& fileName);
+
+  /// The sets of the snapshot, in the order they were saved.
+  std::vector<Set*> getSets() const;
+
+  /// The first set named `name`, or nullptr if there is none.
+  Set* getSet(const std::string& name) const;
+
+private:
+  std::vector<std::unique_ptr<Set>> sets;
+  void* mapping;
+  size_t mappingSize;
+
+  void clear();
+
+  class MetadataWriter;
+  static void writeMetadata(MetadataWriter* writer,
+                            const std::vector<const Set*>& sets,
+                            const std::map<const Set*,int>& setIndices);
+
+  /// disable copy
+  Snapshot(const Snapshot&);
+  Snapshot& operator=(const Snapshot&);
+};
+
+}
+#endif
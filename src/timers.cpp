@@ -1,175 +1,403 @@
 #include "timers.h"
 
-#include "macros.h"
-#include "storage.h"
-#include "ir_builder.h"
-#include "ir_rewriter.h"
-#include "ir_transforms.h"
-#include "inline.h"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include "ir.h"
+#include "ir_rewriter.h"
+#include "ir_visitor.h"
 #include "intrinsics.h"
+#include "util/util.h"
 
 using namespace std;
 
 namespace simit {
 namespace ir {
 
-void printTimes() {
-  const int LINE_LIMIT = 80;
-  double percentageSum = 0.0;
-
-  for (auto line: simit::ir::TimerStorage::getInstance().getSourceLines()) {
-    size_t first = line.find_first_not_of(' ');
-    size_t last = line.find_last_not_of('\n');
-    std::string test = "";
-    if ( first != last ) {
-      test = line.substr(first, (last-first+1));
-      line = line.substr(0, (last+1));
-    }
-    int index = simit::ir::TimerStorage::getInstance().getTimedLineIndex(test);
-    if ( index >= 0) {
-      double percentage= TimerStorage::getInstance().getTimingPercentage(index);
-      percentageSum += percentage;
-      unsigned long long int timerCount =
-          TimerStorage::getInstance().getCounter(index);
-      if (line.length() < LINE_LIMIT) {
-        line.append(LINE_LIMIT - line.length(), ' ');
-        printf("%s (%f%s, %llu)\n", line.c_str(), percentage , "%", timerCount);
-      } else {
-        printf("%s (%f%s, %llu)\n", line.substr(0,LINE_LIMIT).c_str(),
-               percentage, "%", timerCount);
-        for (unsigned x=LINE_LIMIT; x < line.length(); x+= LINE_LIMIT) {
-          printf("\t %s\n",line.substr(x, LINE_LIMIT).c_str());
-        }
-      }
-      TimerStorage::getInstance().deleteIndex(index);
-    } else {
-      if (line.length() < LINE_LIMIT) {
-        line.append(LINE_LIMIT - line.length(), ' ');
-        printf("%s\n", line.c_str());
-      } else {
-        printf("%s\n", line.substr(0,LINE_LIMIT).c_str());
-        for (unsigned x=LINE_LIMIT; x < line.length(); x+= LINE_LIMIT) {
-          printf("\t %s\n",line.substr(x, LINE_LIMIT).c_str());
-        }
+// class Profiler
+int Profiler::addRegion(const string& function, const string& name,
+                        int parent) {
+  if (regions.size() == (size_t)kMaxRegions) {
+    return -1;
+  }
+  regions.push_back({function, name, parent});
+  return regions.size() - 1;
+}
+
+void Profiler::storeTime(int timer, double time) {
+  if (timerSums.size() <= (size_t)timer) {
+    timerSums.resize(timer + 1, 0.0);
+    timerCounts.resize(timer + 1, 0);
+  }
+  timerSums[timer] += time;
+  timerCounts[timer] += 1;
+}
+
+Profiler::~Profiler() {
+#ifdef __linux__
+  for (int fd : eventFds) {
+    close(fd);
+  }
+#endif
+}
+
+const char* Profiler::getHardwareEventName(HardwareEvent event) {
+  switch (event) {
+    case Cycles:             return "cycles";
+    case Instructions:       return "instructions";
+    case CacheMisses:        return "cache_misses";
+    case BranchMisses:       return "branch_misses";
+    case kNumHardwareEvents: break;
+  }
+  return "";
+}
+
+bool Profiler::enableHardwareCounters() {
+  if (eventCounters) {
+    return true;
+  }
+#ifdef __linux__
+  const uint64_t configs[kNumHardwareEvents] = {
+    PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES
+  };
+  hardwareCounterError.clear();
+  for (int i = 0; i < kNumHardwareEvents; ++i) {
+    HardwareEvent event = (HardwareEvent)i;
+
+    // Count user space only, which perf_event_paranoid=2 still allows
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = configs[i];
+    attr.read_format = PERF_FORMAT_GROUP;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    int leader = eventFds.empty() ? -1 : eventFds[0];
+    int fd = syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+    if (fd == -1) {
+      // PMUs without an event, e.g. in virtual machines, leave it out
+      if (!hardwareCounterError.empty()) {
+        hardwareCounterError += "; ";
       }
+      hardwareCounterError += string(getHardwareEventName(event)) + ": " +
+                              strerror(errno);
+      continue;
     }
+    eventFds.push_back(fd);
+    hardwareEvents.push_back(event);
+  }
+#else
+  hardwareCounterError = "hardware counters need Linux perf events";
+#endif
+  if (hardwareEvents.empty()) {
+    return false;
   }
+  eventCounters.reset(new EventCounter[kMaxRegions]());
+  return true;
+}
 
-  printf("Total Time: %f (seconds), %f\n",
-         simit::ir::TimerStorage::getInstance().getTotalTime() / 1000000.0,
-         percentageSum);
+bool Profiler::readHardwareCounters(uint64_t* values) {
+#ifdef __linux__
+  uint64_t group[1 + kNumHardwareEvents];
+  if (read(eventFds[0], group, sizeof(group)) <= 0) {
+    return false;
+  }
+  for (uint64_t i = 0; i < group[0]; ++i) {
+    values[hardwareEvents[i]] = group[1 + i];
+  }
+  return true;
+#else
+  return false;
+#endif
 }
 
-// Singleton
-class InsertTimers : public IRRewriter {
-  using IRRewriter::visit;
-  public: 
-    static InsertTimers& getInstance() {
-      static InsertTimers instance; 
-      return instance;
-    }
-    
-    void visit(const TensorWrite *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
-    }
+void Profiler::endHardwareCounters(int region) {
+  EventCounter& counter = eventCounters[region];
+  if (util::ThreadPool::getInstance().getNumParallelLoops() !=
+      counter.startParallelLoops) {
+    counter.parallel = true;
+  }
+  uint64_t values[kNumHardwareEvents] = {};
+  // Executions whose counters could not be read are left out of the counts
+  if (!counter.started || !readHardwareCounters(values)) {
+    return;
+  }
+  for (HardwareEvent event : hardwareEvents) {
+    counter.total[event] += values[event] - counter.start[event];
+  }
+}
 
-    void visit(const FieldWrite *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+void Profiler::reset() {
+  for (size_t i = 0; i < regions.size(); ++i) {
+    counters[i] = Counter();
+    if (eventCounters) {
+      eventCounters[i] = EventCounter();
     }
-    
-    void visit(const Map *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+  }
+  timerSums.clear();
+  timerCounts.clear();
+}
+
+
+// Profile reports
+static void writeString(ostream& os, const string& str) {
+  os << '"';
+  for (char c : str) {
+    switch (c) {
+      case '"':  os << "\\\""; break;
+      case '\\': os << "\\\\"; break;
+      case '\n': os << "\\n";  break;
+      case '\t': os << "\\t";  break;
+      default:
+        if ((unsigned char)c < 0x20) {
+          os << "\\u" << hex << setw(4) << setfill('0') << (int)c << dec;
+        }
+        else {
+          os << c;
+        }
     }
-    
-    void visit(const Store *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
+  }
+  os << '"';
+}
+
+/// The time of each region that is not spent in its subregions.
+static vector<int64_t> getSelfTimes(const Profiler& profiler) {
+  const vector<ProfileRegion>& regions = profiler.getRegions();
+  vector<int64_t> selfTimes(regions.size());
+  for (size_t i = 0; i < regions.size(); ++i) {
+    selfTimes[i] += profiler.getCounter(i).nanoseconds;
+    if (regions[i].parent != -1) {
+      selfTimes[regions[i].parent] -= profiler.getCounter(i).nanoseconds;
     }
-    
-    void visit(const CallStmt *op) {
-      if (op->callee.getKind() != Func::Internal) {
-        Var timeStartVar = initTimer(util::toString(*op),stmt);
-        stmt = Block::make(stmt,op);
-        storeTimer(stmt, timeStartVar);
-      } else {
-        stmt = Block::make(stmt, op);
+  }
+  return selfTimes;
+}
+
+static void writeJSON(ostream& os, const Profiler& profiler) {
+  const vector<ProfileRegion>& regions = profiler.getRegions();
+  vector<int64_t> selfTimes = getSelfTimes(profiler);
+  os << "{\n  \"regions\": [";
+  for (size_t i = 0; i < regions.size(); ++i) {
+    const Profiler::Counter& counter = profiler.getCounter(i);
+    os << (i == 0 ? "\n" : ",\n") << "    {\"id\": " << i
+       << ", \"parent\": " << regions[i].parent << ", \"function\": ";
+    writeString(os, regions[i].function);
+    os << ", \"name\": ";
+    writeString(os, regions[i].name);
+    os << ", \"count\": " << counter.count
+       << ", \"total_ns\": " << counter.nanoseconds
+       << ", \"self_ns\": " << selfTimes[i];
+    // The counters leave out the workers of the regions' parallel loops
+    for (Profiler::HardwareEvent event : profiler.getHardwareEvents()) {
+      os << ", \"" << Profiler::getHardwareEventName(event) << "\": ";
+      if (profiler.hasHardwareCounts(i)) {
+        os << profiler.getHardwareCount(i, event);
+      }
+      else {
+        os << "null";
       }
     }
-    
-    void visit(const AssignStmt *op) {
-      Var timeStartVar = initTimer(util::toString(*op),stmt);
-      stmt = Block::make(stmt,op);
-      storeTimer(stmt, timeStartVar);
-    }
-    
-    void visit(const IfThenElse *op) {
-      Expr start = rewrite(op->condition);
-      Stmt thenBody = rewrite(op->thenBody);
-      Stmt elseBody = rewrite(op->elseBody);
-      
-      stmt = !elseBody.defined() ? IfThenElse::make(op->condition, thenBody) : 
-             IfThenElse::make(op->condition, thenBody, elseBody);
-    }
-    
-    void visit(const ForRange *op) {
-      Expr start = rewrite(op->start);
-      Expr end = rewrite(op->end);
-      Stmt body = rewrite(op->body);
-      
-      stmt = ForRange::make(op->var, start, end, body);
+    os << "}";
+  }
+  os << "\n  ],\n  \"hardware_counters\": {\"events\": [";
+  for (size_t i = 0; i < profiler.getHardwareEvents().size(); ++i) {
+    Profiler::HardwareEvent event = profiler.getHardwareEvents()[i];
+    os << (i == 0 ? "\"" : ", \"")
+       << Profiler::getHardwareEventName(event) << "\"";
+  }
+  os << "], \"error\": ";
+  writeString(os, profiler.getHardwareCounterError());
+  os << "},\n  \"timers\": [";
+  const vector<double>& timerSums = profiler.getTimerSums();
+  for (size_t i = 0; i < timerSums.size(); ++i) {
+    os << (i == 0 ? "\n" : ",\n") << "    {\"id\": " << i
+       << ", \"count\": " << profiler.getTimerCounts()[i]
+       << ", \"total\": " << timerSums[i] << "}";
+  }
+  os << "\n  ]\n}\n";
+}
+
+static void writeChromeTrace(ostream& os, const Profiler& profiler) {
+  const vector<ProfileRegion>& regions = profiler.getRegions();
+
+  // Lay out each region after its preceding siblings. Parents are registered
+  // before their subregions, so one pass in registration order suffices.
+  vector<uint64_t> starts(regions.size());
+  vector<uint64_t> ends(regions.size());
+  uint64_t rootEnd = 0;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    int parent = regions[i].parent;
+    uint64_t& siblingsEnd = (parent == -1) ? rootEnd : ends[parent];
+    starts[i] = siblingsEnd;
+    ends[i] = starts[i];
+    siblingsEnd += profiler.getCounter(i).nanoseconds;
+  }
+
+  os << "{\"traceEvents\": [";
+  bool first = true;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    const Profiler::Counter& counter = profiler.getCounter(i);
+    if (counter.count == 0) continue;
+    os << (first ? "\n" : ",\n") << "  {\"name\": ";
+    writeString(os, regions[i].name);
+    os << ", \"cat\": ";
+    writeString(os, regions[i].function);
+    os << ", \"ph\": \"X\", \"pid\": 0, \"tid\": 0"
+       << fixed << setprecision(3)
+       << ", \"ts\": " << starts[i] / 1000.0
+       << ", \"dur\": " << counter.nanoseconds / 1000.0
+       << ", \"args\": {\"count\": " << counter.count;
+    for (Profiler::HardwareEvent event : profiler.getHardwareEvents()) {
+      if (profiler.hasHardwareCounts(i)) {
+        os << ", \"" << Profiler::getHardwareEventName(event) << "\": "
+           << profiler.getHardwareCount(i, event);
+      }
     }
-    
-    void visit(const For *op) {
-      Stmt body = rewrite(op->body);
-      
-      stmt = For::make(op->var, op->domain, body);
+    os << "}}";
+    first = false;
+  }
+  os << "\n]}\n";
+}
+
+void writeProfile(ostream& os, ProfileFormat format) {
+  const Profiler& profiler = Profiler::getInstance();
+  switch (format) {
+    case ProfileJSON:
+      writeJSON(os, profiler);
+      break;
+    case ProfileChromeTrace:
+      writeChromeTrace(os, profiler);
+      break;
+  }
+}
+
+void resetProfile() {
+  Profiler::getInstance().reset();
+}
+
+bool enableHardwareCounters() {
+  return Profiler::getInstance().enableHardwareCounters();
+}
+
+
+// Probe insertion
+/// The first line `stmt` prints as, without indentation.
+static string getFirstLine(Stmt stmt) {
+  string line = util::toString(stmt);
+  line = line.substr(0, line.find('\n'));
+  size_t first = line.find_first_not_of(' ');
+  return (first == string::npos) ? line : line.substr(first);
+}
+
+/// True if `stmt` contains a loop.
+static bool containsLoop(Stmt stmt) {
+  class ContainsLoop : public IRQuery {
+    using IRQuery::visit;
+    void visit(const For*)      {result = true;}
+    void visit(const ForRange*) {result = true;}
+    void visit(const While*)    {result = true;}
+  };
+  return ContainsLoop().query(stmt);
+}
+
+class InsertTimers : public IRRewriter {
+public:
+  Func insert(Func func) {
+    this->function = func.getName();
+    int region = addRegion(function);
+    parents.push_back(region);
+    Stmt body = rewrite(func.getBody());
+    parents.pop_back();
+    return Func(func, probe(region, body));
+  }
+
+private:
+  string function;
+  vector<int> parents;
+
+  using IRRewriter::visit;
+
+  int addRegion(const string& name) {
+    int parent = parents.empty() ? -1 : parents.back();
+    return Profiler::getInstance().addRegion(function, name, parent);
+  }
+
+  /// Time `stmt` as `region`.
+  static Stmt probe(int region, Stmt stmt) {
+    if (region == -1) {
+      return stmt;
     }
-  
-    Var getTimeVar() {
-      return timeStartVar;
+    return Block::make({CallStmt::make({}, intrinsics::profileBegin(),{region}),
+                        stmt,
+                        CallStmt::make({}, intrinsics::profileEnd(), {region})});
+  }
+
+  /// Time `op` as a region without subregions, named by the first line it
+  /// prints as.
+  void timeLeaf(Stmt op) {
+    stmt = probe(addRegion(getFirstLine(op)), op);
+  }
+
+  void visit(const AssignStmt *op)  {timeLeaf(op);}
+  void visit(const TensorWrite *op) {timeLeaf(op);}
+  void visit(const FieldWrite *op)  {timeLeaf(op);}
+  void visit(const Store *op)       {timeLeaf(op);}
+  void visit(const Map *op)         {timeLeaf(op);}
+  void visit(const CallStmt *op)    {timeLeaf(op);}
+  void visit(const For *op)         {timeLeaf(op);}
+
+  void visit(const ForRange *op) {
+    if (!containsLoop(op->body)) {
+      timeLeaf(op);
+      return;
     }
-  private:
-    int counter = 0;
-    Var timeStartVar = Var(INTERNAL_PREFIX("simit_internal_time_var"), Float);
-    InsertTimers() {};
-    InsertTimers(InsertTimers const&)    = delete;
-    void operator=(InsertTimers const&)  = delete;
-
-    Var initTimer(string line, Stmt& stmt) {
-      TimerStorage::getInstance().addTimedLine(line);
-      Stmt timeStartStmt =
-          CallStmt::make({getTimeVar()}, intrinsics::clock(), {});
-      stmt = Block::make(timeStartStmt, stmt);
-      return timeStartVar;
+    int region = addRegion(getFirstLine(op));
+    parents.push_back(region);
+    Stmt body = rewrite(op->body);
+    parents.pop_back();
+    stmt = probe(region, ForRange::make(op->var, op->start, op->end, body));
+  }
+
+  void visit(const While *op) {
+    if (!containsLoop(op->body)) {
+      timeLeaf(op);
+      return;
     }
+    int region = addRegion(getFirstLine(op));
+    parents.push_back(region);
+    Stmt body = rewrite(op->body);
+    parents.pop_back();
+    stmt = probe(region, While::make(op->condition, body));
+  }
 
-    void storeTimer(Stmt& stmt, Var& timeStartVar) {
-      Var clock(INTERNAL_PREFIX("clock"), Float);
-      Stmt clockDecl = VarDecl::make(clock);
-      Stmt clockStmt = CallStmt::make({clock}, intrinsics::clock(), {});
-      Expr subtraction = Sub::make(clock, VarExpr::make(timeStartVar));
-      Stmt store = CallStmt::make({}, intrinsics::storeTime(),
-          {counter, subtraction});
-      stmt = Block::make({clockDecl, stmt, clockStmt, store});
-      counter++;
+  /// Inlined calls are commented with the call they replace
+  void visit(const Comment *op) {
+    if (!op->commentedStmt.defined()) {
+      stmt = op;
+      return;
     }
+    int region = addRegion(op->comment);
+    parents.push_back(region);
+    Stmt body = rewrite(op->commentedStmt);
+    parents.pop_back();
+    stmt = probe(region, Comment::make(op->comment, body, op->footerSpace,
+                                       op->headerSpace));
+  }
 };
 
 Func insertTimers(Func func) {
-  Var timeStartVar = InsertTimers::getInstance().getTimeVar();
-  Func timerFunc = Func(func, Block::make(VarDecl::make(timeStartVar), 
-        func.getBody()));
-  timerFunc = InsertTimers::getInstance().rewrite(timerFunc);
-  return timerFunc;
+  return InsertTimers().insert(func);
 }
 
 }}
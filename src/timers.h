@@ -1,90 +1,205 @@
 #ifndef SIMIT_TIMERS_H
 #define SIMIT_TIMERS_H
 
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include <time.h>
+
 #include "ir.h"
+#include "util/thread_pool.h"
 
 namespace simit {
 namespace ir {
 
-void printTimes();
+/// Formats of the profiles written by writeProfile.
+enum ProfileFormat {
+  /// A JSON object with the regions, their parents, execution counts, total
+  /// and self times in nanoseconds and hardware counts, if enabled. The counts
+  /// of regions that ran parallel loops on worker threads are null.
+  ProfileJSON,
+  /// The Chrome trace event format, which chrome://tracing and Perfetto show
+  /// as a flame graph. Each region is a complete event as long as its total
+  /// time, laid out after its preceding siblings within its parent.
+  ProfileChromeTrace
+};
+
+/// Write the time spent in the regions of the functions compiled with
+/// Program::compileWithTimers, since they were compiled or since the last call
+/// to resetProfile.
+void writeProfile(std::ostream& os, ProfileFormat format=ProfileJSON);
+
+/// Zero the times and execution counts of the profiled regions.
+void resetProfile();
+
+/// Also count cycles, instructions, cache misses and branch misses in each
+/// profiled region, using Linux perf events. Returns false if none of the
+/// counters can be opened, e.g. on other systems, in containers that block
+/// perf_event_open or if kernel.perf_event_paranoid is above 2, in which case
+/// profiles only hold times and say why. Counts are for the thread that runs
+/// the function, so regions that run parallel loops on worker threads have no
+/// counts (see Profiler::hasHardwareCounts).
+bool enableHardwareCounters();
+
+/// Insert probes that time the statements of `func`. The function body, the
+/// calls inlined into it and the loops that contain other loops are timed as
+/// regions that contain the regions of their statements. Other statements,
+/// including set loops and innermost loops, are timed as a whole, so that
+/// probes neither run per iteration of a kernel nor serialize parallel loops.
 Func insertTimers(Func func);
 
-// Singleton
-class TimerStorage {
+/// A region of a profiled function.
+struct ProfileRegion {
+  /// The function the region belongs to.
+  std::string function;
+  /// The statement, inlined call or loop of the region.
+  std::string name;
+  /// The region that contains this region, or -1 for function bodies.
+  int parent;
+};
+
+/// Holds the regions of profiled functions and their counters. Regions get
+/// their counter slot when functions are compiled, and the counters are
+/// preallocated, so probes only read the clock and update their slot.
+class Profiler {
 public:
-  static TimerStorage& getInstance() {
-    static TimerStorage instance; 
+  /// The maximum number of regions. Statements compiled after this many
+  /// regions are registered are not profiled.
+  static const int kMaxRegions = 1 << 16;
+
+  struct Counter {
+    uint64_t start;
+    uint64_t nanoseconds;
+    uint64_t count;
+  };
+
+  enum HardwareEvent {
+    Cycles,
+    Instructions,
+    CacheMisses,
+    BranchMisses,
+    kNumHardwareEvents
+  };
+
+  static const char* getHardwareEventName(HardwareEvent event);
+
+  static Profiler& getInstance() {
+    static Profiler instance;
     return instance;
   }
 
-  inline std::vector<std::string>& getSourceLines() {
-    return sourceLines;
+  /// Register a region, returning its counter slot, or -1 if there are
+  /// kMaxRegions regions.
+  int addRegion(const std::string& function, const std::string& name,
+                int parent);
+
+  const std::vector<ProfileRegion>& getRegions() const {
+    return regions;
   }
 
-  inline void addSourceLines(std::stringstream& ss) {
-    for (std::string line; getline(ss, line); sourceLines.push_back(line));
+  const Counter& getCounter(int region) const {
+    return counters[region];
   }
 
-  inline void addTimedLine(std::string line) {
-    timedLines.push_back(line);
+  /// Open the hardware counters, returning whether any could be opened.
+  bool enableHardwareCounters();
+
+  /// The hardware events that are counted, if any.
+  const std::vector<HardwareEvent>& getHardwareEvents() const {
+    return hardwareEvents;
   }
 
-  inline int getTimedLineIndex(std::string line) {
-    size_t pos = find(timedLines.begin(), timedLines.end(),
-        line.c_str()) - timedLines.begin();
-    if (pos >= timedLines.size()){
-      pos = -1;
-    }
-    return pos;
+  /// Why some or all of the hardware counters could not be opened.
+  const std::string& getHardwareCounterError() const {
+    return hardwareCounterError;
   }
 
-  inline void storeTime(size_t index, double time) {
-    while (timerCount.size() < index + 1) {
-      timerCount.push_back(0);
-      timerSums.push_back(0);
-    }
-    timerCount[index] += 1;
-    timerSums[index] += time;
+  /// The number of `event`s in `region`. Only valid if the event is counted.
+  uint64_t getHardwareCount(int region, HardwareEvent event) const {
+    return eventCounters[region].total[event];
   }
 
-  inline double getTime(int index) {
-    return timerSums[index];
+  /// False if the hardware counts of `region` are incomplete because it ran a
+  /// parallel loop on worker threads, which the counters do not follow.
+  bool hasHardwareCounts(int region) const {
+    return eventCounters && !eventCounters[region].parallel;
   }
 
-  inline unsigned long long int getCounter(int index) {
-    return timerCount[index];
+  /// A monotonic timestamp in nanoseconds. clock_gettime is served by the
+  /// vDSO and, unlike rdtsc, needs no calibration to convert to time.
+  static inline uint64_t now() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
   }
 
-  inline void deleteIndex(int index) {
-	timedLines.erase(timedLines.begin()+index);
-	timerSums.erase(timerSums.begin()+index);
-	timerCount.erase(timerCount.begin()+index);
+  inline void begin(int region) {
+    if (eventCounters) {
+      EventCounter& counter = eventCounters[region];
+      counter.started = readHardwareCounters(counter.start);
+      counter.startParallelLoops =
+          util::ThreadPool::getInstance().getNumParallelLoops();
+    }
+    counters[region].start = now();
   }
 
-  inline double getTotalTime() {
-    if (totalTime==-1) {
-    	totalTime = 0;
-    	for(auto const &time : timerSums) {
-    		totalTime += time;
-    	}
+  inline void end(int region) {
+    Counter& counter = counters[region];
+    counter.nanoseconds += now() - counter.start;
+    counter.count += 1;
+    if (eventCounters) {
+      endHardwareCounters(region);
     }
-    return totalTime;
   }
 
-  inline double getTimingPercentage(int index) {
-    return getTime(index) * 100.0 / getTotalTime(); 
+  /// Add `time` to the user timer `timer` (see the storeTime intrinsic).
+  void storeTime(int timer, double time);
+
+  const std::vector<double>& getTimerSums() const {
+    return timerSums;
   }
-  
-  private:
-    std::vector<std::string> sourceLines;
-    std::vector<std::string> timedLines;
-    std::vector<double> timerSums;
-    std::vector<unsigned long long int> timerCount;
-    double totalTime;
-
-    TimerStorage() {totalTime=-1;};
-    TimerStorage(TimerStorage const&)    = delete;
-    void operator=(TimerStorage const&)  = delete;
+
+  const std::vector<uint64_t>& getTimerCounts() const {
+    return timerCounts;
+  }
+
+  void reset();
+
+private:
+  struct EventCounter {
+    uint64_t start[kNumHardwareEvents];
+    uint64_t total[kNumHardwareEvents];
+    bool started;   // the counters were read when the region began
+    unsigned long startParallelLoops;
+    bool parallel;  // the region ran parallel loops on worker threads
+  };
+
+  std::vector<ProfileRegion> regions;
+  std::unique_ptr<Counter[]> counters;
+
+  /// The perf event group of the hardware counters, whose leader is first,
+  /// and the event each of them counts. The event counters are only
+  /// allocated if the group could be opened.
+  std::vector<int> eventFds;
+  std::vector<HardwareEvent> hardwareEvents;
+  std::unique_ptr<EventCounter[]> eventCounters;
+  std::string hardwareCounterError;
+
+  std::vector<double> timerSums;
+  std::vector<uint64_t> timerCounts;
+
+  Profiler() : counters(new Counter[kMaxRegions]()) {}
+  ~Profiler();
+  Profiler(Profiler const&)           = delete;
+  void operator=(Profiler const&)     = delete;
+
+  /// Read the hardware counters into `values`, indexed by HardwareEvent.
+  /// Returns false, leaving `values` as they are, if they cannot be read.
+  bool readHardwareCounters(uint64_t* values);
+  void endHardwareCounters(int region);
 };
 
 }}
@@ -224,10 +224,18 @@ private:
 };
 
 struct Field {
-  Field(std::string name, Type type) : name(name), type(type) {}
+  /// How the tensors of a set field are laid out in memory. AoS stores the
+  /// components of each element together, while SoA stores each component of
+  /// all the elements together, so that component c of element i is at
+  /// c*size + i, where size is the number of elements in the set.
+  enum Layout {AoS, SoA};
+
+  Field(std::string name, Type type, Layout layout=AoS)
+      : name(name), type(type), layout(layout) {}
 
   std::string name;
   Type type;
+  Layout layout;
 };
 
 struct ElementType : TypeNode {
@@ -0,0 +1,115 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace simit {
+namespace util {
+
+/// Set on threads that are executing a parallel loop, so that nested loops
+/// run serially instead of waiting on the pool they are part of.
+static thread_local bool inParallelLoop = false;
+
+// class ThreadPool
+ThreadPool::ThreadPool()
+    : body(nullptr), size(0), grainSize(1), next(0), generation(0), busy(0),
+      stopping(false), numParallelLoops(0) {
+}
+
+ThreadPool::~ThreadPool() {
+  stop();
+}
+
+void ThreadPool::parallelFor(int n, unsigned numThreads,
+                             const function<void(int,int)>& body) {
+  if (n <= 0) {
+    return;
+  }
+  if (numThreads <= 1 || n == 1 || inParallelLoop) {
+    body(0, n);
+    return;
+  }
+
+  lock_guard<std::mutex> jobLock(jobMutex);
+  if (workers.size() != numThreads-1) {
+    resize(numThreads-1);
+  }
+  ++numParallelLoops;
+
+  {
+    lock_guard<std::mutex> lock(mutex);
+    this->body = &body;
+    this->size = n;
+    // Several chunks per thread so that uneven iterations balance out
+    this->grainSize = max(1, n / (int)(numThreads * 8));
+    this->next = 0;
+    this->busy = workers.size();
+    ++generation;
+  }
+  workReady.notify_all();
+
+  inParallelLoop = true;
+  runChunks();
+  inParallelLoop = false;
+
+  unique_lock<std::mutex> lock(mutex);
+  workDone.wait(lock, [this]{return busy == 0;});
+  this->body = nullptr;
+}
+
+void ThreadPool::resize(unsigned numWorkers) {
+  stop();
+  for (unsigned i = 0; i < numWorkers; ++i) {
+    workers.push_back(thread(&ThreadPool::workerLoop, this, generation));
+  }
+}
+
+void ThreadPool::stop() {
+  {
+    lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  workReady.notify_all();
+  for (auto& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+  stopping = false;
+}
+
+void ThreadPool::workerLoop(unsigned generation) {
+  inParallelLoop = true;
+  unsigned seen = generation;
+  while (true) {
+    {
+      unique_lock<std::mutex> lock(mutex);
+      workReady.wait(lock, [&]{return stopping || this->generation != seen;});
+      if (stopping) {
+        return;
+      }
+      seen = this->generation;
+    }
+
+    runChunks();
+
+    {
+      lock_guard<std::mutex> lock(mutex);
+      if (--busy == 0) {
+        workDone.notify_one();
+      }
+    }
+  }
+}
+
+void ThreadPool::runChunks() {
+  while (true) {
+    int start = next.fetch_add(grainSize);
+    if (start >= size) {
+      break;
+    }
+    (*body)(start, min(start + grainSize, size));
+  }
+}
+
+}}
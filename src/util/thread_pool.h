@@ -0,0 +1,74 @@
+#ifndef SIMIT_THREAD_POOL_H
+#define SIMIT_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace simit {
+namespace util {
+
+/// A pool of worker threads that execute parallel loops. The workers are
+/// started on the first parallel loop and are restarted if a loop asks for a
+/// different number of threads. Loops issued from inside a parallel loop run
+/// serially on the calling thread.
+class ThreadPool {
+public:
+  static ThreadPool& getInstance() {
+    static ThreadPool instance;
+    return instance;
+  }
+
+  ~ThreadPool();
+
+  /// Executes `body(start, end)` on sub-ranges that together cover [0, n),
+  /// using `numThreads` threads including the calling thread. Returns once
+  /// every sub-range has been executed.
+  void parallelFor(int n, unsigned numThreads,
+                   const std::function<void(int,int)>& body);
+
+  /// The number of threads started by the pool, including the caller.
+  unsigned getNumThreads() const {return workers.size() + 1;}
+
+  /// The number of loops that have run on the workers, as opposed to serially
+  /// on the calling thread.
+  unsigned long getNumParallelLoops() const {return numParallelLoops;}
+
+private:
+  std::vector<std::thread> workers;
+
+  /// Serializes parallel loops issued by different user threads.
+  std::mutex jobMutex;
+
+  std::mutex mutex;
+  std::condition_variable workReady;
+  std::condition_variable workDone;
+
+  // The current job. Workers claim `grainSize` iterations at a time from
+  // `next` until the range is exhausted.
+  const std::function<void(int,int)>* body;
+  int size;
+  int grainSize;
+  std::atomic<int> next;
+
+  unsigned generation;
+  unsigned busy;
+  bool stopping;
+
+  std::atomic<unsigned long> numParallelLoops;
+
+  ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  void resize(unsigned numWorkers);
+  void stop();
+  void workerLoop(unsigned generation);
+  void runChunks();
+};
+
+}}
+#endif
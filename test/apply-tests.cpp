@@ -29,6 +29,33 @@ TEST(apply, vertices) {
   ASSERT_EQ(6.0, (int)a.get(v2));
 }
 
+TEST(apply, soa_fields) {
+  Set points;
+  FieldRef<simit_float,3> x = points.addField<simit_float,3>("x", Set::SoA);
+  FieldRef<simit_float,3> v = points.addField<simit_float,3>("v", Set::SoA);
+  FieldRef<simit_float> m = points.addField<simit_float>("m");
+  ElementRef p0 = points.add();
+  ElementRef p1 = points.add();
+  x.set(p0, {1.0, 2.0, 3.0});
+  x.set(p1, {4.0, 5.0, 6.0});
+  v.set(p0, {1.0, 1.0, 1.0});
+  v.set(p1, {1.0, 2.0, 3.0});
+  m.set(p0, 1.0);
+  m.set(p1, 2.0);
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.runSafe();
+
+  SIMIT_ASSERT_FLOAT_EQ(2.0, x.get(p0)(0));
+  SIMIT_ASSERT_FLOAT_EQ(3.0, x.get(p0)(1));
+  SIMIT_ASSERT_FLOAT_EQ(4.0, x.get(p0)(2));
+  SIMIT_ASSERT_FLOAT_EQ(6.0, x.get(p1)(0));
+  SIMIT_ASSERT_FLOAT_EQ(9.0, x.get(p1)(1));
+  SIMIT_ASSERT_FLOAT_EQ(12.0, x.get(p1)(2));
+}
+
 TEST(apply, edges_no_endpoints) {
   Set V;
   ElementRef v0 = V.add();
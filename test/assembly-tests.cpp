@@ -163,6 +163,32 @@ TEST(assembly, edges_binary) {
   ASSERT_EQ((int)a(v2), 1);
 }
 
+TEST(assembly, edges_max) {
+  Set V;
+  ElementRef v0 = V.add();
+  ElementRef v1 = V.add();
+  ElementRef v2 = V.add();
+  ElementRef v3 = V.add();
+  FieldRef<int> a = V.addField<int>("a");
+
+  Set E(V,V);
+  FieldRef<int> w = E.addField<int>("w");
+  w(E.add(v0,v1)) = 3;
+  w(E.add(v1,v2)) = 5;
+  w(E.add(v2,v3)) = -4;
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  ASSERT_EQ( 3, (int)a(v0));
+  ASSERT_EQ( 5, (int)a(v1));
+  ASSERT_EQ( 5, (int)a(v2));
+  ASSERT_EQ(-4, (int)a(v3));
+}
+
 TEST(assembly, edges_tertiary) {
   Set V;
   ElementRef v0 = V.add();
@@ -291,6 +317,49 @@ TEST(assembly, matrix_vv) {
   ASSERT_EQ(2, (int)b(v2));
 }
 
+TEST(assembly, matrix_vv_high_valence) {
+  // A hub connected to every other vertex, with the other vertices connected
+  // in a chain, so that rows have very different lengths
+  const int n = 300;
+  Set V;
+  FieldRef<int> a = V.addField<int>("a");
+  FieldRef<int> b = V.addField<int>("b");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(V.add());
+    a(vertices[i]) = i % 11;
+  }
+
+  Set E(V,V);
+  vector<pair<int,int>> edges;
+  for (int i = n-1; i > 0; --i) {
+    edges.push_back({(i%2 == 0) ? 0 : i, (i%2 == 0) ? i : 0});
+    if (i < n-1) {
+      edges.push_back({i+1, i});
+    }
+  }
+  for (auto& edge : edges) {
+    E.add(vertices[edge.first], vertices[edge.second]);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  vector<int> expected(n, 0);
+  for (auto& edge : edges) {
+    int u = edge.first;
+    int w = edge.second;
+    expected[u] += 1*(u % 11) + 2*(w % 11);
+    expected[w] += 3*(u % 11) + 4*(w % 11);
+  }
+  for (int i = 0; i < n; ++i) {
+    ASSERT_EQ(expected[i], (int)b(vertices[i])) << "vertex " << i;
+  }
+}
+
 TEST(assembly, matrix_ve_heterogeneous) {
   Set V0;
   FieldRef<int> b0 = V0.addField<int>("b");
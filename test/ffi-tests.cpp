@@ -53,6 +53,73 @@ void dgetMat(int n,  int m,  int** rowptr, int** colidx,
   getMat(n, m, rowptr, colidx, nn, mm, vals);
 }
 
+// The columns of the nonzero blocks in each block row of the matrices returned
+// by getStructuredMat
+static vector<vector<int>> structuredMatColumns;
+
+/// The component (i,j) of the matrices returned by getStructuredMat.
+static double structuredMatValue(int i, int j) {
+  return 1.0 + (7*i + 3*j) % 5;
+}
+
+/// Computes B*(B*x), where B is the matrix returned by getStructuredMat with
+/// `n` block rows of `bs`x`bs` blocks.
+static vector<double> structuredMatSquareTimes(int n, int bs,
+                                               vector<double> x) {
+  for (int k = 0; k < 2; ++k) {
+    vector<double> y(n*bs, 0.0);
+    for (int i = 0; i < n; ++i) {
+      for (int j : structuredMatColumns[i]) {
+        for (int bi = 0; bi < bs; ++bi) {
+          for (int bj = 0; bj < bs; ++bj) {
+            y[i*bs+bi] += structuredMatValue(i*bs+bi, j*bs+bj) * x[j*bs+bj];
+          }
+        }
+      }
+    }
+    x = y;
+  }
+  return x;
+}
+
+template<typename Float>
+void getStructuredMat(int n,  int m,  int** rowptr, int** colidx,
+                      int nn, int mm, Float** vals) {
+  int nnz = 0;
+  for (auto& columns : structuredMatColumns) {
+    nnz += columns.size();
+  }
+  *rowptr = static_cast<int*>(simit_malloc((n/nn+1) * sizeof(int)));
+  *colidx = static_cast<int*>(simit_malloc(nnz * sizeof(int)));
+  *vals = static_cast<Float*>(simit_malloc(nnz*nn*mm * sizeof(Float)));
+
+  int ij = 0;
+  (*rowptr)[0] = 0;
+  for (int i = 0; i < n/nn; ++i) {
+    for (int j : structuredMatColumns[i]) {
+      (*colidx)[ij] = j;
+      for (int bi = 0; bi < nn; ++bi) {
+        for (int bj = 0; bj < mm; ++bj) {
+          (*vals)[ij*nn*mm + bi*mm + bj] = structuredMatValue(i*nn+bi,
+                                                              j*mm+bj);
+        }
+      }
+      ++ij;
+    }
+    (*rowptr)[i+1] = ij;
+  }
+}
+extern "C"
+void sgetStructuredMat(int n,  int m,  int** rowptr, int** colidx,
+                       int nn, int mm, float** vals) {
+  getStructuredMat(n, m, rowptr, colidx, nn, mm, vals);
+}
+extern "C"
+void dgetStructuredMat(int n,  int m,  int** rowptr, int** colidx,
+                       int nn, int mm, double** vals) {
+  getStructuredMat(n, m, rowptr, colidx, nn, mm, vals);
+}
+
 static bool noargsVisited = false;
 extern "C" int snoargs() {
   noargsVisited = true;
@@ -642,7 +709,6 @@ TEST(ffi, matrix_result_generics) {
   ASSERT_EQ(-10.0, (double)a(v2));
 }
 
-#ifdef EIGEN
 TEST(ffi, extern_matrix_multiply) {
   Set V;
   FieldRef<simit_float> a = V.addField<simit_float>("a");
@@ -658,11 +724,75 @@ TEST(ffi, extern_matrix_multiply) {
   Function func = loadFunction(TEST_FILE_NAME, "main");
   if (!func.defined()) FAIL();
   func.bind("V", &V);
-  func.runSafe();
 
-  // Check that outputs are correct
-  ASSERT_EQ(131.0, (double)a(v0));
-  ASSERT_EQ(241.0, (double)a(v1));
-  ASSERT_EQ(394.0, (double)a(v2));
+  // The second run reuses the structure of the product computed by the first
+  for (int i = 0; i < 2; ++i) {
+    func.runSafe();
+
+    // Check that outputs are correct
+    ASSERT_EQ(131.0, (double)a(v0));
+    ASSERT_EQ(241.0, (double)a(v1));
+    ASSERT_EQ(394.0, (double)a(v2));
+  }
+}
+
+TEST(ffi, extern_matrix_multiply_blocked) {
+  structuredMatColumns = {{0, 1}, {1, 2}, {0, 2}};
+
+  Set V;
+  FieldRef<simit_float,2> a = V.addField<simit_float,2>("a");
+  FieldRef<simit_float,2> b = V.addField<simit_float,2>("b");
+  vector<ElementRef> vertices;
+  vector<double> x;
+  for (int i = 0; i < 3; ++i) {
+    vertices.push_back(V.add());
+    b.set(vertices[i], {(simit_float)(i+1), (simit_float)(2-i)});
+    x.push_back(i+1);
+    x.push_back(2-i);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+
+  vector<double> expected = structuredMatSquareTimes(3, 2, x);
+  for (int run = 0; run < 2; ++run) {
+    func.runSafe();
+    for (int i = 0; i < 3; ++i) {
+      TensorRef<simit_float,2> ai = a.get(vertices[i]);
+      SIMIT_ASSERT_FLOAT_EQ(expected[2*i],   ai(0));
+      SIMIT_ASSERT_FLOAT_EQ(expected[2*i+1], ai(1));
+    }
+  }
+}
+
+TEST(ffi, extern_matrix_multiply_structure) {
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  vector<ElementRef> vertices;
+  vector<double> x;
+  for (int i = 0; i < 3; ++i) {
+    vertices.push_back(V.add());
+    b.set(vertices[i], (simit_float)(i+1));
+    x.push_back(i+1);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+
+  // The structure of the operands changes between runs, so the structure of
+  // the product must be recomputed
+  for (auto columns : {vector<vector<int>>{{0}, {1}, {2}},
+                       vector<vector<int>>{{0, 1}, {0, 1, 2}, {2}},
+                       vector<vector<int>>{{2}, {0}, {1}}}) {
+    structuredMatColumns = columns;
+    func.runSafe();
+
+    vector<double> expected = structuredMatSquareTimes(3, 1, x);
+    for (int i = 0; i < 3; ++i) {
+      SIMIT_ASSERT_FLOAT_EQ(expected[i], (simit_float)a.get(vertices[i]));
+    }
+  }
 }
-#endif
@@ -1,13 +1,25 @@
 #include "simit-test.h"
 
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+
 #include "tensor.h"
 #include "tensor_data.h"
 #include "graph.h"
 #include "ir.h"
+#include "program.h"
+#include "timers.h"
+#include "util/thread_pool.h"
 #include "lower/index_expressions/lower_scatter_workspace.h"
 
 using namespace simit::ir;
 
+namespace simit {
+extern std::string kBackend;
+extern std::string kObjectCacheDir;
+}
+
 TEST(Function, bindSet) {
   Type vertexType = ElementType::make("Vertex", {Field("field", Int)});
   Type vertexSetType = UnstructuredSetType::make(vertexType, {});
@@ -137,3 +149,168 @@ TEST(Function, bindSparseTensor) {
   ASSERT_EQ(-3, A_vals[2]);
   ASSERT_EQ(-4, A_vals[3]);
 }
+
+TEST(Function, objectCache) {
+  if (simit::kBackend != "cpu") {
+    return;
+  }
+
+  char cacheDir[] = "/tmp/simit-object-cache-XXXXXX";
+  ASSERT_NE(nullptr, mkdtemp(cacheDir));
+  std::string oldCacheDir = simit::kObjectCacheDir;
+  simit::kObjectCacheDir = cacheDir;
+
+  auto listCache = [&]() {
+    std::vector<std::string> files;
+    DIR* dir = opendir(cacheDir);
+    while (dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name != "." && name != "..") {
+        files.push_back(name);
+      }
+    }
+    closedir(dir);
+    return files;
+  };
+
+  Var a("a", Int);
+  Var b("b", Int);
+  Stmt neg = AssignStmt::make(a, -b);
+  Environment env;
+  env.addExtern(a);
+  env.addExtern(b);
+
+  // The first compilation stores the object, the second loads it
+  for (int i = 0; i < 2; ++i) {
+    simit::Function function = getTestBackend()->compile(neg, env);
+    simit::Tensor<int> aArg = 0;
+    simit::Tensor<int> bArg = 42 + i;
+    function.bind("a", &aArg);
+    function.bind("b", &bArg);
+    function.runSafe();
+    ASSERT_EQ(-42 - i, aArg);
+    ASSERT_EQ(1u, listCache().size());
+  }
+
+  for (const std::string& file : listCache()) {
+    std::remove((std::string(cacheDir) + "/" + file).c_str());
+  }
+  std::remove(cacheDir);
+  simit::kObjectCacheDir = oldCacheDir;
+}
+
+TEST(Function, profile) {
+  if (simit::kBackend != "cpu") {
+    return;
+  }
+
+  simit::Program program;
+  ASSERT_EQ(0, program.loadString(
+      "export func main()\n"
+      "  var x = 0;\n"
+      "  for i in 0:3\n"
+      "    for j in 0:4\n"
+      "      x = x + j;\n"
+      "    end\n"
+      "  end\n"
+      "end\n"));
+
+  Profiler& profiler = Profiler::getInstance();
+  size_t firstRegion = profiler.getRegions().size();
+  simit::Function function = program.compileWithTimers("main");
+  ASSERT_TRUE(function.defined());
+  const std::vector<ProfileRegion>& regions = profiler.getRegions();
+  ASSERT_LT(firstRegion, regions.size());
+
+  function.runSafe();
+  function.runSafe();
+
+  // The function body is a region that runs once per run, and the inner loop
+  // is a region within the outer loop that runs once per outer iteration
+  int body = -1;
+  int innerLoop = -1;
+  for (size_t i = firstRegion; i < regions.size(); ++i) {
+    if (regions[i].parent == -1) {
+      body = i;
+    }
+    else if (profiler.getCounter(i).count == 6u &&
+             regions[regions[i].parent].parent != -1) {
+      innerLoop = i;
+    }
+  }
+  ASSERT_NE(-1, body);
+  ASSERT_NE(-1, innerLoop);
+  ASSERT_EQ(2u, profiler.getCounter(body).count);
+  ASSERT_LE(profiler.getCounter(innerLoop).nanoseconds,
+            profiler.getCounter(body).nanoseconds);
+
+  std::stringstream json;
+  writeProfile(json);
+  ASSERT_NE(std::string::npos, json.str().find("\"self_ns\""));
+
+  resetProfile();
+  ASSERT_EQ(0u, profiler.getCounter(body).count);
+}
+
+TEST(Function, profileHardwareCounters) {
+  if (simit::kBackend != "cpu") {
+    return;
+  }
+
+  // Machines without perf events, such as some CI containers, profile times
+  // only, and report why
+  Profiler& profiler = Profiler::getInstance();
+  if (!enableHardwareCounters()) {
+    ASSERT_TRUE(profiler.getHardwareEvents().empty());
+    ASSERT_FALSE(profiler.getHardwareCounterError().empty());
+    return;
+  }
+
+  simit::Program program;
+  ASSERT_EQ(0, program.loadString(
+      "export func main()\n"
+      "  var x = 0;\n"
+      "  for i in 0:1000\n"
+      "    x = x + i;\n"
+      "  end\n"
+      "end\n"));
+  size_t firstRegion = profiler.getRegions().size();
+  simit::Function function = program.compileWithTimers("main");
+  ASSERT_TRUE(function.defined());
+  function.runSafe();
+
+  // The function body is the first region of the function
+  for (Profiler::HardwareEvent event : profiler.getHardwareEvents()) {
+    if (event == Profiler::Cycles || event == Profiler::Instructions) {
+      ASSERT_LT(0u, profiler.getHardwareCount(firstRegion, event));
+    }
+  }
+
+  std::stringstream json;
+  writeProfile(json);
+  ASSERT_NE(std::string::npos, json.str().find("\"hardware_counters\""));
+}
+
+TEST(Function, profileHardwareCountersParallel) {
+  Profiler& profiler = Profiler::getInstance();
+  if (!enableHardwareCounters()) {
+    return;
+  }
+
+  // The counters only follow the calling thread, so regions that run loops on
+  // the workers of the thread pool have no counts
+  int serial = profiler.addRegion("test", "serial", -1);
+  int parallel = profiler.addRegion("test", "parallel", -1);
+  ASSERT_NE(-1, parallel);
+  profiler.begin(serial);
+  profiler.end(serial);
+  profiler.begin(parallel);
+  simit::util::ThreadPool::getInstance().parallelFor(16, 2, [](int, int) {});
+  profiler.end(parallel);
+  ASSERT_TRUE(profiler.hasHardwareCounts(serial));
+  ASSERT_FALSE(profiler.hasHardwareCounts(parallel));
+
+  std::stringstream json;
+  writeProfile(json);
+  ASSERT_NE(std::string::npos, json.str().find("\"cycles\": null"));
+}
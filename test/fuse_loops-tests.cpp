@@ -0,0 +1,126 @@
+#include "simit-test.h"
+
+#include "ir.h"
+#include "ir_visitor.h"
+#include "fuse_loops.h"
+
+using namespace std;
+using namespace simit::ir;
+
+/// Returns the number of set loops in `func`.
+static int countLoops(Func func) {
+  int loops = 0;
+  match(func.getBody(),
+    function<void(const For*,Matcher*)>([&](const For* op, Matcher* ctx) {
+      ++loops;
+      ctx->match(op->body);
+    })
+  );
+  return loops;
+}
+
+class FuseLoops : public ::testing::Test {
+protected:
+  FuseLoops()
+      : V("V", UnstructuredSetType::make(ElementType::make("V", {}), {})),
+        vectorType(TensorType::make(ScalarType::Float,
+                                    {IndexDomain(IndexSet(V))})),
+        a("a", vectorType), b("b", vectorType), c("c", vectorType),
+        s("s", Float), stmp("stmp", Float) {}
+
+  Var V;
+  Type vectorType;
+  Var a, b, c;
+  Var s, stmp;
+
+  /// A loop over V that computes `result(i) = operand(i)`.
+  Stmt copy(Var result, Var operand) {
+    Var i("i", Int);
+    return For::make(i, ForDomain(IndexSet(V)),
+                     TensorWrite::make(result, {i}, TensorRead::make(operand,{i})));
+  }
+
+  /// A loop over V that accumulates `operand` into `result`.
+  Stmt sum(Var result, Var operand) {
+    Var i("i", Int);
+    return For::make(i, ForDomain(IndexSet(V)),
+                     AssignStmt::make(result, TensorRead::make(operand, {i}),
+                                      CompoundOperator::Add));
+  }
+
+  Func makeFunc(Stmt body) {
+    return Func("f", {V, b}, {c}, body);
+  }
+};
+
+TEST_F(FuseLoops, elementwise) {
+  Func func = makeFunc(Block::make({VarDecl::make(a), copy(a, b),
+                                    VarDecl::make(c), copy(c, a)}));
+  ASSERT_EQ(1, countLoops(fuseLoops(func, false)));
+}
+
+TEST_F(FuseLoops, indirectRead) {
+  // c(i) = a(j) reads elements of a that later iterations of the first loop
+  // write, so the loops may not be fused
+  Var i("i", Int);
+  Var j("j", Int);
+  Stmt gather = For::make(i, ForDomain(IndexSet(V)),
+      Block::make(VarDecl::make(j),
+                  Block::make(AssignStmt::make(j, Sub::make(i, 1)),
+                              TensorWrite::make(c, {i},
+                                                TensorRead::make(a, {j})))));
+  Func func = makeFunc(Block::make({VarDecl::make(a), copy(a, b),
+                                    VarDecl::make(c), gather}));
+  ASSERT_EQ(2, countLoops(fuseLoops(func, false)));
+}
+
+TEST_F(FuseLoops, reduction) {
+  // The initialization of the reduction is hoisted before the fused loop,
+  // and the read of its result is sunk after it
+  Stmt body = Block::make({VarDecl::make(a), copy(a, b),
+                           VarDecl::make(stmp), AssignStmt::make(stmp, 0.0),
+                           sum(stmp, b),
+                           VarDecl::make(s), AssignStmt::make(s, stmp),
+                           VarDecl::make(c), copy(c, a)});
+  Func fused = fuseLoops(makeFunc(body), false);
+  ASSERT_EQ(1, countLoops(fused));
+
+  vector<string> order;
+  match(fused.getBody(),
+    function<void(const AssignStmt*)>([&](const AssignStmt* op) {
+      order.push_back(op->var.getName());
+    }),
+    function<void(const For*,Matcher*)>([&](const For* op, Matcher* ctx) {
+      order.push_back("loop");
+    })
+  );
+  ASSERT_EQ(vector<string>({"stmp", "loop", "s"}), order);
+
+  // Loops that reduce into scalars also run in parallel
+  ASSERT_EQ(1, countLoops(fuseLoops(makeFunc(body), true)));
+}
+
+TEST_F(FuseLoops, serial) {
+  // The second loop assigns s in every iteration, so it runs serially and is
+  // kept apart from parallel loops
+  Var i("i", Int);
+  Stmt last = For::make(i, ForDomain(IndexSet(V)),
+                        AssignStmt::make(s, TensorRead::make(b, {i})));
+  Stmt body = Block::make({VarDecl::make(a), copy(a, b),
+                           VarDecl::make(s), last,
+                           VarDecl::make(c), copy(c, a)});
+  ASSERT_EQ(1, countLoops(fuseLoops(makeFunc(body), false)));
+  ASSERT_EQ(3, countLoops(fuseLoops(makeFunc(body), true)));
+}
+
+TEST_F(FuseLoops, reductionRead) {
+  // The second loop needs the result of the reduction
+  Var i("i", Int);
+  Stmt scale = For::make(i, ForDomain(IndexSet(V)),
+                         TensorWrite::make(c, {i},
+                                           Mul::make(TensorRead::make(b, {i}),
+                                                     VarExpr::make(s))));
+  Stmt body = Block::make({VarDecl::make(s), AssignStmt::make(s, 0.0),
+                           sum(s, b), VarDecl::make(c), scale});
+  ASSERT_EQ(2, countLoops(fuseLoops(makeFunc(body), false)));
+}
@@ -61,6 +61,101 @@ TEST(Set, IncreaseCapacity) {
   ASSERT_EQ(count, 1029);
 }
 
+TEST(Set, Reserve) {
+  Set myset;
+  auto fld = myset.addField<int>("foo");
+  fld.set(myset.add(), 42);
+
+  myset.reserve(5000);
+  ASSERT_GE(myset.getCapacity(), 5000);
+  int capacity = myset.getCapacity();
+  for (int i=1; i<5000; i++) {
+    fld.set(myset.add(), i);
+  }
+  ASSERT_EQ(capacity, myset.getCapacity());
+
+  ASSERT_EQ(5000, myset.getSize());
+  for (auto elem : myset) {
+    ASSERT_EQ((elem.getIdent() == 0) ? 42 : elem.getIdent(), fld.get(elem));
+  }
+}
+
+TEST(Set, AddN) {
+  Set myset;
+  auto fld = myset.addField<int>("foo");
+  myset.add();
+
+  ElementRef first = myset.addN(3000);
+  ASSERT_EQ(1, first.getIdent());
+  ASSERT_EQ(3001, myset.getSize());
+  for (auto elem : myset) {
+    ASSERT_EQ(0, fld.get(elem));
+  }
+}
+
+TEST(Set, AlignedBuffers) {
+  Set points;
+  Set springs(points, points);
+  auto x = points.addField<double,3>("x");
+  auto m = points.addField<bool>("m");
+  auto k = springs.addField<float>("k");
+
+  ElementRef p0 = points.add();
+  ElementRef s0 = springs.add(p0, p0);
+  x.set(p0, {1.0, 2.0, 3.0});
+  m.set(p0, true);
+  k.set(s0, 4.0f);
+  for (int i = 0; i < 3000; ++i) {
+    springs.add(p0, points.add());
+  }
+
+  for (void* data : {points.getFieldData("x"), points.getFieldData("m"),
+                     springs.getFieldData("k"),
+                     (void*)springs.getEndpointsData()}) {
+    ASSERT_EQ(0u, (uintptr_t)data % kBufferAlignment);
+  }
+  ASSERT_EQ(2.0, x.get(p0)(1));
+  ASSERT_TRUE(m.get(p0));
+  ASSERT_EQ(4.0f, k.get(s0));
+  ASSERT_EQ(p0, springs.getEndpoint(s0, 1));
+}
+
+/// Counts the bytes it allocates and frees.
+class CountingAllocator : public AlignedAllocator {
+public:
+  size_t allocated = 0;
+  size_t freed = 0;
+
+  void* allocate(size_t size) {
+    allocated += size;
+    return AlignedAllocator::allocate(size);
+  }
+
+  void deallocate(void* ptr, size_t size) {
+    freed += size;
+    AlignedAllocator::deallocate(ptr, size);
+  }
+};
+
+TEST(Set, Allocator) {
+  CountingAllocator allocator;
+  setAllocator(&allocator);
+  {
+    Set points;
+    Set springs(points, points);
+    points.addField<double,3>("x", Set::SoA);
+    springs.addField<double>("k");
+    ElementRef p0 = points.add();
+    for (int i = 0; i < 3000; ++i) {
+      springs.add(p0, points.add());
+    }
+    ASSERT_GE(allocator.allocated, 3001 * (3*sizeof(double) + sizeof(double) +
+                                           2*sizeof(int)));
+  }
+  setAllocator(nullptr);
+  ASSERT_EQ(allocator.allocated, allocator.freed);
+}
+
 TEST(Set, FieldAccessByName) {
   Set myset;
   
@@ -209,6 +304,54 @@ TEST(Field, Tensor) {
   SIMIT_ASSERT_FLOAT_EQ(6.6, t4(1,0,0));
 }
 
+TEST(Field, SoA) {
+  Set points;
+  FieldRef<simit_float,3> x = points.addField<simit_float,3>("x", Set::SoA);
+  FieldRef<simit_float,2,2> m = points.addField<simit_float,2,2>("m",
+                                                                 Set::SoA);
+
+  // Grow past the initial capacity, which moves the components
+  const int n = 3000;
+  for (int i = 0; i < n; ++i) {
+    ElementRef p = points.add();
+    x.set(p, {1.0*i, 2.0*i, 3.0*i});
+    TensorRef<simit_float,2,2> mat = m.get(p);
+    mat(0,1) = i;
+    mat(1,0) = -i;
+  }
+  ASSERT_LT(n, points.getCapacity());
+
+  // Component c of element i is at c*capacity + i
+  int capacity = points.getCapacity();
+  simit_float* data = (simit_float*)points.getFieldData("x");
+  for (auto p : points) {
+    int i = p.getIdent();
+    SIMIT_ASSERT_FLOAT_EQ(3.0*i, x.get(p)(2));
+    for (int c = 0; c < 3; ++c) {
+      SIMIT_ASSERT_FLOAT_EQ((c+1.0)*i, data[c*capacity + i]);
+    }
+    SIMIT_ASSERT_FLOAT_EQ(i, m.get(p)(0,1));
+    SIMIT_ASSERT_FLOAT_EQ(-i, m.get(p)(1,0));
+    SIMIT_ASSERT_FLOAT_EQ(0.0, m.get(p)(1,1));
+  }
+
+  // Packed to the set size, as compiled code expects
+  points.shrinkToFit();
+  ASSERT_EQ(n, points.getCapacity());
+  data = (simit_float*)points.getFieldData("x");
+  for (auto p : points) {
+    int i = p.getIdent();
+    SIMIT_ASSERT_FLOAT_EQ(2.0*i, x.get(p)(1));
+    SIMIT_ASSERT_FLOAT_EQ(2.0*i, data[n + i]);
+    SIMIT_ASSERT_FLOAT_EQ(-i, m.get(p)(1,0));
+  }
+
+  // New elements are zero
+  ElementRef p = points.addN(10);
+  SIMIT_ASSERT_FLOAT_EQ(0.0, x.get(p)(1));
+  SIMIT_ASSERT_FLOAT_EQ(0.0, m.get(p)(0,1));
+}
+
 TEST(Field, boolean) {
   Set points;
   FieldRef<bool> b = points.addField<bool>("b");
@@ -287,6 +430,127 @@ TEST(EdgeSet, EdgeIteratorTest) {
   ASSERT_EQ(count, 4);
 }
 
+TEST(EdgeSet, AddN) {
+  Set points;
+  createElements(&points, 4);
+
+  vector<ElementRef> refs;
+  for (auto p : points) {
+    refs.push_back(p);
+  }
+
+  Set edges(points, points);
+  FieldRef<int> y = edges.addField<int>("y");
+  ElementRef e0 = edges.add(refs[0], refs[1]);
+  y.set(e0, 7);
+
+  vector<int> endpoints;
+  for (int i=0; i<2000; i++) {
+    endpoints.push_back(i%4);
+    endpoints.push_back((i+1)%4);
+  }
+  ElementRef first = edges.addN(2000, endpoints.data());
+  ASSERT_EQ(1, first.getIdent());
+  ASSERT_EQ(2001, edges.getSize());
+
+  ASSERT_EQ(refs[0], edges.getEndpoint(e0,0));
+  ASSERT_EQ(refs[1], edges.getEndpoint(e0,1));
+  ASSERT_EQ(7, y.get(e0));
+  for (auto e : edges) {
+    if (e != e0) {
+      int i = e.getIdent() - 1;
+      ASSERT_EQ(refs[i%4], edges.getEndpoint(e,0));
+      ASSERT_EQ(refs[(i+1)%4], edges.getEndpoint(e,1));
+      ASSERT_EQ(0, y.get(e));
+    }
+  }
+}
+
+TEST(EdgeSet, Remove) {
+  Set points;
+  createElements(&points, 4);
+  vector<ElementRef> refs;
+  for (auto p : points) {
+    refs.push_back(p);
+  }
+
+  Set edges(points, points);
+  FieldRef<int,3> x = edges.addField<int,3>("x");
+  FieldRef<int,2> y = edges.addField<int,2>("y", Set::SoA);
+  vector<ElementRef> edgeRefs;
+  for (int i = 0; i < 4; ++i) {
+    edgeRefs.push_back(edges.add(refs[i], refs[(i+1)%4]));
+    x.set(edgeRefs.back(), {i, 10*i, 100*i});
+    y.set(edgeRefs.back(), {-i, -10*i});
+  }
+
+  // The last edge takes the id of the removed edge, with all its data
+  edges.remove(edgeRefs[1]);
+  ASSERT_EQ(3, edges.getSize());
+  ASSERT_EQ(refs[3], edges.getEndpoint(edgeRefs[1], 0));
+  ASSERT_EQ(refs[0], edges.getEndpoint(edgeRefs[1], 1));
+  ASSERT_EQ(300, x.get(edgeRefs[1])(2));
+  ASSERT_EQ(-30, y.get(edgeRefs[1])(1));
+}
+
+TEST(EdgeSet, RemoveAll) {
+  Set points;
+  FieldRef<int> id = points.addField<int>("id");
+  createElements(&points, 1000);
+  vector<ElementRef> refs;
+  for (auto p : points) {
+    refs.push_back(p);
+  }
+  for (ElementRef p : refs) {
+    id.set(p, p.getIdent());
+  }
+
+  Set edges(points, points);
+  FieldRef<int,2> ends = edges.addField<int,2>("ends", Set::SoA);
+  for (int i = 0; i < 1000; ++i) {
+    ElementRef e = edges.add(refs[i], refs[(i+1)%1000]);
+    ends.set(e, {i, (i+1)%1000});
+  }
+
+  // Remove every third point and the edges that connect them
+  vector<ElementRef> removedPoints;
+  for (int i = 0; i < 1000; i += 3) {
+    removedPoints.push_back(refs[i]);
+  }
+  vector<ElementRef> removedEdges;
+  for (ElementRef e : edges) {
+    if (edges.getEndpoint(e,0).getIdent() % 3 == 0 ||
+        edges.getEndpoint(e,1).getIdent() % 3 == 0) {
+      removedEdges.push_back(e);
+    }
+  }
+  vector<int> edgeRemap = edges.removeAll(removedEdges);
+  vector<int> pointRemap = points.removeAll(removedPoints);
+  edges.remapEndpoints(points, pointRemap);
+
+  ASSERT_EQ(666, points.getSize());
+  ASSERT_EQ(1000, (int)pointRemap.size());
+  for (int i = 0; i < 1000; ++i) {
+    ASSERT_EQ((i % 3 == 0) ? -1 : i - i/3 - 1, pointRemap[i]);
+  }
+  for (ElementRef p : points) {
+    ASSERT_EQ(p.getIdent(), pointRemap[id.get(p)]);
+  }
+
+  // The remaining edges keep their order, data and endpoints
+  ASSERT_EQ(1000 - (int)removedEdges.size(), edges.getSize());
+  int lastEnd = -1;
+  for (ElementRef e : edges) {
+    ASSERT_LT(lastEnd, ends.get(e)(0));
+    lastEnd = ends.get(e)(0);
+    ASSERT_EQ(ends.get(e)(0), id.get(edges.getEndpoint(e,0)));
+    ASSERT_EQ(ends.get(e)(1), id.get(edges.getEndpoint(e,1)));
+  }
+  for (size_t i = 0; i < edgeRemap.size(); ++i) {
+    ASSERT_EQ(i % 3 != 1, edgeRemap[i] == -1);
+  }
+}
+
 TEST(GraphGenerator, createBox) {
   Set points;
   Set edges(points, points);
@@ -0,0 +1,112 @@
+/// Native iterative solvers, which work directly on Simit's blocked CSR
+/// matrices and do not require Eigen.
+#include "simit-test.h"
+
+#include "graph.h"
+#include "program.h"
+
+using namespace std;
+using namespace simit;
+
+/// Assembles the system of solve.sim, with edge weights 2 and 1, and checks
+/// the solution computed by the program in `fileName`.
+static void testSolve(const string& fileName,
+                      const vector<simit_float>& expected,
+                      simit_float initialGuess) {
+  Set V;
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  FieldRef<simit_float> x = V.addField<simit_float>("x");
+  ElementRef v0 = V.add();
+  ElementRef v1 = V.add();
+  ElementRef v2 = V.add();
+  b.set(v0, 2.0);
+  b.set(v1, 1.0);
+  b.set(v2, 4.0);
+  for (ElementRef v : {v0, v1, v2}) {
+    x.set(v, initialGuess);
+  }
+
+  Set E(V,V);
+  FieldRef<simit_float> a = E.addField<simit_float>("a");
+  ElementRef e0 = E.add(v0,v1);
+  ElementRef e1 = E.add(v1,v2);
+  a.set(e0, 2.0);
+  a.set(e1, 1.0);
+
+  Function func = loadFunction(fileName, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  SIMIT_ASSERT_FLOAT_NEAR_EQ(expected[0], (simit_float)x.get(v0));
+  SIMIT_ASSERT_FLOAT_NEAR_EQ(expected[1], (simit_float)x.get(v1));
+  SIMIT_ASSERT_FLOAT_NEAR_EQ(expected[2], (simit_float)x.get(v2));
+}
+
+TEST(solver, cgsolve) {
+  testSolve(TEST_FILE_NAME,
+            {0.202777777777778, -0.013888888888889, 0.802777777777778}, 1.0);
+}
+
+TEST(solver, pcgsolve) {
+  testSolve(TEST_FILE_NAME,
+            {0.202777777777778, -0.013888888888889, 0.802777777777778}, 0.0);
+}
+
+TEST(solver, bicgstabsolve) {
+  // A is not symmetric
+  testSolve(TEST_FILE_NAME,
+            {0.208695652173913, -0.043478260869565, 0.817391304347826}, 0.0);
+}
+
+/// Assembles the 3x3-blocked system of the program in `fileName`, whose
+/// diagonal blocks are not diagonal, and checks its solution.
+static void testBlockedSolve(const string& fileName,
+                             const vector<simit_float>& expected) {
+  Set V;
+  FieldRef<simit_float,3> b = V.addField<simit_float,3>("b");
+  FieldRef<simit_float,3> x = V.addField<simit_float,3>("x");
+  ElementRef v0 = V.add();
+  ElementRef v1 = V.add();
+  ElementRef v2 = V.add();
+  b.set(v0, {1.0, 2.0, 3.0});
+  b.set(v1, {4.0, 5.0, 6.0});
+  b.set(v2, {7.0, 8.0, 9.0});
+
+  Set E(V,V);
+  FieldRef<simit_float,3,3> a = E.addField<simit_float,3,3>("a");
+  ElementRef e0 = E.add(v0,v1);
+  ElementRef e1 = E.add(v1,v2);
+  a.set(e0, {2.0, 1.0, 0.0,  1.0, 3.0, 1.0,  0.0, 1.0, 4.0});
+  a.set(e1, {3.0, 1.0, 1.0,  1.0, 2.0, 0.0,  1.0, 0.0, 5.0});
+
+  Function func = loadFunction(fileName, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  vector<ElementRef> vertices = {v0, v1, v2};
+  for (int i = 0; i < 3; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      SIMIT_ASSERT_FLOAT_NEAR_EQ(expected[i*3+j],
+                                 (simit_float)x.get(vertices[i])(j));
+    }
+  }
+}
+
+TEST(solver, pcgsolve_blocked) {
+  testBlockedSolve(TEST_FILE_NAME,
+                   {0.070036429872495, 0.058925318761384, 0.148633879781421,
+                    0.053187613843352, 0.097632058287796, 0.072131147540984,
+                    0.117137879147858, 0.910374594123703, 0.405880256593015});
+}
+
+TEST(solver, bicgstabsolve_blocked) {
+  // A is not symmetric
+  testBlockedSolve(TEST_FILE_NAME,
+                   {0.071440051430408, 0.051832208293153, 0.142076502732240,
+                    0.047573127611700, 0.126004500160720, 0.098360655737705,
+                    0.142328064511621, 0.966283733735832, 0.448503207412687});
+}
@@ -0,0 +1,161 @@
+#include "simit-test.h"
+
+#include <vector>
+
+#include "init.h"
+#include "graph.h"
+#include "program.h"
+
+using namespace std;
+using namespace simit;
+
+/// Computes matrix-vector products without assembling the matrices for the
+/// duration of a test.
+class MatrixFree {
+public:
+  MatrixFree(bool matrixFree) : oldMatrixFree(kMatrixFree) {
+    kMatrixFree = matrixFree;
+  }
+  ~MatrixFree() {
+    kMatrixFree = oldMatrixFree;
+  }
+private:
+  bool oldMatrixFree;
+};
+
+/// Runs the `main` function of `filename` on a chain of `n` springs, with and
+/// without assembling the matrices, and returns the resulting point fields c.
+static vector<vector<simit_float>> runSprings(string filename, int n) {
+  vector<vector<simit_float>> results;
+  for (bool matrixFree : {false, true}) {
+    MatrixFree matrixFreeScope(matrixFree);
+
+    Set points;
+    FieldRef<simit_float> b = points.addField<simit_float>("b");
+    FieldRef<simit_float> c = points.addField<simit_float>("c");
+    points.addField<int>("id");
+    vector<ElementRef> vertices;
+    for (int i = 0; i < n; ++i) {
+      vertices.push_back(points.add());
+      b.set(vertices[i], 1.0 + i % 5);
+    }
+
+    Set springs(points,points);
+    FieldRef<simit_float> a = springs.addField<simit_float>("a");
+    for (int i = 0; i < n-1; ++i) {
+      ElementRef s = springs.add(vertices[i], vertices[i+1]);
+      a.set(s, 1.0 + i % 3);
+    }
+
+    Function func = loadFunction(filename, "main");
+    if (!func.defined()) return {};
+    func.bind("points", &points);
+    func.bind("springs", &springs);
+    func.runSafe();
+
+    results.push_back({});
+    for (int i = 0; i < n; ++i) {
+      results.back().push_back(c.get(vertices[i]));
+    }
+  }
+  return results;
+}
+
+TEST(matrix_free, gemv) {
+  MatrixFree matrixFree(true);
+
+  Set points;
+  FieldRef<simit_float> b = points.addField<simit_float>("b");
+  FieldRef<simit_float> c = points.addField<simit_float>("c");
+  ElementRef p0 = points.add();
+  ElementRef p1 = points.add();
+  ElementRef p2 = points.add();
+  b.set(p0, 1.0);
+  b.set(p1, 2.0);
+  b.set(p2, 3.0);
+
+  // Taint c
+  c.set(p0, 42.0);
+  c.set(p2, 42.0);
+
+  Set springs(points,points);
+  FieldRef<simit_float> a = springs.addField<simit_float>("a");
+  ElementRef s0 = springs.add(p0,p1);
+  ElementRef s1 = springs.add(p1,p2);
+  a.set(s0, 1.0);
+  a.set(s1, 2.0);
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(1.0, b.get(p0));
+  ASSERT_EQ(2.0, b.get(p1));
+  ASSERT_EQ(3.0, b.get(p2));
+
+  ASSERT_EQ(3.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(10.0, c.get(p2));
+}
+
+TEST(matrix_free, gemv_blocked) {
+  MatrixFree matrixFree(true);
+
+  const int n = 100;
+  Set points;
+  FieldRef<simit_float,2> b = points.addField<simit_float,2>("b");
+  FieldRef<simit_float,2> c = points.addField<simit_float,2>("c");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(points.add());
+    b.set(vertices[i], {(simit_float)(i % 5), (simit_float)(i % 3)});
+  }
+
+  Set springs(points,points);
+  FieldRef<simit_float,2,2> a = springs.addField<simit_float,2,2>("a");
+  for (int i = 0; i < n-1; ++i) {
+    ElementRef s = springs.add(vertices[i], vertices[i+1]);
+    a.set(s, {1.0, 2.0, 3.0, 4.0});
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  for (int i = 0; i < n; ++i) {
+    // Sum of the b of the endpoints of the springs incident to vertex i
+    simit_float sum[2] = {0.0, 0.0};
+    for (int k : {i-1, i, i+1}) {
+      if (k < 0 || k >= n) continue;
+      int numSprings = (k == i) ? (i > 0) + (i < n-1) : 1;
+      sum[0] += numSprings * (k % 5);
+      sum[1] += numSprings * (k % 3);
+    }
+    TensorRef<simit_float,2> ci = c.get(vertices[i]);
+    SIMIT_ASSERT_FLOAT_EQ(1.0*sum[0] + 2.0*sum[1], (simit_float)ci(0));
+    SIMIT_ASSERT_FLOAT_EQ(3.0*sum[0] + 4.0*sum[1], (simit_float)ci(1));
+  }
+}
+
+TEST(matrix_free, cg) {
+  // The matrix is multiplied inside the solver loop
+  auto results = runSprings(TEST_FILE_NAME, 100);
+  ASSERT_EQ(2u, results.size());
+  for (size_t i = 0; i < results[0].size(); ++i) {
+    SIMIT_ASSERT_FLOAT_EQ(results[0][i], results[1][i]);
+  }
+}
+
+TEST(matrix_free, inputs_assigned) {
+  // The spring field the blocks are computed from is assigned between the
+  // products, so the matrix must be assembled
+  auto results = runSprings(TEST_FILE_NAME, 100);
+  ASSERT_EQ(2u, results.size());
+  for (size_t i = 0; i < results[0].size(); ++i) {
+    SIMIT_ASSERT_FLOAT_EQ(results[0][i], results[1][i]);
+  }
+}
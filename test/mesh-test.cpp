@@ -6,12 +6,18 @@
 #include <fstream>
 #include <iostream>
 #include <dirent.h>
+#include <unistd.h>
 
 #include "mesh.h"
+#include "graph.h"
 
 using namespace std;
 using namespace simit;
 
+namespace simit {
+extern int kNumThreads;
+}
+
 TEST(Mesh, MeshlabTest) {
   const string input = R"(####
 #
@@ -309,3 +315,106 @@ const string inputEdge = R"(24  1
   
 }
 
+
+/// Writes `contents` to a new temporary file and returns its name.
+static string writeTempFile(const string& contents) {
+  char fileName[] = "/tmp/simit-mesh-XXXXXX";
+  int fd = mkstemp(fileName);
+  EXPECT_GE(fd, 0);
+  close(fd);
+  ofstream out(fileName);
+  out << contents;
+  return fileName;
+}
+
+TEST(Mesh, LoadFile) {
+  const string input = R"(# polygons, texture and normal indices
+v 0 0 0
+vt 0.5 0.5
+v 1 0 0
+vn 0 0 1
+v 1 1 0
+v 0 1 0.25
+f 1 2 3 4
+f 1/1 2/1 3/1
+f 1//1 3//1 4//1
+#end
+v 5 5 5
+f 1 2 5
+)";
+  string fileName = writeTempFile(input);
+  Mesh m;
+  ASSERT_EQ(0, m.load(fileName));
+  remove(fileName.c_str());
+
+  ASSERT_EQ(4u, m.v.size());
+  ASSERT_EQ(0.25, m.v[3][2]);
+  ASSERT_EQ(4u, m.t.size());
+  vector<array<int,3>> trigs = {{{0,1,2}}, {{0,2,3}}, {{0,1,2}}, {{0,2,3}}};
+  ASSERT_EQ(trigs, m.t);
+
+  ASSERT_EQ(-1, m.load("/nonexistent/simit.obj"));
+
+  // Faces with corners that are not vertex indices are errors
+  string malformed = writeTempFile("v 0 0 0\nv 1 0 0\nv 1 1 0\nf 1 2 x\n");
+  Mesh bad;
+  ASSERT_EQ(-1, bad.load(malformed));
+  remove(malformed.c_str());
+}
+
+TEST(MeshVol, LoadTetFile) {
+  // Large enough to be parsed in several chunks
+  string prefix = string(APPS_DIR) + "/data/tet-dragon/dragon40k";
+  string nodeFile = prefix + ".node";
+  string eleFile = prefix + ".ele";
+
+  MeshVol expected;
+  ifstream nodeIn(nodeFile), eleIn(eleFile);
+  ASSERT_EQ(0, expected.loadTet(nodeIn, eleIn));
+
+  int numThreads = simit::kNumThreads;
+  simit::kNumThreads = 4;
+  MeshVol m;
+  int status = m.loadTet(nodeFile, eleFile);
+  simit::kNumThreads = numThreads;
+  ASSERT_EQ(0, status);
+  ASSERT_EQ(expected.v, m.v);
+  ASSERT_EQ(expected.e, m.e);
+
+  string truncated = writeTempFile("3 3 0 0\n0 0 0 0\n1 1 1 1\n");
+  ASSERT_EQ(-1, m.loadTet(truncated, eleFile));
+  remove(truncated.c_str());
+}
+
+TEST(MeshVol, LoadTetSets) {
+  string prefix = string(TEST_INPUT_DIR) + "/program/fem/bar2k";
+  MeshVol mv;
+  ASSERT_EQ(0, mv.loadTet(prefix + ".node", prefix + ".ele"));
+
+  Set verts;
+  Set tets(verts,verts,verts,verts);
+  FieldRef<double,3> x = verts.addField<double,3>("x");
+  ASSERT_EQ(0, loadTetSets(prefix + ".node", prefix + ".ele", &verts, &tets,
+                           "x"));
+  ASSERT_EQ(mv.v.size(), (size_t)verts.getSize());
+  ASSERT_EQ(mv.e.size(), (size_t)tets.getSize());
+  for (auto vert : verts) {
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(mv.v[vert.getIdent()][i], x.get(vert)(i));
+    }
+  }
+  for (auto tet : tets) {
+    for (int i = 0; i < 4; ++i) {
+      ASSERT_EQ(mv.e[tet.getIdent()][i], tets.getEndpoint(tet,i).getIdent());
+    }
+  }
+
+  // A tet that refers to a missing node leaves the sets unchanged
+  string nodeFile = writeTempFile("2 3 0 0\n0 0 0 0\n1 1 1 1\n");
+  string eleFile = writeTempFile("1 4 0\n0 0 1 0 2\n");
+  ASSERT_EQ(-1, loadTetSets(nodeFile, eleFile, &verts, &tets, "x"));
+  remove(nodeFile.c_str());
+  remove(eleFile.c_str());
+  ASSERT_EQ(mv.v.size(), (size_t)verts.getSize());
+  ASSERT_EQ(mv.e.size(), (size_t)tets.getSize());
+}
@@ -0,0 +1,304 @@
+#include "simit-test.h"
+
+#include <atomic>
+#include <vector>
+
+#include "init.h"
+#include "graph.h"
+#include "coloring.h"
+#include "path_indices.h"
+#include "program.h"
+#include "tensor.h"
+#include "util/thread_pool.h"
+
+using namespace std;
+using namespace simit;
+
+/// Sets the number of threads for the duration of a test.
+class NumThreads {
+public:
+  NumThreads(int numThreads) : oldNumThreads(kNumThreads) {
+    kNumThreads = numThreads;
+  }
+  ~NumThreads() {
+    kNumThreads = oldNumThreads;
+  }
+private:
+  int oldNumThreads;
+};
+
+TEST(parallel, thread_pool) {
+  const int n = 10007;
+  vector<atomic<int>> visits(n);
+  for (auto& visit : visits) {
+    visit = 0;
+  }
+
+  util::ThreadPool::getInstance().parallelFor(n, 4, [&](int start, int end) {
+    for (int i = start; i < end; ++i) {
+      visits[i]++;
+    }
+  });
+
+  for (int i = 0; i < n; ++i) {
+    ASSERT_EQ(1, visits[i].load()) << "iteration " << i;
+  }
+}
+
+TEST(parallel, coloring) {
+  // A triangle mesh strip: triangle i has vertices i, i+1 and i+2
+  const int n = 1000;
+  Set V;
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n+2; ++i) {
+    vertices.push_back(V.add());
+  }
+  Set T(V,V,V);
+  for (int i = 0; i < n; ++i) {
+    T.add(vertices[i], vertices[i+1], vertices[i+2]);
+  }
+
+  auto coloring = T.getColoring();
+  ASSERT_EQ(3, coloring->getNumColors());
+  ASSERT_EQ(coloring, T.getColoring());
+
+  // Each element appears once, and elements of a color share no vertices
+  const int* colorsPtr = coloring->getColorsPtr();
+  const int* elements = coloring->getElements();
+  ASSERT_EQ(n, colorsPtr[coloring->getNumColors()]);
+  vector<bool> seen(n, false);
+  for (int c = 0; c < coloring->getNumColors(); ++c) {
+    vector<bool> used(V.getSize(), false);
+    for (int k = colorsPtr[c]; k < colorsPtr[c+1]; ++k) {
+      int e = elements[k];
+      ASSERT_FALSE(seen[e]);
+      seen[e] = true;
+      ASSERT_EQ(c, coloring->getColor(e));
+      for (int i = 0; i < 3; ++i) {
+        int v = e + i;
+        ASSERT_FALSE(used[v]) << "vertex " << v << " has two elements of "
+                              << "color " << c;
+        used[v] = true;
+      }
+    }
+  }
+
+  // Mutating the set discards the coloring
+  T.add(vertices[0], vertices[1], vertices[2]);
+  auto newColoring = T.getColoring();
+  ASSERT_NE(coloring, newColoring);
+  ASSERT_EQ(4, newColoring->getNumColors());
+  ASSERT_EQ(n+1, newColoring->getColorsPtr()[newColoring->getNumColors()]);
+}
+
+TEST(parallel, path_index) {
+  // Enough vertices and edges that the indices are built in several blocks
+  Set V;
+  Set E(V,V);
+  createBox(&V, &E, 20, 20, 20);
+
+  pe::Var v("v", pe::Set("V"));
+  pe::Var e("e", pe::Set("E"));
+  pe::PathExpression ve = pe::Link::make(v, e, pe::Link::ve);
+  pe::PathExpression ev = pe::Link::make(e, v, pe::Link::ev);
+  pe::Var vi("vi"), vj("vj"), ek("ek");
+  pe::PathExpression vev = pe::And::make({vi,vj},
+                                         {{pe::QuantifiedVar::Exist,ek}},
+                                         ve(vi,ek), ev(ek,vj));
+  pe::PathExpression vevOrVev = pe::Or::make({vi,vj}, {}, vev(vi,vj),
+                                             vev(vi,vj));
+
+  pe::PathIndexBuilder serialBuilder;
+  pe::PathIndexBuilder parallelBuilder;
+  parallelBuilder.setNumThreads(4);
+  for (pe::PathIndexBuilder* builder : {&serialBuilder, &parallelBuilder}) {
+    builder->bind("V", &V);
+    builder->bind("E", &E);
+  }
+
+  for (const pe::PathExpression& pexpr : {ve, ev, vev, vevOrVev}) {
+    pe::PathIndex serial = serialBuilder.buildSegmented(pexpr, 0);
+    pe::PathIndex parallel = parallelBuilder.buildSegmented(pexpr, 0);
+    ASSERT_EQ(serial.numElements(), parallel.numElements());
+    ASSERT_EQ(serial.numNeighbors(), parallel.numNeighbors());
+    for (unsigned elem : serial) {
+      vector<unsigned> serialNbrs, parallelNbrs;
+      for (unsigned nbr : serial.neighbors(elem)) {
+        serialNbrs.push_back(nbr);
+      }
+      for (unsigned nbr : parallel.neighbors(elem)) {
+        parallelNbrs.push_back(nbr);
+      }
+      ASSERT_EQ(serialNbrs, parallelNbrs) << pexpr << ", element " << elem;
+    }
+  }
+}
+
+TEST(parallel, vertices) {
+  NumThreads numThreads(4);
+
+  const int n = 10000;
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(V.add());
+    a.set(vertices[i], i);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.runSafe();
+
+  for (int i = 0; i < n; ++i) {
+    SIMIT_ASSERT_FLOAT_EQ(2.0*i, (simit_float)b.get(vertices[i]));
+  }
+}
+
+TEST(parallel, edges_vector) {
+  NumThreads numThreads(4);
+
+  // A chain of edges, so that neighboring iterations update the same vertex
+  const int n = 10000;
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(V.add());
+    a.set(vertices[i], i % 7);
+  }
+
+  Set E(V,V);
+  FieldRef<simit_float> w = E.addField<simit_float>("w");
+  for (int i = 0; i < n-1; ++i) {
+    ElementRef e = E.add(vertices[i], vertices[i+1]);
+    w.set(e, 2.0);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  for (int i = 0; i < n; ++i) {
+    simit_float expected = 0.0;
+    if (i > 0)   expected += 2.0 * ((i-1) % 7);
+    if (i < n-1) expected += 2.0 * ((i+1) % 7);
+    SIMIT_ASSERT_FLOAT_EQ(expected, (simit_float)b.get(vertices[i]));
+  }
+}
+
+TEST(parallel, edges_matrix) {
+  NumThreads numThreads(4);
+
+  const int n = 10000;
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  FieldRef<simit_float> b = V.addField<simit_float>("b");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(V.add());
+    a.set(vertices[i], i % 5);
+  }
+
+  Set E(V,V);
+  FieldRef<simit_float> w = E.addField<simit_float>("w");
+  for (int i = 0; i < n-1; ++i) {
+    ElementRef e = E.add(vertices[i], vertices[i+1]);
+    w.set(e, 1.0);
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("E", &E);
+  func.runSafe();
+
+  for (int i = 0; i < n; ++i) {
+    simit_float expected = 0.0;
+    if (i > 0) {
+      expected += (i-1) % 5 + i % 5;
+    }
+    if (i < n-1) {
+      expected += i % 5 + (i+1) % 5;
+    }
+    SIMIT_ASSERT_FLOAT_EQ(expected, (simit_float)b.get(vertices[i]));
+  }
+}
+
+TEST(parallel, gemv_blocked) {
+  NumThreads numThreads(4);
+
+  // A chain of springs, multiplied by a blocked matrix that is lowered to a
+  // parallel loop over its rows
+  const int n = 10000;
+  Set points;
+  FieldRef<simit_float,2> b = points.addField<simit_float,2>("b");
+  FieldRef<simit_float,2> c = points.addField<simit_float,2>("c");
+  vector<ElementRef> vertices;
+  for (int i = 0; i < n; ++i) {
+    vertices.push_back(points.add());
+    b.set(vertices[i], {(simit_float)(i % 5), (simit_float)(i % 3)});
+  }
+
+  Set springs(points,points);
+  FieldRef<simit_float,2,2> a = springs.addField<simit_float,2,2>("a");
+  for (int i = 0; i < n-1; ++i) {
+    ElementRef s = springs.add(vertices[i], vertices[i+1]);
+    a.set(s, {1.0, 2.0, 3.0, 4.0});
+  }
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  for (int i = 0; i < n; ++i) {
+    // Sum of the b of the endpoints of the springs incident to vertex i
+    simit_float sum[2] = {0.0, 0.0};
+    for (int k : {i-1, i, i+1}) {
+      if (k < 0 || k >= n) continue;
+      int numSprings = (k == i) ? (i > 0) + (i < n-1) : 1;
+      sum[0] += numSprings * (k % 5);
+      sum[1] += numSprings * (k % 3);
+    }
+    TensorRef<simit_float,2> ci = c.get(vertices[i]);
+    SIMIT_ASSERT_FLOAT_EQ(1.0*sum[0] + 2.0*sum[1], (simit_float)ci(0));
+    SIMIT_ASSERT_FLOAT_EQ(3.0*sum[0] + 4.0*sum[1], (simit_float)ci(1));
+  }
+}
+
+TEST(parallel, vertices_reductions) {
+  NumThreads numThreads(4);
+
+  // Workers reduce into partial results that are combined at the end
+  const int n = 10000;
+  Set V;
+  FieldRef<simit_float> a = V.addField<simit_float>("a");
+  for (int i = 0; i < n; ++i) {
+    ElementRef v = V.add();
+    a.set(v, (i % 1000 == 7) ? 2.0 : 1.0);
+  }
+  a.set(V.add(), 0.5);
+
+  Tensor<simit_float> lo = 42.0;
+  Tensor<simit_float> hi = 42.0;
+  Tensor<simit_float> prod = 42.0;
+
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("V", &V);
+  func.bind("lo", &lo);
+  func.bind("hi", &hi);
+  func.bind("prod", &prod);
+  func.runSafe();
+
+  ASSERT_EQ(0.5, (simit_float)lo);
+  ASSERT_EQ(2.0, (simit_float)hi);
+  ASSERT_EQ(512.0, (simit_float)prod);
+}
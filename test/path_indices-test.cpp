@@ -152,6 +152,110 @@ TEST(pathindex, or) {
 }
 
 
+TEST(pathindex, and_or_unsorted) {
+  PathIndexBuilder builder;
+
+  // The neighbors of ev links are in endpoint order, so they may be unsorted
+  // and contain duplicates. Intersections and unions must sort them.
+  simit::Set V;
+  simit::Set E(V,V);
+  ElementRef v0 = V.add();
+  ElementRef v1 = V.add();
+  ElementRef v2 = V.add();
+  E.add(v2, v0);
+  E.add(v1, v1);
+  E.add(v0, v2);
+
+  PathExpression ev = makeEV();
+  builder.bind("V", &V);
+  builder.bind("E", &E);
+  Var e("e");
+  Var v("v");
+
+  PathExpression evANDev = And::make({e,v}, {}, ev(e,v), ev(e,v));
+  PathIndex evANDevIndex = builder.buildSegmented(evANDev, 0);
+  VERIFY_INDEX(evANDevIndex, nbrs({{0,2}, {1}, {0,2}}));
+
+  PathExpression evORev = Or::make({e,v}, {}, ev(e,v), ev(e,v));
+  PathIndex evORevIndex = builder.buildSegmented(evORev, 0);
+  VERIFY_INDEX(evORevIndex, nbrs({{0,2}, {1}, {0,2}}));
+}
+
+
+/// Asserts that `builder` builds the same indices as a fresh builder with the
+/// same bindings.
+static void assertSameAsFreshBuild(PathIndexBuilder* builder,
+                                   const vector<PathExpression>& pexprs) {
+  PathIndexBuilder freshBuilder;
+  for (string name : {"V", "E"}) {
+    freshBuilder.bind(name, builder->getBinding(simit::pe::Set(name)));
+  }
+  for (const PathExpression& pexpr : pexprs) {
+    PathIndex expected = freshBuilder.buildSegmented(pexpr, 0);
+    PathIndex actual = builder->buildSegmented(pexpr, 0);
+    ASSERT_EQ(expected.numElements(), actual.numElements()) << pexpr;
+    ASSERT_EQ(expected.numNeighbors(), actual.numNeighbors()) << pexpr;
+    for (unsigned elem : expected) {
+      vector<unsigned> expectedNbrs, actualNbrs;
+      for (unsigned nbr : expected.neighbors(elem)) {
+        expectedNbrs.push_back(nbr);
+      }
+      for (unsigned nbr : actual.neighbors(elem)) {
+        actualNbrs.push_back(nbr);
+      }
+      ASSERT_EQ(expectedNbrs, actualNbrs) << pexpr << ", element " << elem;
+    }
+  }
+}
+
+TEST(pathindex, update) {
+  // The builder is kept as the sets change, like Function::init does
+  PathIndexBuilder builder;
+
+  simit::Set V;
+  simit::Set E(V,V);
+  Box box = createBox(&V, &E, 6, 6, 1);
+
+  PathExpression ve = makeVE();
+  PathExpression ev = makeEV();
+  Var vi("vi");
+  Var e("e");
+  Var vj("vj");
+  PathExpression vev = And::make({vi,vj}, {{QuantifiedVar::Exist, e}},
+                                 ve(vi,e), ev(e,vj));
+  PathExpression vevOrVev = Or::make({vi,vj}, {}, vev(vi,vj), vev(vi,vj));
+  PathExpression vevAndVev = And::make({vi,vj}, {}, vev(vi,vj), vev(vi,vj));
+  vector<PathExpression> pexprs = {ve, ev, vev, vevOrVev, vevAndVev};
+
+  builder.bind("V", &V);
+  builder.bind("E", &E);
+  PathIndex vevIndex = builder.buildSegmented(vev, 0);
+  PathIndex vevAndVevIndex = builder.buildSegmented(vevAndVev, 0);
+
+  // Indices over unchanged sets are reused
+  ASSERT_TRUE(vevIndex == builder.buildSegmented(vev, 0));
+  ASSERT_TRUE(vevAndVevIndex == builder.buildSegmented(vevAndVev, 0));
+
+  // Indices are updated when elements are added
+  ElementRef v = V.add();
+  E.add(box(0,0,0), v);
+  E.add(v, box(5,5,0));
+  assertSameAsFreshBuild(&builder, pexprs);
+  ASSERT_FALSE(vevIndex == builder.buildSegmented(vev, 0));
+
+  // ...removed
+  E.remove(box.getEdge(box(2,2,0), box(3,2,0)));
+  assertSameAsFreshBuild(&builder, pexprs);
+
+  // ...or when a set is rebound
+  simit::Set W;
+  simit::Set F(W,W);
+  createBox(&W, &F, 3, 2, 1);
+  builder.bind("V", &W);
+  builder.bind("E", &F);
+  assertSameAsFreshBuild(&builder, pexprs);
+}
+
 TEST(pathindex, exist_and) {
   PathIndexBuilder builder;
 
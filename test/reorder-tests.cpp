@@ -9,6 +9,10 @@
 
 using namespace std;
 using namespace simit;
+
+namespace simit {
+extern bool kReorder;
+}
 void vertexDataChecks(FieldRef<simit_float,3>& x, vector<ElementRef>& vertRefs, 
     FieldRef<simit_float,3>& reorder_x, vector<ElementRef>& reorder_vertRefs,
     vector<int>& newOrdering) {
@@ -469,3 +473,319 @@ TEST(Program, reorderFemTest) {
   unsigned int nSteps = 10;
   femTest(filename, prefix, nSteps);
 }
+
+/// Builds a grid of n^3 points connected by springs along the axes, with the
+/// points added in a scrambled order. Each point records its index as added
+/// in "id", and each spring the ids of its endpoints in "ends", so that tests
+/// can check that reordering moves field data along with the endpoints.
+static void createScrambledGrid(int n, Set* points, Set* springs,
+                                Set::FieldLayout layout,
+                                bool spatialField=true) {
+  FieldRef<double,3> x = points->addField<double,3>("x", layout);
+  FieldRef<int> id = points->addField<int>("id");
+  FieldRef<int,2> ends = springs->addField<int,2>("ends");
+  if (spatialField) {
+    points->setSpatialField("x");
+  }
+
+  int numPoints = n*n*n;
+  vector<ElementRef> refs;
+  for (int i = 0; i < numPoints; ++i) {
+    refs.push_back(points->add());
+    id.set(refs.back(), i);
+  }
+  // Grid point c is point (c * 7919) % numPoints, which scatters neighbors
+  auto point = [&](int gx, int gy, int gz) {
+    return refs[((gx + gy*n + gz*n*n) * 7919) % numPoints];
+  };
+  for (int gz = 0; gz < n; ++gz) {
+    for (int gy = 0; gy < n; ++gy) {
+      for (int gx = 0; gx < n; ++gx) {
+        x.set(point(gx,gy,gz), {(double)gx, (double)gy, (double)gz});
+        int neighbors[3][3] = {{gx+1,gy,gz}, {gx,gy+1,gz}, {gx,gy,gz+1}};
+        for (auto& neighbor : neighbors) {
+          if (neighbor[0] < n && neighbor[1] < n && neighbor[2] < n) {
+            ElementRef p0 = point(gx,gy,gz);
+            ElementRef p1 = point(neighbor[0],neighbor[1],neighbor[2]);
+            ElementRef spring = springs->add(p0, p1);
+            ends.set(spring, {id.get(p0), id.get(p1)});
+          }
+        }
+      }
+    }
+  }
+}
+
+/// The sum over springs of the distance between the indices of their points.
+static long springSpan(const Set& springs) {
+  long span = 0;
+  for (ElementRef spring : springs) {
+    span += abs(springs.getEndpoint(spring, 0).getIdent() -
+                springs.getEndpoint(spring, 1).getIdent());
+  }
+  return span;
+}
+
+/// The sum over springs of the distance between the storage indices of their
+/// points.
+static long storedSpringSpan(Set& springs) {
+  const int* endpoints = springs.getEndpointsData();
+  long span = 0;
+  for (int i = 0; i < springs.getSize(); ++i) {
+    span += abs(endpoints[2*i] - endpoints[2*i+1]);
+  }
+  return span;
+}
+
+static bool isPermutation(vector<int> ordering) {
+  sort(ordering.begin(), ordering.end());
+  for (size_t i = 0; i < ordering.size(); ++i) {
+    if (ordering[i] != (int)i) {
+      return false;
+    }
+  }
+  return true;
+}
+
+TEST(Reorder, heuristics) {
+  for (auto vertexHeuristic : {HilbertOrder, MortonOrder,
+                               ReverseCuthillMcKeeOrder}) {
+    for (auto edgeHeuristic : {SortedEndpointsOrder, MinEndpointOrder}) {
+      for (auto layout : {Set::AoS, Set::SoA}) {
+        Set points;
+        Set springs(points, points);
+        createScrambledGrid(8, &points, &springs, layout);
+        long scrambledSpan = springSpan(springs);
+
+        vector<int> edgeOrdering;
+        vector<int> vertexOrdering;
+        reorder(springs, points, vertexHeuristic, edgeHeuristic,
+                edgeOrdering, vertexOrdering);
+        ASSERT_EQ(points.getSize(), (int)vertexOrdering.size());
+        ASSERT_EQ(springs.getSize(), (int)edgeOrdering.size());
+        ASSERT_TRUE(isPermutation(vertexOrdering));
+        ASSERT_TRUE(isPermutation(edgeOrdering));
+        ASSERT_LT(springSpan(springs), scrambledSpan / 4);
+
+        // Field data moves with the elements
+        FieldRef<double,3> x = points.getField<double,3>("x");
+        FieldRef<int> id = points.getField<int>("id");
+        FieldRef<int,2> ends = springs.getField<int,2>("ends");
+        int minEndpoint = 0;
+        vector<int> lastEndpoints = {0, 0};
+        for (ElementRef spring : springs) {
+          ElementRef p0 = springs.getEndpoint(spring, 0);
+          ElementRef p1 = springs.getEndpoint(spring, 1);
+          ASSERT_EQ(ends.get(spring)(0), id.get(p0));
+          ASSERT_EQ(ends.get(spring)(1), id.get(p1));
+          double distance = 0.0;
+          for (int i = 0; i < 3; ++i) {
+            distance += abs(x.get(p0)(i) - x.get(p1)(i));
+          }
+          ASSERT_EQ(1.0, distance);
+
+          // Edges are in the order of their endpoints
+          vector<int> endpoints = {p0.getIdent(), p1.getIdent()};
+          sort(endpoints.begin(), endpoints.end());
+          if (edgeHeuristic == MinEndpointOrder) {
+            ASSERT_LE(minEndpoint, endpoints[0]);
+            minEndpoint = endpoints[0];
+          }
+          else {
+            ASSERT_TRUE(lastEndpoints <= endpoints);
+            lastEndpoints = endpoints;
+          }
+        }
+        for (ElementRef point : points) {
+          ASSERT_EQ(point.getIdent(), vertexOrdering[id.get(point)]);
+        }
+      }
+    }
+  }
+}
+
+TEST(Reorder, forLocality) {
+  for (bool spatialField : {true, false}) {
+    for (auto layout : {Set::AoS, Set::SoA}) {
+      Set points;
+      Set springs(points, points);
+      createScrambledGrid(8, &points, &springs, layout, spatialField);
+      long scrambledSpan = storedSpringSpan(springs);
+      FieldRef<double,3> x = points.getField<double,3>("x");
+      FieldRef<int> id = points.getField<int>("id");
+      FieldRef<int,2> ends = springs.getField<int,2>("ends");
+      vector<ElementRef> endpoints;
+      for (ElementRef spring : springs) {
+        endpoints.push_back(springs.getEndpoint(spring, 0));
+        endpoints.push_back(springs.getEndpoint(spring, 1));
+      }
+
+      reorderForLocality({&points, &springs, &points});
+      ASSERT_TRUE(points.isReordered());
+      ASSERT_TRUE(springs.isReordered());
+      ASSERT_TRUE(isPermutation(points.getElementOrdering()));
+      ASSERT_TRUE(isPermutation(springs.getElementOrdering()));
+      ASSERT_LT(storedSpringSpan(springs), scrambledSpan / 4);
+
+      // Elements keep their ids, and are stored where the ordering says
+      for (ElementRef point : points) {
+        ASSERT_EQ(point.getIdent(), id.get(point));
+        int index = points.getElementIndex(point);
+        ASSERT_EQ(point, points.getElementAt(index));
+        ASSERT_EQ(point.getIdent(), ((int*)points.getFieldData("id"))[index]);
+      }
+      for (ElementRef spring : springs) {
+        ElementRef p0 = springs.getEndpoint(spring, 0);
+        ElementRef p1 = springs.getEndpoint(spring, 1);
+        ASSERT_EQ(endpoints[2*spring.getIdent()], p0);
+        ASSERT_EQ(endpoints[2*spring.getIdent()+1], p1);
+        ASSERT_EQ(ends.get(spring)(0), id.get(p0));
+        ASSERT_EQ(ends.get(spring)(1), id.get(p1));
+      }
+
+      // Reordered sets are left as they are
+      vector<int> ordering = points.getElementOrdering();
+      reorderForLocality({&points, &springs});
+      ASSERT_EQ(ordering, points.getElementOrdering());
+
+      // Elements added and removed after reordering are addressed by id
+      ElementRef p0 = points.add();
+      ElementRef p1 = *points.begin();
+      id.set(p0, p0.getIdent());
+      x.set(p0, {-1.0, -1.0, -1.0});
+      ElementRef spring = springs.add(p0, p1);
+      ASSERT_EQ(points.getSize()-1, p0.getIdent());
+      ASSERT_EQ(p0, springs.getEndpoint(spring, 0));
+      ASSERT_EQ(p1, springs.getEndpoint(spring, 1));
+      ASSERT_EQ(-1.0, x.get(p0)(2));
+
+      ElementRef removed = points.getElementAt(3);
+      points.remove(removed);
+      ASSERT_TRUE(isPermutation(points.getElementOrdering()));
+      ASSERT_EQ(p0.getIdent(), id.get(removed));
+
+      vector<int> ids;
+      for (ElementRef point : points) {
+        ids.push_back(id.get(point));
+      }
+      vector<int> remap = points.removeAll({points.getElementAt(5),
+                                            points.getElementAt(7)});
+      ASSERT_TRUE(isPermutation(points.getElementOrdering()));
+      for (size_t i = 0; i < remap.size(); ++i) {
+        if (remap[i] != -1) {
+          int index = points.getElementOrdering()[remap[i]];
+          ASSERT_EQ(ids[i], id.get(points.getElementAt(index)));
+        }
+      }
+    }
+  }
+}
+
+TEST(Reorder, forLocalityUnboundEdgeSet) {
+  // Only the points are reordered, but the springs still address them
+  Set points;
+  Set springs(points, points);
+  createScrambledGrid(8, &points, &springs, Set::AoS, true);
+  FieldRef<int> id = points.getField<int>("id");
+  FieldRef<int,2> ends = springs.getField<int,2>("ends");
+  vector<ElementRef> endpoints;
+  for (ElementRef spring : springs) {
+    endpoints.push_back(springs.getEndpoint(spring, 0));
+    endpoints.push_back(springs.getEndpoint(spring, 1));
+  }
+
+  reorderForLocality({&points});
+  ASSERT_TRUE(points.isReordered());
+  ASSERT_FALSE(springs.isReordered());
+  for (ElementRef spring : springs) {
+    ElementRef p0 = springs.getEndpoint(spring, 0);
+    ElementRef p1 = springs.getEndpoint(spring, 1);
+    ASSERT_EQ(endpoints[2*spring.getIdent()], p0);
+    ASSERT_EQ(endpoints[2*spring.getIdent()+1], p1);
+    ASSERT_EQ(ends.get(spring)(0), id.get(p0));
+    ASSERT_EQ(ends.get(spring)(1), id.get(p1));
+  }
+}
+
+TEST(Reorder, removeLastId) {
+  // The element with the last id is not the last stored element
+  Set points;
+  FieldRef<int> id = points.addField<int>("id");
+  for (int i = 0; i < 4; ++i) {
+    points.add();
+  }
+  points.permuteElementIndices({3, 2, 1, 0});
+  for (ElementRef point : points) {
+    id.set(point, point.getIdent());
+  }
+  ElementRef last = points.getElementAt(0);
+  ASSERT_EQ(3, last.getIdent());
+  points.remove(last);
+
+  ASSERT_EQ(3, points.getSize());
+  ASSERT_TRUE(isPermutation(points.getElementOrdering()));
+  for (int index = 0; index < points.getSize(); ++index) {
+    ElementRef point = points.getElementAt(index);
+    ASSERT_LT(point.getIdent(), points.getSize());
+    ASSERT_EQ(index, points.getElementIndex(point));
+    ASSERT_EQ(point.getIdent(), id.get(point));
+  }
+}
+
+TEST(Program, reorderAtInit) {
+  Program program;
+  ASSERT_EQ(0, program.loadString(
+      "element Point\n"
+      "  b : float;\n"
+      "  c : float;\n"
+      "end\n"
+      "element Spring\n"
+      "  k : float;\n"
+      "end\n"
+      "extern points  : set{Point};\n"
+      "extern springs : set{Spring}(points,points);\n"
+      "func stiffness(s : Spring, p : (Point*2)) ->\n"
+      "    (K : tensor[points,points](float))\n"
+      "  K(p(0),p(0)) = s.k;\n"
+      "  K(p(0),p(1)) = -s.k;\n"
+      "  K(p(1),p(0)) = -s.k;\n"
+      "  K(p(1),p(1)) = s.k;\n"
+      "end\n"
+      "export func main()\n"
+      "  K = map stiffness to springs reduce +;\n"
+      "  points.c = K * points.b;\n"
+      "end\n")) << program.getDiagnostics();
+
+  vector<double> results[2];
+  for (bool reorder : {false, true}) {
+    Set points;
+    Set springs(points, points);
+    createScrambledGrid(4, &points, &springs, Set::AoS);
+    FieldRef<simit_float> b = points.addField<simit_float>("b");
+    FieldRef<simit_float> c = points.addField<simit_float>("c");
+    FieldRef<simit_float> k = springs.addField<simit_float>("k");
+    for (ElementRef point : points) {
+      b.set(point, point.getIdent());
+    }
+    for (ElementRef spring : springs) {
+      k.set(spring, 1.0 + spring.getIdent() % 3);
+    }
+
+    bool oldReorder = kReorder;
+    kReorder = reorder;
+    Function func = program.compile("main");
+    func.bind("points", &points);
+    func.bind("springs", &springs);
+    func.runSafe();
+    kReorder = oldReorder;
+
+    ASSERT_EQ(reorder, points.isReordered());
+    for (ElementRef point : points) {
+      results[reorder].push_back(c.get(point));
+    }
+  }
+  ASSERT_EQ(results[0].size(), results[1].size());
+  for (size_t i = 0; i < results[0].size(); ++i) {
+    SIMIT_ASSERT_FLOAT_EQ(results[0][i], results[1][i]);
+  }
+}
@@ -0,0 +1,84 @@
+#include "simit-test.h"
+
+#include <set>
+
+#include "ir.h"
+#include "ir_visitor.h"
+#include "storage.h"
+#include "reuse_buffers.h"
+
+using namespace std;
+using namespace simit::ir;
+
+/// Returns the variables declared in `func`.
+static set<Var> declaredVars(Func func) {
+  set<Var> vars;
+  match(func.getBody(),
+    function<void(const VarDecl*)>([&](const VarDecl* op) {
+      vars.insert(op->var);
+    })
+  );
+  return vars;
+}
+
+class ReuseBuffers : public ::testing::Test {
+protected:
+  ReuseBuffers()
+      : V("V", UnstructuredSetType::make(ElementType::make("V", {}), {})),
+        vectorType(TensorType::make(ScalarType::Float,
+                                    {IndexDomain(IndexSet(V))})),
+        a("a", vectorType), b("b", vectorType), c("c", vectorType),
+        d("d", vectorType), s("s", Float) {}
+
+  Var V;
+  Type vectorType;
+  Var a, b, c, d;
+  Var s;
+
+  /// A loop over V that computes `result(i) = operand(i)`.
+  Stmt copy(Var result, Var operand) {
+    Var i("i", Int);
+    return For::make(i, ForDomain(IndexSet(V)),
+                     Store::make(result, i, Load::make(operand, i)));
+  }
+
+  Func makeFunc(Stmt body) {
+    Func func("f", {V, b}, {c}, body);
+    for (const Var& var : {a, b, c, d}) {
+      func.getStorage().add(var, TensorStorage(TensorStorage::Dense));
+    }
+    return func;
+  }
+};
+
+TEST_F(ReuseBuffers, disjoint) {
+  // a is dead when d is computed, so d can be stored in a's buffer
+  Func func = makeFunc(Block::make({VarDecl::make(a), copy(a, b),
+                                    copy(c, a),
+                                    VarDecl::make(d), copy(d, b),
+                                    copy(c, d)}));
+  set<Var> vars = declaredVars(reuseBuffers(func));
+  ASSERT_EQ(1u, vars.size());
+  ASSERT_EQ(1u, vars.count(a));
+}
+
+TEST_F(ReuseBuffers, overlapping) {
+  // a is read after d is computed
+  Func func = makeFunc(Block::make({VarDecl::make(a), copy(a, b),
+                                    VarDecl::make(d), copy(d, b),
+                                    copy(c, a), copy(c, d)}));
+  ASSERT_EQ(2u, declaredVars(reuseBuffers(func)).size());
+}
+
+TEST_F(ReuseBuffers, loop) {
+  // a is read in every iteration of the while loop, also after d is computed
+  // in an earlier iteration
+  Stmt loop = While::make(Lt::make(s, 10.0),
+                          Block::make({copy(c, a),
+                                       VarDecl::make(d), copy(d, b),
+                                       copy(c, d)}));
+  Func func = makeFunc(Block::make({VarDecl::make(a), copy(a, b),
+                                    VarDecl::make(s), AssignStmt::make(s, 0.0),
+                                    loop}));
+  ASSERT_EQ(3u, declaredVars(reuseBuffers(func)).size());
+}
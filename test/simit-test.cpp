@@ -77,6 +77,7 @@ int main(int argc, char **argv) {
 
   // Handle leftover flags
   std::string simitBackend = "cpu";
+  int simitNumThreads = 1;
   for (int i = 0; i < argc; ++i) {
     std::string arg = argv[i];
     if (arg.substr(0,2) == "--") {
@@ -94,6 +95,9 @@ int main(int argc, char **argv) {
         if (keyValPair[0] == "--backend") {
           simitBackend = keyValPair[1];
         } 
+        else if (keyValPair[0] == "--threads") {
+          simitNumThreads = std::stoi(keyValPair[1]);
+        }
         else {
           std::cerr << "Unrecognized arg: " << keyValPair[0] << std::endl;
           return 1;
@@ -115,12 +119,22 @@ int main(int argc, char **argv) {
   int floatSize = sizeof(double);
 #endif
 
-  simit::init(simitBackend, floatSize);
+  simit::Settings settings;
+  settings.backend = simitBackend;
+  settings.floatSize = floatSize;
+  settings.numThreads = simitNumThreads;
+  simit::init(settings);
+
+  if (PROFILE && !simit::ir::enableHardwareCounters()) {
+    std::cerr << "Profiling without hardware counters: "
+              << simit::ir::Profiler::getInstance().getHardwareCounterError()
+              << std::endl;
+  }
 
   int returnValue = RUN_ALL_TESTS();
 
   if (PROFILE) {
-    simit::ir::printTimes();
+    simit::ir::writeProfile(std::cout);
   }
   return returnValue;
 }
@@ -0,0 +1,242 @@
+#include "simit-test.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <unistd.h>
+#include <vector>
+
+#include "graph.h"
+#include "snapshot.h"
+
+using namespace std;
+using namespace simit;
+
+/// Returns the name of a new empty temporary file.
+static string tempFileName() {
+  char fileName[] = "/tmp/simit-snapshot-XXXXXX";
+  int fd = mkstemp(fileName);
+  simit_iassert(fd >= 0);
+  close(fd);
+  return fileName;
+}
+
+TEST(Snapshot, saveAndLoad) {
+  Set points("points");
+  Set springs("springs", points, points);
+  FieldRef<simit_float,3> x = points.addField<simit_float,3>("x");
+  FieldRef<int> id = points.addField<int>("id");
+  FieldRef<simit_float> k = springs.addField<simit_float>("k");
+  createBox(&points, &springs, 3, 3, 3);
+  points.setSpatialField("x");
+  for (auto p : points) {
+    x.set(p, {1.0*p.getIdent(), 2.0*p.getIdent(), 3.0*p.getIdent()});
+    id.set(p, p.getIdent());
+  }
+  for (auto s : springs) {
+    k.set(s, 0.5*s.getIdent());
+  }
+
+  string fileName = tempFileName();
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points, &springs}));
+
+  Snapshot snapshot;
+  ASSERT_EQ(0, snapshot.load(fileName));
+  remove(fileName.c_str());
+  ASSERT_EQ(2u, snapshot.getSets().size());
+  Set* loadedPoints = snapshot.getSet("points");
+  Set* loadedSprings = snapshot.getSet("springs");
+  ASSERT_NE(nullptr, loadedPoints);
+  ASSERT_NE(nullptr, loadedSprings);
+  ASSERT_EQ(nullptr, snapshot.getSet("triangles"));
+
+  ASSERT_EQ(points.getSize(), loadedPoints->getSize());
+  ASSERT_EQ(springs.getSize(), loadedSprings->getSize());
+  ASSERT_EQ(2, loadedSprings->getCardinality());
+  ASSERT_EQ(loadedPoints, loadedSprings->getEndpointSet(0));
+  ASSERT_EQ(loadedPoints, loadedSprings->getEndpointSet(1));
+  ASSERT_EQ("x", loadedPoints->getSpatialFieldName());
+
+  auto loadedX = loadedPoints->getField<simit_float,3>("x");
+  auto loadedId = loadedPoints->getField<int>("id");
+  for (auto p : *loadedPoints) {
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(x.get(p)(i), loadedX.get(p)(i));
+    }
+    ASSERT_EQ((int)id.get(p), (int)loadedId.get(p));
+  }
+  auto loadedK = loadedSprings->getField<simit_float>("k");
+  for (auto s : *loadedSprings) {
+    ASSERT_EQ((simit_float)k.get(s), (simit_float)loadedK.get(s));
+    ASSERT_EQ(springs.getEndpoint(s,0), loadedSprings->getEndpoint(s,0));
+    ASSERT_EQ(springs.getEndpoint(s,1), loadedSprings->getEndpoint(s,1));
+  }
+}
+
+TEST(Snapshot, modifyAndGrow) {
+  Set points("points");
+  Set springs("springs", points, points);
+  FieldRef<int> id = points.addField<int>("id");
+  createElements(&points, 10);
+  springs.addN(1, vector<int>({0,9}).data());
+  for (auto p : points) {
+    id.set(p, p.getIdent());
+  }
+  string fileName = tempFileName();
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points, &springs}));
+
+  {
+    Snapshot snapshot;
+    ASSERT_EQ(0, snapshot.load(fileName));
+    Set* loadedPoints = snapshot.getSet("points");
+    Set* loadedSprings = snapshot.getSet("springs");
+    auto loadedId = loadedPoints->getField<int>("id");
+
+    // Writes stay in memory
+    for (auto p : *loadedPoints) {
+      loadedId.set(p, -1);
+    }
+
+    // Growing copies the data out of the snapshot
+    ElementRef p = loadedPoints->add();
+    loadedId.set(p, 10);
+    ElementRef s = loadedSprings->add(p, p);
+    ASSERT_EQ(11, loadedPoints->getSize());
+    ASSERT_EQ(2, loadedSprings->getSize());
+    for (auto p : *loadedPoints) {
+      ASSERT_EQ(p.getIdent() < 10 ? -1 : 10, loadedId.get(p));
+    }
+    ElementRef s0 = *loadedSprings->begin();
+    ASSERT_EQ(0, loadedSprings->getEndpoint(s0,0).getIdent());
+    ASSERT_EQ(9, loadedSprings->getEndpoint(s0,1).getIdent());
+    ASSERT_EQ(p, loadedSprings->getEndpoint(s,0));
+  }
+
+  // The file is unchanged
+  Snapshot snapshot;
+  ASSERT_EQ(0, snapshot.load(fileName));
+  remove(fileName.c_str());
+  auto loadedId = snapshot.getSet("points")->getField<int>("id");
+  for (auto p : *snapshot.getSet("points")) {
+    ASSERT_EQ(p.getIdent(), loadedId.get(p));
+  }
+}
+
+TEST(Snapshot, grid) {
+  Set points("points");
+  Set grid("grid", points, {3,4});
+  FieldRef<simit_float> a = grid.addField<simit_float>("a");
+  for (auto e : grid) {
+    a.set(e, e.getIdent());
+  }
+  string fileName = tempFileName();
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points, &grid}));
+
+  Snapshot snapshot;
+  ASSERT_EQ(0, snapshot.load(fileName));
+  remove(fileName.c_str());
+  Set* loadedGrid = snapshot.getSet("grid");
+  ASSERT_EQ(Set::Grid, loadedGrid->getKind());
+  ASSERT_EQ(vector<int>({3,4}), loadedGrid->getDimensions());
+  ASSERT_EQ(grid.getSize(), loadedGrid->getSize());
+  ASSERT_EQ(grid.getGridPoint({2,1}), loadedGrid->getGridPoint({2,1}));
+  ASSERT_EQ(grid.getGridEdge({2,1}, 1), loadedGrid->getGridEdge({2,1}, 1));
+  auto loadedA = loadedGrid->getField<simit_float>("a");
+  for (auto e : *loadedGrid) {
+    ASSERT_EQ((simit_float)a.get(e), (simit_float)loadedA.get(e));
+  }
+}
+
+TEST(Snapshot, soa) {
+  Set points("points");
+  FieldRef<simit_float,3> x = points.addField<simit_float,3>("x", Set::SoA);
+  FieldRef<int> id = points.addField<int>("id", Set::SoA);
+  createElements(&points, 100);
+  for (auto p : points) {
+    x.set(p, {1.0*p.getIdent(), 2.0*p.getIdent(), 3.0*p.getIdent()});
+    id.set(p, p.getIdent());
+  }
+  string fileName = tempFileName();
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points}));
+
+  Snapshot snapshot;
+  ASSERT_EQ(0, snapshot.load(fileName));
+  remove(fileName.c_str());
+  Set* loadedPoints = snapshot.getSet("points");
+  auto loadedX = loadedPoints->getField<simit_float,3>("x");
+  auto loadedId = loadedPoints->getField<int>("id");
+  for (auto p : *loadedPoints) {
+    for (int i = 0; i < 3; ++i) {
+      ASSERT_EQ(x.get(p)(i), loadedX.get(p)(i));
+    }
+    ASSERT_EQ((int)id.get(p), (int)loadedId.get(p));
+  }
+
+  // The components are packed in the file and stay packed when mapped
+  simit_float* data = (simit_float*)loadedPoints->getFieldData("x");
+  ASSERT_EQ(2.0*99, data[100 + 99]);
+
+  ElementRef p = loadedPoints->add();
+  loadedX.set(p, {1.0, 2.0, 3.0});
+  for (auto q : *loadedPoints) {
+    ASSERT_EQ(q == p ? 2.0 : 2.0*q.getIdent(), loadedX.get(q)(1));
+  }
+}
+
+TEST(Snapshot, invalid) {
+  Snapshot snapshot;
+  ASSERT_EQ(-1, snapshot.load("/nonexistent/simit.snapshot"));
+
+  string fileName = tempFileName();
+  ofstream out(fileName);
+  out << "element Point end" << endl;
+  out.close();
+  ASSERT_EQ(-1, snapshot.load(fileName));
+
+  // A truncated snapshot
+  Set points("points");
+  points.addField<int>("id");
+  createElements(&points, 100);
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points}));
+  ASSERT_EQ(0, truncate(fileName.c_str(), 100));
+  ASSERT_EQ(-1, snapshot.load(fileName));
+  remove(fileName.c_str());
+  ASSERT_TRUE(snapshot.getSets().empty());
+}
+
+TEST(Snapshot, gemv) {
+  Set points("points");
+  Set springs("springs", points, points);
+  FieldRef<simit_float> b = points.addField<simit_float>("b");
+  points.addField<simit_float>("c");
+  FieldRef<simit_float> a = springs.addField<simit_float>("a");
+  createElements(&points, 3);
+  springs.addN(2, vector<int>({0,1, 1,2}).data());
+  int i = 0;
+  for (auto p : points) {
+    b.set(p, ++i);
+  }
+  i = 0;
+  for (auto s : springs) {
+    a.set(s, ++i);
+  }
+  string fileName = tempFileName();
+  ASSERT_EQ(0, Snapshot::save(fileName, {&points, &springs}));
+
+  Snapshot snapshot;
+  ASSERT_EQ(0, snapshot.load(fileName));
+  remove(fileName.c_str());
+
+  // The function computes on the data in the snapshot
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+  func.bind("points", snapshot.getSet("points"));
+  func.bind("springs", snapshot.getSet("springs"));
+  func.runSafe();
+
+  auto c = snapshot.getSet("points")->getField<simit_float>("c");
+  vector<simit_float> expected = {3.0, 13.0, 10.0};
+  for (auto p : *snapshot.getSet("points")) {
+    ASSERT_EQ(expected[p.getIdent()], c.get(p));
+  }
+}
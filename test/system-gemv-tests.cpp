@@ -57,6 +57,124 @@ TEST(system, gemv) {
   ASSERT_EQ(10.0, c.get(p2));
 }
 
+TEST(system, gemv_rebind) {
+  // Points
+  Set points;
+  FieldRef<simit_float> b = points.addField<simit_float>("b");
+  FieldRef<simit_float> c = points.addField<simit_float>("c");
+
+  ElementRef p0 = points.add();
+  ElementRef p1 = points.add();
+  ElementRef p2 = points.add();
+
+  b.set(p0, 1.0);
+  b.set(p1, 2.0);
+  b.set(p2, 3.0);
+
+  // Springs
+  Set springs(points,points);
+  FieldRef<simit_float> a = springs.addField<simit_float>("a");
+
+  ElementRef s0 = springs.add(p0,p1);
+  ElementRef s1 = springs.add(p1,p2);
+
+  a.set(s0, 1.0);
+  a.set(s1, 2.0);
+
+  // Compile program and bind arguments
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(3.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(10.0, c.get(p2));
+
+  // Rebinding unchanged sets reuses the matrix, which must be cleared
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(3.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(10.0, c.get(p2));
+
+  // Adding a spring changes the matrix structure
+  ElementRef s2 = springs.add(p2,p0);
+  a.set(s2, 3.0);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(15.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(22.0, c.get(p2));
+}
+
+TEST(system, gemv_rebind_args) {
+  // Points
+  Set points;
+  FieldRef<simit_float> b = points.addField<simit_float>("b");
+  FieldRef<simit_float> c = points.addField<simit_float>("c");
+
+  ElementRef p0 = points.add();
+  ElementRef p1 = points.add();
+  ElementRef p2 = points.add();
+
+  b.set(p0, 1.0);
+  b.set(p1, 2.0);
+  b.set(p2, 3.0);
+
+  // Springs
+  Set springs(points,points);
+  FieldRef<simit_float> a = springs.addField<simit_float>("a");
+
+  ElementRef s0 = springs.add(p0,p1);
+  ElementRef s1 = springs.add(p1,p2);
+
+  a.set(s0, 1.0);
+  a.set(s1, 2.0);
+
+  // Compile program and bind arguments. The function takes an argument, so
+  // it is initialized through the init and deinit harnesses.
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+
+  simit::Tensor<simit_float, 2> scale;
+  scale(0) = 1.0;
+  scale(1) = 1.0;
+
+  func.bind("s", &scale);
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(3.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(10.0, c.get(p2));
+
+  // Rebinding unchanged sets reuses the matrix, which must be cleared
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(3.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(10.0, c.get(p2));
+
+  // Adding a spring changes the matrix structure
+  ElementRef s2 = springs.add(p2,p0);
+  a.set(s2, 3.0);
+  func.bind("springs", &springs);
+  func.runSafe();
+
+  ASSERT_EQ(15.0, c.get(p0));
+  ASSERT_EQ(13.0, c.get(p1));
+  ASSERT_EQ(22.0, c.get(p2));
+}
+
 TEST(system, gemv_stencil) {
   // Points
   Set points;
@@ -903,6 +1021,56 @@ TEST(system, gemv_blocked) {
   ASSERT_EQ(136.0, c2(1));
 }
 
+TEST(system, gemv_blocked3) {
+  // Points
+  Set points;
+  FieldRef<simit_float,3> b = points.addField<simit_float,3>("b");
+  FieldRef<simit_float,3> c = points.addField<simit_float,3>("c");
+
+  ElementRef p0 = points.add();
+  ElementRef p1 = points.add();
+  ElementRef p2 = points.add();
+
+  b.set(p0, {1.0, 2.0, 3.0});
+  b.set(p1, {4.0, 5.0, 6.0});
+  b.set(p2, {7.0, 8.0, 9.0});
+
+  // Springs
+  Set springs(points,points);
+  FieldRef<simit_float,3,3> a = springs.addField<simit_float,3,3>("a");
+
+  ElementRef s0 = springs.add(p0,p1);
+  ElementRef s1 = springs.add(p1,p2);
+
+  a.set(s0, {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0, 8.0, 9.0});
+  a.set(s1, {10.0, 11.0, 12.0, 13.0, 14.0, 15.0, 16.0, 17.0, 18.0});
+
+  // Compile program and bind arguments
+  Function func = loadFunction(TEST_FILE_NAME, "main");
+  if (!func.defined()) FAIL();
+
+  func.bind("points", &points);
+  func.bind("springs", &springs);
+
+  func.runSafe();
+
+  // Check that outputs are correct
+  TensorRef<simit_float,3> c0 = c.get(p0);
+  ASSERT_EQ(46.0, c0(0));
+  ASSERT_EQ(109.0, c0(1));
+  ASSERT_EQ(172.0, c0(2));
+
+  TensorRef<simit_float,3> c1 = c.get(p1);
+  ASSERT_EQ(479.0, c1(0));
+  ASSERT_EQ(659.0, c1(1));
+  ASSERT_EQ(839.0, c1(2));
+
+  TensorRef<simit_float,3> c2 = c.get(p2);
+  ASSERT_EQ(433.0, c2(0));
+  ASSERT_EQ(550.0, c2(1));
+  ASSERT_EQ(667.0, c2(2));
+}
+
 TEST(system, gemv_blocked_nw) {
   // Points
   Set points;
@@ -0,0 +1,115 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "mesh.h"
+#include "path_expressions.h"
+#include "path_indices.h"
+
+using namespace std;
+using namespace simit;
+using namespace simit::pe;
+
+/// Times path index construction on a tetrahedral mesh, building the indices
+/// that Function::init builds for a FEM style program: the vertex-tet and
+/// tet-vertex links, the vertex-vertex index of tet assembly, and the
+/// intersection and union of that index with itself. Also times rebuilding
+/// the memoized indices after a tet is added to the mesh, which recomputes
+/// only the changed rows but still visits every row.
+///
+/// Usage: simit-bench-pathindex <node-file> <ele-file> [repetitions [threads]]
+/// e.g. apps/data/tet-dragon/dragon40k.node apps/data/tet-dragon/dragon40k.ele
+int main(int argc, const char* argv[]) {
+  if (argc < 3 || argc > 5) {
+    cerr << "Usage: simit-bench-pathindex <node-file> <ele-file> "
+         << "[repetitions [threads]]" << endl;
+    return 3;
+  }
+  int repetitions = (argc >= 4) ? atoi(argv[3]) : 10;
+  int numThreads = (argc >= 5) ? atoi(argv[4]) : 1;
+
+  MeshVol mesh;
+  if (mesh.loadTet(argv[1], argv[2]) < 0) {
+    cerr << "Error loading mesh" << endl;
+    return 2;
+  }
+
+  simit::Set V;
+  simit::Set T(V,V,V,V);
+  vector<ElementRef> vertices;
+  for (size_t i = 0; i < mesh.v.size(); ++i) {
+    vertices.push_back(V.add());
+  }
+  for (auto& tet : mesh.e) {
+    T.add(vertices[tet[0]], vertices[tet[1]], vertices[tet[2]],
+          vertices[tet[3]]);
+  }
+  cout << "vertices: " << V.getSize() << ", tets: " << T.getSize() << endl;
+
+  Var v("v", simit::pe::Set("V"));
+  Var t("t", simit::pe::Set("T"));
+  PathExpression vt = Link::make(v, t, Link::ve);
+  PathExpression tv = Link::make(t, v, Link::ev);
+
+  Var vi("vi"), vj("vj"), tk("tk");
+  PathExpression vtv = And::make({vi,vj}, {{QuantifiedVar::Exist,tk}},
+                                 vt(vi,tk), tv(tk,vj));
+  PathExpression vtvAnd = And::make({vi,vj}, {}, vtv(vi,vj), vtv(vi,vj));
+  PathExpression vtvOr = Or::make({vi,vj}, {}, vtv(vi,vj), vtv(vi,vj));
+
+  struct Benchmark {
+    string name;
+    PathExpression pexpr;
+  };
+  vector<Benchmark> benchmarks = {{"ve", vt}, {"ev", tv}, {"vev", vtv},
+                                  {"vev and vev", vtvAnd},
+                                  {"vev or vev", vtvOr}};
+
+  cout << left << setw(14) << "index" << right << setw(15) << "neighbors"
+       << setw(13) << "build" << setw(13) << "update" << endl;
+  for (auto& benchmark : benchmarks) {
+    double total = 0.0;
+    double totalUpdate = 0.0;
+    unsigned numNeighbors = 0;
+    for (int r = 0; r < repetitions; ++r) {
+      // A fresh builder, so that no index is memoized from a previous run
+      PathIndexBuilder builder;
+      builder.setNumThreads(numThreads);
+      builder.bind("V", &V);
+      builder.bind("T", &T);
+
+      auto start = chrono::steady_clock::now();
+      PathIndex index = builder.buildSegmented(benchmark.pexpr, 0);
+      auto end = chrono::steady_clock::now();
+      total += chrono::duration<double,milli>(end - start).count();
+      numNeighbors = index.numNeighbors();
+    }
+
+    // Local topology change: add a tet and update the memoized index
+    PathIndexBuilder builder;
+    builder.setNumThreads(numThreads);
+    builder.bind("V", &V);
+    builder.bind("T", &T);
+    builder.buildSegmented(benchmark.pexpr, 0);
+    for (int r = 0; r < repetitions; ++r) {
+      auto& tet = mesh.e[r % mesh.e.size()];
+      T.add(vertices[tet[0]], vertices[tet[1]], vertices[tet[2]],
+            vertices[tet[3]]);
+
+      auto start = chrono::steady_clock::now();
+      builder.buildSegmented(benchmark.pexpr, 0);
+      auto end = chrono::steady_clock::now();
+      totalUpdate += chrono::duration<double,milli>(end - start).count();
+    }
+
+    cout << left << setw(14) << benchmark.name << right << setw(15)
+         << numNeighbors << fixed << setprecision(3) << setw(10)
+         << total/repetitions << " ms" << setw(10)
+         << totalUpdate/repetitions << " ms" << endl;
+  }
+  return 0;
+}
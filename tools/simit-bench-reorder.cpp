@@ -0,0 +1,173 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+#include "init.h"
+#include "program.h"
+#include "reorder.h"
+
+using namespace std;
+using namespace simit;
+
+static const int kNumSpmvs = 50;
+
+/// A program that assembles a matrix with 3x3 blocks from springs, and
+/// multiplies it by a vector once (`once`) or kNumSpmvs times (`repeated`).
+static const string kProgram =
+    "element Point\n"
+    "  x : tensor[3](float);\n"
+    "  b : tensor[3](float);\n"
+    "  c : tensor[3](float);\n"
+    "end\n"
+    "element Spring\n"
+    "  a : tensor[3,3](float);\n"
+    "end\n"
+    "extern points  : set{Point};\n"
+    "extern springs : set{Spring}(points,points);\n"
+    "func dist_a(s : Spring, p : (Point*2)) ->\n"
+    "    (M : tensor[points,points](tensor[3,3](float)))\n"
+    "  M(p(0),p(0)) = s.a;\n"
+    "  M(p(0),p(1)) = s.a;\n"
+    "  M(p(1),p(0)) = s.a;\n"
+    "  M(p(1),p(1)) = s.a;\n"
+    "end\n"
+    "export func once()\n"
+    "  A = map dist_a to springs reduce +;\n"
+    "  points.c = A * points.b;\n"
+    "end\n"
+    "export func repeated()\n"
+    "  A = map dist_a to springs reduce +;\n"
+    "  for k in 0:" + to_string(kNumSpmvs) + "\n"
+    "    points.c = A * points.b;\n"
+    "  end\n"
+    "end\n";
+
+/// Builds a box of springs whose points and springs are in random order, as
+/// they often are in meshes from external tools.
+static void createScrambledBox(Set* points, Set* springs, int boxSize) {
+  FieldRef<double,3> x = points->addField<double,3>("x");
+  points->addField<double,3>("b");
+  points->addField<double,3>("c");
+  springs->addField<double,3,3>("a");
+  Box box = createBox(points, springs, boxSize, boxSize, boxSize);
+  for (int i = 0; i < boxSize; ++i) {
+    for (int j = 0; j < boxSize; ++j) {
+      for (int k = 0; k < boxSize; ++k) {
+        x.set(box(i,j,k), {(double)i, (double)j, (double)k});
+      }
+    }
+  }
+  points->setSpatialField("x");
+  fill_n((double*)points->getFieldData("b"), points->getSize()*3, 1.0);
+  fill_n((double*)springs->getFieldData("a"), springs->getSize()*9, 1.0);
+
+  mt19937 random(0);
+  vector<int> vertexOrdering(points->getSize());
+  vector<int> edgeOrdering(springs->getSize());
+  for (vector<int>* ordering : {&vertexOrdering, &edgeOrdering}) {
+    for (size_t i = 0; i < ordering->size(); ++i) {
+      (*ordering)[i] = i;
+    }
+    shuffle(ordering->begin(), ordering->end(), random);
+  }
+  reorderVertexSet(*springs, *points, vertexOrdering);
+  reorderEdgeSet(*springs, edgeOrdering);
+}
+
+/// Returns the fastest of `repetitions` runs of `function`, in milliseconds.
+static double time(Function function, int repetitions) {
+  function.init();
+  double fastest = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    auto start = chrono::steady_clock::now();
+    function.run();
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double,milli>(end - start).count();
+    fastest = (r == 0) ? ms : min(fastest, ms);
+  }
+  return fastest;
+}
+
+/// Times reordering a scrambled box of springs with each vertex and edge
+/// ordering heuristic, and the assembly and sparse matrix-vector product of a
+/// 3x3 blocked matrix on the reordered box. Assembly is timed with one product,
+/// and the time of a product is the difference between a program that
+/// multiplies the matrix many times and one that multiplies it once.
+///
+/// Usage: simit-bench-reorder [box-size [repetitions [threads]]]
+int main(int argc, const char* argv[]) {
+  if (argc > 4) {
+    cerr << "Usage: simit-bench-reorder [box-size [repetitions [threads]]]"
+         << endl;
+    return 3;
+  }
+  int boxSize = (argc >= 2) ? atoi(argv[1]) : 40;
+  int repetitions = (argc >= 3) ? atoi(argv[2]) : 5;
+  int numThreads = (argc >= 4) ? atoi(argv[3]) : 1;
+
+  Settings settings;
+  settings.numThreads = numThreads;
+  init(settings);
+
+  Program program;
+  if (program.loadString(kProgram) != 0) {
+    cerr << program.getDiagnostics() << endl;
+    return 1;
+  }
+
+  struct Ordering {
+    string name;
+    bool reorder;
+    VertexOrderingHeuristic vertexHeuristic;
+    EdgeOrderingHeuristic edgeHeuristic;
+  };
+  vector<Ordering> orderings = {
+    {"scrambled",    false, HilbertOrder, SortedEndpointsOrder},
+    {"hilbert",      true,  HilbertOrder, SortedEndpointsOrder},
+    {"hilbert-min",  true,  HilbertOrder, MinEndpointOrder},
+    {"morton",       true,  MortonOrder, SortedEndpointsOrder},
+    {"morton-min",   true,  MortonOrder, MinEndpointOrder},
+    {"rcm",          true,  ReverseCuthillMcKeeOrder, SortedEndpointsOrder},
+    {"rcm-min",      true,  ReverseCuthillMcKeeOrder, MinEndpointOrder},
+  };
+
+  cout << left << setw(14) << "ordering" << right << setw(14) << "reorder"
+       << setw(14) << "assembly" << setw(14) << "spmv" << endl;
+  for (const Ordering& ordering : orderings) {
+    Set points;
+    Set springs(points,points);
+    createScrambledBox(&points, &springs, boxSize);
+
+    double reorderMs = 0.0;
+    if (ordering.reorder) {
+      vector<int> vertexOrdering;
+      vector<int> edgeOrdering;
+      auto start = chrono::steady_clock::now();
+      reorder(springs, points, ordering.vertexHeuristic,
+              ordering.edgeHeuristic, edgeOrdering, vertexOrdering);
+      auto end = chrono::steady_clock::now();
+      reorderMs = chrono::duration<double,milli>(end - start).count();
+    }
+
+    Function once = program.compile("once");
+    Function repeated = program.compile("repeated");
+    for (Function* function : {&once, &repeated}) {
+      function->bind("points", &points);
+      function->bind("springs", &springs);
+    }
+    double onceMs = time(once, repetitions);
+    double spmvMs = (time(repeated, repetitions) - onceMs) / (kNumSpmvs - 1);
+
+    cout << left << setw(14) << ordering.name << right << fixed
+         << setprecision(3) << setw(11) << reorderMs << " ms"
+         << setw(11) << onceMs - spmvMs << " ms"
+         << setw(11) << spmvMs << " ms" << endl;
+  }
+  return 0;
+}
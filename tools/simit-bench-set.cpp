@@ -0,0 +1,80 @@
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "graph.h"
+
+using namespace std;
+using namespace simit;
+
+/// Adds the fields of a typical simulation to a vertex set and an edge set.
+static void addFields(Set* points, Set* springs) {
+  points->addField<double,3>("x");
+  points->addField<double,3>("v");
+  points->addField<double>("m");
+  springs->addField<double>("k");
+  springs->addField<double>("l0");
+}
+
+/// Builds a set of `size` points and a set of `size` springs that connect
+/// consecutive points, adding the elements one at a time, one at a time after
+/// reserving room for them, or all at once. Returns the time in milliseconds.
+static double build(int size, const string& method) {
+  auto start = chrono::steady_clock::now();
+  Set points;
+  Set springs(points,points);
+  addFields(&points, &springs);
+
+  if (method == "add" || method == "reserve") {
+    if (method == "reserve") {
+      points.reserve(size);
+      springs.reserve(size);
+    }
+    vector<ElementRef> refs(size);
+    for (int i = 0; i < size; ++i) {
+      refs[i] = points.add();
+    }
+    for (int i = 0; i < size; ++i) {
+      springs.add(refs[i], refs[(i+1) % size]);
+    }
+  }
+  else {
+    points.addN(size);
+    vector<int> endpoints(2*size);
+    for (int i = 0; i < size; ++i) {
+      endpoints[2*i] = i;
+      endpoints[2*i+1] = (i+1) % size;
+    }
+    springs.addN(size, endpoints.data());
+  }
+  auto end = chrono::steady_clock::now();
+  return chrono::duration<double,milli>(end - start).count();
+}
+
+/// Times building large vertex and edge sets with fields, adding elements one
+/// at a time (Set::add), one at a time after Set::reserve, and in bulk
+/// (Set::addN).
+///
+/// Usage: simit-bench-set [size [repetitions]]
+int main(int argc, const char* argv[]) {
+  if (argc > 3) {
+    cerr << "Usage: simit-bench-set [size [repetitions]]" << endl;
+    return 3;
+  }
+  int size = (argc >= 2) ? atoi(argv[1]) : 10000000;
+  int repetitions = (argc >= 3) ? atoi(argv[2]) : 3;
+
+  cout << "points: " << size << ", springs: " << size << endl;
+  for (string method : {"add", "reserve", "addN"}) {
+    double total = 0.0;
+    for (int r = 0; r < repetitions; ++r) {
+      total += build(size, method);
+    }
+    cout << left << setw(10) << method << right << fixed << setprecision(3)
+         << setw(12) << total/repetitions << " ms" << endl;
+  }
+  return 0;
+}
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <string>
+
+#include "graph.h"
+#include "init.h"
+#include "mesh.h"
+#include "program.h"
+
+using namespace std;
+using namespace simit;
+
+/// Returns the text of the Simit program in `fileName`, with the element fields
+/// matching `fields` declared `soa` if `soa` is true.
+static string readProgram(const string& fileName, const string& fields,
+                          bool soa) {
+  ifstream file(fileName);
+  if (!file.good()) {
+    return "";
+  }
+  stringstream text;
+  text << file.rdbuf();
+  if (!soa) {
+    return text.str();
+  }
+  regex fieldDecl("\n([ \t]+)(" + fields + ")([ \t]*:)");
+  return regex_replace(text.str(), fieldDecl, "\n$1soa $2$3");
+}
+
+/// Returns the fastest of `repetitions` runs of `function`, in milliseconds.
+static double time(Function function, int repetitions) {
+  function.init();
+  double fastest = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    auto start = chrono::steady_clock::now();
+    function.run();
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double,milli>(end - start).count();
+    fastest = (r == 0) ? ms : min(fastest, ms);
+  }
+  return fastest;
+}
+
+/// Times a timestep of the explicit springs app on a box of springs.
+static double springs(const string& appsDir, bool soa, int boxSize,
+                      int repetitions) {
+  Program program;
+  if (program.loadString(readProgram(appsDir + "/springs/esprings.sim",
+                                     "x|v", soa)) != 0) {
+    cerr << program.getDiagnostics() << endl;
+    exit(1);
+  }
+
+  Set::FieldLayout layout = soa ? Set::SoA : Set::AoS;
+  Set points;
+  Set springs(points,points);
+  FieldRef<double,3> x = points.addField<double,3>("x", layout);
+  points.addField<double,3>("v", layout);
+  FieldRef<double> m = points.addField<double>("m");
+  points.addField<bool>("fixed");
+  FieldRef<double> k = springs.addField<double>("k");
+  FieldRef<double> l0 = springs.addField<double>("l0");
+  createBox(&points, &springs, boxSize, boxSize, boxSize);
+
+  int i = 0;
+  for (ElementRef point : points) {
+    x.set(point, {(double)(i % boxSize), (double)(i / boxSize % boxSize),
+                  (double)(i / boxSize / boxSize)});
+    m.set(point, 1.0);
+    ++i;
+  }
+  for (ElementRef spring : springs) {
+    k.set(spring, 1e4);
+    l0.set(spring, 1.0);
+  }
+
+  Function timestep = program.compile("timestep");
+  timestep.bind("points", &points);
+  timestep.bind("springs", &springs);
+  return time(timestep, repetitions);
+}
+
+/// Times a timestep of the linear FEM app on the tetrahedral bunny.
+static double fem(const string& appsDir, bool soa, int repetitions) {
+  Program program;
+  if (program.loadString(readProgram(appsDir + "/fem/fem_linear.sim",
+                                     "x|v|fe", soa)) != 0) {
+    cerr << program.getDiagnostics() << endl;
+    exit(1);
+  }
+
+  Set::FieldLayout layout = soa ? Set::SoA : Set::AoS;
+  Set verts;
+  Set tets(verts, verts, verts, verts);
+  verts.addField<double,3>("x", layout);
+  verts.addField<double,3>("v", layout);
+  verts.addField<double,3>("fe", layout);
+  verts.addField<int>("c");
+  FieldRef<double> m = verts.addField<double>("m");
+  FieldRef<double> u = tets.addField<double>("u");
+  FieldRef<double> l = tets.addField<double>("l");
+  tets.addField<double>("W");
+  tets.addField<double,3,3>("B");
+
+  string mesh = appsDir + "/data/tet-bunny/bunny.1";
+  if (loadTetSets(mesh + ".node", mesh + ".ele", &verts, &tets, "x") != 0) {
+    cerr << "Could not load " << mesh << endl;
+    exit(1);
+  }
+  for (ElementRef vert : verts) {
+    m.set(vert, 1.0);
+  }
+  for (ElementRef tet : tets) {
+    u.set(tet, 5e4);
+    l.set(tet, 1e5);
+  }
+
+  Function initializeTet = program.compile("initializeTet");
+  initializeTet.bind("verts", &verts);
+  initializeTet.bind("tets", &tets);
+  initializeTet.init();
+  initializeTet.run();
+
+  Function timestep = program.compile("main");
+  timestep.bind("verts", &verts);
+  timestep.bind("tets", &tets);
+  return time(timestep, repetitions);
+}
+
+/// Times a timestep of the springs and FEM apps with the vector fields of their
+/// vertices laid out as arrays of structures (AoS) and as structures of arrays
+/// (SoA).
+///
+/// Usage: simit-bench-soa apps-dir [box-size [repetitions [threads]]]
+int main(int argc, const char* argv[]) {
+  if (argc < 2 || argc > 5) {
+    cerr << "Usage: simit-bench-soa apps-dir [box-size [repetitions [threads]]]"
+         << endl;
+    return 3;
+  }
+  string appsDir = argv[1];
+  int boxSize = (argc >= 3) ? atoi(argv[2]) : 40;
+  int repetitions = (argc >= 4) ? atoi(argv[3]) : 10;
+  int numThreads = (argc >= 5) ? atoi(argv[4]) : 1;
+
+  Settings settings;
+  settings.numThreads = numThreads;
+  init(settings);
+
+  cout << left << setw(10) << "app" << right << setw(14) << "AoS"
+       << setw(14) << "SoA" << endl;
+  double springsTimes[2];
+  double femTimes[2];
+  for (bool soa : {false, true}) {
+    springsTimes[soa] = springs(appsDir, soa, boxSize, repetitions);
+    femTimes[soa] = fem(appsDir, soa, repetitions);
+  }
+  cout << fixed << setprecision(3);
+  cout << left << setw(10) << "springs" << right
+       << setw(11) << springsTimes[0] << " ms" << setw(11) << springsTimes[1]
+       << " ms" << endl;
+  cout << left << setw(10) << "fem" << right
+       << setw(11) << femTimes[0] << " ms" << setw(11) << femTimes[1]
+       << " ms" << endl;
+  return 0;
+}
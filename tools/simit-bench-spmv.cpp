@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "graph.h"
+#include "init.h"
+#include "program.h"
+
+using namespace std;
+using namespace simit;
+
+static const int kNumSpmvs = 50;
+
+/// Returns a program that assembles a matrix with blockSize x blockSize blocks
+/// from springs, and multiplies it by a vector once (`once`) or kNumSpmvs times
+/// (`repeated`).
+static string getProgram(int blockSize) {
+  string vectorType = (blockSize == 1) ? "float" :
+      "tensor[" + to_string(blockSize) + "](float)";
+  string blockType = (blockSize == 1) ? "float" :
+      "tensor[" + to_string(blockSize) + "," + to_string(blockSize) +
+      "](float)";
+
+  stringstream program;
+  program << "element Point\n"
+          << "  b : " << vectorType << ";\n"
+          << "  c : " << vectorType << ";\n"
+          << "end\n"
+          << "element Spring\n"
+          << "  a : " << blockType << ";\n"
+          << "end\n"
+          << "extern points  : set{Point};\n"
+          << "extern springs : set{Spring}(points,points);\n"
+          << "func dist_a(s : Spring, p : (Point*2)) ->\n"
+          << "    (M : tensor[points,points](" << blockType << "))\n"
+          << "  M(p(0),p(0)) = s.a;\n"
+          << "  M(p(0),p(1)) = s.a;\n"
+          << "  M(p(1),p(0)) = s.a;\n"
+          << "  M(p(1),p(1)) = s.a;\n"
+          << "end\n"
+          << "export func once()\n"
+          << "  A = map dist_a to springs reduce +;\n"
+          << "  points.c = A * points.b;\n"
+          << "end\n"
+          << "export func repeated()\n"
+          << "  A = map dist_a to springs reduce +;\n"
+          << "  for k in 0:" << kNumSpmvs << "\n"
+          << "    points.c = A * points.b;\n"
+          << "  end\n"
+          << "end\n";
+  return program.str();
+}
+
+/// Adds the fields of the program to the points and springs, and sets b and a
+/// to ones. `dims` is empty for scalars or the size of the vector blocks.
+template <typename T, int... dims>
+static void addFields(Set* points, Set* springs) {
+  points->addField<T,dims...>("b");
+  points->addField<T,dims...>("c");
+  springs->addField<T,dims...,dims...>("a");
+  int blockSize = 1;
+  for (int dim : {1, dims...}) {
+    blockSize *= dim;
+  }
+  fill_n((T*)points->getFieldData("b"), points->getSize()*blockSize, T(1));
+  fill_n((T*)springs->getFieldData("a"),
+         springs->getSize()*blockSize*blockSize, T(1));
+}
+
+/// Returns the fastest of `repetitions` runs of `function`, in milliseconds.
+static double time(Function function, int repetitions) {
+  function.init();
+  double fastest = 0.0;
+  for (int r = 0; r < repetitions; ++r) {
+    auto start = chrono::steady_clock::now();
+    function.run();
+    auto end = chrono::steady_clock::now();
+    double ms = chrono::duration<double,milli>(end - start).count();
+    fastest = (r == 0) ? ms : min(fastest, ms);
+  }
+  return fastest;
+}
+
+/// Times sparse matrix-vector products with 1x1, 3x3 and 4x4 blocks on a box
+/// of springs, lowered to the kernels specialized for the block shape and to
+/// generic index expression loops. The time of a product is the difference
+/// between a program that assembles the matrix and multiplies it many times and
+/// one that multiplies it once.
+///
+/// Usage: simit-bench-spmv [box-size [repetitions [threads]]]
+int main(int argc, const char* argv[]) {
+  if (argc > 4) {
+    cerr << "Usage: simit-bench-spmv [box-size [repetitions [threads]]]"
+         << endl;
+    return 3;
+  }
+  int boxSize = (argc >= 2) ? atoi(argv[1]) : 40;
+  int repetitions = (argc >= 3) ? atoi(argv[2]) : 5;
+  int numThreads = (argc >= 4) ? atoi(argv[3]) : 1;
+
+  cout << left << setw(8) << "block" << right << setw(12) << "nonzeros"
+       << setw(17) << "specialized" << setw(17) << "generic" << endl;
+  for (int blockSize : {1, 3, 4}) {
+    Set points;
+    Set springs(points,points);
+    createBox(&points, &springs, boxSize, boxSize, boxSize);
+    switch (blockSize) {
+      case 1:
+        addFields<double>(&points, &springs);
+        break;
+      case 3:
+        addFields<double,3>(&points, &springs);
+        break;
+      case 4:
+        addFields<double,4>(&points, &springs);
+        break;
+    }
+
+    // Each vertex has a diagonal block and a block per incident spring
+    double nonzeros = (points.getSize() + 2.0*springs.getSize())
+                      * blockSize * blockSize;
+
+    double gflops[2];
+    for (bool specialized : {true, false}) {
+      Settings settings;
+      settings.numThreads = numThreads;
+      settings.blockedSpmv = specialized;
+      init(settings);
+
+      Program program;
+      if (program.loadString(getProgram(blockSize)) != 0) {
+        cerr << program.getDiagnostics() << endl;
+        return 1;
+      }
+      Function once = program.compile("once");
+      Function repeated = program.compile("repeated");
+      for (Function* function : {&once, &repeated}) {
+        function->bind("points", &points);
+        function->bind("springs", &springs);
+      }
+      double ms = (time(repeated, repetitions) - time(once, repetitions))
+                  / (kNumSpmvs - 1);
+      gflops[specialized ? 0 : 1] = 2.0 * nonzeros / (ms * 1e6);
+    }
+
+    cout << left << setw(8) << (to_string(blockSize) + "x" +
+                                to_string(blockSize))
+         << right << setw(12) << (size_t)nonzeros << fixed << setprecision(3)
+         << setw(10) << gflops[0] << " GFLOP/s" << setw(10) << gflops[1]
+         << " GFLOP/s" << endl;
+  }
+  return 0;
+}